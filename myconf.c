@@ -166,4 +166,137 @@ int _tt_epoll_wait(int epfd, struct epoll_event *events, int maxevents, int time
 
 
 
+/*************************************************************************************************
+ * io_uring
+ *************************************************************************************************/
+
+
+#if defined(TTUSEURING)
+
+
+/* Check whether an operation is supported by an io_uring instance.
+   `fd' specifies the file descriptor of the ring.
+   `op' specifies the operation code.
+   The return value is true if the kernel reports that the operation is supported. */
+static bool _tt_uring_probe(int fd, int op){
+  int psiz = sizeof(struct io_uring_probe) + sizeof(struct io_uring_probe_op) * 256;
+  struct io_uring_probe *probe = tcmalloc(psiz);
+  memset(probe, 0, psiz);
+  bool rv = syscall(__NR_io_uring_register, fd, IORING_REGISTER_PROBE, probe, 256) == 0 &&
+    op <= probe->last_op && (probe->ops[op].flags & IO_URING_OP_SUPPORTED);
+  tcfree(probe);
+  return rv;
+}
+
+
+/* Create an io_uring instance. */
+TTURING *_tt_uring_new(int entries){
+  struct io_uring_params params;
+  memset(&params, 0, sizeof(params));
+  int fd = syscall(__NR_io_uring_setup, entries, &params);
+  if(fd == -1) return NULL;
+  if(!_tt_uring_probe(fd, IORING_OP_WRITEV)){
+    close(fd);
+    return NULL;
+  }
+  TTURING *ring = tcmalloc(sizeof(*ring));
+  ring->fd = fd;
+  ring->sqmsiz = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  ring->cqmsiz = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+  ring->sqesiz = params.sq_entries * sizeof(struct io_uring_sqe);
+  ring->sqmap = mmap(NULL, ring->sqmsiz, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                     fd, IORING_OFF_SQ_RING);
+  ring->cqmap = ring->sqmap != MAP_FAILED ?
+    mmap(NULL, ring->cqmsiz, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+         fd, IORING_OFF_CQ_RING) : MAP_FAILED;
+  ring->sqes = ring->cqmap != MAP_FAILED ?
+    mmap(NULL, ring->sqesiz, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+         fd, IORING_OFF_SQES) : MAP_FAILED;
+  if(ring->sqes == MAP_FAILED){
+    if(ring->cqmap != MAP_FAILED) munmap(ring->cqmap, ring->cqmsiz);
+    if(ring->sqmap != MAP_FAILED) munmap(ring->sqmap, ring->sqmsiz);
+    close(fd);
+    tcfree(ring);
+    return NULL;
+  }
+  char *sp = ring->sqmap;
+  ring->sqhead = (unsigned *)(sp + params.sq_off.head);
+  ring->sqtail = (unsigned *)(sp + params.sq_off.tail);
+  ring->sqmask = *(unsigned *)(sp + params.sq_off.ring_mask);
+  ring->sqarray = (unsigned *)(sp + params.sq_off.array);
+  char *cp = ring->cqmap;
+  ring->cqhead = (unsigned *)(cp + params.cq_off.head);
+  ring->cqtail = (unsigned *)(cp + params.cq_off.tail);
+  ring->cqmask = *(unsigned *)(cp + params.cq_off.ring_mask);
+  ring->cqes = (struct io_uring_cqe *)(cp + params.cq_off.cqes);
+  return ring;
+}
+
+
+/* Delete an io_uring instance. */
+void _tt_uring_del(TTURING *ring){
+  munmap(ring->sqes, ring->sqesiz);
+  munmap(ring->cqmap, ring->cqmsiz);
+  munmap(ring->sqmap, ring->sqmsiz);
+  close(ring->fd);
+  tcfree(ring);
+}
+
+
+/* Submit a task writing vectors to an io_uring instance. */
+bool _tt_uring_writev(TTURING *ring, int fd, const struct iovec *iov, int iovnum, off_t off,
+                      uint64_t data){
+  unsigned tail = *ring->sqtail;
+  __sync_synchronize();
+  if(tail - *ring->sqhead > ring->sqmask){
+    errno = EAGAIN;
+    return false;
+  }
+  unsigned idx = tail & ring->sqmask;
+  struct io_uring_sqe *sqe = ring->sqes + idx;
+  memset(sqe, 0, sizeof(*sqe));
+  sqe->opcode = IORING_OP_WRITEV;
+  sqe->fd = fd;
+  sqe->off = off;
+  sqe->addr = (uintptr_t)iov;
+  sqe->len = iovnum;
+  sqe->user_data = data;
+  ring->sqarray[idx] = idx;
+  __sync_synchronize();
+  *ring->sqtail = tail + 1;
+  while(syscall(__NR_io_uring_enter, ring->fd, 1, 0, 0, NULL, 0) == -1){
+    if(errno != EINTR) return false;
+  }
+  return true;
+}
+
+
+/* Fetch a completed task of an io_uring instance without waiting. */
+bool _tt_uring_peek(TTURING *ring, uint64_t *datap, int *resp){
+  unsigned head = *ring->cqhead;
+  __sync_synchronize();
+  if(head == *ring->cqtail) return false;
+  struct io_uring_cqe *cqe = ring->cqes + (head & ring->cqmask);
+  *datap = cqe->user_data;
+  *resp = cqe->res;
+  __sync_synchronize();
+  *ring->cqhead = head + 1;
+  return true;
+}
+
+
+/* Wait for a completed task of an io_uring instance. */
+bool _tt_uring_wait(TTURING *ring, uint64_t *datap, int *resp){
+  while(!_tt_uring_peek(ring, datap, resp)){
+    if(syscall(__NR_io_uring_enter, ring->fd, 0, 1, IORING_ENTER_GETEVENTS, NULL, 0) == -1 &&
+       errno != EINTR) return false;
+  }
+  return true;
+}
+
+
+#endif
+
+
+
 // END OF FILE
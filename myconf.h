@@ -195,6 +195,7 @@
 #include <sys/times.h>
 #include <sys/resource.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <sys/un.h>
 #include <sys/select.h>
 #include <fcntl.h>
@@ -235,6 +236,16 @@ typedef struct { int portev_object; } port_event_t;
 #include <sys/epoll.h>
 #endif
 
+#if defined(_SYS_LINUX_)
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#define TTUSEFUTEX     1
+#if defined(_MYURING)
+#include <linux/io_uring.h>
+#define TTUSEURING     1
+#endif
+#endif
+
 
 
 /*************************************************************************************************
@@ -313,6 +324,42 @@ int _tt_epoll_wait(int epfd, struct epoll_event *events, int maxevents, int time
 
 
 
+/*************************************************************************************************
+ * io_uring
+ *************************************************************************************************/
+
+
+#if defined(TTUSEURING)
+
+typedef struct {                         /* type of structure for an io_uring instance */
+  int fd;                                /* file descriptor of the ring */
+  void *sqmap;                           /* mapped region of the submission ring */
+  size_t sqmsiz;                         /* size of the mapped submission ring */
+  void *cqmap;                           /* mapped region of the completion ring */
+  size_t cqmsiz;                         /* size of the mapped completion ring */
+  struct io_uring_sqe *sqes;             /* array of submission entries */
+  size_t sqesiz;                         /* size of the array of submission entries */
+  volatile unsigned *sqhead;             /* head of the submission ring */
+  volatile unsigned *sqtail;             /* tail of the submission ring */
+  unsigned sqmask;                       /* mask of the submission ring */
+  unsigned *sqarray;                     /* index array of the submission ring */
+  volatile unsigned *cqhead;             /* head of the completion ring */
+  volatile unsigned *cqtail;             /* tail of the completion ring */
+  unsigned cqmask;                       /* mask of the completion ring */
+  struct io_uring_cqe *cqes;             /* array of completion entries */
+} TTURING;
+
+TTURING *_tt_uring_new(int entries);
+void _tt_uring_del(TTURING *ring);
+bool _tt_uring_writev(TTURING *ring, int fd, const struct iovec *iov, int iovnum, off_t off,
+                      uint64_t data);
+bool _tt_uring_peek(TTURING *ring, uint64_t *datap, int *resp);
+bool _tt_uring_wait(TTURING *ring, uint64_t *datap, int *resp);
+
+#endif
+
+
+
 /*************************************************************************************************
  * utilities for implementation
  *************************************************************************************************/
@@ -36,6 +36,7 @@ typedef struct _SCREXT {                 // type of structure of the script exte
   uint32_t sid;                          // server ID
   TCMDB *stash;                          // global stash object
   TCMDB *lock;                           // global lock object
+  TTMETRICS *metrics;                    // metrics registry object
   void (*logger)(int, const char *, void *);  // logging function
   void *logopq;                          // opaque pointer for the logging function
   bool term;                             // terminate flag
@@ -45,7 +46,7 @@ typedef struct _SCREXT {                 // type of structure of the script exte
 /* Initialize the global scripting language extension. */
 void *scrextnew(void **screxts, int thnum, int thid, const char *path,
                 TCADB *adb, TCULOG *ulog, uint32_t sid, TCMDB *stash, TCMDB *lock,
-                void (*logger)(int, const char *, void *), void *logopq){
+                TTMETRICS *metrics, void (*logger)(int, const char *, void *), void *logopq){
   SCREXT *scr = tcmalloc(sizeof(*scr));
   scr->screxts = (SCREXT **)screxts;
   scr->thnum = thnum;
@@ -56,6 +57,7 @@ void *scrextnew(void **screxts, int thnum, int thid, const char *path,
   scr->sid = sid;
   scr->stash = stash;
   scr->lock = lock;
+  scr->metrics = metrics;
   scr->logger = logger;
   scr->logopq = logopq;
   scr->term = false;
@@ -174,6 +176,7 @@ typedef struct {                         // type of structure of the server data
   uint32_t sid;                          // server ID
   TCMDB *stash;                          // global stash object
   TCMDB *lock;                           // global lock object
+  TTMETRICS *metrics;                    // metrics registry object
   pthread_mutex_t *lcks;                 // mutex for user locks
   int lcknum;                            // number of user locks
   void (*logger)(int, const char *, void *);  // logging function
@@ -187,6 +190,7 @@ static void reporterror(lua_State *lua);
 static bool iterrec(const void *kbuf, int ksiz, const void *vbuf, int vsiz, lua_State *lua);
 static int serv_eval(lua_State *lua);
 static int serv_log(lua_State *lua);
+static int serv_metric(lua_State *lua);
 static int serv_put(lua_State *lua);
 static int serv_putkeep(lua_State *lua);
 static int serv_putcat(lua_State *lua);
@@ -237,7 +241,7 @@ static int serv_mkdir(lua_State *lua);
 /* Initialize the global scripting language extension. */
 void *scrextnew(void **screxts, int thnum, int thid, const char *path,
                 TCADB *adb, TCULOG *ulog, uint32_t sid, TCMDB *stash, TCMDB *lock,
-                void (*logger)(int, const char *, void *), void *logopq){
+                TTMETRICS *metrics, void (*logger)(int, const char *, void *), void *logopq){
   char *ibuf;
   int isiz;
   if(*path == '@'){
@@ -266,12 +270,14 @@ void *scrextnew(void **screxts, int thnum, int thid, const char *path,
   serv->sid = sid;
   serv->stash = stash;
   serv->lock = lock;
+  serv->metrics = metrics;
   serv->logger = logger;
   serv->logopq = logopq;
   serv->term = false;
   lua_setglobal(lua, SERVVAR);
   lua_register(lua, "_eval", serv_eval);
   lua_register(lua, "_log", serv_log);
+  lua_register(lua, "_metric", serv_metric);
   lua_register(lua, "_put", serv_put);
   lua_register(lua, "_putkeep", serv_putkeep);
   lua_register(lua, "_putcat", serv_putcat);
@@ -535,6 +541,55 @@ static int serv_log(lua_State *lua){
 }
 
 
+/* for _metric function */
+static int serv_metric(lua_State *lua){
+  int argc = lua_gettop(lua);
+  if(argc < 1){
+    lua_pushstring(lua, "_metric: invalid arguments");
+    lua_error(lua);
+  }
+  const char *name = lua_tostring(lua, 1);
+  if(!name){
+    lua_pushstring(lua, "_metric: invalid arguments");
+    lua_error(lua);
+  }
+  lua_getglobal(lua, SERVVAR);
+  SERV *serv = lua_touserdata(lua, -1);
+  if(!serv->metrics){
+    lua_settop(lua, 0);
+    lua_pushnil(lua);
+    return 1;
+  }
+  int id;
+  if(argc > 1){
+    int type = TTMTCOUNTER;
+    if(argc > 2){
+      const char *tstr = lua_tostring(lua, 3);
+      if(!tstr){
+        lua_pushstring(lua, "_metric: invalid arguments");
+        lua_error(lua);
+      }
+      if(!tcstricmp(tstr, "gauge")){
+        type = TTMTGAUGE;
+      } else if(!tcstricmp(tstr, "bytes")){
+        type = TTMTBYTES;
+      }
+    }
+    id = ttmetricsreg(serv->metrics, name, type);
+    if(id >= 0) ttmetricsadd(serv->metrics, serv->thid, id, lua_tointeger(lua, 2));
+  } else {
+    id = ttmetricsfind(serv->metrics, name);
+  }
+  lua_settop(lua, 0);
+  if(id >= 0){
+    lua_pushnumber(lua, ttmetricssum(serv->metrics, id));
+  } else {
+    lua_pushnil(lua);
+  }
+  return 1;
+}
+
+
 /* for _put function */
 static int serv_put(lua_State *lua){
   int argc = lua_gettop(lua);
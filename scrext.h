@@ -53,12 +53,13 @@
    `sid' specifies the server ID.
    `stash' specifies the global stash object.
    `lock' specifies the global lock object.
+   `metrics' specifies the metrics registry object.  If it is `NULL', metrics are not available.
    `logger' specifies the pointer to a function to do with a log message.
    `logopq' specifies the opaque pointer for the logging function.
    The return value is the scripting object or `NULL' on failure. */
 void *scrextnew(void **screxts, int thnum, int thid, const char *path,
                 TCADB *adb, TCULOG *ulog, uint32_t sid, TCMDB *stash, TCMDB *lock,
-                void (*logger)(int, const char *, void *), void *logopq);
+                TTMETRICS *metrics, void (*logger)(int, const char *, void *), void *logopq);
 
 
 /* Destroy the scripting language extension.
@@ -44,6 +44,7 @@ static bool tcrdblockmethod(TCRDB *rdb);
 static void tcrdbunlockmethod(TCRDB *rdb);
 static bool tcrdbreconnect(TCRDB *rdb);
 static bool tcrdbsend(TCRDB *rdb, const void *buf, int size);
+static bool tcrdbsendtrace(TCRDB *rdb, const void *buf, int size);
 static bool tcrdbtuneimpl(TCRDB *rdb, double timeout, int opts);
 static bool tcrdbopenimpl(TCRDB *rdb, const char *host, int port);
 static bool tcrdbcloseimpl(TCRDB *rdb);
@@ -54,6 +55,9 @@ static bool tcrdbputshlimpl(TCRDB *rdb, const void *kbuf, int ksiz, const void *
                             int width);
 static bool tcrdbputnrimpl(TCRDB *rdb, const void *kbuf, int ksiz, const void *vbuf, int vsiz);
 static bool tcrdboutimpl(TCRDB *rdb, const void *kbuf, int ksiz);
+static bool tcrdbmputimpl(TCRDB *rdb, TCMAP *recs);
+static bool tcrdbmoutimpl(TCRDB *rdb, const TCLIST *keys);
+static bool tcrdbrecvmulti(TCRDB *rdb, int ecode);
 static void *tcrdbgetimpl(TCRDB *rdb, const void *kbuf, int ksiz, int *sp);
 static bool tcrdbmgetimpl(TCRDB *rdb, TCMAP *recs);
 static int tcrdbvsizimpl(TCRDB *rdb, const void *kbuf, int ksiz);
@@ -75,6 +79,11 @@ static uint64_t tcrdbrnumimpl(TCRDB *rdb);
 static uint64_t tcrdbsizeimpl(TCRDB *rdb);
 static char *tcrdbstatimpl(TCRDB *rdb);
 static TCLIST *tcrdbmiscimpl(TCRDB *rdb, const char *name, int opts, const TCLIST *args);
+static void tcrdbbatchhead(RDBBATCH *batch, int cmd, int ksiz);
+static bool tcrdbbatchexecimpl(TCRDB *rdb, RDBBATCH *batch);
+static int tcrdbcurnewimpl(TCRDB *rdb);
+static bool tcrdbcurcmdimpl(TCRDB *rdb, int cmd, int id, const void *kbuf, int ksiz);
+static TCLIST *tcrdbcurmoveimpl(TCRDB *rdb, int cmd, int id, int max, int bmax);
 static void tcrdbqrypopmeta(RDBQRY *qry, TCLIST *res);
 static void *tcrdbparasearchworker(PARASEARCHARG *arg);
 static long double tcrdbatof(const char *str);
@@ -327,6 +336,30 @@ bool tcrdbout2(TCRDB *rdb, const char *kstr){
 }
 
 
+/* Store records into a remote database object at once. */
+bool tcrdbmput(TCRDB *rdb, TCMAP *recs){
+  assert(rdb && recs);
+  if(!tcrdblockmethod(rdb)) return false;
+  bool rv;
+  pthread_cleanup_push((void (*)(void *))tcrdbunlockmethod, rdb);
+  rv = tcrdbmputimpl(rdb, recs);
+  pthread_cleanup_pop(1);
+  return rv;
+}
+
+
+/* Remove records of a remote database object at once. */
+bool tcrdbmout(TCRDB *rdb, const TCLIST *keys){
+  assert(rdb && keys);
+  if(!tcrdblockmethod(rdb)) return false;
+  bool rv;
+  pthread_cleanup_push((void (*)(void *))tcrdbunlockmethod, rdb);
+  rv = tcrdbmoutimpl(rdb, keys);
+  pthread_cleanup_pop(1);
+  return rv;
+}
+
+
 /* Retrieve a record in a remote database object. */
 void *tcrdbget(TCRDB *rdb, const void *kbuf, int ksiz, int *sp){
   assert(rdb && kbuf && ksiz >= 0 && sp);
@@ -618,6 +651,199 @@ TCLIST *tcrdbmisc(TCRDB *rdb, const char *name, int opts, const TCLIST *args){
 }
 
 
+/* Create a batch object. */
+RDBBATCH *tcrdbbatchnew(TCRDB *rdb){
+  assert(rdb);
+  RDBBATCH *batch = tcmalloc(sizeof(*batch));
+  batch->rdb = rdb;
+  batch->req = tcxstrnew();
+  batch->cmds = tcxstrnew();
+  batch->res = tclistnew();
+  return batch;
+}
+
+
+/* Delete a batch object. */
+void tcrdbbatchdel(RDBBATCH *batch){
+  assert(batch);
+  tclistdel(batch->res);
+  tcxstrdel(batch->cmds);
+  tcxstrdel(batch->req);
+  tcfree(batch);
+}
+
+
+/* Add a sub-command to store a record to a batch object. */
+void tcrdbbatchput(RDBBATCH *batch, const void *kbuf, int ksiz, const void *vbuf, int vsiz){
+  assert(batch && kbuf && ksiz >= 0 && vbuf && vsiz >= 0);
+  tcrdbbatchhead(batch, TTCMDPUT, ksiz);
+  uint32_t num = TTHTONL((uint32_t)vsiz);
+  tcxstrcat(batch->req, &num, sizeof(num));
+  tcxstrcat(batch->req, kbuf, ksiz);
+  tcxstrcat(batch->req, vbuf, vsiz);
+}
+
+
+/* Add a sub-command to remove a record to a batch object. */
+void tcrdbbatchout(RDBBATCH *batch, const void *kbuf, int ksiz){
+  assert(batch && kbuf && ksiz >= 0);
+  tcrdbbatchhead(batch, TTCMDOUT, ksiz);
+  tcxstrcat(batch->req, kbuf, ksiz);
+}
+
+
+/* Add a sub-command to retrieve a record to a batch object. */
+void tcrdbbatchget(RDBBATCH *batch, const void *kbuf, int ksiz){
+  assert(batch && kbuf && ksiz >= 0);
+  tcrdbbatchhead(batch, TTCMDGET, ksiz);
+  tcxstrcat(batch->req, kbuf, ksiz);
+}
+
+
+/* Add a sub-command to get the size of the value of a record to a batch object. */
+void tcrdbbatchvsiz(RDBBATCH *batch, const void *kbuf, int ksiz){
+  assert(batch && kbuf && ksiz >= 0);
+  tcrdbbatchhead(batch, TTCMDVSIZ, ksiz);
+  tcxstrcat(batch->req, kbuf, ksiz);
+}
+
+
+/* Add a sub-command to add an integer to a record to a batch object. */
+void tcrdbbatchaddint(RDBBATCH *batch, const void *kbuf, int ksiz, int num){
+  assert(batch && kbuf && ksiz >= 0);
+  tcrdbbatchhead(batch, TTCMDADDINT, ksiz);
+  uint32_t lnum = TTHTONL((uint32_t)num);
+  tcxstrcat(batch->req, &lnum, sizeof(lnum));
+  tcxstrcat(batch->req, kbuf, ksiz);
+}
+
+
+/* Add a sub-command to call a function of the script language extension to a batch object. */
+void tcrdbbatchext(RDBBATCH *batch, const char *name, int opts,
+                   const void *kbuf, int ksiz, const void *vbuf, int vsiz){
+  assert(batch && name && kbuf && ksiz >= 0 && vbuf && vsiz >= 0);
+  int nsiz = strlen(name);
+  tcrdbbatchhead(batch, TTCMDEXT, nsiz);
+  uint32_t num;
+  num = TTHTONL((uint32_t)opts);
+  tcxstrcat(batch->req, &num, sizeof(num));
+  num = TTHTONL((uint32_t)ksiz);
+  tcxstrcat(batch->req, &num, sizeof(num));
+  num = TTHTONL((uint32_t)vsiz);
+  tcxstrcat(batch->req, &num, sizeof(num));
+  tcxstrcat(batch->req, name, nsiz);
+  tcxstrcat(batch->req, kbuf, ksiz);
+  tcxstrcat(batch->req, vbuf, vsiz);
+}
+
+
+/* Execute the sub-commands of a batch object. */
+bool tcrdbbatchexec(RDBBATCH *batch){
+  assert(batch);
+  TCRDB *rdb = batch->rdb;
+  if(!tcrdblockmethod(rdb)) return false;
+  bool rv;
+  pthread_cleanup_push((void (*)(void *))tcrdbunlockmethod, rdb);
+  rv = tcrdbbatchexecimpl(rdb, batch);
+  pthread_cleanup_pop(1);
+  return rv;
+}
+
+
+/* Get the number of sub-commands of a batch object. */
+int tcrdbbatchnum(RDBBATCH *batch){
+  assert(batch);
+  return tcxstrsize(batch->cmds);
+}
+
+
+/* Get the result of a sub-command of a batch object. */
+const void *tcrdbbatchval(RDBBATCH *batch, int idx, int *sp){
+  assert(batch && sp);
+  if(idx < 0 || idx >= tclistnum(batch->res)) return NULL;
+  int rsiz;
+  const char *rbuf = tclistval(batch->res, idx, &rsiz);
+  if(rsiz < 1 || *rbuf != 0) return NULL;
+  *sp = rsiz - 1;
+  return rbuf + 1;
+}
+
+
+/* Create a cursor object. */
+RDBCUR *tcrdbcurnew(TCRDB *rdb){
+  assert(rdb);
+  if(!tcrdblockmethod(rdb)) return NULL;
+  int id;
+  pthread_cleanup_push((void (*)(void *))tcrdbunlockmethod, rdb);
+  id = tcrdbcurnewimpl(rdb);
+  pthread_cleanup_pop(1);
+  if(id < 1) return NULL;
+  RDBCUR *cur = tcmalloc(sizeof(*cur));
+  cur->rdb = rdb;
+  cur->id = id;
+  return cur;
+}
+
+
+/* Delete a cursor object. */
+void tcrdbcurdel(RDBCUR *cur){
+  assert(cur);
+  TCRDB *rdb = cur->rdb;
+  if(rdb->fd >= 0 && tcrdblockmethod(rdb)){
+    pthread_cleanup_push((void (*)(void *))tcrdbunlockmethod, rdb);
+    tcrdbcurcmdimpl(rdb, TTCMDCURDEL, cur->id, NULL, 0);
+    pthread_cleanup_pop(1);
+  }
+  tcfree(cur);
+}
+
+
+/* Move a cursor object to the front of records corresponding a key. */
+bool tcrdbcurjump(RDBCUR *cur, const void *kbuf, int ksiz){
+  assert(cur && kbuf && ksiz >= 0);
+  TCRDB *rdb = cur->rdb;
+  if(!tcrdblockmethod(rdb)) return false;
+  bool rv;
+  pthread_cleanup_push((void (*)(void *))tcrdbunlockmethod, rdb);
+  rv = tcrdbcurcmdimpl(rdb, TTCMDCURJUMP, cur->id, kbuf, ksiz);
+  pthread_cleanup_pop(1);
+  return rv;
+}
+
+
+/* Move a cursor object to the front of records corresponding a key string. */
+bool tcrdbcurjump2(RDBCUR *cur, const char *kstr){
+  assert(cur && kstr);
+  return tcrdbcurjump(cur, kstr, strlen(kstr));
+}
+
+
+/* Get records from the position of a cursor object forward. */
+TCLIST *tcrdbcurnext(RDBCUR *cur, int max, int bmax){
+  assert(cur && max >= 0);
+  TCRDB *rdb = cur->rdb;
+  if(!tcrdblockmethod(rdb)) return NULL;
+  TCLIST *rv;
+  pthread_cleanup_push((void (*)(void *))tcrdbunlockmethod, rdb);
+  rv = tcrdbcurmoveimpl(rdb, TTCMDCURNEXT, cur->id, max, bmax);
+  pthread_cleanup_pop(1);
+  return rv;
+}
+
+
+/* Get records from the position of a cursor object backward. */
+TCLIST *tcrdbcurprev(RDBCUR *cur, int max, int bmax){
+  assert(cur && max >= 0);
+  TCRDB *rdb = cur->rdb;
+  if(!tcrdblockmethod(rdb)) return NULL;
+  TCLIST *rv;
+  pthread_cleanup_push((void (*)(void *))tcrdbunlockmethod, rdb);
+  rv = tcrdbcurmoveimpl(rdb, TTCMDCURPREV, cur->id, max, bmax);
+  pthread_cleanup_pop(1);
+  return rv;
+}
+
+
 
 /*************************************************************************************************
  * table extension
@@ -1135,6 +1361,8 @@ static bool tcrdbreconnect(TCRDB *rdb){
    If successful, the return value is true, else, it is false. */
 static bool tcrdbsend(TCRDB *rdb, const void *buf, int size){
   assert(rdb && buf && size >= 0);
+  if((rdb->opts & RDBTTRACE) && size > 0 && *(unsigned char *)buf == TTMAGICNUM)
+    return tcrdbsendtrace(rdb, buf, size);
   if(ttsockcheckend(rdb->sock)){
     if(!(rdb->opts & RDBTRECON)) return false;
     tcsleep(RDBRECONWAIT);
@@ -1156,6 +1384,23 @@ static bool tcrdbsend(TCRDB *rdb, const void *buf, int size){
 }
 
 
+/* Send a command with the magic number to be traced.
+   `rdb' specifies the remote database object.
+   `buf' specifies the pointer to the region of the command.
+   `size' specifies the size of the region.
+   If successful, the return value is true, else, it is false. */
+static bool tcrdbsendtrace(TCRDB *rdb, const void *buf, int size){
+  assert(rdb && buf && size > 0);
+  char stack[TTIOBUFSIZ];
+  char *tbuf = (size < TTIOBUFSIZ) ? stack : tcmalloc(size);
+  memcpy(tbuf, buf, size);
+  *(unsigned char *)tbuf = TTMAGICTRACE;
+  bool rv = tcrdbsend(rdb, tbuf, size);
+  if(tbuf != stack) tcfree(tbuf);
+  return rv;
+}
+
+
 /* Set the tuning parameters of a remote database object.
    `rdb' specifies the remote database object.
    `timeout' specifies the timeout of each query in seconds.
@@ -1519,6 +1764,114 @@ static bool tcrdboutimpl(TCRDB *rdb, const void *kbuf, int ksiz){
 }
 
 
+/* Store records into a remote database object at once.
+   `rdb' specifies the remote database object.
+   `recs' specifies a map object containing the keys and the values of the records.
+   If successful, the return value is true, else, it is false. */
+static bool tcrdbmputimpl(TCRDB *rdb, TCMAP *recs){
+  assert(rdb && recs);
+  if(rdb->fd < 0){
+    if(!rdb->host || !(rdb->opts & RDBTRECON)){
+      tcrdbsetecode(rdb, TTEINVALID);
+      return false;
+    }
+    if(!tcrdbreconnect(rdb)) return false;
+  }
+  bool err = false;
+  TCXSTR *xstr = tcxstrnew();
+  pthread_cleanup_push((void (*)(void *))tcxstrdel, xstr);
+  uint8_t magic[2];
+  magic[0] = TTMAGICNUM;
+  magic[1] = TTCMDMPUT;
+  tcxstrcat(xstr, magic, sizeof(magic));
+  uint32_t num;
+  num = (uint32_t)tcmaprnum(recs);
+  num = TTHTONL(num);
+  tcxstrcat(xstr, &num, sizeof(num));
+  tcmapiterinit(recs);
+  const char *kbuf;
+  int ksiz;
+  while((kbuf = tcmapiternext(recs, &ksiz)) != NULL){
+    int vsiz;
+    const char *vbuf = tcmapiterval(kbuf, &vsiz);
+    num = TTHTONL((uint32_t)ksiz);
+    tcxstrcat(xstr, &num, sizeof(num));
+    num = TTHTONL((uint32_t)vsiz);
+    tcxstrcat(xstr, &num, sizeof(num));
+    tcxstrcat(xstr, kbuf, ksiz);
+    tcxstrcat(xstr, vbuf, vsiz);
+  }
+  if(tcrdbsend(rdb, tcxstrptr(xstr), tcxstrsize(xstr))){
+    if(!tcrdbrecvmulti(rdb, TTEMISC)) err = true;
+  } else {
+    err = true;
+  }
+  pthread_cleanup_pop(1);
+  return !err;
+}
+
+
+/* Remove records of a remote database object at once.
+   `rdb' specifies the remote database object.
+   `keys' specifies a list object containing the keys of the records.
+   If successful, the return value is true, else, it is false. */
+static bool tcrdbmoutimpl(TCRDB *rdb, const TCLIST *keys){
+  assert(rdb && keys);
+  if(rdb->fd < 0){
+    if(!rdb->host || !(rdb->opts & RDBTRECON)){
+      tcrdbsetecode(rdb, TTEINVALID);
+      return false;
+    }
+    if(!tcrdbreconnect(rdb)) return false;
+  }
+  bool err = false;
+  TCXSTR *xstr = tcxstrnew();
+  pthread_cleanup_push((void (*)(void *))tcxstrdel, xstr);
+  uint8_t magic[2];
+  magic[0] = TTMAGICNUM;
+  magic[1] = TTCMDMOUT;
+  tcxstrcat(xstr, magic, sizeof(magic));
+  int knum = tclistnum(keys);
+  uint32_t num;
+  num = TTHTONL((uint32_t)knum);
+  tcxstrcat(xstr, &num, sizeof(num));
+  for(int i = 0; i < knum; i++){
+    int ksiz;
+    const char *kbuf = tclistval(keys, i, &ksiz);
+    num = TTHTONL((uint32_t)ksiz);
+    tcxstrcat(xstr, &num, sizeof(num));
+    tcxstrcat(xstr, kbuf, ksiz);
+  }
+  if(tcrdbsend(rdb, tcxstrptr(xstr), tcxstrsize(xstr))){
+    if(!tcrdbrecvmulti(rdb, TTENOREC)) err = true;
+  } else {
+    err = true;
+  }
+  pthread_cleanup_pop(1);
+  return !err;
+}
+
+
+/* Receive the response of a command on multiple records.
+   `rdb' specifies the remote database object.
+   `ecode' specifies the error code set when some records are not processed.
+   If all records are processed, the return value is true, else, it is false. */
+static bool tcrdbrecvmulti(TCRDB *rdb, int ecode){
+  assert(rdb);
+  int code = ttsockgetc(rdb->sock);
+  ttsockgetint32(rdb->sock);
+  if(code == -1 || ttsockcheckend(rdb->sock)){
+    tcrdbsetecode(rdb, TTERECV);
+    return false;
+  }
+  if(code != 0){
+    tcrdbsetecode(rdb, ecode);
+    return false;
+  }
+  return true;
+}
+
+
 /* Retrieve a record in a remote database object.
    `rdb' specifies the remote database object.
    `kbuf' specifies the pointer to the region of the key.
@@ -2461,6 +2814,266 @@ static TCLIST *tcrdbmiscimpl(TCRDB *rdb, const char *name, int opts, const TCLIS
 }
 
 
+/* Add the command ID and the first size of a sub-command to a batch object.
+   `batch' specifies the batch object.
+   `cmd' specifies the command ID.
+   `ksiz' specifies the first size. */
+static void tcrdbbatchhead(RDBBATCH *batch, int cmd, int ksiz){
+  assert(batch && ksiz >= 0);
+  uint8_t code = cmd;
+  tcxstrcat(batch->cmds, &code, sizeof(code));
+  tcxstrcat(batch->req, &code, sizeof(code));
+  uint32_t num = TTHTONL((uint32_t)ksiz);
+  tcxstrcat(batch->req, &num, sizeof(num));
+}
+
+
+/* Execute the sub-commands of a batch object.
+   `rdb' specifies the remote database object.
+   `batch' specifies the batch object.
+   If successful, the return value is true, else, it is false. */
+static bool tcrdbbatchexecimpl(TCRDB *rdb, RDBBATCH *batch){
+  assert(rdb && batch);
+  if(rdb->fd < 0){
+    if(!rdb->host || !(rdb->opts & RDBTRECON)){
+      tcrdbsetecode(rdb, TTEINVALID);
+      return false;
+    }
+    if(!tcrdbreconnect(rdb)) return false;
+  }
+  tclistclear(batch->res);
+  bool err = false;
+  const unsigned char *cmds = tcxstrptr(batch->cmds);
+  int cnum = tcxstrsize(batch->cmds);
+  TCXSTR *xstr = tcxstrnew3(tcxstrsize(batch->req) + sizeof(uint8_t) * 2 + sizeof(uint32_t));
+  pthread_cleanup_push((void (*)(void *))tcxstrdel, xstr);
+  uint8_t magic[2];
+  magic[0] = TTMAGICNUM;
+  magic[1] = TTCMDBATCH;
+  tcxstrcat(xstr, magic, sizeof(magic));
+  uint32_t num = TTHTONL((uint32_t)cnum);
+  tcxstrcat(xstr, &num, sizeof(num));
+  tcxstrcat(xstr, tcxstrptr(batch->req), tcxstrsize(batch->req));
+  if(tcrdbsend(rdb, tcxstrptr(xstr), tcxstrsize(xstr))){
+    int code = ttsockgetc(rdb->sock);
+    if(code == 0){
+      int rnum = ttsockgetint32(rdb->sock);
+      if(!ttsockcheckend(rdb->sock) && rnum == cnum){
+        char stack[TTIOBUFSIZ];
+        for(int i = 0; !err && i < rnum; i++){
+          code = ttsockgetc(rdb->sock);
+          if(code == -1){
+            err = true;
+            break;
+          }
+          *stack = code;
+          if(code != 0){
+            tclistpush(batch->res, stack, 1);
+            continue;
+          }
+          int vsiz;
+          switch(cmds[i]){
+            case TTCMDGET:
+            case TTCMDEXT:
+              vsiz = ttsockgetint32(rdb->sock);
+              if(ttsockcheckend(rdb->sock) || vsiz < 0){
+                err = true;
+              } else {
+                char *buf = (vsiz < TTIOBUFSIZ - 1) ? stack : tcmalloc(vsiz + 1);
+                *buf = 0;
+                if(ttsockrecv(rdb->sock, buf + 1, vsiz) && !ttsockcheckend(rdb->sock)){
+                  tclistpush(batch->res, buf, vsiz + 1);
+                } else {
+                  err = true;
+                }
+                if(buf != stack) tcfree(buf);
+              }
+              break;
+            case TTCMDVSIZ:
+            case TTCMDADDINT:
+              vsiz = ttsockgetint32(rdb->sock);
+              if(ttsockcheckend(rdb->sock)){
+                err = true;
+              } else {
+                vsiz = sprintf(stack + 1, "%d", vsiz);
+                tclistpush(batch->res, stack, vsiz + 1);
+              }
+              break;
+            default:
+              tclistpush(batch->res, stack, 1);
+              break;
+          }
+        }
+      } else {
+        err = true;
+      }
+      if(err) tcrdbsetecode(rdb, TTERECV);
+    } else {
+      tcrdbsetecode(rdb, code == -1 ? TTERECV : TTEMISC);
+      err = true;
+    }
+  } else {
+    err = true;
+  }
+  pthread_cleanup_pop(1);
+  return !err;
+}
+
+
+/* Create a cursor on the server.
+   `rdb' specifies the remote database object.
+   The return value is the ID number of the new cursor or 0 on failure. */
+static int tcrdbcurnewimpl(TCRDB *rdb){
+  assert(rdb);
+  if(rdb->fd < 0){
+    if(!rdb->host || !(rdb->opts & RDBTRECON)){
+      tcrdbsetecode(rdb, TTEINVALID);
+      return 0;
+    }
+    if(!tcrdbreconnect(rdb)) return 0;
+  }
+  int id = 0;
+  unsigned char buf[TTIOBUFSIZ];
+  unsigned char *wp = buf;
+  *(wp++) = TTMAGICNUM;
+  *(wp++) = TTCMDCURNEW;
+  if(tcrdbsend(rdb, buf, wp - buf)){
+    int code = ttsockgetc(rdb->sock);
+    id = ttsockgetint32(rdb->sock);
+    if(ttsockcheckend(rdb->sock)){
+      tcrdbsetecode(rdb, TTERECV);
+      id = 0;
+    } else if(code != 0 || id < 1){
+      tcrdbsetecode(rdb, TTEMISC);
+      id = 0;
+    }
+  }
+  return id;
+}
+
+
+/* Send a command about a cursor whose response is the status code only.
+   `rdb' specifies the remote database object.
+   `cmd' specifies the command ID.
+   `id' specifies the ID number of the cursor.
+   `kbuf' specifies the pointer to the region of the key or `NULL' if no key is sent.
+   `ksiz' specifies the size of the region of the key.
+   If successful, the return value is true, else, it is false. */
+static bool tcrdbcurcmdimpl(TCRDB *rdb, int cmd, int id, const void *kbuf, int ksiz){
+  assert(rdb && ksiz >= 0);
+  if(rdb->fd < 0){
+    tcrdbsetecode(rdb, TTEINVALID);
+    return false;
+  }
+  bool err = false;
+  int rsiz = 2 + sizeof(uint32_t) * 2 + ksiz;
+  unsigned char stack[TTIOBUFSIZ];
+  unsigned char *buf = (rsiz < TTIOBUFSIZ) ? stack : tcmalloc(rsiz);
+  pthread_cleanup_push(free, (buf == stack) ? NULL : buf);
+  unsigned char *wp = buf;
+  *(wp++) = TTMAGICNUM;
+  *(wp++) = cmd;
+  uint32_t num;
+  num = TTHTONL((uint32_t)id);
+  memcpy(wp, &num, sizeof(num));
+  wp += sizeof(num);
+  if(kbuf){
+    num = TTHTONL((uint32_t)ksiz);
+    memcpy(wp, &num, sizeof(num));
+    wp += sizeof(num);
+    memcpy(wp, kbuf, ksiz);
+    wp += ksiz;
+  }
+  if(tcrdbsend(rdb, buf, wp - buf)){
+    int code = ttsockgetc(rdb->sock);
+    if(code != 0){
+      tcrdbsetecode(rdb, code == -1 ? TTERECV : TTEMISC);
+      err = true;
+    }
+  } else {
+    err = true;
+  }
+  pthread_cleanup_pop(1);
+  return !err;
+}
+
+
+/* Get records from the position of a cursor on the server.
+   `rdb' specifies the remote database object.
+   `cmd' specifies the command ID.
+   `id' specifies the ID number of the cursor.
+   `max' specifies the maximum number of records.
+   `bmax' specifies the rough limit of the total size of the records.
+   If successful, the return value is a list object of the keys and the values of the records,
+   else, it is `NULL'. */
+static TCLIST *tcrdbcurmoveimpl(TCRDB *rdb, int cmd, int id, int max, int bmax){
+  assert(rdb && max >= 0);
+  if(rdb->fd < 0){
+    tcrdbsetecode(rdb, TTEINVALID);
+    return NULL;
+  }
+  TCLIST *res = NULL;
+  bool err = false;
+  unsigned char buf[TTIOBUFSIZ];
+  unsigned char *wp = buf;
+  *(wp++) = TTMAGICNUM;
+  *(wp++) = cmd;
+  uint32_t num;
+  num = TTHTONL((uint32_t)id);
+  memcpy(wp, &num, sizeof(num));
+  wp += sizeof(num);
+  num = TTHTONL((uint32_t)max);
+  memcpy(wp, &num, sizeof(num));
+  wp += sizeof(num);
+  num = TTHTONL((uint32_t)bmax);
+  memcpy(wp, &num, sizeof(num));
+  wp += sizeof(num);
+  if(tcrdbsend(rdb, buf, wp - buf)){
+    int code = ttsockgetc(rdb->sock);
+    int rnum = ttsockgetint32(rdb->sock);
+    if(ttsockcheckend(rdb->sock)){
+      tcrdbsetecode(rdb, TTERECV);
+      err = true;
+    } else if(code == 0){
+      if(rnum >= 0){
+        res = tclistnew2(rnum * 2 + 1);
+        char stack[TTIOBUFSIZ];
+        for(int i = 0; !err && i < rnum; i++){
+          int ksiz = ttsockgetint32(rdb->sock);
+          int vsiz = ttsockgetint32(rdb->sock);
+          if(ttsockcheckend(rdb->sock) || ksiz < 0 || vsiz < 0){
+            err = true;
+            break;
+          }
+          int rsiz = ksiz + vsiz;
+          char *rbuf = (rsiz < TTIOBUFSIZ) ? stack : tcmalloc(rsiz + 1);
+          if(ttsockrecv(rdb->sock, rbuf, rsiz) && !ttsockcheckend(rdb->sock)){
+            tclistpush(res, rbuf, ksiz);
+            tclistpush(res, rbuf + ksiz, vsiz);
+          } else {
+            err = true;
+          }
+          if(rbuf != stack) tcfree(rbuf);
+        }
+      } else {
+        err = true;
+      }
+      if(err) tcrdbsetecode(rdb, TTERECV);
+    } else {
+      tcrdbsetecode(rdb, TTEMISC);
+      err = true;
+    }
+  } else {
+    err = true;
+  }
+  if(res && err){
+    tclistdel(res);
+    res = NULL;
+  }
+  return res;
+}
+
+
 /* Pop meta data from the result list to the member of the query object.
    `qry' specifies the query object.
    `res' specifies the list object of the primary keys. */
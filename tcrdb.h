@@ -61,7 +61,8 @@ enum {                                   /* enumeration for error codes */
 };
 
 enum {                                   /* enumeration for tuning options */
-  RDBTRECON = 1 << 0                     /* reconnect automatically */
+  RDBTRECON = 1 << 0,                    /* reconnect automatically */
+  RDBTTRACE = 1 << 1                     /* mark each command to be traced */
 };
 
 enum {                                   /* enumeration for scripting extension options */
@@ -77,6 +78,18 @@ enum {                                   /* enumeration for miscellaneous operat
   RDBMONOULOG = 1 << 0                   /* omission of update log */
 };
 
+typedef struct {                         /* type of structure for a batch */
+  TCRDB *rdb;                            /* database object */
+  TCXSTR *req;                           /* serialized sub-commands */
+  TCXSTR *cmds;                          /* command IDs of the sub-commands */
+  TCLIST *res;                           /* results of the sub-commands */
+} RDBBATCH;
+
+typedef struct {                         /* type of structure for a cursor */
+  TCRDB *rdb;                            /* database object */
+  int id;                                /* ID number */
+} RDBCUR;
+
 
 /* Get the message string corresponding to an error code.
    `ecode' specifies the error code.
@@ -109,7 +122,8 @@ int tcrdbecode(TCRDB *rdb);
    `timeout' specifies the timeout of each query in seconds.  If it is not more than 0, the
    timeout is not specified.
    `opts' specifies options by bitwise-or: `RDBTRECON' specifies that the connection is recovered
-   automatically when it is disconnected.
+   automatically when it is disconnected, `RDBTTRACE' specifies that each command is marked to be
+   traced by the request tracer of the server regardless of its sampling rate.
    If successful, the return value is true, else, it is false.
    Note that the tuning parameters should be set before the database is opened. */
 bool tcrdbtune(TCRDB *rdb, double timeout, int opts);
@@ -257,6 +271,26 @@ bool tcrdbout(TCRDB *rdb, const void *kbuf, int ksiz);
 bool tcrdbout2(TCRDB *rdb, const char *kstr);
 
 
+/* Store records into a remote database object at once.
+   `rdb' specifies the remote database object.
+   `recs' specifies a map object containing the keys and the values of the records.
+   If successful, the return value is true, else, it is false.  False is returned if any record
+   is not stored.
+   Existing records with the same keys are overwritten.  The records are applied with the locks
+   of themselves only and logged as one entry of the update log. */
+bool tcrdbmput(TCRDB *rdb, TCMAP *recs);
+
+
+/* Remove records of a remote database object at once.
+   `rdb' specifies the remote database object.
+   `keys' specifies a list object containing the keys of the records.
+   If successful, the return value is true, else, it is false.  False is returned if any record
+   does not exist.
+   The records are removed with the locks of themselves only and logged as one entry of the
+   update log. */
+bool tcrdbmout(TCRDB *rdb, const TCLIST *keys);
+
+
 /* Retrieve a record in a remote database object.
    `rdb' specifies the remote database object.
    `kbuf' specifies the pointer to the region of the key.
@@ -531,6 +565,169 @@ char *tcrdbstat(TCRDB *rdb);
 TCLIST *tcrdbmisc(TCRDB *rdb, const char *name, int opts, const TCLIST *args);
 
 
+/* Create a batch object.
+   `rdb' specifies the remote database object.
+   The return value is the new batch object.
+   A batch object carries sub-commands which are sent in one request and whose results are
+   received in one response. */
+RDBBATCH *tcrdbbatchnew(TCRDB *rdb);
+
+
+/* Delete a batch object.
+   `batch' specifies the batch object. */
+void tcrdbbatchdel(RDBBATCH *batch);
+
+
+/* Add a sub-command to store a record to a batch object.
+   `batch' specifies the batch object.
+   `kbuf' specifies the pointer to the region of the key.
+   `ksiz' specifies the size of the region of the key.
+   `vbuf' specifies the pointer to the region of the value.
+   `vsiz' specifies the size of the region of the value.
+   The result of the sub-command is an empty region. */
+void tcrdbbatchput(RDBBATCH *batch, const void *kbuf, int ksiz, const void *vbuf, int vsiz);
+
+
+/* Add a sub-command to remove a record to a batch object.
+   `batch' specifies the batch object.
+   `kbuf' specifies the pointer to the region of the key.
+   `ksiz' specifies the size of the region of the key.
+   The result of the sub-command is an empty region. */
+void tcrdbbatchout(RDBBATCH *batch, const void *kbuf, int ksiz);
+
+
+/* Add a sub-command to retrieve a record to a batch object.
+   `batch' specifies the batch object.
+   `kbuf' specifies the pointer to the region of the key.
+   `ksiz' specifies the size of the region of the key.
+   The result of the sub-command is the value of the record. */
+void tcrdbbatchget(RDBBATCH *batch, const void *kbuf, int ksiz);
+
+
+/* Add a sub-command to get the size of the value of a record to a batch object.
+   `batch' specifies the batch object.
+   `kbuf' specifies the pointer to the region of the key.
+   `ksiz' specifies the size of the region of the key.
+   The result of the sub-command is the decimal string of the size. */
+void tcrdbbatchvsiz(RDBBATCH *batch, const void *kbuf, int ksiz);
+
+
+/* Add a sub-command to add an integer to a record to a batch object.
+   `batch' specifies the batch object.
+   `kbuf' specifies the pointer to the region of the key.
+   `ksiz' specifies the size of the region of the key.
+   `num' specifies the additional value.
+   The result of the sub-command is the decimal string of the summation. */
+void tcrdbbatchaddint(RDBBATCH *batch, const void *kbuf, int ksiz, int num);
+
+
+/* Add a sub-command to call a function of the script language extension to a batch object.
+   `batch' specifies the batch object.
+   `name' specifies the function name.
+   `opts' specifies options by bitwise-or: `RDBXOLCKREC' for record locking, `RDBXOLCKGLB' for
+   global locking.
+   `kbuf' specifies the pointer to the region of the key.
+   `ksiz' specifies the size of the region of the key.
+   `vbuf' specifies the pointer to the region of the value.
+   `vsiz' specifies the size of the region of the value.
+   The result of the sub-command is the response of the function. */
+void tcrdbbatchext(RDBBATCH *batch, const char *name, int opts,
+                   const void *kbuf, int ksiz, const void *vbuf, int vsiz);
+
+
+/* Execute the sub-commands of a batch object.
+   `batch' specifies the batch object.
+   If successful, the return value is true, else, it is false.  True is returned even if some
+   sub-commands fail, whose results can be checked with `tcrdbbatchval'.
+   The sub-commands are performed in order.  Write sub-commands between calls of the script
+   language extension take the locks of their records at once.  The sub-commands are kept in
+   the object and can be executed again. */
+bool tcrdbbatchexec(RDBBATCH *batch);
+
+
+/* Get the number of sub-commands of a batch object.
+   `batch' specifies the batch object.
+   The return value is the number of sub-commands. */
+int tcrdbbatchnum(RDBBATCH *batch);
+
+
+/* Get the result of a sub-command of a batch object.
+   `batch' specifies the batch object.
+   `idx' specifies the index of the sub-command.
+   `sp' specifies the pointer to the variable into which the size of the region of the return
+   value is assigned.
+   The return value is the pointer to the region of the result of the last execution.  `NULL'
+   is returned if the sub-command failed or the index is out of bounds.
+   Because an additional zero code is appended at the end of the region of the return value,
+   the return value can be treated as a character string. */
+const void *tcrdbbatchval(RDBBATCH *batch, int idx, int *sp);
+
+
+/* Create a cursor object.
+   `rdb' specifies the remote database object.
+   The return value is the new cursor object or `NULL' on failure.
+   A cursor belongs to the connection of the remote database object and is positioned at the
+   first record.  It is independent of the other cursors and of the iterator of the database.
+   It is discarded when the connection is closed.
+   Each connection can have 16 cursors at most. */
+RDBCUR *tcrdbcurnew(TCRDB *rdb);
+
+
+/* Delete a cursor object.
+   `cur' specifies the cursor object. */
+void tcrdbcurdel(RDBCUR *cur);
+
+
+/* Move a cursor object to the front of records corresponding a key.
+   `cur' specifies the cursor object.
+   `kbuf' specifies the pointer to the region of the key.
+   `ksiz' specifies the size of the region of the key.
+   If successful, the return value is true, else, it is false.
+   For B+ tree databases, the cursor is set to the first record corresponding the key or the
+   next substitute if completely matching record does not exist.  For the other databases, the
+   traversal is resumed at the record of the key, which should exist. */
+bool tcrdbcurjump(RDBCUR *cur, const void *kbuf, int ksiz);
+
+
+/* Move a cursor object to the front of records corresponding a key string.
+   `cur' specifies the cursor object.
+   `kstr' specifies the string of the key.
+   If successful, the return value is true, else, it is false. */
+bool tcrdbcurjump2(RDBCUR *cur, const char *kstr);
+
+
+/* Get records from the position of a cursor object forward.
+   `cur' specifies the cursor object.
+   `max' specifies the maximum number of records.
+   `bmax' specifies the rough limit of the total size of the records.  If it is not more than 0,
+   the limit is not specified.
+   If successful, the return value is a list object of the keys and the values of the records
+   one after the other, else, it is `NULL'.  An empty list is returned at the end of the
+   database.
+   The cursor is moved past the returned records.  The order of records is that of the iterator
+   of the database.  For the other databases than B+ tree, the traversal is resumed at the first
+   remaining one of the records following the last returned one, so that removed records are
+   skipped.  It fails only if the eight records following the last returned one have all been
+   removed.
+   Because the object of the return value is created with the function `tclistnew', it should
+   be deleted with the function `tclistdel' when it is no longer in use. */
+TCLIST *tcrdbcurnext(RDBCUR *cur, int max, int bmax);
+
+
+/* Get records from the position of a cursor object backward.
+   `cur' specifies the cursor object.
+   `max' specifies the maximum number of records.
+   `bmax' specifies the rough limit of the total size of the records.  If it is not more than 0,
+   the limit is not specified.
+   If successful, the return value is a list object of the keys and the values of the records
+   one after the other, else, it is `NULL'.  An empty list is returned at the beginning of the
+   database.
+   This function is supported by B+ tree databases only.
+   Because the object of the return value is created with the function `tclistnew', it should
+   be deleted with the function `tclistdel' when it is no longer in use. */
+TCLIST *tcrdbcurprev(RDBCUR *cur, int max, int bmax);
+
+
 
 /*************************************************************************************************
  * table extension
@@ -48,6 +48,7 @@ static int runoptimize(int argc, char **argv);
 static int runvanish(int argc, char **argv);
 static int runcopy(int argc, char **argv);
 static int runmisc(int argc, char **argv);
+static int runslowlog(int argc, char **argv);
 static int runimporttsv(int argc, char **argv);
 static int runrestore(int argc, char **argv);
 static int runsetmst(int argc, char **argv);
@@ -72,6 +73,7 @@ static int procvanish(const char *host, int port);
 static int proccopy(const char *host, int port, const char *dpath);
 static int procmisc(const char *host, int port, const char *func, int opts,
                     const TCLIST *args, int sep, bool px);
+static int procslowlog(const char *host, int port, int max, const TCLIST *ths);
 static int procimporttsv(const char *host, int port, const char *file, bool nr,
                          bool sc, int sep);
 static int procrestore(const char *host, int port, const char *upath, uint64_t ts, int opts);
@@ -112,6 +114,8 @@ int main(int argc, char **argv){
     rv = runcopy(argc, argv);
   } else if(!strcmp(argv[1], "misc")){
     rv = runmisc(argc, argv);
+  } else if(!strcmp(argv[1], "slowlog")){
+    rv = runslowlog(argc, argv);
   } else if(!strcmp(argv[1], "importtsv")){
     rv = runimporttsv(argc, argv);
   } else if(!strcmp(argv[1], "restore")){
@@ -152,6 +156,7 @@ static void usage(void){
   fprintf(stderr, "  %s copy [-port num] host dpath\n", g_progname);
   fprintf(stderr, "  %s misc [-port num] [-mnu] [-sx] [-sep chr] [-px] host func [arg...]\n",
           g_progname);
+  fprintf(stderr, "  %s slowlog [-port num] [-th name msec] host [num]\n", g_progname);
   fprintf(stderr, "  %s importtsv [-port num] [-nr] [-sc] [-sep chr] host [file]\n", g_progname);
   fprintf(stderr, "  %s restore [-port num] [-ts num] [-rcc] host upath\n", g_progname);
   fprintf(stderr, "  %s setmst [-port num] [-mport num] [-ts num] [-rcc] host [mhost]\n",
@@ -771,6 +776,40 @@ static int runmisc(int argc, char **argv){
   return rv;
 }
 
+/* parse arguments of slowlog command */
+static int runslowlog(int argc, char **argv){
+  char *host = NULL;
+  char *mstr = NULL;
+  TCLIST *ths = tcmpoollistnew(tcmpoolglobal());
+  int port = TTDEFPORT;
+  for(int i = 2; i < argc; i++){
+    if(!host && argv[i][0] == '-'){
+      if(!strcmp(argv[i], "-port")){
+        if(++i >= argc) usage();
+        port = tcatoi(argv[i]);
+      } else if(!strcmp(argv[i], "-th")){
+        if(++i >= argc) usage();
+        tclistpush2(ths, argv[i]);
+        if(++i >= argc) usage();
+        tclistpush2(ths, argv[i]);
+      } else {
+        usage();
+      }
+    } else if(!host){
+      host = argv[i];
+    } else if(!mstr){
+      mstr = argv[i];
+    } else {
+      usage();
+    }
+  }
+  if(!host) usage();
+  int max = mstr ? tcatoi(mstr) : 0;
+  int rv = procslowlog(host, port, max, ths);
+  return rv;
+}
+
+
 
 /* parse arguments of importtsv command */
 static int runimporttsv(int argc, char **argv){
@@ -1365,6 +1404,44 @@ static int procmisc(const char *host, int port, const char *func, int opts,
   return err ? 1 : 0;
 }
 
+/* perform slowlog command */
+static int procslowlog(const char *host, int port, int max, const TCLIST *ths){
+  TCRDB *rdb = tcrdbnew();
+  if(!myopen(rdb, host, port)){
+    printerr(rdb);
+    tcrdbdel(rdb);
+    return 1;
+  }
+  bool err = false;
+  TCLIST *res;
+  if(tclistnum(ths) > 0){
+    res = tcrdbmisc(rdb, "slowth", RDBMONOULOG, ths);
+  } else {
+    TCLIST *args = tclistnew2(1);
+    tclistprintf(args, "%d", max);
+    res = tcrdbmisc(rdb, "slowlog", RDBMONOULOG, args);
+    tclistdel(args);
+  }
+  if(res){
+    for(int i = 0; i < tclistnum(res); i++){
+      int rsiz;
+      const char *rbuf = tclistval(res, i, &rsiz);
+      printf("%s\n", rbuf);
+    }
+    tclistdel(res);
+  } else {
+    printerr(rdb);
+    err = true;
+  }
+  if(!tcrdbclose(rdb)){
+    if(!err) printerr(rdb);
+    err = true;
+  }
+  tcrdbdel(rdb);
+  return err ? 1 : 0;
+}
+
+
 
 /* perform importtsv command */
 static int procimporttsv(const char *host, int port, const char *file, bool nr,
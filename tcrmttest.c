@@ -18,6 +18,47 @@
 #include "myconf.h"
 
 #define RECBUFSIZ      32                // buffer for records
+#define HISTSUBBITS    10                // number of bits of sub-buckets of latency histograms
+#define HISTSUBNUM     (1<<HISTSUBBITS)  // number of sub-buckets in each magnitude
+#define HISTMAGMAX     36                // maximum magnitude of latency histograms
+#define HISTBKTNUM     ((HISTMAGMAX-HISTSUBBITS+1)*HISTSUBNUM)  // number of buckets
+#define RATEEVMAX      256               // maximum number of events of the rate test
+#define RATEWAITMAX    10                // maximum milliseconds of waiting for events
+#define RATEDRAIN      5.0               // seconds of waiting for responses after the test
+#define RATEIOBUFSIZ   65536             // size of the I/O buffer of the rate test
+#define RATESCANMAX    100               // default maximum length of scans of the rate test
+#define RATETHETA      0.99              // default parameter of the Zipfian distribution
+#define RATEZIPFTRY    64                // maximum number of trials of drawing an existing key
+#define RATEHOTSET     0.2               // default ratio of the hot set of the hotspot distribution
+#define RATEHOTOPS     0.8               // default ratio of operations to the hot set
+
+enum {                                   // enumeration for operations of the rate test
+  RATEOPREAD,                            // read
+  RATEOPUPDATE,                          // update
+  RATEOPINSERT,                          // insert
+  RATEOPSCAN,                            // scan
+  RATEOPRMW,                             // read-modify-write
+  RATEOPNUM                              // number of operations
+};
+
+enum {                                   // enumeration for requests of the rate test
+  RATERQGET,                             // get
+  RATERQPUT,                             // put
+  RATERQMGET                             // multiple get
+};
+
+enum {                                   // enumeration for protocols of the rate test
+  RATEPRBIN,                             // binary
+  RATEPRMC,                              // memcached
+  RATEPRHTTP                             // HTTP
+};
+
+enum {                                   // enumeration for key distributions of the rate test
+  RATEDUNIFORM,                          // uniform
+  RATEDZIPF,                             // Zipfian
+  RATEDHOTSPOT,                          // hotspot
+  RATEDLATEST                            // latest
+};
 
 typedef struct {                         // type of structure for write thread
   TCRDB *rdb;
@@ -56,6 +97,76 @@ typedef struct {                         // type of structure for table thread
   int id;
 } TARGTABLE;
 
+typedef struct {                         // type of structure for latency histogram
+  uint64_t *counts;                      // numbers of samples in each bucket
+  uint64_t num;                          // number of samples
+  uint64_t max;                          // maximum value
+  double sum;                            // summation of values
+} LATHIST;
+
+typedef struct {                         // type of structure for request waiting for response
+  double itime;                          // intended time of sending
+  int op;                                // operation
+  int req;                               // request
+  int64_t kid;                           // ID of the key
+  bool last;                             // whether the response completes the operation
+} RATEPEND;
+
+typedef struct {                         // type of structure for connection of rate thread
+  int fd;                                // file descriptor
+  TCXSTR *wbuf;                          // buffer of data to be sent
+  int woff;                              // offset of data not sent yet
+  char *rbuf;                            // buffer of received data
+  int rsiz;                              // size of received data
+  int rcap;                              // capacity of the buffer of received data
+  RATEPEND *pends;                       // requests waiting for responses
+  int phead;                             // position of the oldest request
+  int pnum;                              // number of waiting requests
+  int pcap;                              // capacity of waiting requests
+  int ost;                               // status of the current operation
+  bool wout;                             // whether writability is watched
+} RATECONN;
+
+typedef struct {                         // type of structure for workload of the rate test
+  int proto;                             // protocol
+  int ratios[RATEOPNUM];                 // ratios of operations
+  int dist;                              // distribution of keys
+  int64_t rnum;                          // number of records stored before the test
+  volatile int64_t knum;                 // number of keys including inserted ones
+  int64_t kmax;                          // number of keys expected at the end of the test
+  double theta;                          // parameter of the Zipfian distribution
+  double zetan;                          // zeta value of the number of expected keys
+  double zeta2;                          // zeta value of two
+  double alpha;                          // exponent of the Zipfian distribution
+  double eta;                            // coefficient of the Zipfian distribution
+  double hotset;                         // ratio of the hot set
+  double hotops;                         // ratio of operations to the hot set
+  int vmin;                              // minimum size of values
+  int vmax;                              // maximum size of values
+  int *vsizs;                            // sizes of the value size histogram
+  double *vcums;                         // cumulative weights of the value size histogram
+  int vnum;                              // number of elements of the value size histogram
+  int scanmax;                           // maximum length of scans
+} RATECONF;
+
+typedef struct {                         // type of structure for rate thread
+  const char *host;
+  int port;
+  RATECONF *conf;
+  int cnum;
+  double rate;
+  double stime;
+  double sec;
+  int id;
+  uint64_t seed;
+  char *vbuf;
+  LATHIST hists[RATEOPNUM];
+  uint64_t onum;
+  uint64_t missnum;
+  uint64_t errnum;
+  double lagmax;
+} TARGRATE;
+
 
 /* global variables */
 const char *g_progname;                  // program name
@@ -74,17 +185,43 @@ static int runread(int argc, char **argv);
 static int runremove(int argc, char **argv);
 static int runtypical(int argc, char **argv);
 static int runtable(int argc, char **argv);
+static int runrate(int argc, char **argv);
 static int procwrite(const char *host, int port, int tnum, int rnum,
                      bool nr, const char *ext, bool rnd);
 static int procread(const char *host, int port, int tnum, int mul, bool rnd);
 static int procremove(const char *host, int port, int tnum, bool rnd);
 static int proctypical(const char *host, int port, int tnum, int rnum);
 static int proctable(const char *host, int port, int tnum, int rnum, bool rnd);
+static int procrate(const char *host, int port, int tnum, int cnum, double rate, double sec,
+                    int rnum, int proto, const int *ratios, int dist, double theta,
+                    double hotset, double hotops, int vmin, int vmax, const char *vhpath,
+                    int scanmax, bool json);
 static void *threadwrite(void *targ);
 static void *threadread(void *targ);
 static void *threadremove(void *targ);
 static void *threadtypical(void *targ);
 static void *threadtable(void *targ);
+static void *threadrate(void *targ);
+static void histinit(LATHIST *hist);
+static void histadd(LATHIST *hist, uint64_t usec);
+static void histmerge(LATHIST *hist, const LATHIST *src);
+static uint64_t histpercentile(const LATHIST *hist, double ratio);
+static void histdestroy(LATHIST *hist);
+static bool rateflush(RATECONN *conn);
+static int rateparse(RATECONN *conn, TARGRATE *arg, double now);
+static bool ratemix(const char *str, int *ratios, int *distp);
+static bool ratevhist(RATECONF *conf, const char *path);
+static double raterand(uint64_t *seedp);
+static int rateop(const RATECONF *conf, uint64_t *seedp);
+static int64_t ratezipf(const RATECONF *conf, uint64_t *seedp);
+static int64_t ratekey(RATECONF *conf, uint64_t *seedp);
+static int ratevsiz(const RATECONF *conf, uint64_t *seedp);
+static int ratereq(RATECONN *conn, TARGRATE *arg, double itime, int op, int req, int64_t kid,
+                   int knum, int vsiz);
+static void ratepush(RATECONN *conn, double itime, int op, int req, int64_t kid, bool last);
+static int rateresp(int proto, int req, const char *ptr, int size, int *stp);
+static void printrate(const char *name, const LATHIST *hist, bool json, bool last);
+static void printjsonstr(const char *str);
 
 
 /* main routine */
@@ -103,6 +240,8 @@ int main(int argc, char **argv){
     rv = runtypical(argc, argv);
   } else if(!strcmp(argv[1], "table")){
     rv = runtable(argc, argv);
+  } else if(!strcmp(argv[1], "rate")){
+    rv = runrate(argc, argv);
   } else {
     usage();
   }
@@ -121,6 +260,11 @@ static void usage(void){
   fprintf(stderr, "  %s remove [-port num] [-tnum num] host\n", g_progname);
   fprintf(stderr, "  %s typical [-port num] [-tnum num] host rnum\n", g_progname);
   fprintf(stderr, "  %s table [-port num] [-tnum num] host rnum\n", g_progname);
+  fprintf(stderr, "  %s rate [-port num] [-tnum num] [-cnum num] [-rate num] [-sec num]"
+          " [-proto bin|mc|http] [-get num] [-mix a|b|c|d|e|f|r:u:i:s:m]"
+          " [-dist uniform|zipf|hotspot|latest] [-theta num] [-hset num] [-hops num]"
+          " [-vsiz num] [-vmax num] [-vhist path] [-scan num] [-json] host rnum\n",
+          g_progname);
   fprintf(stderr, "\n");
   exit(1);
 }
@@ -351,6 +495,128 @@ static int runtable(int argc, char **argv){
 }
 
 
+/* parse arguments of rate command */
+static int runrate(int argc, char **argv){
+  char *host = NULL;
+  char *rstr = NULL;
+  int port = TTDEFPORT;
+  int tnum = 1;
+  int cnum = 0;
+  double rate = 1000;
+  double sec = 10;
+  int proto = RATEPRBIN;
+  int gratio = 50;
+  char *mix = NULL;
+  int dist = -1;
+  double theta = RATETHETA;
+  double hotset = RATEHOTSET;
+  double hotops = RATEHOTOPS;
+  int vmin = 8;
+  int vmax = -1;
+  char *vhpath = NULL;
+  int scanmax = RATESCANMAX;
+  bool json = false;
+  for(int i = 2; i < argc; i++){
+    if(!host && argv[i][0] == '-'){
+      if(!strcmp(argv[i], "-port")){
+        if(++i >= argc) usage();
+        port = tcatoi(argv[i]);
+      } else if(!strcmp(argv[i], "-tnum")){
+        if(++i >= argc) usage();
+        tnum = tcatoi(argv[i]);
+      } else if(!strcmp(argv[i], "-cnum")){
+        if(++i >= argc) usage();
+        cnum = tcatoi(argv[i]);
+      } else if(!strcmp(argv[i], "-rate")){
+        if(++i >= argc) usage();
+        rate = tcatof(argv[i]);
+      } else if(!strcmp(argv[i], "-sec")){
+        if(++i >= argc) usage();
+        sec = tcatof(argv[i]);
+      } else if(!strcmp(argv[i], "-proto")){
+        if(++i >= argc) usage();
+        if(!tcstricmp(argv[i], "bin")){
+          proto = RATEPRBIN;
+        } else if(!tcstricmp(argv[i], "mc")){
+          proto = RATEPRMC;
+        } else if(!tcstricmp(argv[i], "http")){
+          proto = RATEPRHTTP;
+        } else {
+          usage();
+        }
+      } else if(!strcmp(argv[i], "-get")){
+        if(++i >= argc) usage();
+        gratio = tcatoi(argv[i]);
+      } else if(!strcmp(argv[i], "-mix")){
+        if(++i >= argc) usage();
+        mix = argv[i];
+      } else if(!strcmp(argv[i], "-dist")){
+        if(++i >= argc) usage();
+        if(!tcstricmp(argv[i], "uniform")){
+          dist = RATEDUNIFORM;
+        } else if(!tcstricmp(argv[i], "zipf")){
+          dist = RATEDZIPF;
+        } else if(!tcstricmp(argv[i], "hotspot")){
+          dist = RATEDHOTSPOT;
+        } else if(!tcstricmp(argv[i], "latest")){
+          dist = RATEDLATEST;
+        } else {
+          usage();
+        }
+      } else if(!strcmp(argv[i], "-theta")){
+        if(++i >= argc) usage();
+        theta = tcatof(argv[i]);
+      } else if(!strcmp(argv[i], "-hset")){
+        if(++i >= argc) usage();
+        hotset = tcatof(argv[i]);
+      } else if(!strcmp(argv[i], "-hops")){
+        if(++i >= argc) usage();
+        hotops = tcatof(argv[i]);
+      } else if(!strcmp(argv[i], "-vsiz")){
+        if(++i >= argc) usage();
+        vmin = tcatoi(argv[i]);
+      } else if(!strcmp(argv[i], "-vmax")){
+        if(++i >= argc) usage();
+        vmax = tcatoi(argv[i]);
+      } else if(!strcmp(argv[i], "-vhist")){
+        if(++i >= argc) usage();
+        vhpath = argv[i];
+      } else if(!strcmp(argv[i], "-scan")){
+        if(++i >= argc) usage();
+        scanmax = tcatoi(argv[i]);
+      } else if(!strcmp(argv[i], "-json")){
+        json = true;
+      } else {
+        usage();
+      }
+    } else if(!host){
+      host = argv[i];
+    } else if(!rstr){
+      rstr = argv[i];
+    } else {
+      usage();
+    }
+  }
+  if(!host || !rstr || tnum < 1 || rate <= 0 || sec <= 0 || vmin < 0) usage();
+  if(theta <= 0 || theta >= 1 || hotset <= 0 || hotset > 1 || hotops < 0 || hotops > 1 ||
+     scanmax < 1 || gratio < 0 || gratio > 100) usage();
+  if(cnum < tnum) cnum = tnum;
+  if(vmax < vmin) vmax = vmin;
+  int ratios[RATEOPNUM];
+  memset(ratios, 0, sizeof(ratios));
+  ratios[RATEOPREAD] = gratio;
+  ratios[RATEOPUPDATE] = 100 - gratio;
+  int mdist = RATEDUNIFORM;
+  if(mix && !ratemix(mix, ratios, &mdist)) usage();
+  if(dist < 0) dist = mdist;
+  int rnum = tcatoi(rstr);
+  if(rnum < 1) usage();
+  int rv = procrate(host, port, tnum, cnum, rate, sec, rnum, proto, ratios, dist, theta,
+                    hotset, hotops, vmin, vmax, vhpath, scanmax, json);
+  return rv;
+}
+
+
 /* perform write command */
 static int procwrite(const char *host, int port, int tnum, int rnum,
                      bool nr, const char *ext, bool rnd){
@@ -674,6 +940,173 @@ static int proctable(const char *host, int port, int tnum, int rnum, bool rnd){
 }
 
 
+/* perform rate command */
+static int procrate(const char *host, int port, int tnum, int cnum, double rate, double sec,
+                    int rnum, int proto, const int *ratios, int dist, double theta,
+                    double hotset, double hotops, int vmin, int vmax, const char *vhpath,
+                    int scanmax, bool json){
+  const char *protonames[] = { "bin", "mc", "http" };
+  const char *distnames[] = { "uniform", "zipf", "hotspot", "latest" };
+  const char *opnames[RATEOPNUM] = { "read", "update", "insert", "scan", "rmw" };
+  if(!json)
+    iprintf("<Rate Test>\n  host=%s  port=%d  tnum=%d  cnum=%d  rate=%.1f  sec=%.1f  rnum=%d"
+            "  proto=%s  mix=%d:%d:%d:%d:%d  dist=%s  theta=%.3f  vsiz=%d  vmax=%d"
+            "  vhist=%s  scan=%d\n\n", host, port, tnum, cnum, rate, sec, rnum,
+            protonames[proto], ratios[RATEOPREAD], ratios[RATEOPUPDATE], ratios[RATEOPINSERT],
+            ratios[RATEOPSCAN], ratios[RATEOPRMW], distnames[dist], theta, vmin, vmax,
+            vhpath ? vhpath : "", scanmax);
+  bool err = false;
+  if(signal(SIGPIPE, SIG_IGN) == SIG_ERR){
+    fprintf(stderr, "%s: signal failed\n", g_progname);
+    err = true;
+  }
+  RATECONF conf;
+  memset(&conf, 0, sizeof(conf));
+  conf.proto = proto;
+  memcpy(conf.ratios, ratios, sizeof(conf.ratios));
+  conf.dist = dist;
+  conf.rnum = rnum;
+  conf.knum = rnum;
+  int rsum = 0;
+  for(int i = 0; i < RATEOPNUM; i++){
+    rsum += ratios[i];
+  }
+  conf.kmax = rnum + (rsum > 0 ? (int64_t)(rate * sec * ratios[RATEOPINSERT] / rsum) : 0);
+  conf.theta = theta;
+  conf.hotset = hotset;
+  conf.hotops = hotops;
+  conf.vmin = vmin;
+  conf.vmax = vmax;
+  conf.scanmax = scanmax;
+  if(dist == RATEDZIPF || dist == RATEDLATEST){
+    for(int64_t i = 1; i <= conf.kmax; i++){
+      conf.zetan += 1.0 / pow(i, theta);
+    }
+    conf.zeta2 = 1.0 + pow(0.5, theta);
+    conf.alpha = 1.0 / (1.0 - theta);
+    conf.eta = (1.0 - pow(2.0 / conf.kmax, 1.0 - theta)) / (1.0 - conf.zeta2 / conf.zetan);
+  }
+  if(vhpath && !ratevhist(&conf, vhpath)){
+    fprintf(stderr, "%s: %s: invalid value size histogram\n", g_progname, vhpath);
+    return 1;
+  }
+  TARGRATE targs[tnum];
+  pthread_t threads[tnum];
+  double stime = tctime() + 0.1;
+  for(int i = 0; i < tnum; i++){
+    TARGRATE *targ = targs + i;
+    targ->host = host;
+    targ->port = port;
+    targ->conf = &conf;
+    targ->cnum = cnum / tnum + (i < cnum % tnum ? 1 : 0);
+    targ->rate = rate / tnum;
+    targ->stime = stime + i / rate;
+    targ->sec = sec;
+    targ->id = i;
+    targ->seed = ((uint64_t)(stime * 1000000) ^ ((i + 1) * 0x9e3779b97f4a7c15ULL)) | 1;
+    targ->vbuf = NULL;
+    for(int j = 0; j < RATEOPNUM; j++){
+      histinit(targ->hists + j);
+    }
+    targ->onum = 0;
+    targ->missnum = 0;
+    targ->errnum = 0;
+    targ->lagmax = 0;
+  }
+  if(tnum == 1){
+    if(threadrate(targs) != NULL) err = true;
+  } else {
+    for(int i = 0; i < tnum; i++){
+      if(pthread_create(threads + i, NULL, threadrate, targs + i) != 0){
+        fprintf(stderr, "%s: pthread_create failed\n", g_progname);
+        targs[i].id = -1;
+        err = true;
+      }
+    }
+    for(int i = 0; i < tnum; i++){
+      if(targs[i].id == -1) continue;
+      void *rv;
+      if(pthread_join(threads[i], &rv) != 0){
+        fprintf(stderr, "%s: pthread_join failed\n", g_progname);
+        err = true;
+      } else if(rv){
+        err = true;
+      }
+    }
+  }
+  double etime = tctime() - stime;
+  LATHIST hists[RATEOPNUM];
+  LATHIST all;
+  histinit(&all);
+  uint64_t onum = 0;
+  uint64_t missnum = 0;
+  uint64_t errnum = 0;
+  double lagmax = 0;
+  for(int i = 0; i < RATEOPNUM; i++){
+    histinit(hists + i);
+    for(int j = 0; j < tnum; j++){
+      histmerge(hists + i, targs[j].hists + i);
+    }
+    histmerge(&all, hists + i);
+  }
+  for(int i = 0; i < tnum; i++){
+    onum += targs[i].onum;
+    missnum += targs[i].missnum;
+    errnum += targs[i].errnum;
+    if(targs[i].lagmax > lagmax) lagmax = targs[i].lagmax;
+    for(int j = 0; j < RATEOPNUM; j++){
+      histdestroy(targs[i].hists + j);
+    }
+  }
+  if(json){
+    printf("{\"test\":\"rate\",\"host\":");
+    printjsonstr(host);
+    printf(",\"port\":%d,\"tnum\":%d,\"cnum\":%d,\"rate\":%.3f,\"sec\":%.3f,\"rnum\":%d,"
+           "\"proto\":\"%s\",", port, tnum, cnum, rate, sec, rnum, protonames[proto]);
+    printf("\"mix\":{");
+    for(int i = 0; i < RATEOPNUM; i++){
+      printf("\"%s\":%d%s", opnames[i], ratios[i], i < RATEOPNUM - 1 ? "," : "");
+    }
+    printf("},\"dist\":\"%s\",\"theta\":%.3f,\"vsiz\":%d,\"vmax\":%d,\"vhist\":",
+           distnames[dist], theta, vmin, vmax);
+    printjsonstr(vhpath ? vhpath : "");
+    printf(",\"scan\":%d,", scanmax);
+    printf("\"ops\":%llu,\"done\":%llu,\"misses\":%llu,\"errors\":%llu,\"time\":%.3f,"
+           "\"throughput\":%.3f,\"lag_max_us\":%llu,\"latency_us\":{",
+           (unsigned long long)onum, (unsigned long long)all.num, (unsigned long long)missnum,
+           (unsigned long long)errnum, etime, all.num / etime,
+           (unsigned long long)(lagmax * 1000000));
+    for(int i = 0; i < RATEOPNUM; i++){
+      printrate(opnames[i], hists + i, true, false);
+    }
+    printrate("all", &all, true, true);
+    printf("}}\n");
+  } else {
+    for(int i = 0; i < RATEOPNUM; i++){
+      if(hists[i].num > 0) printrate(opnames[i], hists + i, false, false);
+    }
+    printrate("all", &all, false, true);
+    iprintf("operations: %llu\n", (unsigned long long)onum);
+    iprintf("done: %llu\n", (unsigned long long)all.num);
+    iprintf("misses: %llu\n", (unsigned long long)missnum);
+    iprintf("errors: %llu\n", (unsigned long long)errnum);
+    iprintf("max lag: %llu\n", (unsigned long long)(lagmax * 1000000));
+    iprintf("inserted: %lld\n", (long long)(conf.knum - conf.rnum));
+    iprintf("throughput: %.3f\n", all.num / etime);
+    iprintf("time: %.3f\n", etime);
+  }
+  for(int i = 0; i < RATEOPNUM; i++){
+    histdestroy(hists + i);
+  }
+  histdestroy(&all);
+  tcfree(conf.vcums);
+  tcfree(conf.vsizs);
+  if(errnum > 0) err = true;
+  if(!json) iprintf("%s\n\n", err ? "error" : "ok");
+  return err ? 1 : 0;
+}
+
+
 /* thread the write function */
 static void *threadwrite(void *targ){
   TCRDB *rdb = ((TARGWRITE *)targ)->rdb;
@@ -912,4 +1345,684 @@ static void *threadtable(void *targ){
 
 
 
+/* thread the rate function */
+static void *threadrate(void *targ){
+  TARGRATE *arg = targ;
+  RATECONF *conf = arg->conf;
+  int cnum = arg->cnum;
+  bool err = false;
+  int epfd = epoll_create(cnum);
+  if(epfd == -1){
+    fprintf(stderr, "%s: epoll_create failed\n", g_progname);
+    return "error";
+  }
+  char addr[TTADDRBUFSIZ];
+  if(arg->port > 0 && !ttgethostaddr(arg->host, addr)){
+    fprintf(stderr, "%s: ttgethostaddr failed\n", g_progname);
+    epoll_close(epfd);
+    return "error";
+  }
+  RATECONN *conns = tcmalloc(sizeof(*conns) * cnum);
+  for(int i = 0; i < cnum; i++){
+    RATECONN *conn = conns + i;
+    conn->fd = arg->port > 0 ? ttopensock(addr, arg->port) : ttopensockunix(arg->host);
+    conn->wbuf = tcxstrnew3(RATEIOBUFSIZ);
+    conn->woff = 0;
+    conn->rcap = RATEIOBUFSIZ;
+    conn->rbuf = tcmalloc(conn->rcap);
+    conn->rsiz = 0;
+    conn->pcap = 256;
+    conn->pends = tcmalloc(sizeof(*conn->pends) * conn->pcap);
+    conn->phead = 0;
+    conn->pnum = 0;
+    conn->ost = -1;
+    conn->wout = false;
+    if(conn->fd == -1){
+      fprintf(stderr, "%s: ttopensock failed\n", g_progname);
+      err = true;
+      continue;
+    }
+    int flags = fcntl(conn->fd, F_GETFL, NULL);
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN | EPOLLONESHOT;
+    ev.data.ptr = conn;
+    if(flags == -1 || fcntl(conn->fd, F_SETFL, flags | O_NONBLOCK) == -1 ||
+       epoll_ctl(epfd, EPOLL_CTL_ADD, conn->fd, &ev) != 0){
+      fprintf(stderr, "%s: epoll_ctl failed\n", g_progname);
+      close(conn->fd);
+      conn->fd = -1;
+      err = true;
+    }
+  }
+  arg->vbuf = tcmalloc(conf->vmax + 1);
+  memset(arg->vbuf, 'v', conf->vmax);
+  double interval = 1.0 / arg->rate;
+  double next = arg->stime;
+  double end = arg->stime + arg->sec;
+  int cidx = 0;
+  int pnum = 0;
+  while(!err){
+    double now = tctime();
+    while(next <= now && next < end){
+      RATECONN *conn = conns + cidx;
+      cidx = (cidx + 1) % cnum;
+      arg->onum++;
+      if(now - next > arg->lagmax) arg->lagmax = now - next;
+      if(conn->fd == -1){
+        arg->errnum++;
+        next += interval;
+        continue;
+      }
+      int op = rateop(conf, &arg->seed);
+      int64_t kid = (op == RATEOPINSERT) ? __sync_add_and_fetch(&conf->knum, 1) :
+        ratekey(conf, &arg->seed);
+      int req = RATERQGET;
+      int knum = 1;
+      int vsiz = 0;
+      if(op == RATEOPUPDATE || op == RATEOPINSERT){
+        req = RATERQPUT;
+        vsiz = ratevsiz(conf, &arg->seed);
+      } else if(op == RATEOPSCAN){
+        req = RATERQMGET;
+        knum = 1 + (int)(raterand(&arg->seed) * conf->scanmax);
+      }
+      pnum += ratereq(conn, arg, next, op, req, kid, knum, vsiz);
+      next += interval;
+    }
+    for(int i = 0; i < cnum; i++){
+      RATECONN *conn = conns + i;
+      if(conn->fd == -1 || conn->wout || conn->woff >= tcxstrsize(conn->wbuf)) continue;
+      if(!rateflush(conn)){
+        arg->errnum += conn->pnum;
+        pnum -= conn->pnum;
+        conn->pnum = 0;
+        close(conn->fd);
+        conn->fd = -1;
+        continue;
+      }
+      if(conn->woff < tcxstrsize(conn->wbuf)){
+        struct epoll_event ev;
+        memset(&ev, 0, sizeof(ev));
+        ev.events = EPOLLIN | EPOLLOUT | EPOLLONESHOT;
+        ev.data.ptr = conn;
+        if(epoll_ctl(epfd, EPOLL_CTL_MOD, conn->fd, &ev) == 0) conn->wout = true;
+      }
+    }
+    if(now >= end && (pnum < 1 || now >= end + RATEDRAIN)) break;
+    int wait = (next < end) ? (next - now) * 1000 : RATEWAITMAX;
+    wait = tclmax(tclmin(wait, RATEWAITMAX), 0);
+    struct epoll_event events[RATEEVMAX];
+    int fdnum = epoll_wait(epfd, events, RATEEVMAX, wait);
+    if(fdnum == -1){
+      if(errno == EINTR) continue;
+      fprintf(stderr, "%s: epoll_wait failed\n", g_progname);
+      err = true;
+      break;
+    }
+    now = tctime();
+    for(int i = 0; i < fdnum; i++){
+      RATECONN *conn = events[i].data.ptr;
+      if(conn->fd == -1) continue;
+      bool ok = true;
+      if(events[i].events & EPOLLOUT){
+        conn->wout = false;
+        if(!rateflush(conn)) ok = false;
+      }
+      if(ok){
+        int rv = rateparse(conn, arg, now);
+        if(rv < 0){
+          ok = false;
+        } else {
+          pnum -= rv;
+        }
+      }
+      if(ok){
+        struct epoll_event ev;
+        memset(&ev, 0, sizeof(ev));
+        ev.events = EPOLLIN | EPOLLONESHOT;
+        if(conn->woff < tcxstrsize(conn->wbuf)){
+          ev.events |= EPOLLOUT;
+          conn->wout = true;
+        }
+        ev.data.ptr = conn;
+        if(epoll_ctl(epfd, EPOLL_CTL_MOD, conn->fd, &ev) != 0) ok = false;
+      }
+      if(!ok){
+        arg->errnum += conn->pnum;
+        pnum -= conn->pnum;
+        conn->pnum = 0;
+        close(conn->fd);
+        conn->fd = -1;
+      }
+    }
+  }
+  arg->errnum += pnum;
+  tcfree(arg->vbuf);
+  for(int i = 0; i < cnum; i++){
+    RATECONN *conn = conns + i;
+    if(conn->fd != -1 && close(conn->fd) != 0) err = true;
+    tcfree(conn->pends);
+    tcfree(conn->rbuf);
+    tcxstrdel(conn->wbuf);
+  }
+  tcfree(conns);
+  epoll_close(epfd);
+  return err ? "error" : NULL;
+}
+
+
+/* initialize a latency histogram */
+static void histinit(LATHIST *hist){
+  hist->counts = tccalloc(HISTBKTNUM, sizeof(*hist->counts));
+  hist->num = 0;
+  hist->max = 0;
+  hist->sum = 0;
+}
+
+
+/* add a sample in microseconds to a latency histogram */
+static void histadd(LATHIST *hist, uint64_t usec){
+  int idx;
+  if(usec < HISTSUBNUM){
+    idx = usec;
+  } else {
+    int mag = 63 - __builtin_clzll(usec);
+    idx = (mag - HISTSUBBITS + 1) * HISTSUBNUM + ((usec >> (mag - HISTSUBBITS)) & (HISTSUBNUM - 1));
+    if(idx >= HISTBKTNUM) idx = HISTBKTNUM - 1;
+  }
+  hist->counts[idx]++;
+  hist->num++;
+  if(usec > hist->max) hist->max = usec;
+  hist->sum += usec;
+}
+
+
+/* merge a latency histogram into another */
+static void histmerge(LATHIST *hist, const LATHIST *src){
+  for(int i = 0; i < HISTBKTNUM; i++){
+    hist->counts[i] += src->counts[i];
+  }
+  hist->num += src->num;
+  if(src->max > hist->max) hist->max = src->max;
+  hist->sum += src->sum;
+}
+
+
+/* get a percentile in microseconds of a latency histogram */
+static uint64_t histpercentile(const LATHIST *hist, double ratio){
+  if(hist->num < 1) return 0;
+  uint64_t cnt = 0;
+  for(int i = 0; i < HISTBKTNUM; i++){
+    cnt += hist->counts[i];
+    if(cnt > 0 && cnt >= ratio * hist->num){
+      if(i < HISTSUBNUM) return i;
+      int mag = i / HISTSUBNUM + HISTSUBBITS - 1;
+      int sub = i % HISTSUBNUM;
+      uint64_t bound = ((uint64_t)(HISTSUBNUM + sub + 1) << (mag - HISTSUBBITS)) - 1;
+      return tclmin(bound, hist->max);
+    }
+  }
+  return hist->max;
+}
+
+
+/* release resources of a latency histogram */
+static void histdestroy(LATHIST *hist){
+  tcfree(hist->counts);
+}
+
+
+/* send buffered requests of a connection of the rate test */
+static bool rateflush(RATECONN *conn){
+  const char *ptr = tcxstrptr(conn->wbuf);
+  int size = tcxstrsize(conn->wbuf);
+  while(conn->woff < size){
+    int wb = send(conn->fd, ptr + conn->woff, size - conn->woff, 0);
+    if(wb > 0){
+      conn->woff += wb;
+    } else if(wb == -1 && errno == EINTR){
+      continue;
+    } else if(wb == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)){
+      return true;
+    } else {
+      return false;
+    }
+  }
+  tcxstrclear(conn->wbuf);
+  conn->woff = 0;
+  return true;
+}
+
+
+/* receive and parse responses of a connection of the rate test */
+static int rateparse(RATECONN *conn, TARGRATE *arg, double now){
+  while(true){
+    if(conn->rsiz >= conn->rcap){
+      conn->rcap *= 2;
+      conn->rbuf = tcrealloc(conn->rbuf, conn->rcap);
+    }
+    int rb = recv(conn->fd, conn->rbuf + conn->rsiz, conn->rcap - conn->rsiz, 0);
+    if(rb > 0){
+      conn->rsiz += rb;
+      if(conn->rsiz < conn->rcap) break;
+    } else if(rb == -1 && errno == EINTR){
+      continue;
+    } else if(rb == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)){
+      break;
+    } else {
+      return -1;
+    }
+  }
+  int done = 0;
+  int off = 0;
+  while(conn->pnum > 0 && off < conn->rsiz){
+    RATEPEND pend = conn->pends[conn->phead];
+    int st;
+    int size = rateresp(arg->conf->proto, pend.req, conn->rbuf + off, conn->rsiz - off, &st);
+    if(size < 0) return -1;
+    if(size < 1) break;
+    off += size;
+    conn->phead++;
+    conn->pnum--;
+    if(conn->pnum < 1) conn->phead = 0;
+    done++;
+    if(conn->ost < 0 || st == 2 || (st == 0 && conn->ost != 2)) conn->ost = st;
+    if(!pend.last){
+      if(pend.op != RATEOPRMW) continue;
+      if(conn->ost != 2){
+        done -= ratereq(conn, arg, pend.itime, pend.op, RATERQPUT, pend.kid, 1,
+                        ratevsiz(arg->conf, &arg->seed));
+        continue;
+      }
+    }
+    if(conn->ost == 2){
+      arg->errnum++;
+    } else if(conn->ost == 1){
+      arg->missnum++;
+    }
+    conn->ost = -1;
+    double lat = now - pend.itime;
+    histadd(arg->hists + pend.op, lat > 0 ? lat * 1000000 : 0);
+  }
+  if(off > 0){
+    memmove(conn->rbuf, conn->rbuf + off, conn->rsiz - off);
+    conn->rsiz -= off;
+  }
+  return done;
+}
+
+
+/* parse the expression of an operation mix of the rate test */
+static bool ratemix(const char *str, int *ratios, int *distp){
+  const int presets[][RATEOPNUM] = {
+    { 50, 50, 0, 0, 0 }, { 95, 5, 0, 0, 0 }, { 100, 0, 0, 0, 0 },
+    { 95, 0, 5, 0, 0 }, { 0, 0, 5, 95, 0 }, { 50, 0, 0, 0, 50 }
+  };
+  int c = tolower(*(unsigned char *)str);
+  if(c >= 'a' && c <= 'f' && str[1] == '\0'){
+    memcpy(ratios, presets[c-'a'], sizeof(presets[0]));
+    *distp = (c == 'd') ? RATEDLATEST : RATEDZIPF;
+    return true;
+  }
+  TCLIST *elems = tcstrsplit(str, ":");
+  int num = tclistnum(elems);
+  bool err = num < 1 || num > RATEOPNUM;
+  int sum = 0;
+  for(int i = 0; i < RATEOPNUM; i++){
+    ratios[i] = (i < num) ? tcatoi(tclistval2(elems, i)) : 0;
+    if(ratios[i] < 0) err = true;
+    sum += ratios[i];
+  }
+  tclistdel(elems);
+  if(sum < 1) err = true;
+  *distp = RATEDUNIFORM;
+  return !err;
+}
+
+
+/* load a histogram file of value sizes of the rate test */
+static bool ratevhist(RATECONF *conf, const char *path){
+  TCLIST *lines = tcreadfilelines(path);
+  if(!lines) return false;
+  int lnum = tclistnum(lines);
+  conf->vsizs = tcmalloc(sizeof(*conf->vsizs) * (lnum + 1));
+  conf->vcums = tcmalloc(sizeof(*conf->vcums) * (lnum + 1));
+  conf->vnum = 0;
+  double sum = 0;
+  bool err = false;
+  for(int i = 0; i < lnum; i++){
+    const char *line = tclistval2(lines, i);
+    while(*line == ' ' || *line == '\t'){
+      line++;
+    }
+    if(*line == '\0' || *line == '#') continue;
+    int vsiz = tcatoi(line);
+    while(*line != '\0' && *line != ' ' && *line != '\t'){
+      line++;
+    }
+    double weight = (*line != '\0') ? tcatof(line) : 1.0;
+    if(vsiz < 0 || weight < 0){
+      err = true;
+      break;
+    }
+    if(weight <= 0) continue;
+    sum += weight;
+    conf->vsizs[conf->vnum] = vsiz;
+    conf->vcums[conf->vnum] = sum;
+    if(conf->vnum < 1 || vsiz < conf->vmin) conf->vmin = vsiz;
+    if(conf->vnum < 1 || vsiz > conf->vmax) conf->vmax = vsiz;
+    conf->vnum++;
+  }
+  tclistdel(lines);
+  return !err && conf->vnum > 0;
+}
+
+
+/* get a random number from zero to one of a rate thread */
+static double raterand(uint64_t *seedp){
+  uint64_t x = *seedp;
+  x ^= x >> 12;
+  x ^= x << 25;
+  x ^= x >> 27;
+  *seedp = x;
+  return ((x * 0x2545f4914f6cdd1dULL) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+
+/* choose an operation of the rate test */
+static int rateop(const RATECONF *conf, uint64_t *seedp){
+  int sum = 0;
+  for(int i = 0; i < RATEOPNUM; i++){
+    sum += conf->ratios[i];
+  }
+  int num = raterand(seedp) * sum;
+  for(int i = 0; i < RATEOPNUM; i++){
+    if(num < conf->ratios[i]) return i;
+    num -= conf->ratios[i];
+  }
+  return RATEOPREAD;
+}
+
+
+/* get a rank based on the Zipfian distribution of the rate test */
+static int64_t ratezipf(const RATECONF *conf, uint64_t *seedp){
+  double rnd = raterand(seedp);
+  double uz = rnd * conf->zetan;
+  if(uz < 1.0) return 0;
+  if(uz < conf->zeta2) return 1;
+  int64_t rank = conf->kmax * pow(conf->eta * rnd - conf->eta + 1.0, conf->alpha);
+  return (rank < conf->kmax) ? rank : conf->kmax - 1;
+}
+
+
+/* choose the ID of a key of the rate test */
+static int64_t ratekey(RATECONF *conf, uint64_t *seedp){
+  int64_t knum = conf->knum;
+  switch(conf->dist){
+    case RATEDZIPF: {
+      uint64_t hash = 0;
+      for(int i = 0; i < RATEZIPFTRY; i++){
+        uint64_t rank = ratezipf(conf, seedp);
+        hash = 14695981039346656037ULL;
+        for(int j = 0; j < sizeof(rank); j++){
+          hash = (hash ^ ((rank >> (j * 8)) & 0xff)) * 1099511628211ULL;
+        }
+        if(hash % conf->kmax < knum) return hash % conf->kmax + 1;
+      }
+      return hash % knum + 1;
+    }
+    case RATEDHOTSPOT: {
+      int64_t hnum = knum * conf->hotset;
+      if(hnum < 1) hnum = 1;
+      if(hnum >= knum || raterand(seedp) < conf->hotops)
+        return 1 + (int64_t)(raterand(seedp) * hnum);
+      return 1 + hnum + (int64_t)(raterand(seedp) * (knum - hnum));
+    }
+    case RATEDLATEST: {
+      int64_t kid = knum - ratezipf(conf, seedp);
+      return (kid > 0) ? kid : 1;
+    }
+  }
+  return 1 + (int64_t)(raterand(seedp) * knum);
+}
+
+
+/* choose the size of a value of the rate test */
+static int ratevsiz(const RATECONF *conf, uint64_t *seedp){
+  if(conf->vnum > 0){
+    double num = raterand(seedp) * conf->vcums[conf->vnum-1];
+    int left = 0;
+    int right = conf->vnum - 1;
+    while(left < right){
+      int mid = (left + right) / 2;
+      if(conf->vcums[mid] > num){
+        right = mid;
+      } else {
+        left = mid + 1;
+      }
+    }
+    return conf->vsizs[left];
+  }
+  return conf->vmin + (int)(raterand(seedp) * (conf->vmax - conf->vmin + 1));
+}
+
+
+/* append a request to a connection of the rate test and get the number of responses */
+static int ratereq(RATECONN *conn, TARGRATE *arg, double itime, int op, int req, int64_t kid,
+                   int knum, int vsiz){
+  TCXSTR *wbuf = conn->wbuf;
+  char kbuf[RECBUFSIZ];
+  char hbuf[TTADDRBUFSIZ+RECBUFSIZ*4];
+  int ksiz, hsiz;
+  int rnum = 1;
+  switch(arg->conf->proto){
+    case RATEPRMC:
+      if(req == RATERQPUT){
+        ksiz = sprintf(kbuf, "%08lld", (long long)kid);
+        hsiz = sprintf(hbuf, "set %s 0 0 %d\r\n", kbuf, vsiz);
+        tcxstrcat(wbuf, hbuf, hsiz);
+        tcxstrcat(wbuf, arg->vbuf, vsiz);
+        tcxstrcat(wbuf, "\r\n", 2);
+      } else {
+        tcxstrcat(wbuf, "get", 3);
+        for(int i = 0; i < knum; i++){
+          ksiz = sprintf(kbuf, " %08lld", (long long)(kid + i));
+          tcxstrcat(wbuf, kbuf, ksiz);
+        }
+        tcxstrcat(wbuf, "\r\n", 2);
+      }
+      break;
+    case RATEPRHTTP:
+      if(req == RATERQMGET){
+        req = RATERQGET;
+        rnum = knum;
+      }
+      for(int i = 0; i < rnum; i++){
+        hsiz = snprintf(hbuf, sizeof(hbuf), "%s /%08lld HTTP/1.1\r\nHost: %s\r\n",
+                        (req == RATERQPUT) ? "PUT" : "GET", (long long)(kid + i), arg->host);
+        tcxstrcat(wbuf, hbuf, tclmin(hsiz, sizeof(hbuf) - 1));
+        if(req == RATERQPUT){
+          hsiz = sprintf(hbuf, "Content-Length: %d\r\n\r\n", vsiz);
+          tcxstrcat(wbuf, hbuf, hsiz);
+          tcxstrcat(wbuf, arg->vbuf, vsiz);
+        } else {
+          tcxstrcat(wbuf, "\r\n", 2);
+        }
+      }
+      break;
+    default: {
+      unsigned char *wp = (unsigned char *)hbuf;
+      *(wp++) = TTMAGICNUM;
+      *(wp++) = (req == RATERQPUT) ? TTCMDPUT : (req == RATERQMGET) ? TTCMDMGET : TTCMDGET;
+      uint32_t lnum;
+      if(req == RATERQMGET){
+        lnum = TTHTONL((uint32_t)knum);
+        memcpy(wp, &lnum, sizeof(lnum));
+        wp += sizeof(lnum);
+      }
+      tcxstrcat(wbuf, hbuf, (char *)wp - hbuf);
+      for(int i = 0; i < knum; i++){
+        ksiz = sprintf(kbuf, "%08lld", (long long)(kid + i));
+        wp = (unsigned char *)hbuf;
+        lnum = TTHTONL((uint32_t)ksiz);
+        memcpy(wp, &lnum, sizeof(lnum));
+        wp += sizeof(lnum);
+        if(req == RATERQPUT){
+          lnum = TTHTONL((uint32_t)vsiz);
+          memcpy(wp, &lnum, sizeof(lnum));
+          wp += sizeof(lnum);
+        }
+        tcxstrcat(wbuf, hbuf, (char *)wp - hbuf);
+        tcxstrcat(wbuf, kbuf, ksiz);
+      }
+      if(req == RATERQPUT) tcxstrcat(wbuf, arg->vbuf, vsiz);
+      break;
+    }
+  }
+  bool stage = op == RATEOPRMW && req == RATERQGET;
+  for(int i = 0; i < rnum; i++){
+    ratepush(conn, itime, op, req, kid, !stage && i == rnum - 1);
+  }
+  return rnum;
+}
+
+
+/* add a request waiting for the response to a connection of the rate test */
+static void ratepush(RATECONN *conn, double itime, int op, int req, int64_t kid, bool last){
+  if(conn->phead + conn->pnum >= conn->pcap){
+    if(conn->phead > 0){
+      memmove(conn->pends, conn->pends + conn->phead, sizeof(*conn->pends) * conn->pnum);
+      conn->phead = 0;
+    } else {
+      conn->pcap *= 2;
+      conn->pends = tcrealloc(conn->pends, sizeof(*conn->pends) * conn->pcap);
+    }
+  }
+  RATEPEND *pend = conn->pends + conn->phead + conn->pnum++;
+  pend->itime = itime;
+  pend->op = op;
+  pend->req = req;
+  pend->kid = kid;
+  pend->last = last;
+}
+
+
+/* parse a response of the rate test and get its size, or 0 if it is incomplete */
+static int rateresp(int proto, int req, const char *ptr, int size, int *stp){
+  const unsigned char *rp = (unsigned char *)ptr;
+  uint32_t lnum;
+  if(proto == RATEPRBIN){
+    if(size < 1) return 0;
+    if(req == RATERQPUT || *rp != 0){
+      *stp = (*rp == 0) ? 0 : (req == RATERQGET) ? 1 : 2;
+      return 1;
+    }
+    if(size < 1 + sizeof(lnum)) return 0;
+    memcpy(&lnum, rp + 1, sizeof(lnum));
+    lnum = TTNTOHL(lnum);
+    if(req == RATERQGET){
+      *stp = 0;
+      return (size >= 1 + sizeof(lnum) + lnum) ? 1 + sizeof(lnum) + lnum : 0;
+    }
+    int rnum = lnum;
+    int off = 1 + sizeof(lnum);
+    for(int i = 0; i < rnum; i++){
+      if(size < off + sizeof(lnum) * 2) return 0;
+      memcpy(&lnum, rp + off, sizeof(lnum));
+      int64_t rsiz = TTNTOHL(lnum);
+      memcpy(&lnum, rp + off + sizeof(lnum), sizeof(lnum));
+      rsiz += TTNTOHL(lnum);
+      if(size < off + sizeof(lnum) * 2 + rsiz) return 0;
+      off += sizeof(lnum) * 2 + rsiz;
+    }
+    *stp = (rnum > 0) ? 0 : 1;
+    return off;
+  }
+  int off = 0;
+  int hnum = 0;
+  int code = 0;
+  int64_t clen = 0;
+  while(true){
+    const char *ep = memchr(ptr + off, '\n', size - off);
+    if(!ep) return 0;
+    const char *line = ptr + off;
+    int lsiz = ep - line;
+    if(lsiz > 0 && line[lsiz-1] == '\r') lsiz--;
+    off = ep - ptr + 1;
+    if(proto == RATEPRMC){
+      if(req == RATERQPUT){
+        *stp = (lsiz == 6 && !memcmp(line, "STORED", 6)) ? 0 : 2;
+        return off;
+      }
+      if(lsiz == 3 && !memcmp(line, "END", 3)){
+        *stp = (hnum > 0) ? 0 : 1;
+        return off;
+      }
+      if(lsiz < 6 || memcmp(line, "VALUE ", 6)){
+        *stp = 2;
+        return off;
+      }
+      const char *pv = line + lsiz;
+      while(pv > line && pv[-1] >= '0' && pv[-1] <= '9'){
+        pv--;
+      }
+      clen = tcatoi(pv) + 2;
+      if(size < off + clen) return 0;
+      off += clen;
+      hnum++;
+    } else if(hnum++ < 1){
+      const char *pv = memchr(line, ' ', lsiz);
+      if(!pv) return -1;
+      code = tcatoi(pv + 1);
+    } else if(lsiz < 1){
+      if(size < off + clen) return 0;
+      *stp = (code >= 200 && code < 300) ? 0 : (code == 404) ? 1 : 2;
+      return off + clen;
+    } else if(tcstrifwm(line, "content-length:")){
+      clen = tcatoi(line + 15);
+    }
+  }
+  return 0;
+}
+
+
+/* print percentiles of a latency histogram */
+static void printrate(const char *name, const LATHIST *hist, bool json, bool last){
+  uint64_t p50 = histpercentile(hist, 0.5);
+  uint64_t p90 = histpercentile(hist, 0.9);
+  uint64_t p99 = histpercentile(hist, 0.99);
+  uint64_t p999 = histpercentile(hist, 0.999);
+  double mean = hist->num > 0 ? hist->sum / hist->num : 0;
+  if(json){
+    printf("\"%s\":{\"count\":%llu,\"mean\":%.3f,\"p50\":%llu,\"p90\":%llu,\"p99\":%llu,"
+           "\"p999\":%llu,\"max\":%llu}%s", name, (unsigned long long)hist->num, mean,
+           (unsigned long long)p50, (unsigned long long)p90, (unsigned long long)p99,
+           (unsigned long long)p999, (unsigned long long)hist->max, last ? "" : ",");
+  } else {
+    iprintf("%s: count=%llu mean=%.3f p50=%llu p90=%llu p99=%llu p999=%llu max=%llu\n", name,
+            (unsigned long long)hist->num, mean, (unsigned long long)p50,
+            (unsigned long long)p90, (unsigned long long)p99, (unsigned long long)p999,
+            (unsigned long long)hist->max);
+  }
+}
+
+
+/* print a string as a JSON string literal */
+static void printjsonstr(const char *str){
+  putchar('"');
+  for(const unsigned char *rp = (unsigned char *)str; *rp != '\0'; rp++){
+    if(*rp == '"' || *rp == '\\'){
+      printf("\\%c", *rp);
+    } else if(*rp < 0x20){
+      printf("\\u%04x", *rp);
+    } else {
+      putchar(*rp);
+    }
+  }
+  putchar('"');
+}
+
+
+
 // END OF FILE
@@ -924,6 +924,132 @@ static int procmisc(const char *host, int port, int cnum, int tout, int rnum){
       rdb = rdbs[myrand(rnum)%cnum];
     }
   }
+  iprintf("random multi writing:\n");
+  for(int i = 1; i <= rnum; i++){
+    if(i % 10 == 1){
+      TCMAP *recs = tcmapnew();
+      TCLIST *keys = tclistnew();
+      int num = myrand(10) + 1;
+      for(int j = 0; j < num; j++){
+        char kbuf[RECBUFSIZ];
+        int ksiz = sprintf(kbuf, "[%d]", myrand(rnum) + 1);
+        tcmapput(recs, kbuf, ksiz, kbuf, ksiz);
+      }
+      if(tcrdbmput(rdb, recs)){
+        tcmapiterinit(recs);
+        const char *kbuf;
+        int ksiz;
+        while((kbuf = tcmapiternext(recs, &ksiz))){
+          int vsiz;
+          const char *vbuf = tcmapiterval(kbuf, &vsiz);
+          int rsiz;
+          char *rbuf = tcrdbget(rdb, kbuf, ksiz, &rsiz);
+          if(rbuf){
+            if(rsiz != vsiz || memcmp(rbuf, vbuf, rsiz)){
+              eprint(rdb, __LINE__, "(validation)");
+              err = true;
+            }
+            tcfree(rbuf);
+          } else {
+            eprint(rdb, __LINE__, "tcrdbget");
+            err = true;
+          }
+          tclistpush(keys, kbuf, ksiz);
+        }
+      } else {
+        eprint(rdb, __LINE__, "tcrdbmput");
+        err = true;
+      }
+      if(myrand(2) == 0 && !tcrdbmout(rdb, keys) && tcrdbecode(rdb) != TTENOREC){
+        eprint(rdb, __LINE__, "tcrdbmout");
+        err = true;
+      }
+      tclistdel(keys);
+      tcmapdel(recs);
+    }
+    if(rnum > 250 && i % (rnum / 250) == 0){
+      iputchar('.');
+      if(i == rnum || i % (rnum / 10) == 0) iprintf(" (%08d)\n", i);
+      rdb = rdbs[myrand(rnum)%cnum];
+    }
+  }
+  iprintf("random batch calling:\n");
+  for(int i = 1; i <= rnum; i++){
+    if(i % 10 == 1){
+      RDBBATCH *batch = tcrdbbatchnew(rdb);
+      char kbuf[RECBUFSIZ];
+      int ksiz = sprintf(kbuf, "{%d}", myrand(rnum) + 1);
+      tcrdbbatchput(batch, kbuf, ksiz, kbuf, ksiz);
+      tcrdbbatchget(batch, kbuf, ksiz);
+      tcrdbbatchvsiz(batch, kbuf, ksiz);
+      tcrdbbatchaddint(batch, "{batch}", 7, 1);
+      if(myrand(2) == 0) tcrdbbatchout(batch, kbuf, ksiz);
+      if(tcrdbbatchexec(batch)){
+        int rsiz;
+        const char *rbuf = tcrdbbatchval(batch, 1, &rsiz);
+        if(!rbuf || rsiz != ksiz || memcmp(rbuf, kbuf, ksiz) ||
+           !(rbuf = tcrdbbatchval(batch, 2, &rsiz)) || tcatoi(rbuf) != ksiz ||
+           !tcrdbbatchval(batch, 0, &rsiz) || !tcrdbbatchval(batch, 3, &rsiz) ||
+           (tcrdbbatchnum(batch) > 4 && !tcrdbbatchval(batch, 4, &rsiz))){
+          eprint(rdb, __LINE__, "(validation)");
+          err = true;
+        }
+      } else {
+        eprint(rdb, __LINE__, "tcrdbbatchexec");
+        err = true;
+      }
+      tcrdbbatchdel(batch);
+    }
+    if(rnum > 250 && i % (rnum / 250) == 0){
+      iputchar('.');
+      if(i == rnum || i % (rnum / 10) == 0) iprintf(" (%08d)\n", i);
+      rdb = rdbs[myrand(rnum)%cnum];
+    }
+  }
+  iprintf("cursor scanning:\n");
+  TCRDB *crdb = rdb;
+  RDBCUR *cur = tcrdbcurnew(crdb);
+  if(!cur){
+    eprint(crdb, __LINE__, "tcrdbcurnew");
+    err = true;
+  }
+  for(int i = 1; cur && i <= rnum; i++){
+    if(i % 10 == 1){
+      if(myrand(20) == 0){
+        char kbuf[RECBUFSIZ];
+        int ksiz = sprintf(kbuf, "[%d]", myrand(rnum) + 1);
+        if(!tcrdbcurjump(cur, kbuf, ksiz) && tcrdbecode(crdb) != TTEMISC){
+          eprint(crdb, __LINE__, "tcrdbcurjump");
+          err = true;
+          break;
+        }
+      }
+      TCLIST *recs = tcrdbcurnext(cur, myrand(16) + 1, myrand(4096));
+      if(!recs){
+        eprint(crdb, __LINE__, "tcrdbcurnext");
+        err = true;
+        break;
+      }
+      for(int j = 0; j < tclistnum(recs) - 1; j += 2){
+        int ksiz, vsiz;
+        const char *kbuf = tclistval(recs, j, &ksiz);
+        const char *vbuf = tclistval(recs, j + 1, &vsiz);
+        int rsiz;
+        char *rbuf = tcrdbget(crdb, kbuf, ksiz, &rsiz);
+        if(!rbuf || rsiz != vsiz || memcmp(rbuf, vbuf, rsiz)){
+          eprint(crdb, __LINE__, "(validation)");
+          err = true;
+        }
+        tcfree(rbuf);
+      }
+      tclistdel(recs);
+    }
+    if(rnum > 250 && i % (rnum / 250) == 0){
+      iputchar('.');
+      if(i == rnum || i % (rnum / 10) == 0) iprintf(" (%08d)\n", i);
+    }
+  }
+  if(cur) tcrdbcurdel(cur);
   iprintf("script extension calling:\n");
   for(int i = 1; i <= rnum; i++){
     char kbuf[RECBUFSIZ];
@@ -18,10 +18,59 @@
 #include "tculog.h"
 #include "myconf.h"
 
-#define TCULAIOCBNUM   64                // number of AIO tasks
+#define TCULURINGNUM   4                 // number of entries of the io_uring instance
+#define TCULRINGSIZ    (1<<22)           // size of the record ring
+#define TCULRINGIND    0xff              // mark of an entry of the record ring with a pointer
+#define TCULRINGIOV    64                // maximum number of vectors of the writer thread
+#define TCULRINGERRNUM 8                 // number of failed ranges kept by the record ring
+#define TCULRINGBATNUM 4                 // number of batches kept in flight by the writer thread
+#define TCULIDXSTEP    (1<<16)           // interval of entries of the index of each file
+#define TCULIDXBUFSIZ  (1<<20)           // size of the buffer to build an index
+#define TCULRDMAPMIN   (1<<20)           // minimum size of the mapping of a log reader
+#define TCULGBUFMAX    (1<<20)           // maximum size of a kept buffer of group commit
 #define TCULTMDEVALW   30.0              // allowed time deviance
 #define TCREPLTIMEO    60.0              // timeout of the replication socket
 
+typedef struct {                         // type of structure for a record ring
+  unsigned char *buf;                    // region of the ring
+  volatile uint64_t head;                // position reserved by writers
+  volatile uint64_t tail;                // position drained by the writer thread
+  volatile bool sleep;                   // whether the writer thread is sleeping
+  volatile bool fin;                     // whether the writer thread should finish
+  volatile bool err;                     // whether writing failed
+  uint64_t errs[TCULRINGERRNUM][2];      // beginning and end positions of failed ranges
+  volatile int errnum;                   // number of failed ranges
+  pthread_key_t pkey;                    // key of the position last put by each thread
+  pthread_mutex_t mtx;                   // mutex for the conditions
+  pthread_cond_t wcnd;                   // condition to wake the writer thread
+  pthread_cond_t scnd;                   // condition to wait for space
+  pthread_t thid;                        // ID of the writer thread
+  bool alive;                            // whether the writer thread is running
+} TCULRING;
+
+typedef struct {                         // type of structure for a batch of the writer thread
+  struct iovec iov[TCULRINGIOV];         // vectors of the records
+  int iovnum;                            // number of the vectors
+  int iovcur;                            // index of the first vector not written yet
+  char *copies[TCULRINGIOV];             // duplicated regions of large records
+  int cnum;                              // number of the duplicated regions
+  uint64_t beg;                          // beginning position in the ring
+  uint64_t end;                          // end position in the ring
+  uint64_t off;                          // offset of the data not written yet in the file
+  uint64_t wsiz;                         // size of the records
+  int rnum;                              // number of the records
+  TCXSTR *ixbuf;                         // buffer of the index entries
+  bool rot;                              // whether the file is rotated after the batch
+  volatile bool busy;                    // whether the batch is being written
+  bool err;                              // whether writing failed
+} TCULBATCH;
+
+typedef struct _TCULGWAIT {              // type of structure for a writer of group commit
+  struct _TCULGWAIT *next;               // next writer
+  bool done;                             // whether the record has been written
+  bool err;                              // whether writing the record failed
+} TCULGWAIT;
+
 typedef struct {                         // type of structure for a putshl operand
   const char *vbuf;                      // region of the value.
   int vsiz;                              // size of the region
@@ -30,8 +79,39 @@ typedef struct {                         // type of structure for a putshl opera
 
 
 /* private function prototypes */
-static bool tculogflushaiocbp(struct aiocb *aiocbp);
+static bool tculogopenfile(TCULOG *ulog);
+static bool tculogopenindex(TCULOG *ulog);
+static void tculogaddindex(TCXSTR *ixbuf, uint64_t *nextp, uint64_t off,
+                           const unsigned char *buf, int64_t size);
+static bool tculogflushindex(TCULOG *ulog);
+static bool tculogbuildindex(const char *base, int id);
+static void tculogprepindex(TCULOG *ulog, int id);
+static uint64_t tculogseekindex(const char *base, int id, uint64_t ts);
+static bool tculrdmap(TCULRD *ulrd, uint64_t end);
+static uint64_t tculrdend(TCULRD *ulrd);
+static void tculrdunmap(TCULRD *ulrd);
+static bool tculogrotate(TCULOG *ulog);
+static bool tculogwritegroup(TCULOG *ulog, unsigned char *buf, int size, bool stamp);
+static bool tculogflushgroup(TCULOG *ulog, void *buf, int size, int rnum, bool stamp);
+static void tculogstamp(TCULOG *ulog, unsigned char *buf);
+static bool tculogsyncfile(TCULOG *ulog, int fd);
+static void tculogsetdsize(TCULOG *ulog, int max, uint64_t size);
+static bool tculogringput(TCULOG *ulog, const unsigned char *buf, int size);
+static bool tculogringcheck(TCULRING *ring);
+static void tculogringfail(TCULRING *ring, uint64_t beg, uint64_t end);
+static void tculogringstore(TCULRING *ring, uint64_t pos, const void *buf, int size);
+static void tculogringload(TCULRING *ring, uint64_t pos, void *buf, int size);
+static bool tculogringunstamped(const unsigned char *buf);
+static void tculogringwake(TCULRING *ring);
+static void *tculogringproc(void *opq);
+static void tculogringsubmit(TCULOG *ulog, TCULBATCH *bat, int id);
+static void tculogringdone(TCULOG *ulog, TCULBATCH *bat, int id, int res);
+static void tculogringrelease(TCULOG *ulog, TCULBATCH *bat, bool fail);
 static void *tculogadbputshlproc(const void *vbuf, int vsiz, int *sp, PUTSHLOP *op);
+static bool tculogbeginlist(TCULOG *ulog, const TCLIST *keys, int step, bool *idxs);
+static void tculogendlist(TCULOG *ulog, const bool *idxs);
+static int tculogadbmulti(TCULOG *ulog, uint32_t sid, uint32_t mid, TCADB *adb,
+                          const TCLIST *elems, int cmd);
 
 
 
@@ -46,17 +126,39 @@ TCULOG *tculognew(void){
   for(int i = 0; i < TCULRMTXNUM; i++){
     if(pthread_mutex_init(ulog->rmtxs + i, NULL) != 0) tcmyfatal("pthread_mutex_init failed");
   }
+  if(pthread_key_create(&ulog->hkey, NULL) != 0) tcmyfatal("pthread_key_create failed");
   if(pthread_rwlock_init(&ulog->rwlck, NULL) != 0) tcmyfatal("pthread_rwlock_init failed");
   if(pthread_cond_init(&ulog->cnd, NULL) != 0) tcmyfatal("pthread_cond_init failed");
   if(pthread_mutex_init(&ulog->wmtx, NULL) != 0) tcmyfatal("pthread_mutex_init failed");
+  if(pthread_mutex_init(&ulog->gmtx, NULL) != 0) tcmyfatal("pthread_mutex_init failed");
+  if(pthread_cond_init(&ulog->gcnd, NULL) != 0) tcmyfatal("pthread_cond_init failed");
+  if(pthread_mutex_init(&ulog->imtx, NULL) != 0) tcmyfatal("pthread_mutex_init failed");
+  ulog->gbuf = tcxstrnew3(TTIOBUFSIZ);
+  ulog->gspare = tcxstrnew3(TTIOBUFSIZ);
+  ulog->gwaits = NULL;
+  ulog->gbusy = false;
+  ulog->sts = 0;
+  ulog->spol = TCULSNONE;
+  ulog->sdirty = false;
   ulog->base = NULL;
   ulog->limsiz = 0;
   ulog->max = 0;
   ulog->fd = -1;
   ulog->size = 0;
-  ulog->aiocbs = NULL;
-  ulog->aiocbi = 0;
-  ulog->aioend = 0;
+  ulog->ixfd = -1;
+  ulog->ixnext = 0;
+  ulog->ixbuf = tcxstrnew();
+  ulog->dsize = 0;
+  ulog->uring = NULL;
+  ulog->ring = NULL;
+  ulog->metrics = NULL;
+  ulog->mtid = -1;
+  ulog->mtsync = -1;
+  ulog->mtsusec = -1;
+  ulog->mtgroup = -1;
+  ulog->mtgrec = -1;
+  ulog->syncproc = NULL;
+  ulog->syncop = NULL;
   return ulog;
 }
 
@@ -65,10 +167,28 @@ TCULOG *tculognew(void){
 void tculogdel(TCULOG *ulog){
   assert(ulog);
   if(ulog->base) tculogclose(ulog);
-  if(ulog->aiocbs) tcfree(ulog->aiocbs);
+  if(ulog->ring){
+    TCULRING *ring = ulog->ring;
+    pthread_key_delete(ring->pkey);
+    pthread_cond_destroy(&ring->scnd);
+    pthread_cond_destroy(&ring->wcnd);
+    pthread_mutex_destroy(&ring->mtx);
+    tcfree(ring->buf);
+    tcfree(ring);
+  }
+#if defined(TTUSEURING)
+  if(ulog->uring) _tt_uring_del(ulog->uring);
+#endif
+  tcxstrdel(ulog->ixbuf);
+  tcxstrdel(ulog->gspare);
+  tcxstrdel(ulog->gbuf);
+  pthread_mutex_destroy(&ulog->imtx);
+  pthread_cond_destroy(&ulog->gcnd);
+  pthread_mutex_destroy(&ulog->gmtx);
   pthread_mutex_destroy(&ulog->wmtx);
   pthread_cond_destroy(&ulog->cnd);
   pthread_rwlock_destroy(&ulog->rwlck);
+  pthread_key_delete(ulog->hkey);
   for(int i = TCULRMTXNUM - 1; i >= 0; i--){
     pthread_mutex_destroy(ulog->rmtxs + i);
   }
@@ -76,21 +196,63 @@ void tculogdel(TCULOG *ulog){
 }
 
 
-/* Set AIO control of an update log object. */
-bool tculogsetaio(TCULOG *ulog){
-#if defined(_SYS_LINUX_)
+/* Set the metrics registry of an update log object. */
+void tculogsetmetrics(TCULOG *ulog, TTMETRICS *metrics){
+  assert(ulog && metrics);
+  ulog->mtid = ttmetricsreg(metrics, "ulog_bytes", TTMTBYTES);
+  ulog->mtsync = ttmetricsreg(metrics, "ulog_syncs", TTMTCOUNTER);
+  ulog->mtsusec = ttmetricsreg(metrics, "ulog_sync_usec", TTMTCOUNTER);
+  ulog->mtgroup = ttmetricsreg(metrics, "ulog_groups", TTMTCOUNTER);
+  ulog->mtgrec = ttmetricsreg(metrics, "ulog_group_records", TTMTCOUNTER);
+  if(ulog->mtid >= 0 && ulog->mtsync >= 0 && ulog->mtsusec >= 0 && ulog->mtgroup >= 0 &&
+     ulog->mtgrec >= 0) ulog->metrics = metrics;
+}
+
+
+/* Set the function to observe synchronizations of an update log object. */
+void tculogsetsyncproc(TCULOG *ulog, void (*proc)(double, void *), void *op){
+  assert(ulog && proc);
+  ulog->syncproc = proc;
+  ulog->syncop = op;
+}
+
+
+/* Set the synchronization policy of an update log object. */
+bool tculogsetsync(TCULOG *ulog, int policy){
   assert(ulog);
-  if(ulog->base || ulog->aiocbs) return false;
-  struct aiocb *aiocbs = tcmalloc(sizeof(*aiocbs) * TCULAIOCBNUM);
-  for(int i = 0; i < TCULAIOCBNUM; i++){
-    memset(aiocbs + i, 0, sizeof(*aiocbs));
+  if(ulog->base) return false;
+  switch(policy){
+    case TCULSNONE:
+    case TCULSINTERVAL:
+      break;
+    case TCULSGROUP:
+    case TCULSALWAYS:
+      if(ulog->ring) return false;
+      break;
+    default:
+      return false;
   }
-  ulog->aiocbs = aiocbs;
+  ulog->spol = policy;
   return true;
-#else
+}
+
+
+/* Set AIO control of an update log object. */
+bool tculogsetaio(TCULOG *ulog){
   assert(ulog);
-  return true;
+  if(ulog->base || ulog->ring) return false;
+  TCULRING *ring = tcmalloc(sizeof(*ring));
+  ring->buf = tcmalloc(TCULRINGSIZ);
+  if(pthread_key_create(&ring->pkey, free) != 0) tcmyfatal("pthread_key_create failed");
+  if(pthread_mutex_init(&ring->mtx, NULL) != 0) tcmyfatal("pthread_mutex_init failed");
+  if(pthread_cond_init(&ring->wcnd, NULL) != 0) tcmyfatal("pthread_cond_init failed");
+  if(pthread_cond_init(&ring->scnd, NULL) != 0) tcmyfatal("pthread_cond_init failed");
+  ring->alive = false;
+  ulog->ring = ring;
+#if defined(TTUSEURING)
+  ulog->uring = _tt_uring_new(TCULURINGNUM);
 #endif
+  return true;
 }
 
 
@@ -114,22 +276,43 @@ bool tculogopen(TCULOG *ulog, const char *base, uint64_t limsiz){
   }
   tclistdel(names);
   if(max < 1) max = 1;
+  char *ixpath = tcsprintf("%s/%08d%s", base, max, TCULIDXSUFFIX);
+  char *path = tcsprintf("%s/%08d%s", base, max, TCULSUFFIX);
+  bool miss = stat(ixpath, &sbuf) != 0 && stat(path, &sbuf) == 0;
+  tcfree(path);
+  tcfree(ixpath);
+  if(miss && !tculogbuildindex(base, max)) return false;
   ulog->base = tcstrdup(base);
   ulog->limsiz = (limsiz > 0) ? limsiz : INT64_MAX / 2;
   ulog->max = max;
   ulog->fd = -1;
-  ulog->size = sbuf.st_size;
-  struct aiocb *aiocbs = ulog->aiocbs;
-  if(aiocbs){
-    for(int i = 0; i < TCULAIOCBNUM; i++){
-      struct aiocb *aiocbp = aiocbs + i;
-      aiocbp->aio_fildes = 0;
-      aiocbp->aio_buf = NULL;
-      aiocbp->aio_nbytes = 0;
+  path = tcsprintf("%s/%08d%s", base, max, TCULSUFFIX);
+  ulog->size = (stat(path, &sbuf) == 0) ? sbuf.st_size : 0;
+  ulog->dsize = ulog->size;
+  tcfree(path);
+  ulog->ixfd = -1;
+  ulog->ixnext = 0;
+  tcxstrclear(ulog->ixbuf);
+  if(ulog->ring){
+    TCULRING *ring = ulog->ring;
+    memset(ring->buf, 0, TCULRINGSIZ);
+    ring->tail = ring->head;
+    ring->sleep = false;
+    ring->fin = false;
+    ring->err = false;
+    ring->errnum = 0;
+    if(!tculogopenfile(ulog) ||
+       pthread_create(&ring->thid, NULL, tculogringproc, ulog) != 0){
+      if(ulog->fd != -1) close(ulog->fd);
+      ulog->fd = -1;
+      if(ulog->ixfd != -1) close(ulog->ixfd);
+      ulog->ixfd = -1;
+      tcfree(ulog->base);
+      ulog->base = NULL;
+      return false;
     }
+    ring->alive = true;
   }
-  ulog->aiocbi = 0;
-  ulog->aioend = 0;
   return true;
 }
 
@@ -139,23 +322,62 @@ bool tculogclose(TCULOG *ulog){
   assert(ulog);
   if(!ulog->base) return false;
   bool err = false;
-  struct aiocb *aiocbs = ulog->aiocbs;
-  if(aiocbs){
-    for(int i = 0; i < TCULAIOCBNUM; i++){
-      if(!tculogflushaiocbp(aiocbs + i)) err = true;
+  TCULRING *ring = ulog->ring;
+  if(ring && ring->alive){
+    ring->fin = true;
+    tculogringwake(ring);
+    if(pthread_join(ring->thid, NULL) != 0) err = true;
+    ring->alive = false;
+    if(ring->err) err = true;
+  }
+  if(ulog->fd != -1 && ulog->spol != TCULSNONE && ulog->sdirty){
+    if(tculogsyncfile(ulog, ulog->fd)){
+      ulog->dsize = ulog->size;
+    } else {
+      err = true;
     }
   }
+  ulog->sdirty = false;
   if(ulog->fd != -1 && close(ulog->fd) != 0) err = true;
+  ulog->fd = -1;
+  if(!tculogflushindex(ulog)) err = true;
+  if(ulog->ixfd != -1 && close(ulog->ixfd) != 0) err = true;
+  ulog->ixfd = -1;
   tcfree(ulog->base);
   ulog->base = NULL;
   return !err;
 }
 
 
+/* Synchronize the current file of an update log object with the device. */
+bool tculogsync(TCULOG *ulog){
+  assert(ulog);
+  if(!ulog->base) return false;
+  if(pthread_rwlock_wrlock(&ulog->rwlck) != 0) return false;
+  int fd = -1;
+  int max = ulog->max;
+  uint64_t size = ulog->size;
+  if(ulog->sdirty && ulog->fd != -1){
+    fd = dup(ulog->fd);
+    ulog->sdirty = false;
+  }
+  pthread_rwlock_unlock(&ulog->rwlck);
+  if(fd == -1) return true;
+  bool err = false;
+  if(tculogsyncfile(ulog, fd)){
+    tculogsetdsize(ulog, max, size);
+  } else {
+    err = true;
+  }
+  if(close(fd) != 0) err = true;
+  return !err;
+}
+
+
 /* Get the mutex index of a record. */
 int tculogrmtxidx(TCULOG *ulog, const char *kbuf, int ksiz){
   assert(ulog && kbuf && ksiz >= 0);
-  if(!ulog->base || !ulog->aiocbs) return 0;
+  if(!ulog->base) return 0;
   uint32_t hash = 19780211;
   while(ksiz--){
     hash = hash * 41 + *(uint8_t *)kbuf++;
@@ -168,17 +390,20 @@ int tculogrmtxidx(TCULOG *ulog, const char *kbuf, int ksiz){
 bool tculogbegin(TCULOG *ulog, int idx){
   assert(ulog);
   if(!ulog->base) return false;
+  uint32_t held = (uintptr_t)pthread_getspecific(ulog->hkey);
   if(idx < 0){
     for(int i = 0; i < TCULRMTXNUM; i++){
+      if(held & (1U << i)) continue;
       if(pthread_mutex_lock(ulog->rmtxs + i) != 0){
         for(i--; i >= 0; i--){
-          pthread_mutex_unlock(ulog->rmtxs + i);
+          if(!(held & (1U << i))) pthread_mutex_unlock(ulog->rmtxs + i);
         }
         return false;
       }
     }
     return true;
   }
+  if(held & (1U << idx)) return true;
   return pthread_mutex_lock(ulog->rmtxs + idx) == 0;
 }
 
@@ -186,38 +411,58 @@ bool tculogbegin(TCULOG *ulog, int idx){
 /* End the critical section of an update log object. */
 bool tculogend(TCULOG *ulog, int idx){
   assert(ulog);
+  uint32_t held = (uintptr_t)pthread_getspecific(ulog->hkey);
   if(idx < 0){
     bool err = false;
     for(int i = TCULRMTXNUM - 1; i >= 0; i--){
+      if(held & (1U << i)) continue;
       if(pthread_mutex_unlock(ulog->rmtxs + i) != 0) err = true;
     }
     return !err;
   }
+  if(held & (1U << idx)) return true;
   return pthread_mutex_unlock(ulog->rmtxs + idx) == 0;
 }
 
 
+/* Begin the critical section of records of an update log object. */
+bool tculogbeginrecs(TCULOG *ulog, const TCLIST *keys){
+  assert(ulog && keys);
+  bool idxs[TCULRMTXNUM];
+  if(!tculogbeginlist(ulog, keys, 1, idxs)) return false;
+  uint32_t held = (uintptr_t)pthread_getspecific(ulog->hkey);
+  for(int i = 0; i < TCULRMTXNUM; i++){
+    if(idxs[i]) held |= 1U << i;
+  }
+  if(pthread_setspecific(ulog->hkey, (void *)(uintptr_t)held) != 0){
+    tculogendlist(ulog, idxs);
+    return false;
+  }
+  return true;
+}
+
+
+/* End the critical section of records of an update log object. */
+bool tculogendrecs(TCULOG *ulog){
+  assert(ulog);
+  uint32_t held = (uintptr_t)pthread_getspecific(ulog->hkey);
+  if(pthread_setspecific(ulog->hkey, NULL) != 0) return false;
+  bool err = false;
+  for(int i = TCULRMTXNUM - 1; i >= 0; i--){
+    if((held & (1U << i)) && pthread_mutex_unlock(ulog->rmtxs + i) != 0) err = true;
+  }
+  return !err;
+}
+
+
 /* Write a message into an update log object. */
 bool tculogwrite(TCULOG *ulog, uint64_t ts, uint32_t sid, uint32_t mid,
                  const void *ptr, int size){
   assert(ulog && ptr && size >= 0);
   if(!ulog->base) return false;
-  if(ts < 1) ts = (uint64_t)(tctime() * 1000000);
+  bool stamp = ts < 1;
+  if(stamp && !ulog->ring) ts = (uint64_t)(tctime() * 1000000);
   bool err = false;
-  if(pthread_rwlock_wrlock(&ulog->rwlck) != 0) return false;
-  pthread_cleanup_push((void (*)(void *))pthread_rwlock_unlock, &ulog->rwlck);
-  if(ulog->fd == -1){
-    char *path = tcsprintf("%s/%08d%s", ulog->base, ulog->max, TCULSUFFIX);
-    int fd = open(path, O_WRONLY | O_CREAT | O_APPEND, 00644);
-    tcfree(path);
-    struct stat sbuf;
-    if(fd != -1 && fstat(fd, &sbuf) == 0){
-      ulog->fd = fd;
-      ulog->size = sbuf.st_size;
-    } else {
-      err = true;
-    }
-  }
   int rsiz = sizeof(uint8_t) + sizeof(uint64_t) + sizeof(uint32_t) * 2 + size;
   unsigned char stack[TTIOBUFSIZ];
   unsigned char *buf = (rsiz < TTIOBUFSIZ) ? stack : tcmalloc(rsiz);
@@ -237,70 +482,14 @@ bool tculogwrite(TCULOG *ulog, uint64_t ts, uint32_t sid, uint32_t mid,
   memcpy(wp, &lnum, sizeof(lnum));
   wp += sizeof(lnum);
   memcpy(wp, ptr, size);
-  if(ulog->fd != -1){
-    struct aiocb *aiocbs = (struct aiocb *)ulog->aiocbs;
-    if(aiocbs){
-      struct aiocb *aiocbp = aiocbs + ulog->aiocbi;
-      if(aiocbp->aio_buf){
-        off_t aioend = aiocbp->aio_offset + aiocbp->aio_nbytes;
-        if(tculogflushaiocbp(aiocbp)){
-          ulog->aioend = aioend;
-        } else {
-          err = true;
-        }
-      }
-      aiocbp->aio_fildes = ulog->fd;
-      aiocbp->aio_offset = ulog->size;
-      aiocbp->aio_buf = tcmemdup(buf, rsiz);
-      aiocbp->aio_nbytes = rsiz;
-      while(aio_write(aiocbp) != 0){
-        if(errno != EAGAIN){
-          tcfree((char *)aiocbp->aio_buf);
-          aiocbp->aio_buf = NULL;
-          err = true;
-          break;
-        }
-        for(int i = 0; i < TCULAIOCBNUM; i++){
-          if(i == ulog->aiocbi) continue;
-          if(!tculogflushaiocbp(aiocbs + i)){
-            err = true;
-            break;
-          }
-        }
-      }
-      ulog->aiocbi = (ulog->aiocbi + 1) % TCULAIOCBNUM;
-    } else {
-      if(!tcwrite(ulog->fd, buf, rsiz)) err = true;
-    }
-    if(!err){
-      ulog->size += rsiz;
-      if(ulog->size >= ulog->limsiz){
-        if(aiocbs){
-          for(int i = 0; i < TCULAIOCBNUM; i++){
-            if(!tculogflushaiocbp(aiocbs + i)) err = true;
-          }
-          ulog->aiocbi = 0;
-          ulog->aioend = 0;
-        }
-        char *path = tcsprintf("%s/%08d%s", ulog->base, ulog->max + 1, TCULSUFFIX);
-        int fd = open(path, O_WRONLY | O_CREAT | O_APPEND, 00644);
-        tcfree(path);
-        if(fd != 0){
-          if(close(ulog->fd) != 0) err = true;
-          ulog->fd = fd;
-          ulog->size = 0;
-          ulog->max++;
-        } else {
-          err = true;
-        }
-      }
-      if(pthread_cond_broadcast(&ulog->cnd) != 0) err = true;
-    }
-  } else {
+  tttracemark(TTTSULWAIT);
+  if(ulog->ring){
+    if(!tculogringput(ulog, buf, rsiz)) err = true;
+  } else if(!tculogwritegroup(ulog, buf, rsiz, stamp)){
     err = true;
   }
   pthread_cleanup_pop(1);
-  pthread_cleanup_pop(1);
+  tttracemark(TTTSULEND);
   return !err;
 }
 
@@ -347,13 +536,17 @@ TCULRD *tculrdnew(TCULOG *ulog, uint64_t ts){
     if(bts >= fts) break;
   }
   if(num < 1) num = 1;
+  if(num < ulog->max) tculogprepindex(ulog, num);
   TCULRD *urld = tcmalloc(sizeof(*urld));
   urld->ulog = ulog;
   urld->ts = ts;
   urld->num = num;
   urld->fd = -1;
-  urld->rbuf = tcmalloc(TTIOBUFSIZ);
-  urld->rsiz = TTIOBUFSIZ;
+  urld->off = tculogseekindex(ulog->base, num, bts);
+  urld->map = NULL;
+  urld->msiz = 0;
+  urld->fsiz = 0;
+  urld->sealed = false;
   pthread_rwlock_unlock(&ulog->rwlck);
   return urld;
 }
@@ -362,8 +555,7 @@ TCULRD *tculrdnew(TCULOG *ulog, uint64_t ts){
 /* Delete a log reader object. */
 void tculrddel(TCULRD *ulrd){
   assert(ulrd);
-  if(ulrd->fd != -1) close(ulrd->fd);
-  tcfree(ulrd->rbuf);
+  tculrdunmap(ulrd);
   tcfree(ulrd);
 }
 
@@ -394,83 +586,49 @@ void tculrdwait(TCULRD *ulrd){
 /* Read a message from a log reader object. */
 const void *tculrdread(TCULRD *ulrd, int *sp, uint64_t *tsp, uint32_t *sidp, uint32_t *midp){
   assert(ulrd && sp && tsp && sidp && midp);
-  TCULOG *ulog = ulrd->ulog;
-  if(pthread_rwlock_rdlock(&ulog->rwlck) != 0) return NULL;
-  if(ulrd->fd == -1){
-    char *path = tcsprintf("%s/%08d%s", ulog->base, ulrd->num, TCULSUFFIX);
-    ulrd->fd = open(path, O_RDONLY, 00644);
-    tcfree(path);
-    if(ulrd->fd == -1){
-      pthread_rwlock_unlock(&ulog->rwlck);
-      return NULL;
-    }
-  }
-  int rsiz = sizeof(uint8_t) + sizeof(uint64_t) + sizeof(uint32_t) * 2;
-  unsigned char buf[rsiz];
-  uint64_t ts;
-  uint32_t sid, mid, size;
+  int hsiz = sizeof(uint8_t) + sizeof(uint64_t) + sizeof(uint32_t) * 2;
   while(true){
-    if(ulog->aiocbs && ulrd->num == ulog->max){
-      struct stat sbuf;
-      if(fstat(ulrd->fd, &sbuf) == -1 ||
-         (sbuf.st_size < ulog->size && sbuf.st_size >= ulog->aioend)){
-        pthread_rwlock_unlock(&ulog->rwlck);
-        return NULL;
-      }
-    }
-    if(!tcread(ulrd->fd, buf, rsiz)){
-      if(ulrd->num < ulog->max){
-        close(ulrd->fd);
-        ulrd->num++;
-        char *path = tcsprintf("%s/%08d%s", ulog->base, ulrd->num, TCULSUFFIX);
-        ulrd->fd = open(path, O_RDONLY, 00644);
-        tcfree(path);
-        if(ulrd->fd == -1){
-          pthread_rwlock_unlock(&ulog->rwlck);
-          return NULL;
-        }
-        continue;
-      }
-      pthread_rwlock_unlock(&ulog->rwlck);
-      return NULL;
-    }
-    const unsigned char *rp = buf;
-    if(*rp != TCULMAGICNUM){
-      pthread_rwlock_unlock(&ulog->rwlck);
-      return NULL;
+    if(ulrd->fd == -1 && !tculrdmap(ulrd, 0)) return NULL;
+    uint64_t end = tculrdend(ulrd);
+    if(ulrd->off + hsiz > end){
+      if(!ulrd->sealed) return NULL;
+      tculrdunmap(ulrd);
+      ulrd->num++;
+      ulrd->off = 0;
+      continue;
     }
+    if(end > ulrd->msiz && !tculrdmap(ulrd, end)) return NULL;
+    const unsigned char *rp = (unsigned char *)ulrd->map + ulrd->off;
+    if(*rp != TCULMAGICNUM) return NULL;
     rp += sizeof(uint8_t);
+    uint64_t ts;
     memcpy(&ts, rp, sizeof(ts));
     ts = TTNTOHLL(ts);
     rp += sizeof(ts);
     uint16_t snum;
     memcpy(&snum, rp, sizeof(snum));
-    sid = TTNTOHS(snum);
+    uint32_t sid = TTNTOHS(snum);
     rp += sizeof(snum);
     memcpy(&snum, rp, sizeof(snum));
-    mid = TTNTOHS(snum);
+    uint32_t mid = TTNTOHS(snum);
     rp += sizeof(snum);
+    uint32_t size;
     memcpy(&size, rp, sizeof(size));
     size = TTNTOHL(size);
     rp += sizeof(size);
-    if(ulrd->rsiz < size + 1){
-      ulrd->rbuf = tcrealloc(ulrd->rbuf, size + 1);
-      ulrd->rsiz = size + 1;
-    }
-    if(!tcread(ulrd->fd, ulrd->rbuf, size)){
-      pthread_rwlock_unlock(&ulog->rwlck);
-      return NULL;
+    if(ulrd->off + hsiz + size > end){
+      if(!ulrd->sealed) return NULL;
+      ulrd->off = end;
+      continue;
     }
+    ulrd->off += hsiz + size;
     if(ts < ulrd->ts) continue;
-    break;
+    *sp = size;
+    *tsp = ts;
+    *sidp = sid;
+    *midp = mid;
+    return rp;
   }
-  *sp = size;
-  *tsp = ts;
-  *sidp = sid;
-  *midp = mid;
-  ulrd->rbuf[size] = '\0';
-  pthread_rwlock_unlock(&ulog->rwlck);
-  return ulrd->rbuf;
 }
 
 
@@ -481,7 +639,9 @@ bool tculogadbput(TCULOG *ulog, uint32_t sid, uint32_t mid, TCADB *adb,
   bool err = false;
   int rmidx = tculogrmtxidx(ulog, kbuf, ksiz);
   bool dolog = tculogbegin(ulog, rmidx);
+  tttracemark(TTTSDBBEGIN);
   if(!tcadbput(adb, kbuf, ksiz, vbuf, vsiz)) err = true;
+  tttracemark(TTTSDBEND);
   if(dolog){
     unsigned char mstack[TTIOBUFSIZ];
     int msiz = sizeof(uint8_t) * 3 + sizeof(uint32_t) * 2 + ksiz + vsiz;
@@ -516,7 +676,9 @@ bool tculogadbputkeep(TCULOG *ulog, uint32_t sid, uint32_t mid, TCADB *adb,
   bool err = false;
   int rmidx = tculogrmtxidx(ulog, kbuf, ksiz);
   bool dolog = tculogbegin(ulog, rmidx);
+  tttracemark(TTTSDBBEGIN);
   if(!tcadbputkeep(adb, kbuf, ksiz, vbuf, vsiz)) err = true;
+  tttracemark(TTTSDBEND);
   if(dolog){
     unsigned char mstack[TTIOBUFSIZ];
     int msiz = sizeof(uint8_t) * 3 + sizeof(uint32_t) * 2 + ksiz + vsiz;
@@ -551,7 +713,9 @@ bool tculogadbputcat(TCULOG *ulog, uint32_t sid, uint32_t mid, TCADB *adb,
   bool err = false;
   int rmidx = tculogrmtxidx(ulog, kbuf, ksiz);
   bool dolog = tculogbegin(ulog, rmidx);
+  tttracemark(TTTSDBBEGIN);
   if(!tcadbputcat(adb, kbuf, ksiz, vbuf, vsiz)) err = true;
+  tttracemark(TTTSDBEND);
   if(dolog){
     unsigned char mstack[TTIOBUFSIZ];
     int msiz = sizeof(uint8_t) * 3 + sizeof(uint32_t) * 2 + ksiz + vsiz;
@@ -590,8 +754,10 @@ bool tculogadbputshl(TCULOG *ulog, uint32_t sid, uint32_t mid, TCADB *adb,
   op.vbuf = vbuf;
   op.vsiz = vsiz;
   op.width = width;
+  tttracemark(TTTSDBBEGIN);
   if(!tcadbputproc(adb, kbuf, ksiz, vbuf, vsiz, (TCPDPROC)tculogadbputshlproc, &op))
     err = true;
+  tttracemark(TTTSDBEND);
   if(dolog){
     unsigned char mstack[TTIOBUFSIZ];
     int msiz = sizeof(uint8_t) * 3 + sizeof(uint32_t) * 3 + ksiz + vsiz;
@@ -629,7 +795,9 @@ bool tculogadbout(TCULOG *ulog, uint32_t sid, uint32_t mid, TCADB *adb,
   bool err = false;
   int rmidx = tculogrmtxidx(ulog, kbuf, ksiz);
   bool dolog = tculogbegin(ulog, rmidx);
+  tttracemark(TTTSDBBEGIN);
   if(!tcadbout(adb, kbuf, ksiz)) err = true;
+  tttracemark(TTTSDBEND);
   if(dolog){
     unsigned char mstack[TTIOBUFSIZ];
     int msiz = sizeof(uint8_t) * 3 + sizeof(uint32_t) + ksiz;
@@ -652,13 +820,29 @@ bool tculogadbout(TCULOG *ulog, uint32_t sid, uint32_t mid, TCADB *adb,
 }
 
 
+/* Store records into an abstract database object. */
+int tculogadbmput(TCULOG *ulog, uint32_t sid, uint32_t mid, TCADB *adb, const TCLIST *recs){
+  assert(ulog && adb && recs);
+  return tculogadbmulti(ulog, sid, mid, adb, recs, TTCMDMPUT);
+}
+
+
+/* Remove records of an abstract database object. */
+int tculogadbmout(TCULOG *ulog, uint32_t sid, uint32_t mid, TCADB *adb, const TCLIST *keys){
+  assert(ulog && adb && keys);
+  return tculogadbmulti(ulog, sid, mid, adb, keys, TTCMDMOUT);
+}
+
+
 /* Add an integer to a record in an abstract database object. */
 int tculogadbaddint(TCULOG *ulog, uint32_t sid, uint32_t mid, TCADB *adb,
                     const void *kbuf, int ksiz, int num){
   assert(ulog && adb && kbuf && ksiz >= 0);
   int rmidx = tculogrmtxidx(ulog, kbuf, ksiz);
   bool dolog = num != 0 && tculogbegin(ulog, rmidx);
+  tttracemark(TTTSDBBEGIN);
   int rnum = tcadbaddint(adb, kbuf, ksiz, num);
+  tttracemark(TTTSDBEND);
   if(dolog){
     unsigned char mstack[TTIOBUFSIZ];
     int msiz = sizeof(uint8_t) * 3 + sizeof(uint32_t) * 2 + ksiz;
@@ -690,7 +874,9 @@ double tculogadbadddouble(TCULOG *ulog, uint32_t sid, uint32_t mid, TCADB *adb,
   assert(ulog && adb && kbuf && ksiz >= 0);
   int rmidx = tculogrmtxidx(ulog, kbuf, ksiz);
   bool dolog = num != 0 && tculogbegin(ulog, rmidx);
+  tttracemark(TTTSDBBEGIN);
   double rnum = tcadbadddouble(adb, kbuf, ksiz, num);
+  tttracemark(TTTSDBEND);
   if(dolog){
     unsigned char mstack[TTIOBUFSIZ];
     int msiz = sizeof(uint8_t) * 3 + sizeof(uint32_t) + sizeof(uint64_t) * 2 + ksiz;
@@ -787,7 +973,9 @@ TCLIST *tculogadbmisc(TCULOG *ulog, uint32_t sid, uint32_t mid, TCADB *adb,
                       const char *name, const TCLIST *args){
   assert(ulog && adb && name && args);
   bool dolog = tculogbegin(ulog, -1);
+  tttracemark(TTTSDBBEGIN);
   TCLIST *rv = tcadbmisc(adb, name, args);
+  tttracemark(TTTSDBEND);
   if(dolog){
     int nsiz = strlen(name);
     int anum = tclistnum(args);
@@ -954,6 +1142,52 @@ bool tculogadbredo(TCADB *adb, const char *ptr, int size, TCULOG *ulog,
         err = true;
       }
       break;
+    case TTCMDMPUT:
+    case TTCMDMOUT:
+      if(size >= sizeof(uint32_t)){
+        uint32_t rnum;
+        memcpy(&rnum, rp, sizeof(rnum));
+        rnum = TTNTOHL(rnum);
+        rp += sizeof(rnum);
+        size -= sizeof(rnum);
+        int step = (cmd == TTCMDMPUT) ? 2 : 1;
+        if(rnum > size / (sizeof(uint32_t) * step)){
+          err = true;
+          break;
+        }
+        TCLIST *elems = tclistnew2(rnum * step);
+        for(int i = 0; !err && i < rnum; i++){
+          uint32_t sizs[2];
+          if(size < sizeof(*sizs) * step){
+            err = true;
+            break;
+          }
+          memcpy(sizs, rp, sizeof(*sizs) * step);
+          rp += sizeof(*sizs) * step;
+          size -= sizeof(*sizs) * step;
+          for(int j = 0; j < step; j++){
+            sizs[j] = TTNTOHL(sizs[j]);
+            if(sizs[j] > size){
+              err = true;
+              break;
+            }
+            size -= sizs[j];
+          }
+          for(int j = 0; !err && j < step; j++){
+            tclistpush(elems, rp, sizs[j]);
+            rp += sizs[j];
+          }
+        }
+        if(!err){
+          int num = (cmd == TTCMDMPUT) ? tculogadbmput(ulog, sid, mid, adb, elems) :
+            tculogadbmout(ulog, sid, mid, adb, elems);
+          if((num == rnum) != exp) *cp = false;
+        }
+        tclistdel(elems);
+      } else {
+        err = true;
+      }
+      break;
     case TTCMDADDINT:
       if(size >= sizeof(uint32_t) * 2){
         uint32_t ksiz;
@@ -1158,29 +1392,1001 @@ const char *tcreplread(TCREPL *repl, int *sp, uint64_t *tsp, uint32_t *sidp){
 }
 
 
-/* Flush a AIO task.
-   `aiocbp' specifies the pointer to the AIO task object.
+/* Open the current file of an update log object if it is not opened.
+   `ulog' specifies the update log object whose writer lock is held.
+   If successful, the return value is true, else, it is false. */
+static bool tculogopenfile(TCULOG *ulog){
+  assert(ulog);
+  if(ulog->fd != -1) return true;
+  char *path = tcsprintf("%s/%08d%s", ulog->base, ulog->max, TCULSUFFIX);
+  int fd = open(path, O_WRONLY | O_CREAT | O_APPEND, 00644);
+  tcfree(path);
+  struct stat sbuf;
+  if(fd == -1) return false;
+  if(fstat(fd, &sbuf) != 0){
+    close(fd);
+    return false;
+  }
+  ulog->fd = fd;
+  ulog->size = sbuf.st_size;
+  if(!tculogopenindex(ulog)){
+    close(fd);
+    ulog->fd = -1;
+    return false;
+  }
+  return true;
+}
+
+
+/* Open the index of the current file of an update log object.
+   `ulog' specifies the update log object.
+   If successful, the return value is true, else, it is false.
+   A broken entry at the end is cut off and the next record is indexed after the interval from
+   the last entry. */
+static bool tculogopenindex(TCULOG *ulog){
+  assert(ulog);
+  char *path = tcsprintf("%s/%08d%s", ulog->base, ulog->max, TCULIDXSUFFIX);
+  int fd = open(path, O_RDWR | O_CREAT | O_APPEND, 00644);
+  tcfree(path);
+  if(fd == -1) return false;
+  struct stat sbuf;
+  if(fstat(fd, &sbuf) != 0){
+    close(fd);
+    return false;
+  }
+  int esiz = sizeof(uint64_t) * 2;
+  off_t isiz = sbuf.st_size - sbuf.st_size % esiz;
+  if(isiz != sbuf.st_size && ftruncate(fd, isiz) != 0){
+    close(fd);
+    return false;
+  }
+  uint64_t next = 0;
+  if(isiz >= esiz){
+    unsigned char buf[esiz];
+    if(pread(fd, buf, esiz, isiz - esiz) != esiz){
+      close(fd);
+      return false;
+    }
+    uint64_t llnum;
+    memcpy(&llnum, buf + sizeof(llnum), sizeof(llnum));
+    next = TTNTOHLL(llnum) + TCULIDXSTEP;
+  }
+  if(ulog->ixfd != -1) close(ulog->ixfd);
+  ulog->ixfd = fd;
+  ulog->ixnext = next;
+  tcxstrclear(ulog->ixbuf);
+  return true;
+}
+
+
+/* Add index entries of records.
+   `ixbuf' specifies the buffer into which the entries are added.
+   `nextp' specifies the pointer to the variable of the offset from which the next record is
+   indexed.  It is advanced by each added entry.
+   `off' specifies the offset of the records in the file.
+   `buf' specifies the pointer to the region of the framed records.
+   `size' specifies the size of the region.  Only the header of the last record is required.
+   Each entry is composed of the timestamp and the offset of a record in big endian. */
+static void tculogaddindex(TCXSTR *ixbuf, uint64_t *nextp, uint64_t off,
+                           const unsigned char *buf, int64_t size){
+  assert(ixbuf && nextp && buf);
+  int hsiz = sizeof(uint8_t) + sizeof(uint64_t) + sizeof(uint32_t) * 2;
+  while(size >= hsiz && *buf == TCULMAGICNUM){
+    uint32_t lnum;
+    memcpy(&lnum, buf + hsiz - sizeof(lnum), sizeof(lnum));
+    int64_t rsiz = hsiz + (int64_t)TTNTOHL(lnum);
+    if(off >= *nextp){
+      tcxstrcat(ixbuf, buf + sizeof(uint8_t), sizeof(uint64_t));
+      uint64_t llnum = TTHTONLL(off);
+      tcxstrcat(ixbuf, &llnum, sizeof(llnum));
+      *nextp = off + TCULIDXSTEP;
+    }
+    buf += rsiz;
+    size -= rsiz;
+    off += rsiz;
+  }
+}
+
+
+/* Write waiting index entries of an update log object.
+   `ulog' specifies the update log object.
    If successful, the return value is true, else, it is false. */
-static bool tculogflushaiocbp(struct aiocb *aiocbp){
-  assert(aiocbp);
-  if(!aiocbp->aio_buf) return true;
+static bool tculogflushindex(TCULOG *ulog){
+  assert(ulog);
+  int size = tcxstrsize(ulog->ixbuf);
+  if(size < 1) return true;
+  bool err = ulog->ixfd == -1 || !tcwrite(ulog->ixfd, tcxstrptr(ulog->ixbuf), size);
+  tcxstrclear(ulog->ixbuf);
+  return !err;
+}
+
+
+/* Build the index of a file of an update log.
+   `base' specifies the path of the base directory.
+   `id' specifies the ID number of the file.
+   If successful, the return value is true, else, it is false.
+   The index is written into a temporary file and renamed so that no reader sees it partially. */
+static bool tculogbuildindex(const char *base, int id){
+  assert(base && id > 0);
+  char *path = tcsprintf("%s/%08d%s", base, id, TCULSUFFIX);
+  int fd = open(path, O_RDONLY, 00644);
+  tcfree(path);
+  if(fd == -1) return false;
+  char *ixpath = tcsprintf("%s/%08d%s", base, id, TCULIDXSUFFIX);
+  char *tmppath = tcsprintf("%s.tmp", ixpath);
+  bool err = false;
+  int ixfd = open(tmppath, O_WRONLY | O_CREAT | O_TRUNC, 00644);
+  if(ixfd != -1){
+    int hsiz = sizeof(uint8_t) + sizeof(uint64_t) + sizeof(uint32_t) * 2;
+    unsigned char *rbuf = tcmalloc(TCULIDXBUFSIZ);
+    TCXSTR *ixbuf = tcxstrnew();
+    uint64_t next = 0;
+    uint64_t off = 0;
+    while(true){
+      ssize_t rb = pread(fd, rbuf, TCULIDXBUFSIZ, off);
+      if(rb < hsiz){
+        if(rb == -1) err = true;
+        break;
+      }
+      int64_t pos = 0;
+      while(pos + hsiz <= rb && rbuf[pos] == TCULMAGICNUM){
+        uint32_t lnum;
+        memcpy(&lnum, rbuf + pos + hsiz - sizeof(lnum), sizeof(lnum));
+        tculogaddindex(ixbuf, &next, off + pos, rbuf + pos, hsiz);
+        pos += hsiz + (int64_t)TTNTOHL(lnum);
+      }
+      if(pos < 1) break;
+      off += pos;
+    }
+    if(!tcwrite(ixfd, tcxstrptr(ixbuf), tcxstrsize(ixbuf))) err = true;
+    tcxstrdel(ixbuf);
+    tcfree(rbuf);
+    if(close(ixfd) != 0) err = true;
+    if(err){
+      unlink(tmppath);
+    } else if(rename(tmppath, ixpath) != 0){
+      unlink(tmppath);
+      err = true;
+    }
+  } else {
+    err = true;
+  }
+  tcfree(tmppath);
+  tcfree(ixpath);
+  if(close(fd) != 0) err = true;
+  return !err;
+}
+
+
+/* Build the index of a sealed file of an update log object if it is missing.
+   `ulog' specifies the update log object.
+   `id' specifies the ID number of the file.
+   Builders are serialized and the existence is checked again by each, so that an index is built
+   once.  If building fails, readers seek from the beginning of the file. */
+static void tculogprepindex(TCULOG *ulog, int id){
+  assert(ulog && id > 0);
+  char *path = tcsprintf("%s/%08d%s", ulog->base, id, TCULIDXSUFFIX);
+  struct stat sbuf;
+  if(stat(path, &sbuf) != 0 && pthread_mutex_lock(&ulog->imtx) == 0){
+    if(stat(path, &sbuf) != 0) tculogbuildindex(ulog->base, id);
+    pthread_mutex_unlock(&ulog->imtx);
+  }
+  tcfree(path);
+}
+
+
+/* Get the offset from which a file of an update log should be read for a timestamp.
+   `base' specifies the path of the base directory.
+   `id' specifies the ID number of the file.
+   `ts' specifies the timestamp.
+   The return value is the offset of the last indexed record whose timestamp is not greater than
+   the specified one.  If no index is available, 0 is returned.  The entries are searched by
+   binary search as the timestamps are almost in ascending order. */
+static uint64_t tculogseekindex(const char *base, int id, uint64_t ts){
+  assert(base && id > 0);
+  char *path = tcsprintf("%s/%08d%s", base, id, TCULIDXSUFFIX);
+  int fd = open(path, O_RDONLY, 00644);
+  tcfree(path);
+  if(fd == -1) return 0;
+  int esiz = sizeof(uint64_t) * 2;
+  uint64_t off = 0;
+  struct stat sbuf;
+  if(fstat(fd, &sbuf) == 0){
+    int64_t left = 0;
+    int64_t right = sbuf.st_size / esiz;
+    while(left < right){
+      int64_t mid = (left + right) / 2;
+      unsigned char buf[esiz];
+      if(pread(fd, buf, esiz, mid * esiz) != esiz){
+        off = 0;
+        break;
+      }
+      uint64_t llnum;
+      memcpy(&llnum, buf, sizeof(llnum));
+      if(TTNTOHLL(llnum) <= ts){
+        memcpy(&llnum, buf + sizeof(llnum), sizeof(llnum));
+        off = TTNTOHLL(llnum);
+        left = mid + 1;
+      } else {
+        right = mid;
+      }
+    }
+  }
+  close(fd);
+  if(off < 1) return 0;
+  path = tcsprintf("%s/%08d%s", base, id, TCULSUFFIX);
+  fd = open(path, O_RDONLY, 00644);
+  tcfree(path);
+  if(fd == -1) return 0;
+  unsigned char magic;
+  if(pread(fd, &magic, sizeof(magic), off) != sizeof(magic) || magic != TCULMAGICNUM) off = 0;
+  close(fd);
+  return off;
+}
+
+
+/* Map the current file of a log reader object.
+   `ulrd' specifies the log reader object.
+   `end' specifies the end offset to be mapped.  If it is 0, the file is opened and mapped.
+   If successful, the return value is true, else, it is false.
+   A file no longer written is mapped entirely.  The current file is mapped beyond its end with
+   room so that it is remapped seldom. */
+static bool tculrdmap(TCULRD *ulrd, uint64_t end){
+  assert(ulrd);
+  TCULOG *ulog = ulrd->ulog;
+  if(pthread_rwlock_rdlock(&ulog->rwlck) != 0) return false;
   bool err = false;
+  struct stat sbuf;
+  if(ulrd->fd == -1){
+    char *path = tcsprintf("%s/%08d%s", ulog->base, ulrd->num, TCULSUFFIX);
+    ulrd->fd = open(path, O_RDONLY, 00644);
+    tcfree(path);
+    if(ulrd->fd != -1 && fstat(ulrd->fd, &sbuf) == 0){
+      ulrd->sealed = ulrd->num < ulog->max;
+      ulrd->fsiz = ulrd->sealed ? sbuf.st_size : 0;
+      if(end < sbuf.st_size) end = sbuf.st_size;
+    } else {
+      err = true;
+    }
+  }
+  if(!err){
+    uint64_t msiz = ulrd->sealed ? ulrd->fsiz : tclmax(end * 2, TCULRDMAPMIN);
+    if(msiz > ulrd->msiz){
+      if(ulrd->map) munmap(ulrd->map, ulrd->msiz);
+      ulrd->map = NULL;
+      ulrd->msiz = 0;
+      if(msiz > 0){
+        void *map = mmap(NULL, msiz, PROT_READ, MAP_SHARED, ulrd->fd, 0);
+        if(map != MAP_FAILED){
+          ulrd->map = map;
+          ulrd->msiz = msiz;
+        } else {
+          err = true;
+        }
+      }
+    }
+  }
+  if(err) tculrdunmap(ulrd);
+  pthread_rwlock_unlock(&ulog->rwlck);
+  return !err;
+}
+
+
+/* Get the end offset to be read in the current file of a log reader object.
+   `ulrd' specifies the log reader object.
+   The return value is the end offset.
+   The size published by the writer is read without the lock.  If the file has been switched, it
+   is sealed with its final size under the lock. */
+static uint64_t tculrdend(TCULRD *ulrd){
+  assert(ulrd);
+  if(ulrd->sealed) return ulrd->fsiz;
+  TCULOG *ulog = ulrd->ulog;
+  int max = ulog->max;
+  __sync_synchronize();
+  uint64_t end = ulog->size;
+  __sync_synchronize();
+  struct stat sbuf;
+  if(max != ulrd->num || ulog->max != max){
+    if(max < ulrd->num || pthread_rwlock_rdlock(&ulog->rwlck) != 0) return ulrd->off;
+    if(ulrd->num < ulog->max && fstat(ulrd->fd, &sbuf) == 0){
+      ulrd->sealed = true;
+      ulrd->fsiz = sbuf.st_size;
+      end = ulrd->fsiz;
+    } else {
+      end = ulrd->off;
+    }
+    pthread_rwlock_unlock(&ulog->rwlck);
+  } else if(ulog->fd == -1){
+    if(fstat(ulrd->fd, &sbuf) != 0) return ulrd->off;
+    end = sbuf.st_size;
+  }
+  return end;
+}
+
+
+/* Release the current file of a log reader object.
+   `ulrd' specifies the log reader object. */
+static void tculrdunmap(TCULRD *ulrd){
+  assert(ulrd);
+  if(ulrd->map) munmap(ulrd->map, ulrd->msiz);
+  ulrd->map = NULL;
+  ulrd->msiz = 0;
+  if(ulrd->fd != -1) close(ulrd->fd);
+  ulrd->fd = -1;
+  ulrd->fsiz = 0;
+  ulrd->sealed = false;
+}
+
+
+/* Switch an update log object to the next file.
+   `ulog' specifies the update log object whose writer lock is held.
+   If successful, the return value is true, else, it is false. */
+static bool tculogrotate(TCULOG *ulog){
+  assert(ulog);
+  bool err = false;
+  char *path = tcsprintf("%s/%08d%s", ulog->base, ulog->max + 1, TCULSUFFIX);
+  int fd = open(path, O_WRONLY | O_CREAT | O_APPEND, 00644);
+  tcfree(path);
+  if(fd != -1){
+    if(ulog->spol != TCULSNONE && ulog->sdirty && !tculogsyncfile(ulog, ulog->fd)) err = true;
+    ulog->sdirty = false;
+    if(close(ulog->fd) != 0) err = true;
+    if(!tculogflushindex(ulog)) err = true;
+    ulog->fd = fd;
+    ulog->size = 0;
+    if(pthread_mutex_lock(&ulog->wmtx) == 0){
+      ulog->max++;
+      ulog->dsize = 0;
+      pthread_mutex_unlock(&ulog->wmtx);
+    } else {
+      ulog->max++;
+      err = true;
+    }
+    if(!tculogopenindex(ulog)) err = true;
+  } else {
+    err = true;
+  }
+  return !err;
+}
+
+
+/* Write a record into an update log object by group commit.
+   `ulog' specifies the update log object.
+   `buf' specifies the pointer to the region of the framed record.
+   `size' specifies the size of the region.
+   `stamp' specifies whether to stamp the current time on the record when it is queued.
+   If successful, the return value is true, else, it is false.
+   The record is appended to the waiting buffer.  If no other thread is writing, the calling
+   thread becomes the leader and writes all waiting records at once.  Otherwise, it waits until
+   a leader has written its record.  Because the caller holds the mutex of the record, records of
+   the same key are written in the order of their updates.  If the synchronization policy is
+   `TCULSALWAYS', the record is written and synchronized by itself. */
+static bool tculogwritegroup(TCULOG *ulog, unsigned char *buf, int size, bool stamp){
+  assert(ulog && buf && size >= 0);
+  if(ulog->spol == TCULSALWAYS){
+    tttracemark(TTTSULLOCK);
+    return tculogflushgroup(ulog, buf, size, 1, stamp);
+  }
+  int ocs = PTHREAD_CANCEL_DISABLE;
+  pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &ocs);
+  if(pthread_mutex_lock(&ulog->gmtx) != 0){
+    pthread_setcancelstate(ocs, NULL);
+    return false;
+  }
+  tttracemark(TTTSULLOCK);
+  TCULGWAIT wait;
+  wait.next = ulog->gwaits;
+  wait.done = false;
+  wait.err = false;
+  ulog->gwaits = &wait;
+  if(stamp) tculogstamp(ulog, buf);
+  tcxstrcat(ulog->gbuf, buf, size);
+  while(!wait.done){
+    if(ulog->gbusy){
+      pthread_cond_wait(&ulog->gcnd, &ulog->gmtx);
+      continue;
+    }
+    ulog->gbusy = true;
+    TCXSTR *xstr = ulog->gbuf;
+    TCULGWAIT *waits = ulog->gwaits;
+    ulog->gbuf = ulog->gspare;
+    ulog->gspare = NULL;
+    ulog->gwaits = NULL;
+    pthread_mutex_unlock(&ulog->gmtx);
+    int rnum = 0;
+    for(TCULGWAIT *wp = waits; wp; wp = wp->next){
+      rnum++;
+    }
+    bool err = !tculogflushgroup(ulog, (void *)tcxstrptr(xstr), tcxstrsize(xstr), rnum, false);
+    if(tcxstrsize(xstr) > TCULGBUFMAX){
+      tcxstrdel(xstr);
+      xstr = tcxstrnew3(TTIOBUFSIZ);
+    } else {
+      tcxstrclear(xstr);
+    }
+    pthread_mutex_lock(&ulog->gmtx);
+    while(waits){
+      TCULGWAIT *next = waits->next;
+      waits->err = err;
+      waits->done = true;
+      waits = next;
+    }
+    ulog->gspare = xstr;
+    ulog->gbusy = false;
+    pthread_cond_broadcast(&ulog->gcnd);
+  }
+  pthread_mutex_unlock(&ulog->gmtx);
+  pthread_setcancelstate(ocs, NULL);
+  return !wait.err;
+}
+
+
+/* Write records gathered by group commit into an update log object.
+   `ulog' specifies the update log object.
+   `buf' specifies the pointer to the region of the records.
+   `size' specifies the size of the region.
+   `rnum' specifies the number of the records.
+   `stamp' specifies whether to stamp the current time on the single record under the lock.
+   If successful, the return value is true, else, it is false.
+   The file is synchronized after the writer lock is released so that readers and other writers
+   are not blocked by the device. */
+static bool tculogflushgroup(TCULOG *ulog, void *buf, int size, int rnum, bool stamp){
+  assert(ulog && buf && size >= 0 && rnum >= 0);
+  if(pthread_rwlock_wrlock(&ulog->rwlck) != 0) return false;
+  if(stamp) tculogstamp(ulog, buf);
+  bool err = false;
+  int fd = -1;
+  int max = ulog->max;
+  uint64_t dsize = 0;
+  if(!tculogopenfile(ulog) || !tcwrite(ulog->fd, buf, size)){
+    err = true;
+  } else {
+    tculogaddindex(ulog->ixbuf, &ulog->ixnext, ulog->size, buf, size);
+    if(!tculogflushindex(ulog)) err = true;
+    ulog->size += size;
+    ulog->sdirty = true;
+    if(ulog->metrics){
+      ttmetricsadd(ulog->metrics, -1, ulog->mtid, size);
+      ttmetricsadd(ulog->metrics, -1, ulog->mtgroup, 1);
+      ttmetricsadd(ulog->metrics, -1, ulog->mtgrec, rnum);
+    }
+    if(ulog->spol >= TCULSGROUP){
+      fd = dup(ulog->fd);
+      if(fd == -1) err = true;
+      ulog->sdirty = false;
+      max = ulog->max;
+      dsize = ulog->size;
+    }
+    if(ulog->size >= ulog->limsiz && !tculogrotate(ulog)) err = true;
+    if(pthread_cond_broadcast(&ulog->cnd) != 0) err = true;
+  }
+  pthread_rwlock_unlock(&ulog->rwlck);
+  if(fd != -1){
+    if(tculogsyncfile(ulog, fd)){
+      tculogsetdsize(ulog, max, dsize);
+    } else {
+      err = true;
+    }
+    if(close(fd) != 0) err = true;
+  }
+  return !err;
+}
+
+
+/* Stamp the current time on a framed record.
+   `ulog' specifies the update log object.
+   `buf' specifies the pointer to the region of the framed record.
+   Records are stamped under the lock which decides their order, and the time is not earlier than
+   the last stamped one, so that timestamps in a file never go backward. */
+static void tculogstamp(TCULOG *ulog, unsigned char *buf){
+  assert(ulog && buf);
+  uint64_t ts = (uint64_t)(tctime() * 1000000);
+  if(ts < ulog->sts) ts = ulog->sts;
+  ulog->sts = ts;
+  uint64_t llnum = TTHTONLL(ts);
+  memcpy(buf + sizeof(uint8_t), &llnum, sizeof(llnum));
+}
+
+
+/* Synchronize a file of an update log object with the device.
+   `ulog' specifies the update log object.
+   `fd' specifies the file descriptor.
+   If successful, the return value is true, else, it is false. */
+static bool tculogsyncfile(TCULOG *ulog, int fd){
+  assert(ulog && fd >= 0);
+  double stime = tctime();
+#if defined(_SYS_LINUX_)
+  bool err = fdatasync(fd) != 0;
+#else
+  bool err = fsync(fd) != 0;
+#endif
+  double etime = tctime() - stime;
+  if(ulog->metrics){
+    ttmetricsadd(ulog->metrics, -1, ulog->mtsync, 1);
+    ttmetricsadd(ulog->metrics, -1, ulog->mtsusec, etime * 1000000);
+  }
+  if(ulog->syncproc) ulog->syncproc(etime, ulog->syncop);
+  return !err;
+}
+
+
+/* Publish the size of a file of an update log object synchronized with the device.
+   `ulog' specifies the update log object.
+   `max' specifies the ID of the file which was synchronized.
+   `size' specifies the size of the file when it was synchronized.
+   The size is ignored if the file has been switched since. */
+static void tculogsetdsize(TCULOG *ulog, int max, uint64_t size){
+  assert(ulog);
+  if(pthread_mutex_lock(&ulog->wmtx) != 0) return;
+  if(ulog->max == max && size > ulog->dsize) ulog->dsize = size;
+  pthread_mutex_unlock(&ulog->wmtx);
+}
+
+
+/* Put a record into the ring of an update log object.
+   `ulog' specifies the update log object.
+   `buf' specifies the pointer to the region of the framed record.
+   `size' specifies the size of the region.
+   If successful, the return value is true, else, it is false.
+   False is also returned if the writer thread failed to write a record which the calling thread
+   put before.  Space is reserved
+   by compare-and-swap, and the first byte of the entry is stored at last so that the writer
+   thread never reads a partial entry.  A large record is duplicated and its pointer is put. */
+static bool tculogringput(TCULOG *ulog, const unsigned char *buf, int size){
+  assert(ulog && buf && size > 0);
+  TCULRING *ring = ulog->ring;
+  bool err = !tculogringcheck(ring);
+  unsigned char ibuf[sizeof(uint8_t)+sizeof(char *)+sizeof(int)];
+  const unsigned char *rp = buf;
+  int rsiz = size;
+  if(size > TCULRINGSIZ / 16){
+    char *copy = tcmemdup(buf, size);
+    ibuf[0] = TCULRINGIND;
+    memcpy(ibuf + sizeof(uint8_t), &copy, sizeof(copy));
+    memcpy(ibuf + sizeof(uint8_t) + sizeof(copy), &size, sizeof(size));
+    rp = ibuf;
+    rsiz = sizeof(ibuf);
+  }
+  uint64_t head;
   while(true){
-    int rv = aio_error(aiocbp);
-    if(rv == 0) break;
-    if(rv != EINPROGRESS){
+    head = ring->head;
+    if(head + rsiz - ring->tail <= TCULRINGSIZ){
+      if(__sync_bool_compare_and_swap(&ring->head, head, head + rsiz)) break;
+      continue;
+    }
+    int ocs = PTHREAD_CANCEL_DISABLE;
+    pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &ocs);
+    if(pthread_mutex_lock(&ring->mtx) == 0){
+      pthread_cond_signal(&ring->wcnd);
+      if(ring->head + rsiz - ring->tail > TCULRINGSIZ){
+        struct timeval tv;
+        struct timespec ts;
+        gettimeofday(&tv, NULL);
+        ts.tv_sec = tv.tv_sec;
+        ts.tv_nsec = tv.tv_usec * 1000 + 10000000;
+        if(ts.tv_nsec >= 1000000000){
+          ts.tv_sec++;
+          ts.tv_nsec -= 1000000000;
+        }
+        pthread_cond_timedwait(&ring->scnd, &ring->mtx, &ts);
+      }
+      pthread_mutex_unlock(&ring->mtx);
+    }
+    pthread_setcancelstate(ocs, NULL);
+  }
+  tttracemark(TTTSULLOCK);
+  uint64_t *pend = pthread_getspecific(ring->pkey);
+  if(!pend){
+    pend = tcmalloc(sizeof(*pend) * 2);
+    pend[0] = head;
+    pend[1] = head;
+    if(pthread_setspecific(ring->pkey, pend) != 0){
+      tcfree(pend);
+      pend = NULL;
       err = true;
-      break;
     }
-    if(aio_suspend((void *)&aiocbp, 1, NULL) == -1) err = true;
   }
-  tcfree((char *)aiocbp->aio_buf);
-  aiocbp->aio_buf = NULL;
-  if(aio_return(aiocbp) != aiocbp->aio_nbytes) err = true;
+  if(pend){
+    if(pend[0] >= pend[1]) pend[0] = head;
+    pend[1] = head + rsiz;
+  }
+  tculogringstore(ring, head + 1, rp + 1, rsiz - 1);
+  __sync_synchronize();
+  ((volatile unsigned char *)ring->buf)[head&(TCULRINGSIZ-1)] = rp[0];
+  __sync_synchronize();
+  if(ring->sleep) tculogringwake(ring);
   return !err;
 }
 
 
+/* Check whether records put by the calling thread into a record ring have been written.
+   `ring' specifies the record ring object.
+   If no drained record of the calling thread failed, the return value is true, else, it is
+   false.
+   The range of records put by each thread since the last check is kept in the thread specific
+   data.  It is checked against the failed ranges only after the writer thread has drained all of
+   it, and is cleared then. */
+static bool tculogringcheck(TCULRING *ring){
+  assert(ring);
+  uint64_t *pend = pthread_getspecific(ring->pkey);
+  if(!pend || pend[0] >= pend[1] || pend[1] > ring->tail) return true;
+  __sync_synchronize();
+  bool err = false;
+  if(ring->errnum > 0){
+    if(pthread_mutex_lock(&ring->mtx) == 0){
+      int num = tclmin(ring->errnum, TCULRINGERRNUM);
+      if(ring->errnum > TCULRINGERRNUM &&
+         pend[0] < ring->errs[ring->errnum%TCULRINGERRNUM][0]) err = true;
+      for(int i = 0; i < num; i++){
+        if(pend[0] < ring->errs[i][1] && ring->errs[i][0] < pend[1]) err = true;
+      }
+      pthread_mutex_unlock(&ring->mtx);
+    } else {
+      err = true;
+    }
+  }
+  pend[0] = pend[1];
+  return !err;
+}
+
+
+/* Record a failed range of a record ring.
+   `ring' specifies the record ring object.
+   `beg' specifies the beginning position of the range.
+   `end' specifies the end position of the range.
+   Only the latest ranges are kept.  A range older than all of them is regarded as failed. */
+static void tculogringfail(TCULRING *ring, uint64_t beg, uint64_t end){
+  assert(ring);
+  ring->err = true;
+  if(pthread_mutex_lock(&ring->mtx) != 0) return;
+  int idx = ring->errnum % TCULRINGERRNUM;
+  ring->errs[idx][0] = beg;
+  ring->errs[idx][1] = end;
+  ring->errnum++;
+  pthread_mutex_unlock(&ring->mtx);
+}
+
+
+/* Store data into a record ring.
+   `ring' specifies the record ring object.
+   `pos' specifies the position.
+   `buf' specifies the pointer to the region of the data.
+   `size' specifies the size of the region. */
+static void tculogringstore(TCULRING *ring, uint64_t pos, const void *buf, int size){
+  assert(ring && buf && size >= 0);
+  int idx = pos & (TCULRINGSIZ - 1);
+  int fsiz = tclmin(size, TCULRINGSIZ - idx);
+  memcpy(ring->buf + idx, buf, fsiz);
+  if(fsiz < size) memcpy(ring->buf, (char *)buf + fsiz, size - fsiz);
+}
+
+
+/* Load data from a record ring.
+   `ring' specifies the record ring object.
+   `pos' specifies the position.
+   `buf' specifies the pointer to the region into which the data is copied.
+   `size' specifies the size of the data. */
+static void tculogringload(TCULRING *ring, uint64_t pos, void *buf, int size){
+  assert(ring && buf && size >= 0);
+  int idx = pos & (TCULRINGSIZ - 1);
+  int fsiz = tclmin(size, TCULRINGSIZ - idx);
+  memcpy(buf, ring->buf + idx, fsiz);
+  if(fsiz < size) memcpy((char *)buf + fsiz, ring->buf, size - fsiz);
+}
+
+
+/* Check whether a framed record in a record ring is waiting to be stamped.
+   `buf' specifies the pointer to the region of the framed record.
+   The return value is true if the timestamp is zero, else, it is false. */
+static bool tculogringunstamped(const unsigned char *buf){
+  assert(buf);
+  uint64_t llnum;
+  memcpy(&llnum, buf + sizeof(uint8_t), sizeof(llnum));
+  return llnum == 0;
+}
+
+
+/* Wake the writer thread of a record ring.
+   `ring' specifies the record ring object. */
+static void tculogringwake(TCULRING *ring){
+  assert(ring);
+  if(pthread_mutex_lock(&ring->mtx) != 0) return;
+  pthread_cond_signal(&ring->wcnd);
+  pthread_mutex_unlock(&ring->mtx);
+}
+
+
+/* Drain the record ring of an update log object.
+   `opq' specifies the update log object.
+   The return value is always `NULL'.
+   Ready entries from the tail are gathered into vectors of a batch and written at the next
+   offset of the file.  If the io_uring instance is available, several batches are kept in flight
+   and their completions are collected later.  Batches are released in the order of the ring:
+   the end of the file is published to readers and the space of the entries is cleared.  The
+   range of entries which failed is recorded before it is released, and the file is truncated to
+   the published end once all batches in flight are settled.  Records without timestamp are
+   stamped in the order of the ring. */
+static void *tculogringproc(void *opq){
+  TCULOG *ulog = opq;
+  TCULRING *ring = ulog->ring;
+  volatile unsigned char *marks = ring->buf;
+  int hsiz = sizeof(uint8_t) + sizeof(uint64_t) + sizeof(uint32_t) * 2;
+  int bmax = 1;
+#if defined(TTUSEURING)
+  if(ulog->uring) bmax = TCULRINGBATNUM;
+#endif
+  TCULBATCH *bats = tcmalloc(sizeof(*bats) * bmax);
+  for(int i = 0; i < bmax; i++){
+    bats[i].ixbuf = tcxstrnew();
+  }
+  uint64_t pos = ring->tail;
+  uint64_t off = ulog->size;
+  int first = 0;
+  int bnum = 0;
+  int pfd = -1;
+  bool rot = false;
+  bool fail = false;
+  while(true){
+#if defined(TTUSEURING)
+    if(ulog->uring){
+      uint64_t data;
+      int res;
+      while(_tt_uring_peek(ulog->uring, &data, &res)){
+        if(data < bmax) tculogringdone(ulog, bats + data, data, res);
+      }
+    }
+#endif
+    while(bnum > 0 && !bats[first].busy){
+      TCULBATCH *bat = bats + first;
+      if(bat->err) fail = true;
+      tculogringrelease(ulog, bat, fail);
+      if(bat->rot){
+        off = ulog->size;
+        rot = false;
+      }
+      first = (first + 1) % bmax;
+      bnum--;
+    }
+    if(fail && bnum < 1){
+      if(ulog->fd != -1 && ftruncate(ulog->fd, ulog->size) != 0) ring->err = true;
+      off = ulog->size;
+      fail = false;
+    }
+    if(!rot && bnum < bmax){
+      int id = (first + bnum) % bmax;
+      TCULBATCH *bat = bats + id;
+      bat->beg = pos;
+      bat->off = off;
+      bat->wsiz = 0;
+      bat->iovnum = 0;
+      bat->iovcur = 0;
+      bat->cnum = 0;
+      bat->rnum = 0;
+      bat->rot = false;
+      bat->err = false;
+      while(!bat->rot && bat->iovnum < TCULRINGIOV - 2){
+        int idx = pos & (TCULRINGSIZ - 1);
+        int mark = marks[idx];
+        if(mark == 0) break;
+        __sync_synchronize();
+        if(mark == TCULRINGIND){
+          unsigned char ibuf[sizeof(uint8_t)+sizeof(char *)+sizeof(int)];
+          tculogringload(ring, pos, ibuf, sizeof(ibuf));
+          char *copy;
+          int csiz;
+          memcpy(&copy, ibuf + sizeof(uint8_t), sizeof(copy));
+          memcpy(&csiz, ibuf + sizeof(uint8_t) + sizeof(copy), sizeof(csiz));
+          if(tculogringunstamped((unsigned char *)copy)) tculogstamp(ulog, (unsigned char *)copy);
+          tculogaddindex(bat->ixbuf, &ulog->ixnext, off + bat->wsiz, (unsigned char *)copy,
+                         hsiz);
+          bat->iov[bat->iovnum].iov_base = copy;
+          bat->iov[bat->iovnum].iov_len = csiz;
+          bat->iovnum++;
+          bat->copies[bat->cnum++] = copy;
+          pos += sizeof(ibuf);
+          bat->wsiz += csiz;
+        } else {
+          unsigned char hbuf[hsiz];
+          tculogringload(ring, pos, hbuf, hsiz);
+          if(tculogringunstamped(hbuf)){
+            tculogstamp(ulog, hbuf);
+            tculogringstore(ring, pos + sizeof(uint8_t), hbuf + sizeof(uint8_t),
+                            sizeof(uint64_t));
+          }
+          uint32_t lnum;
+          memcpy(&lnum, hbuf + hsiz - sizeof(lnum), sizeof(lnum));
+          int rsiz = hsiz + TTNTOHL(lnum);
+          tculogaddindex(bat->ixbuf, &ulog->ixnext, off + bat->wsiz, hbuf, hsiz);
+          int fsiz = tclmin(rsiz, TCULRINGSIZ - idx);
+          struct iovec *iov = bat->iov + bat->iovnum;
+          if(bat->iovnum > 0 && (char *)iov[-1].iov_base + iov[-1].iov_len ==
+             (char *)ring->buf + idx){
+            iov[-1].iov_len += fsiz;
+          } else {
+            iov->iov_base = ring->buf + idx;
+            iov->iov_len = fsiz;
+            bat->iovnum++;
+          }
+          if(fsiz < rsiz){
+            iov = bat->iov + bat->iovnum;
+            iov->iov_base = ring->buf;
+            iov->iov_len = rsiz - fsiz;
+            bat->iovnum++;
+          }
+          pos += rsiz;
+          bat->wsiz += rsiz;
+        }
+        bat->rnum++;
+        if(off + bat->wsiz >= ulog->limsiz) bat->rot = true;
+      }
+      if(bat->iovnum > 0){
+        if(ulog->fd != pfd){
+          int flags = fcntl(ulog->fd, F_GETFL);
+          if(flags != -1 && (flags & O_APPEND)) fcntl(ulog->fd, F_SETFL, flags & ~O_APPEND);
+          pfd = ulog->fd;
+        }
+        bat->end = pos;
+        rot = bat->rot;
+        off += bat->wsiz;
+        bnum++;
+        tculogringsubmit(ulog, bat, id);
+        continue;
+      }
+    }
+#if defined(TTUSEURING)
+    if(bnum > 0){
+      uint64_t data;
+      int res;
+      if(_tt_uring_wait(ulog->uring, &data, &res)){
+        if(data < bmax) tculogringdone(ulog, bats + data, data, res);
+      } else {
+        for(int i = 0; i < bmax; i++){
+          if(bats[i].busy){
+            bats[i].err = true;
+            bats[i].busy = false;
+          }
+        }
+      }
+      continue;
+    }
+#endif
+    if(ring->fin && ring->head == ring->tail) break;
+    if(pthread_mutex_lock(&ring->mtx) != 0){
+      ring->err = true;
+      break;
+    }
+    ring->sleep = true;
+    __sync_synchronize();
+    if(!ring->fin && marks[ring->tail&(TCULRINGSIZ-1)] == 0){
+      struct timeval tv;
+      struct timespec ts;
+      gettimeofday(&tv, NULL);
+      ts.tv_sec = tv.tv_sec + 1;
+      ts.tv_nsec = tv.tv_usec * 1000;
+      pthread_cond_timedwait(&ring->wcnd, &ring->mtx, &ts);
+    }
+    ring->sleep = false;
+    pthread_mutex_unlock(&ring->mtx);
+  }
+  for(int i = 0; i < bmax; i++){
+    tcxstrdel(bats[i].ixbuf);
+  }
+  tcfree(bats);
+  return NULL;
+}
+
+
+/* Write the remaining vectors of a batch of the writer thread.
+   `ulog' specifies the update log object.
+   `bat' specifies the batch object.
+   `id' specifies the index of the batch.
+   If the io_uring instance is available, the vectors are submitted to it as a task and the batch
+   is kept busy until its completion is collected.  Otherwise, they are written at once. */
+static void tculogringsubmit(TCULOG *ulog, TCULBATCH *bat, int id){
+  assert(ulog && bat && id >= 0);
+  bat->busy = true;
+  while(bat->iovcur < bat->iovnum){
+#if defined(TTUSEURING)
+    if(ulog->uring){
+      if(_tt_uring_writev(ulog->uring, ulog->fd, bat->iov + bat->iovcur,
+                          bat->iovnum - bat->iovcur, bat->off, id)) return;
+      bat->err = true;
+      break;
+    }
+#endif
+    ssize_t wb = pwritev(ulog->fd, bat->iov + bat->iovcur, bat->iovnum - bat->iovcur, bat->off);
+    if(wb == -1){
+      if(errno == EINTR) continue;
+      bat->err = true;
+      break;
+    }
+    tculogringdone(ulog, bat, id, wb);
+    return;
+  }
+  bat->busy = false;
+}
+
+
+/* Settle the completion of a task of a batch of the writer thread.
+   `ulog' specifies the update log object.
+   `bat' specifies the batch object.
+   `id' specifies the index of the batch.
+   `res' specifies the number of written bytes or the negated error code.
+   The written vectors are skipped and the rest of them are written again. */
+static void tculogringdone(TCULOG *ulog, TCULBATCH *bat, int id, int res){
+  assert(ulog && bat && id >= 0);
+  if(res < 1 && res != -EINTR && res != -EAGAIN){
+    bat->err = true;
+    bat->busy = false;
+    return;
+  }
+  if(res > 0){
+    bat->off += res;
+    while(bat->iovcur < bat->iovnum && res >= (int)bat->iov[bat->iovcur].iov_len){
+      res -= bat->iov[bat->iovcur].iov_len;
+      bat->iovcur++;
+    }
+    if(bat->iovcur < bat->iovnum){
+      struct iovec *iov = bat->iov + bat->iovcur;
+      iov->iov_base = (char *)iov->iov_base + res;
+      iov->iov_len -= res;
+    }
+  }
+  tculogringsubmit(ulog, bat, id);
+}
+
+
+/* Release a settled batch of the writer thread.
+   `ulog' specifies the update log object.
+   `bat' specifies the batch object.
+   `fail' specifies whether the batch or a preceding one failed.
+   Unless it failed, the index entries are flushed and the end of the file is published.  Then
+   the file is rotated if required and the space of the entries is cleared and released. */
+static void tculogringrelease(TCULOG *ulog, TCULBATCH *bat, bool fail){
+  assert(ulog && bat);
+  TCULRING *ring = ulog->ring;
+  bool err = fail;
+  if(!err){
+    tcxstrcat(ulog->ixbuf, tcxstrptr(bat->ixbuf), tcxstrsize(bat->ixbuf));
+    if(!tculogflushindex(ulog)) err = true;
+    __sync_synchronize();
+    ulog->size += bat->wsiz;
+    ulog->sdirty = true;
+    if(ulog->metrics){
+      ttmetricsadd(ulog->metrics, -1, ulog->mtid, bat->wsiz);
+      ttmetricsadd(ulog->metrics, -1, ulog->mtgroup, 1);
+      ttmetricsadd(ulog->metrics, -1, ulog->mtgrec, bat->rnum);
+    }
+  }
+  tcxstrclear(bat->ixbuf);
+  for(int i = 0; i < bat->cnum; i++){
+    tcfree(bat->copies[i]);
+  }
+  if(bat->rot){
+    if(pthread_rwlock_wrlock(&ulog->rwlck) == 0){
+      if(!tculogrotate(ulog)) err = true;
+      pthread_rwlock_unlock(&ulog->rwlck);
+    } else {
+      err = true;
+    }
+  }
+  uint64_t beg = bat->beg;
+  uint64_t end = bat->end;
+  if(err) tculogringfail(ring, beg, end);
+  int idx = beg & (TCULRINGSIZ - 1);
+  int fsiz = tclmin(end - beg, TCULRINGSIZ - idx);
+  memset(ring->buf + idx, 0, fsiz);
+  if(fsiz < end - beg) memset(ring->buf, 0, end - beg - fsiz);
+  __sync_synchronize();
+  ring->tail = end;
+  if(pthread_mutex_lock(&ring->mtx) == 0){
+    pthread_cond_broadcast(&ring->scnd);
+    pthread_mutex_unlock(&ring->mtx);
+  }
+  pthread_cond_broadcast(&ulog->cnd);
+}
+
+
 /* Call back function for the putshl function.
    `vbuf' specifies the pointer to the region of the value.
    `vsiz' specifies the size of the region of the value.
@@ -1207,5 +2413,118 @@ static void *tculogadbputshlproc(const void *vbuf, int vsiz, int *sp, PUTSHLOP *
 }
 
 
+/* Lock the mutexes of the records of a list in ascending order, except for held ones.
+   `ulog' specifies the update log object.
+   `keys' specifies a list object containing keys.
+   `step' specifies the interval of keys in the list.
+   `idxs' specifies an array of `TCULRMTXNUM' elements into which flags of locked mutexes are
+   assigned.
+   If successful, the return value is true, else, it is false. */
+static bool tculogbeginlist(TCULOG *ulog, const TCLIST *keys, int step, bool *idxs){
+  assert(ulog && keys && step > 0 && idxs);
+  memset(idxs, 0, sizeof(*idxs) * TCULRMTXNUM);
+  if(!ulog->base) return false;
+  uint32_t held = (uintptr_t)pthread_getspecific(ulog->hkey);
+  int knum = tclistnum(keys);
+  for(int i = 0; i < knum; i += step){
+    int ksiz;
+    const char *kbuf = tclistval(keys, i, &ksiz);
+    int idx = tculogrmtxidx(ulog, kbuf, ksiz);
+    if(!(held & (1U << idx))) idxs[idx] = true;
+  }
+  for(int i = 0; i < TCULRMTXNUM; i++){
+    if(idxs[i] && pthread_mutex_lock(ulog->rmtxs + i) != 0){
+      idxs[i] = false;
+      tculogendlist(ulog, idxs);
+      return false;
+    }
+  }
+  return true;
+}
+
+
+/* Unlock the mutexes locked by `tculogbeginlist'.
+   `ulog' specifies the update log object.
+   `idxs' specifies the array of flags of locked mutexes. */
+static void tculogendlist(TCULOG *ulog, const bool *idxs){
+  assert(ulog && idxs);
+  for(int i = TCULRMTXNUM - 1; i >= 0; i--){
+    if(idxs[i]) pthread_mutex_unlock(ulog->rmtxs + i);
+  }
+}
+
+
+/* Store or remove records of an abstract database object and log them as one message.
+   `ulog' specifies the update log object.
+   `sid' specifies the origin server ID of the message.
+   `mid' specifies the master server ID of the message.
+   `adb' specifies the abstract database object connected as a writer.
+   `elems' specifies a list object containing keys, or keys and values one after the other.
+   `cmd' specifies the command ID, `TTCMDMPUT' or `TTCMDMOUT'.
+   The return value is the number of records processed successfully, or -1 on failure of
+   logging. */
+static int tculogadbmulti(TCULOG *ulog, uint32_t sid, uint32_t mid, TCADB *adb,
+                          const TCLIST *elems, int cmd){
+  assert(ulog && adb && elems);
+  int step = (cmd == TTCMDMPUT) ? 2 : 1;
+  int elnum = tclistnum(elems) / step * step;
+  if(elnum < 1) return 0;
+  bool idxs[TCULRMTXNUM];
+  bool dolog = tculogbeginlist(ulog, elems, step, idxs);
+  int num = 0;
+  tttracemark(TTTSDBBEGIN);
+  for(int i = 0; i < elnum; i += step){
+    int ksiz;
+    const char *kbuf = tclistval(elems, i, &ksiz);
+    if(step > 1){
+      int vsiz;
+      const char *vbuf = tclistval(elems, i + 1, &vsiz);
+      if(tcadbput(adb, kbuf, ksiz, vbuf, vsiz)) num++;
+    } else {
+      if(tcadbout(adb, kbuf, ksiz)) num++;
+    }
+  }
+  tttracemark(TTTSDBEND);
+  if(dolog){
+    int rnum = elnum / step;
+    int msiz = sizeof(uint8_t) * 3 + sizeof(uint32_t);
+    for(int i = 0; i < elnum; i++){
+      int esiz;
+      tclistval(elems, i, &esiz);
+      msiz += sizeof(uint32_t) + esiz;
+    }
+    unsigned char mstack[TTIOBUFSIZ];
+    unsigned char *mbuf = (msiz < TTIOBUFSIZ) ? mstack : tcmalloc(msiz + 1);
+    unsigned char *wp = mbuf;
+    *(wp++) = TTMAGICNUM;
+    *(wp++) = cmd;
+    uint32_t lnum;
+    lnum = TTHTONL(rnum);
+    memcpy(wp, &lnum, sizeof(lnum));
+    wp += sizeof(lnum);
+    for(int i = 0; i < elnum; i += step){
+      for(int j = 0; j < step; j++){
+        int esiz;
+        tclistval(elems, i + j, &esiz);
+        lnum = TTHTONL(esiz);
+        memcpy(wp, &lnum, sizeof(lnum));
+        wp += sizeof(lnum);
+      }
+      for(int j = 0; j < step; j++){
+        int esiz;
+        const char *ebuf = tclistval(elems, i + j, &esiz);
+        memcpy(wp, ebuf, esiz);
+        wp += esiz;
+      }
+    }
+    *(wp++) = (num == rnum) ? 0 : 1;
+    if(!tculogwrite(ulog, 0, sid, mid, mbuf, msiz)) num = -1;
+    if(mbuf != mstack) tcfree(mbuf);
+    tculogendlist(ulog, idxs);
+  }
+  return num;
+}
+
+
 
 // END OF FILE
@@ -37,23 +37,53 @@ __TCULOG_CLINKAGEBEGIN
 
 
 #define TCULSUFFIX     ".ulog"           /* suffix of update log files */
+#define TCULIDXSUFFIX  ".ulix"           /* suffix of index files of update log files */
 #define TCULMAGICNUM   0xc9              /* magic number of each command */
 #define TCULMAGICNOP   0xca              /* magic number of NOP command */
 #define TCULRMTXNUM    31                /* number of mutexes of records */
 
+enum {                                   /* enumeration for synchronization policies */
+  TCULSNONE,                             /* not synchronize */
+  TCULSINTERVAL,                         /* synchronize by `tculogsync' periodically */
+  TCULSGROUP,                            /* synchronize each group of records */
+  TCULSALWAYS                            /* synchronize each record */
+};
+
 typedef struct {                         /* type of structure for an update log */
   pthread_mutex_t rmtxs[TCULRMTXNUM];    /* mutex for records */
+  pthread_key_t hkey;                    /* key of the record mutexes held by each thread */
   pthread_rwlock_t rwlck;                /* mutex for operation */
   pthread_cond_t cnd;                    /* condition variable */
   pthread_mutex_t wmtx;                  /* mutex for waiting condition */
+  pthread_mutex_t gmtx;                  /* mutex for group commit */
+  pthread_cond_t gcnd;                   /* condition variable for group commit */
+  pthread_mutex_t imtx;                  /* mutex for building indexes */
+  TCXSTR *gbuf;                          /* records waiting for group commit */
+  TCXSTR *gspare;                        /* spare buffer swapped with the waiting one */
+  void *gwaits;                          /* writers waiting for group commit */
+  bool gbusy;                            /* whether a leader is writing a group */
+  uint64_t sts;                          /* last stamped timestamp */
+  int spol;                              /* synchronization policy */
+  bool sdirty;                           /* whether unsynchronized records exist */
   char *base;                            /* path of the base directory */
   uint64_t limsiz;                       /* limit size */
   int max;                               /* number of maximum ID */
   int fd;                                /* current file descriptor */
   uint64_t size;                         /* current size */
-  void *aiocbs;                          /* AIO tasks */
-  int aiocbi;                            /* index of AIO tasks */
-  uint64_t aioend;                       /* end offset of AIO tasks */
+  int ixfd;                              /* file descriptor of the current index */
+  uint64_t ixnext;                       /* offset from which the next record is indexed */
+  TCXSTR *ixbuf;                         /* index entries waiting to be written */
+  uint64_t dsize;                        /* size of the current file synchronized */
+  void *uring;                           /* io_uring instance carrying writes of the writer */
+  void *ring;                            /* record ring drained by the writer thread */
+  TTMETRICS *metrics;                    /* metrics registry */
+  int mtid;                              /* ID of the metric of written bytes */
+  int mtsync;                            /* ID of the metric of synchronizations */
+  int mtsusec;                           /* ID of the metric of synchronization time */
+  int mtgroup;                           /* ID of the metric of written groups */
+  int mtgrec;                            /* ID of the metric of records in groups */
+  void (*syncproc)(double, void *);      /* function to observe each synchronization */
+  void *syncop;                          /* opaque object for the observing function */
 } TCULOG;
 
 typedef struct {                         /* type of structure for a log reader */
@@ -61,8 +91,11 @@ typedef struct {                         /* type of structure for a log reader *
   uint64_t ts;                           /* beginning timestamp */
   int num;                               /* number of current ID */
   int fd;                                /* current file descriptor */
-  char *rbuf;                            /* record buffer */
-  int rsiz;                              /* size of the record buffer */
+  uint64_t off;                          /* offset in the current file */
+  char *map;                             /* region of the current file mapped */
+  uint64_t msiz;                         /* size of the mapped region */
+  uint64_t fsiz;                         /* size of the current file if sealed */
+  bool sealed;                           /* whether the current file is no longer written */
 } TCULRD;
 
 typedef struct {                         /* type of structure for a replication */
@@ -84,9 +117,41 @@ TCULOG *tculognew(void);
 void tculogdel(TCULOG *ulog);
 
 
+/* Set the metrics registry of an update log object.
+   `ulog' specifies the update log object.
+   `metrics' specifies the metrics registry object.  The metric "ulog_bytes" is registered in it
+   and increased by the size of each written record.  "ulog_syncs" and "ulog_sync_usec" are
+   increased by each synchronization of the file and its time in microseconds.  "ulog_groups"
+   and "ulog_group_records" are increased by each group commit and the number of its records. */
+void tculogsetmetrics(TCULOG *ulog, TTMETRICS *metrics);
+
+
+/* Set the function to observe synchronizations of an update log object.
+   `ulog' specifies the update log object.
+   `proc' specifies the pointer to the function called with the time of each synchronization in
+   seconds and `op'.  It may be called by several threads at the same time.
+   `op' specifies an arbitrary pointer to be given to the function. */
+void tculogsetsyncproc(TCULOG *ulog, void (*proc)(double, void *), void *op);
+
+
+/* Set the synchronization policy of an update log object.
+   `ulog' specifies the update log object.
+   `policy' specifies the policy: `TCULSNONE' not to synchronize, `TCULSINTERVAL' to synchronize
+   by the function `tculogsync', `TCULSGROUP' to synchronize each group of records before the
+   writers return, `TCULSALWAYS' to write and synchronize each record by itself.
+   If successful, the return value is true, else, it is false.
+   This function should be called before the update log is opened.  `TCULSGROUP' and
+   `TCULSALWAYS' are not available with AIO control. */
+bool tculogsetsync(TCULOG *ulog, int policy);
+
+
 /* Set AIO control of an update log object.
    `ulog' specifies the update log object.
-   If successful, the return value is true, else, it is false. */
+   If successful, the return value is true, else, it is false.
+   Records are copied into a ring buffer and written by a dedicated thread in large sequential
+   writes.  If the library is built with io_uring and the kernel supports it, the writes of the
+   thread are carried by an io_uring instance.  Errors of writing a record are reported by a
+   later call of `tculogwrite' in the thread which wrote the record. */
 bool tculogsetaio(TCULOG *ulog);
 
 
@@ -95,7 +160,10 @@ bool tculogsetaio(TCULOG *ulog);
    `base' specifies the path of the base directory.
    `limsiz' specifies the limit size of each file.  If it is not more than 0, no limit is
    specified.
-   If successful, the return value is true, else, it is false. */
+   If successful, the return value is true, else, it is false.
+   Each file has an index file which maps timestamps to offsets at intervals.  The index of the
+   current file is built here if it is missing.  That of an older file is built when a log
+   reader seeks in the file first. */
 bool tculogopen(TCULOG *ulog, const char *base, uint64_t limsiz);
 
 
@@ -105,6 +173,14 @@ bool tculogopen(TCULOG *ulog, const char *base, uint64_t limsiz);
 bool tculogclose(TCULOG *ulog);
 
 
+/* Synchronize the current file of an update log object with the device.
+   `ulog' specifies the update log object.
+   If successful, the return value is true, else, it is false.
+   Nothing is done if no record has been written since the last synchronization.  The member
+   `dsize' is advanced to the size of the current file when it was synchronized. */
+bool tculogsync(TCULOG *ulog);
+
+
 /* Get the mutex index of a record.
    `ulog' specifies the update log object.
    `kbuf' specifies the pointer to the region of the key.
@@ -127,6 +203,22 @@ bool tculogbegin(TCULOG *ulog, int idx);
 bool tculogend(TCULOG *ulog, int idx);
 
 
+/* Begin the critical section of records of an update log object.
+   `ulog' specifies the update log object.
+   `keys' specifies a list object containing the keys of the records.
+   If successful, the return value is true, else, it is false.
+   The mutexes of the records are locked in ascending order and held by the calling thread
+   until `tculogendrecs' is called.  Meanwhile, critical sections of the same records begun by
+   the thread do not lock them again. */
+bool tculogbeginrecs(TCULOG *ulog, const TCLIST *keys);
+
+
+/* End the critical section of records of an update log object.
+   `ulog' specifies the update log object.
+   If successful, the return value is true, else, it is false. */
+bool tculogendrecs(TCULOG *ulog);
+
+
 /* Write a message into an update log object.
    `ulog' specifies the update log object.
    `ts' specifies the timestamp.  If it is 0, the current time is specified.
@@ -134,7 +226,9 @@ bool tculogend(TCULOG *ulog, int idx);
    `mid' specifies the master server ID of the message.
    `ptr' specifies the pointer to the region of the message.
    `size' specifies the size of the region.
-   If successful, the return value is true, else, it is false. */
+   If successful, the return value is true, else, it is false.
+   Unless AIO control is set, messages written by concurrent threads are gathered and written by
+   one of them at once, and this function returns after the message is written. */
 bool tculogwrite(TCULOG *ulog, uint64_t ts, uint32_t sid, uint32_t mid,
                  const void *ptr, int size);
 
@@ -142,7 +236,8 @@ bool tculogwrite(TCULOG *ulog, uint64_t ts, uint32_t sid, uint32_t mid,
 /* Create a log reader object.
    `ulog' specifies the update log object.
    `ts' specifies the beginning timestamp.
-   The return value is the new log reader object. */
+   The return value is the new log reader object.
+   The reader seeks the position of the timestamp by the index of the file. */
 TCULRD *tculrdnew(TCULOG *ulog, uint64_t ts);
 
 
@@ -167,7 +262,11 @@ void tculrdwait(TCULRD *ulrd);
    `midp' specifies the pointer to the variable into which the master server ID of the next
    message is assigned.
    If successful, the return value is the pointer to the region of the value of the next message.
-   `NULL' is returned if no record is to be read. */
+   `NULL' is returned if no record is to be read.
+   Files are mapped on memory and the region of the return value points into the mapping.  It is
+   available until the next call with the same object.  Because the current file is read up to
+   the end published by the writer, the lock of the update log is acquired only when another file
+   is mapped. */
 const void *tculrdread(TCULRD *ulrd, int *sp, uint64_t *tsp, uint32_t *sidp, uint32_t *midp);
 
 
@@ -244,6 +343,28 @@ bool tculogadbout(TCULOG *ulog, uint32_t sid, uint32_t mid, TCADB *adb,
                   const void *kbuf, int ksiz);
 
 
+/* Store records into an abstract database object.
+   `ulog' specifies the update log object.
+   `sid' specifies the origin server ID of the message.
+   `mid' specifies the master server ID of the message.
+   `adb' specifies the abstract database object connected as a writer.
+   `recs' specifies a list object containing keys and values one after the other.
+   The return value is the number of records stored successfully, or -1 on failure of logging.
+   Only the mutexes of the records are locked and the operation is logged as one message. */
+int tculogadbmput(TCULOG *ulog, uint32_t sid, uint32_t mid, TCADB *adb, const TCLIST *recs);
+
+
+/* Remove records of an abstract database object.
+   `ulog' specifies the update log object.
+   `sid' specifies the origin server ID of the message.
+   `mid' specifies the master server ID of the message.
+   `adb' specifies the abstract database object connected as a writer.
+   `keys' specifies a list object containing the keys.
+   The return value is the number of records removed successfully, or -1 on failure of logging.
+   Only the mutexes of the records are locked and the operation is logged as one message. */
+int tculogadbmout(TCULOG *ulog, uint32_t sid, uint32_t mid, TCADB *adb, const TCLIST *keys);
+
+
 /* Add an integer to a record in an abstract database object.
    `ulog' specifies the update log object.
    `sid' specifies the origin server ID of the message.
@@ -24,6 +24,7 @@
 #define DEFPIDPATH     "ttserver.pid"    // default name of the PID file
 #define DEFRTSPATH     "ttserver.rts"    // default name of the RTS file
 #define DEFULIMSIZ     (1LL<<30)         // default limit size of an update log file
+#define DEFULSINT      1000              // default interval of synchronizing the update log
 #define MAXARGSIZ      (256<<20)         // maximum size of each argument
 #define MAXARGNUM      (1<<20)           // maximum number of arguments
 #define NUMBUFSIZ      32                // size of a numeric buffer
@@ -32,6 +33,26 @@
 #define RECMTXNUM      31                // number of mutexes of records
 #define STASHBNUM      1021              // bucket number of the script stash object
 #define REPLPERIOD     1.0               // period of calling replication request
+#define REPLTHNUM      4                 // number of replication sender threads
+#define REPLBATCHNUM   1024              // number of records sent to a slave at a turn
+#define REPLSENDTIMEO  30.0              // timeout of sending a turn of records to a slave
+#define ADMTHNUM       2                 // number of admin threads
+#define ADMQUEUEMAX    64                // maximum number of waiting admin jobs
+#define LATSUBBITS     3                 // number of bits of sub-buckets of latency histograms
+#define LATSUBNUM      (1<<LATSUBBITS)   // number of sub-buckets in each magnitude
+#define LATBKTNUM      240               // number of buckets of latency histograms
+#define METRICSMAX     256               // maximum number of metrics
+#define SLOWRINGNUM    1024              // number of slots of the ring of slow requests
+#define SLOWKEYSIZ     32                // size of the key prefix of a slow request
+#define SLOWHEADSIZ    64                // size of the head of a request kept for the slow log
+#define SLOWRECNUM     256               // number of recent slow requests kept for queries
+#define SLOWPERIOD     1.0               // period of draining the slow requests
+#define SLOWDEFTH      100               // default threshold of slow requests in milliseconds
+#define TRACESLOTNUM   65536             // number of slots of the trace file
+#define TRACEDEFRATE   1000              // default sampling rate of the request tracer
+#define CAPHEADSIZ     8                 // size of the header of a captured request
+#define CURMAX         16                // maximum number of cursors of each connection
+#define CURLOOKNUM     8                 // number of keys read ahead for the position of a cursor
 
 enum {                                   // enumeration for command sequential numbers
   TTSEQPUT,                              // sequential number of put command
@@ -61,6 +82,14 @@ enum {                                   // enumeration for command sequential n
   TTSEQMISC,                             // sequential number of stat command
   TTSEQREPL,                             // sequential number of repl command
   TTSEQSLAVE,                            // sequential number of slave command
+  TTSEQMPUT,                             // sequential number of mput command
+  TTSEQMOUT,                             // sequential number of mout command
+  TTSEQBATCH,                            // sequential number of batch command
+  TTSEQCURNEW,                           // sequential number of curnew command
+  TTSEQCURJUMP,                          // sequential number of curjump command
+  TTSEQCURNEXT,                          // sequential number of curnext command
+  TTSEQCURPREV,                          // sequential number of curprev command
+  TTSEQCURDEL,                           // sequential number of curdel command
   TTSEQALLORG,                           // sequential number of all commands the original
   TTSEQALLMC,                            // sequential number of all commands the memcached
   TTSEQALLHTTP,                          // sequential number of all commands the HTTP
@@ -70,12 +99,38 @@ enum {                                   // enumeration for command sequential n
 };
 
 enum {                                   // enumeration for command sequential numbers
-  TTSEQPUTMISS = TTSEQSLAVE,             // sequential number of misses of get commands
+  TTSEQCMDNUM = TTSEQALLORG,             // number of sequential numbers of commands
+  TTSEQPUTMISS = TTSEQCMDNUM,            // sequential number of misses of get commands
   TTSEQOUTMISS,                          // sequential number of misses of out commands
   TTSEQGETMISS,                          // sequential number of misses of get commands
   TTSEQNUM                               // number of sequential numbers
 };
 
+enum {                                   // enumeration for ID numbers of fixed metrics
+  MTBININ = TTSEQNUM,                    // ID number of bytes received by the original protocol
+  MTBINOUT,                              // ID number of bytes sent by the original protocol
+  MTMCIN,                                // ID number of bytes received by the memcached protocol
+  MTMCOUT,                               // ID number of bytes sent by the memcached protocol
+  MTHTTPIN,                              // ID number of bytes received by the HTTP
+  MTHTTPOUT,                             // ID number of bytes sent by the HTTP
+  MTREPLOUT,                             // ID number of bytes sent to slaves
+  MTREPLIN,                              // ID number of bytes received from the master
+  MTFIXNUM                               // number of fixed metrics
+};
+
+enum {                                   // enumeration for protocols
+  PROTOBIN,                              // original binary protocol
+  PROTOMC,                               // memcached compatible protocol
+  PROTOHTTP                              // HTTP compatible protocol
+};
+
+enum {                                   // enumeration for phases of latency
+  LATPHQUEUE,                            // waiting in the queue
+  LATPHEXEC,                             // execution
+  LATPHSEND,                             // sending the response
+  LATPHNUM                               // number of phases
+};
+
 typedef struct {                         // type of structure of logging opaque object
   int fd;
 } LOGARG;
@@ -93,6 +148,7 @@ typedef struct {                         // type of structure of master synchron
   bool recon;                            // re-connect flag
   bool fatal;                            // fatal error flag
   uint64_t mts;                          // modified time stamp
+  TTMETRICS *metrics;                    // metrics registry object
 } REPLARG;
 
 typedef struct {                         // type of structure of periodic opaque object
@@ -104,18 +160,146 @@ typedef struct {                         // type of structure of periodic opaque
   void *scrext;                          // script extension object
 } EXTPCARG;
 
+typedef struct {                         // type of structure of latency histograms of a thread
+  int seq;                               // sequential number of the current command
+  uint64_t buckets[TTSEQCMDNUM][LATPHNUM][LATBKTNUM];  // numbers of samples in each bucket
+} LATHIST;
+
+typedef struct {                         // type of structure of marks of a command
+  double stime;                          // start time
+  double wtime;                          // seconds spent in sending before the start
+  uint64_t rbase;                        // bytes received before the command
+  uint64_t sbase;                        // bytes sent before the command
+  int proto;                             // protocol of the command
+  char head[SLOWHEADSIZ];                // head of the request
+  int hsiz;                              // size of the head of the request
+  TCXSTR *cap;                           // buffer of the captured request
+} CMDMARK;
+
+typedef struct {                         // type of structure of a slow request entry
+  volatile uint64_t seq;                 // sequence number of the slot
+  double time;                           // time of completion
+  int cmd;                               // sequential number of the command
+  int proto;                             // protocol of the command
+  char kbuf[SLOWKEYSIZ];                 // prefix of the key
+  int kpsiz;                             // size of the prefix of the key
+  int ksiz;                              // size of the key
+  int vsiz;                              // size of the value
+  double qtime;                          // seconds waiting in the queue
+  double etime;                          // seconds of execution
+  double stime;                          // seconds of sending the response
+} SLOWENT;
+
+typedef struct {                         // type of structure of slow request log object
+  double ths[TTSEQCMDNUM];               // thresholds of each command in seconds
+  SLOWENT *ents;                         // slots of the ring
+  volatile uint64_t head;                // position to be written next
+  uint64_t tail;                         // position to be read next
+  volatile uint64_t drops;               // number of dropped entries
+  int fd;                                // file descriptor of the log file
+  TCLIST *recs;                          // recent records
+  pthread_mutex_t mtx;                   // mutex for the recent records
+} SLOWLOG;
+
+typedef struct {                         // type of structure of admin thread object
+  pthread_t thid;                        // thread ID
+  bool alive;                            // alive flag
+  int idx;                               // ordinal index among the counters
+  void *targ;                            // task opaque object
+} ADMTHREAD;
+
+typedef struct {                         // type of structure of replication slave object
+  TTSOCK *sock;                          // socket object
+  TCULRD *ulrd;                          // update log reader object
+  uint64_t ts;                           // beginning time stamp
+  uint32_t sid;                          // server ID number of the slave
+  double noptime;                        // time of the last no-operation message
+  uint64_t ssum;                         // bytes already counted in the metrics
+} REPLSLAVE;
+
+typedef struct {                         // type of structure of replication sender thread object
+  pthread_t thid;                        // thread ID
+  bool alive;                            // alive flag
+  TCLIST *slaves;                        // slave objects served by the thread
+  void *targ;                            // task opaque object
+} REPLSEND;
+
+typedef struct {                         // type of structure of tracing state of a thread
+  TTSPAN span;                           // span of the current command
+  int cnt;                               // number of commands since the last sample
+} TRACESTATE;
+
+typedef struct {                         // type of structure of admin job object
+  TTSOCK *sock;                          // socket object
+  TTREQ req;                             // copy of the request object
+  int cmd;                               // command number
+  CMDMARK mark;                          // marks of the command
+} ADMJOB;
+
 typedef struct {                         // type of structure of task opaque object
   int thnum;                             // number of threads
-  uint64_t *counts;                      // conunters of execution
+  TTMETRICS *metrics;                    // metrics registry object
+  LATHIST *lats;                         // latency histograms of each thread
+  uint64_t *slats;                       // latency histogram of synchronizations of the update log
+  TCXSTR **mtbufs;                       // buffers to render metrics by each thread
+  SLOWLOG *slow;                         // slow request log object
+  TTTRACER *tracer;                      // request tracer object
+  int trrate;                            // sampling rate of the request tracer
+  TRACESTATE *traces;                    // tracing states of each thread
+  TCULOG *cap;                           // capture log object
   uint64_t mask;                         // bit mask of commands
   TCADB *adb;                            // database object
   TCULOG *ulog;                          // update log object
   uint32_t sid;                          // server ID number
   REPLARG *sarg;                         // replication object
   pthread_mutex_t rmtxs[RECMTXNUM];      // mutex for records
+  pthread_mutex_t itmtx;                 // mutex for the iterator of the database
+  TCLIST *itkeys;                        // keys read ahead for the iterator of legacy commands
+  bool itpark;                           // whether the iterator of legacy commands is parked
   void **screxts;                        // script extension objects
+  REPLSEND rsends[REPLTHNUM];            // replication sender thread objects
+  pthread_mutex_t rsmtx;                 // mutex for replication sender threads
+  pthread_cond_t rscnd;                  // condition variable for replication sender threads
+  bool rsterm;                           // terminate flag of replication sender threads
+  const TCLIST *extheavies;              // names of heavy extension functions
+  ADMTHREAD admths[ADMTHNUM];            // admin thread objects
+  TCLIST *admjobs;                       // queue of admin jobs
+  pthread_mutex_t admmtx;                // mutex for admin jobs
+  pthread_cond_t admcnd;                 // condition variable for admin jobs
+  bool admterm;                          // terminate flag of admin threads
 } TASKARG;
 
+typedef struct {                         // type of structure of a cursor of a connection
+  int id;                                // ID number
+  BDBCUR *bcur;                          // cursor of the B+ tree database
+  TCLIST *keys;                          // keys of the position for the other databases
+  int pos;                               // kind of the position
+} CONNCUR;
+
+enum {                                   // enumeration for kinds of positions of cursors
+  CURPFIRST,                             // the first record
+  CURPAT,                                // the record of the key
+  CURPAFTER,                             // the first remaining record of the keys read ahead
+  CURPEND                                // the end
+};
+
+typedef struct {                         // type of structure of the state of a connection
+  CONNCUR curs[CURMAX];                  // cursors
+  int curid;                             // last ID number of cursors
+} CONNSTATE;
+
+typedef struct {                         // type of structure of a sub-command of a batch
+  int cmd;                               // command ID
+  int nsiz;                              // size of the function name
+  int opts;                              // options of the function
+  int ksiz;                              // size of the key
+  int vsiz;                              // size of the value
+  int num;                               // additional number
+  const char *nbuf;                      // pointer to the function name
+  const char *kbuf;                      // pointer to the key
+  const char *vbuf;                      // pointer to the value
+} BATCHOP;
+
 typedef struct {                         // type of structure of termination opaque object
   int thnum;                             // number of threads
   TCADB *adb;                            // database object
@@ -123,6 +307,7 @@ typedef struct {                         // type of structure of termination opa
   void **screxts;                        // script extension objects
   EXTPCARG *pcargs;                      // periodic opaque objects
   int pcnum;                             // number of periodic opaque objects
+  TASKARG *targ;                         // task opaque object
   bool err;                              // error flag
 } TERMARG;
 
@@ -133,6 +318,15 @@ double g_starttime = 0.0;                // start time
 TTSERV *g_serv = NULL;                   // server object
 int g_loglevel = TTLOGINFO;              // whether to log debug information
 bool g_restart = false;                  // restart flag
+const char *g_seqnames[] = {             // names of commands indexed by sequential numbers
+  "put", "putkeep", "putcat", "putshl", "putnr", "out", "get", "mget", "vsiz",
+  "iterinit", "iternext", "fwmkeys", "addint", "adddouble", "ext", "sync", "optimize",
+  "vanish", "copy", "restore", "setmst", "rnum", "size", "stat", "misc", "repl", "slave",
+  "mput", "mout", "batch", "curnew", "curjump", "curnext", "curprev", "curdel"
+};
+const char *g_ulsnames[] = {             // names of synchronization policies of the update log
+  "none", "interval", "group", "always"
+};
 
 
 /* function prototypes */
@@ -141,19 +335,57 @@ static void usage(void);
 static uint64_t getcmdmask(const char *expr);
 static void sigtermhandler(int signum);
 static void sigchldhandler(int signum);
-static int proc(const char *dbname, const char *host, int port, int thnum, int tout,
-                bool dmn, const char *pidpath, bool kl, const char *logpath,
-                const char *ulogpath, uint64_t ulim, bool uas, uint32_t sid,
-                const char *mhost, int mport, const char *rtspath, int ropts,
+static int proc(const char *dbname, const char *host, int port, int thnum, bool reactor,
+                int tout, bool dmn, const char *pidpath, bool kl, const char *logpath,
+                const char *ulogpath, uint64_t ulim, bool uas, int ulsync, int ulsint,
+                uint32_t sid, const char *mhost, int mport, const char *rtspath, int ropts,
                 const char *skelpath, int mulnum, const char *extpath, const TCLIST *extpcs,
-                uint64_t mask);
+                const TCLIST *extheavies, const char *slogpath, const TCLIST *slths,
+                const char *trpath, int trrate, const char *cappath, uint64_t mask);
 static void do_log(int level, const char *msg, void *opq);
 static void do_slave(void *opq);
 static void do_extpc(void *opq);
+static void do_ulsync(void *opq);
 static void do_task(TTSOCK *sock, void *opq, TTREQ *req);
+static bool isadmcmd(TTSOCK *sock, TASKARG *arg, int cmd);
+static bool isextheavy(TASKARG *arg, const void *name, int nsiz);
+static bool isbatchheavy(TASKARG *arg, const unsigned char *rp, int size);
+static bool pushadmjob(TTSOCK *sock, TASKARG *arg, TTREQ *req, int cmd, const CMDMARK *mark);
+static void do_admin(TTSOCK *sock, TASKARG *arg, TTREQ *req, int cmd);
+static void *admworker(void *opq);
+static bool startadmthreads(TASKARG *arg);
+static bool stopadmthreads(TASKARG *arg);
+static int do_check(const char *ptr, int size, void *opq);
+static int binreqsize(const unsigned char *ptr, int size);
+static int64_t listreqsize(const unsigned char *ptr, int size, int64_t off, int64_t rnum);
+static int64_t pairreqsize(const unsigned char *ptr, int size, int64_t off, int64_t rnum);
+static int64_t batchreqsize(const unsigned char *ptr, int size, int64_t off, int64_t rnum);
+static int textreqsize(const char *ptr, int size);
 static char **tokenize(char *str, int *np);
 static uint32_t recmtxidx(const char *kbuf, int ksiz);
-static uint64_t sumstat(TASKARG *arg, int seq);
+static TTMETRICS *newmetrics(int thnum);
+static void countcmd(TASKARG *arg, TTREQ *req, int seq);
+static void markcmd(TTSOCK *sock, CMDMARK *mark);
+static int latbucket(double sec);
+static uint64_t latbound(int idx);
+static void donecmd(TTSOCK *sock, TASKARG *arg, TTREQ *req, const CMDMARK *mark);
+static void countsync(double sec, void *opq);
+static void printlats(TASKARG *arg, TCXSTR *xstr, const char *head, int delim, const char *tail);
+static void printpcts(TCXSTR *xstr, const uint64_t *buckets, const char *head, const char *name,
+                      int delim, const char *tail);
+static SLOWLOG *slownew(void);
+static void slowdel(SLOWLOG *slow);
+static bool setslowth(SLOWLOG *slow, const char *name, double msec);
+static void pushslow(SLOWLOG *slow, int seq, const CMDMARK *mark,
+                     double qtime, double etime, double stime);
+static int32_t slowheadint(const CMDMARK *mark, int off);
+static void slowkey(const CMDMARK *mark, SLOWENT *ent);
+static void do_slowlog(void *opq);
+static TCLIST *miscslow(TASKARG *arg, const char *name, const TCLIST *args);
+static void begintrace(TASKARG *arg, TTREQ *req, bool force);
+static void endtrace(TASKARG *arg, TTREQ *req);
+static void begincap(TTSOCK *sock, CMDMARK *mark);
+static void endcap(TTSOCK *sock, TASKARG *arg, TTREQ *req, const CMDMARK *mark);
 static void do_put(TTSOCK *sock, TASKARG *arg, TTREQ *req);
 static void do_putkeep(TTSOCK *sock, TASKARG *arg, TTREQ *req);
 static void do_putcat(TTSOCK *sock, TASKARG *arg, TTREQ *req);
@@ -165,10 +397,20 @@ static void do_mget(TTSOCK *sock, TASKARG *arg, TTREQ *req);
 static void do_vsiz(TTSOCK *sock, TASKARG *arg, TTREQ *req);
 static void do_iterinit(TTSOCK *sock, TASKARG *arg, TTREQ *req);
 static void do_iternext(TTSOCK *sock, TASKARG *arg, TTREQ *req);
+static void do_curnew(TTSOCK *sock, TASKARG *arg, TTREQ *req);
+static void do_curjump(TTSOCK *sock, TASKARG *arg, TTREQ *req);
+static void do_curmove(TTSOCK *sock, TASKARG *arg, TTREQ *req, bool back);
+static void do_curdel(TTSOCK *sock, TASKARG *arg, TTREQ *req);
+static CONNCUR *getcur(TTSOCK *sock, int id);
+static void delcur(CONNCUR *cur);
+static void readitkeys(TCADB *adb, TCLIST *keys);
+static bool seekitkeys(TCADB *adb, TCLIST *keys);
 static void do_fwmkeys(TTSOCK *sock, TASKARG *arg, TTREQ *req);
 static void do_addint(TTSOCK *sock, TASKARG *arg, TTREQ *req);
 static void do_adddouble(TTSOCK *sock, TASKARG *arg, TTREQ *req);
 static void do_ext(TTSOCK *sock, TASKARG *arg, TTREQ *req);
+static char *callext(void *scr, pthread_mutex_t *rmtxs, const char *name, int opts,
+                     const char *kbuf, int ksiz, const char *vbuf, int vsiz, int *sp);
 static void do_sync(TTSOCK *sock, TASKARG *arg, TTREQ *req);
 static void do_optimize(TTSOCK *sock, TASKARG *arg, TTREQ *req);
 static void do_vanish(TTSOCK *sock, TASKARG *arg, TTREQ *req);
@@ -179,7 +421,16 @@ static void do_rnum(TTSOCK *sock, TASKARG *arg, TTREQ *req);
 static void do_size(TTSOCK *sock, TASKARG *arg, TTREQ *req);
 static void do_stat(TTSOCK *sock, TASKARG *arg, TTREQ *req);
 static void do_misc(TTSOCK *sock, TASKARG *arg, TTREQ *req);
+static void do_mput(TTSOCK *sock, TASKARG *arg, TTREQ *req);
+static void do_mout(TTSOCK *sock, TASKARG *arg, TTREQ *req);
+static void do_batch(TTSOCK *sock, TASKARG *arg, TTREQ *req);
+static void dobatchop(TASKARG *arg, TTREQ *req, const BATCHOP *op, TCXSTR *xstr);
 static void do_repl(TTSOCK *sock, TASKARG *arg, TTREQ *req);
+static int replsendslave(TASKARG *arg, REPLSLAVE *slave);
+static void replslavedel(REPLSLAVE *slave);
+static void *replsender(void *opq);
+static bool startreplsenders(TASKARG *arg);
+static bool stopreplsenders(TASKARG *arg);
 static void do_mc_set(TTSOCK *sock, TASKARG *arg, TTREQ *req, char **tokens, int tnum);
 static void do_mc_add(TTSOCK *sock, TASKARG *arg, TTREQ *req, char **tokens, int tnum);
 static void do_mc_replace(TTSOCK *sock, TASKARG *arg, TTREQ *req, char **tokens, int tnum);
@@ -194,12 +445,15 @@ static void do_mc_flushall(TTSOCK *sock, TASKARG *arg, TTREQ *req, char **tokens
 static void do_mc_version(TTSOCK *sock, TASKARG *arg, TTREQ *req, char **tokens, int tnum);
 static void do_mc_quit(TTSOCK *sock, TASKARG *arg, TTREQ *req, char **tokens, int tnum);
 static void do_http_get(TTSOCK *sock, TASKARG *arg, TTREQ *req, int ver, const char *uri);
+static void do_http_latency(TTSOCK *sock, TASKARG *arg, TTREQ *req, int ver);
+static void do_http_metrics(TTSOCK *sock, TASKARG *arg, TTREQ *req, int ver);
 static void do_http_head(TTSOCK *sock, TASKARG *arg, TTREQ *req, int ver, const char *uri);
 static void do_http_put(TTSOCK *sock, TASKARG *arg, TTREQ *req, int ver, const char *uri);
 static void do_http_post(TTSOCK *sock, TASKARG *arg, TTREQ *req, int ver, const char *uri);
 static void do_http_delete(TTSOCK *sock, TASKARG *arg, TTREQ *req, int ver, const char *uri);
 static void do_http_options(TTSOCK *sock, TASKARG *arg, TTREQ *req, int ver, const char *uri);
 static void do_term(void *opq);
+static void do_close(void *opq, void *hopq);
 
 
 /* main routine */
@@ -216,13 +470,22 @@ int main(int argc, char **argv){
   char *skelpath = NULL;
   char *extpath = NULL;
   TCLIST *extpcs = NULL;
+  TCLIST *extheavies = NULL;
+  char *slogpath = NULL;
+  TCLIST *slths = NULL;
+  char *trpath = NULL;
+  char *cappath = NULL;
+  int trrate = TRACEDEFRATE;
   int port = TTDEFPORT;
   int thnum = DEFTHNUM;
+  bool reactor = false;
   int tout = 0;
   bool dmn = false;
   bool kl = false;
   uint64_t ulim = DEFULIMSIZ;
   bool uas = false;
+  int ulsync = TCULSNONE;
+  int ulsint = DEFULSINT;
   uint32_t sid = 0;
   int mport = TTDEFPORT;
   int ropts = 0;
@@ -239,6 +502,10 @@ int main(int argc, char **argv){
       } else if(!strcmp(argv[i], "-thnum")){
         if(++i >= argc) usage();
         thnum = tcatoi(argv[i]);
+      } else if(!strcmp(argv[i], "-reactors")){
+        if(++i >= argc) usage();
+        thnum = tcatoi(argv[i]);
+        reactor = true;
       } else if(!strcmp(argv[i], "-tout")){
         if(++i >= argc) usage();
         tout = tcatoi(argv[i]);
@@ -264,6 +531,16 @@ int main(int argc, char **argv){
         ulim = tcatoix(argv[i]);
       } else if(!strcmp(argv[i], "-uas")){
         uas = true;
+      } else if(!strcmp(argv[i], "-ulsync")){
+        if(++i >= argc) usage();
+        ulsync = -1;
+        for(int j = 0; j < (int)(sizeof(g_ulsnames) / sizeof(*g_ulsnames)); j++){
+          if(!tcstricmp(argv[i], g_ulsnames[j])) ulsync = j;
+        }
+        if(ulsync < 0) usage();
+      } else if(!strcmp(argv[i], "-ulsint")){
+        if(++i >= argc) usage();
+        ulsint = tcatoi(argv[i]);
       } else if(!strcmp(argv[i], "-sid")){
         if(++i >= argc) usage();
         sid = tcatoi(argv[i]);
@@ -293,6 +570,28 @@ int main(int argc, char **argv){
         tclistpush2(extpcs, argv[i]);
         if(++i >= argc) usage();
         tclistpush2(extpcs, argv[i]);
+      } else if(!strcmp(argv[i], "-extheavy")){
+        if(!extheavies) extheavies = tclistnew2(1);
+        if(++i >= argc) usage();
+        tclistpush2(extheavies, argv[i]);
+      } else if(!strcmp(argv[i], "-slog")){
+        if(++i >= argc) usage();
+        slogpath = argv[i];
+      } else if(!strcmp(argv[i], "-slth")){
+        if(!slths) slths = tclistnew2(1);
+        if(++i >= argc) usage();
+        tclistpush2(slths, argv[i]);
+        if(++i >= argc) usage();
+        tclistpush2(slths, argv[i]);
+      } else if(!strcmp(argv[i], "-trace")){
+        if(++i >= argc) usage();
+        trpath = argv[i];
+      } else if(!strcmp(argv[i], "-trrate")){
+        if(++i >= argc) usage();
+        trrate = tcatoi(argv[i]);
+      } else if(!strcmp(argv[i], "-cap")){
+        if(++i >= argc) usage();
+        cappath = argv[i];
       } else if(!strcmp(argv[i], "-mask")){
         if(++i >= argc) usage();
         mask |= getcmdmask(argv[i]);
@@ -314,14 +613,17 @@ int main(int argc, char **argv){
     }
   }
   if(!dbname) dbname = "*";
-  if(thnum < 1 || mport < 1) usage();
+  if(thnum < 1 || mport < 1 || ulsint < 1) usage();
   if(dmn && !pidpath) pidpath = DEFPIDPATH;
   if(!rtspath) rtspath = DEFRTSPATH;
   g_serv = ttservnew();
-  int rv = proc(dbname, host, port, thnum, tout, dmn, pidpath, kl, logpath,
-                ulogpath, ulim, uas, sid, mhost, mport, rtspath, ropts,
-                skelpath, mulnum, extpath, extpcs, mask);
+  int rv = proc(dbname, host, port, thnum, reactor, tout, dmn, pidpath, kl, logpath,
+                ulogpath, ulim, uas, ulsync, ulsint, sid, mhost, mport, rtspath, ropts,
+                skelpath, mulnum, extpath, extpcs, extheavies, slogpath, slths,
+                trpath, trrate, cappath, mask);
   ttservdel(g_serv);
+  if(slths) tclistdel(slths);
+  if(extheavies) tclistdel(extheavies);
   if(extpcs) tclistdel(extpcs);
   return rv;
 }
@@ -332,10 +634,12 @@ static void usage(void){
   fprintf(stderr, "%s: the server of Tokyo Tyrant\n", g_progname);
   fprintf(stderr, "\n");
   fprintf(stderr, "usage:\n");
-  fprintf(stderr, "  %s [-host name] [-port num] [-thnum num] [-tout num]"
+  fprintf(stderr, "  %s [-host name] [-port num] [-thnum num|-reactors num] [-tout num]"
           " [-dmn] [-pid path] [-kl] [-log path] [-ld|-le] [-ulog path] [-ulim num] [-uas]"
-          " [-sid num] [-mhost name] [-mport num] [-rts path] [-rcc] [-skel name] [-mul num]"
-          " [-ext path] [-extpc name period] [-mask expr] [-unmask expr] [dbname]\n",
+          " [-ulsync name] [-ulsint msec] [-sid num] [-mhost name] [-mport num] [-rts path]"
+          " [-rcc] [-skel name] [-mul num]"
+          " [-ext path] [-extpc name period] [-extheavy name] [-slog path] [-slth name msec]"
+          " [-trace path] [-trrate num] [-cap path] [-mask expr] [-unmask expr] [dbname]\n",
           g_progname);
   fprintf(stderr, "\n");
   exit(1);
@@ -372,6 +676,16 @@ static uint64_t getcmdmask(const char *expr){
       mask |= 1ULL << TTSEQITERINIT;
     } else if(!tcstricmp(name, "iternext")){
       mask |= 1ULL << TTSEQITERNEXT;
+    } else if(!tcstricmp(name, "curnew")){
+      mask |= 1ULL << TTSEQCURNEW;
+    } else if(!tcstricmp(name, "curjump")){
+      mask |= 1ULL << TTSEQCURJUMP;
+    } else if(!tcstricmp(name, "curnext")){
+      mask |= 1ULL << TTSEQCURNEXT;
+    } else if(!tcstricmp(name, "curprev")){
+      mask |= 1ULL << TTSEQCURPREV;
+    } else if(!tcstricmp(name, "curdel")){
+      mask |= 1ULL << TTSEQCURDEL;
     } else if(!tcstricmp(name, "fwmkeys")){
       mask |= 1ULL << TTSEQFWMKEYS;
     } else if(!tcstricmp(name, "addint")){
@@ -400,6 +714,12 @@ static uint64_t getcmdmask(const char *expr){
       mask |= 1ULL << TTSEQSTAT;
     } else if(!tcstricmp(name, "misc")){
       mask |= 1ULL << TTSEQMISC;
+    } else if(!tcstricmp(name, "mput")){
+      mask |= 1ULL << TTSEQMPUT;
+    } else if(!tcstricmp(name, "mout")){
+      mask |= 1ULL << TTSEQMOUT;
+    } else if(!tcstricmp(name, "batch")){
+      mask |= 1ULL << TTSEQBATCH;
     } else if(!tcstricmp(name, "repl")){
       mask |= 1ULL << TTSEQREPL;
     } else if(!tcstricmp(name, "slave")){
@@ -439,12 +759,13 @@ static void sigchldhandler(int signum){
 
 
 /* perform the command */
-static int proc(const char *dbname, const char *host, int port, int thnum, int tout,
-                bool dmn, const char *pidpath, bool kl, const char *logpath,
-                const char *ulogpath, uint64_t ulim, bool uas, uint32_t sid,
-                const char *mhost, int mport, const char *rtspath, int ropts,
+static int proc(const char *dbname, const char *host, int port, int thnum, bool reactor,
+                int tout, bool dmn, const char *pidpath, bool kl, const char *logpath,
+                const char *ulogpath, uint64_t ulim, bool uas, int ulsync, int ulsint,
+                uint32_t sid, const char *mhost, int mport, const char *rtspath, int ropts,
                 const char *skelpath, int mulnum, const char *extpath, const TCLIST *extpcs,
-                uint64_t mask){
+                const TCLIST *extheavies, const char *slogpath, const TCLIST *slths,
+                const char *trpath, int trrate, const char *cappath, uint64_t mask){
   LOGARG larg;
   larg.fd = 1;
   ttservsetloghandler(g_serv, do_log, &larg);
@@ -467,6 +788,12 @@ static int proc(const char *dbname, const char *host, int port, int thnum, int t
       ttservlog(g_serv, TTLOGINFO, "warning: skel(%s) is not the absolute path", skelpath);
     if(extpath && *extpath != MYPATHCHR)
       ttservlog(g_serv, TTLOGINFO, "warning: ext(%s) is not the absolute path", extpath);
+    if(slogpath && *slogpath != MYPATHCHR)
+      ttservlog(g_serv, TTLOGINFO, "warning: slog(%s) is not the absolute path", slogpath);
+    if(trpath && *trpath != MYPATHCHR)
+      ttservlog(g_serv, TTLOGINFO, "warning: trace(%s) is not the absolute path", trpath);
+    if(cappath && *cappath != MYPATHCHR)
+      ttservlog(g_serv, TTLOGINFO, "warning: cap(%s) is not the absolute path", cappath);
     if(chdir("/") == -1){
       ttservlog(g_serv, TTLOGERROR, "chdir failed");
       return 1;
@@ -477,6 +804,8 @@ static int proc(const char *dbname, const char *host, int port, int thnum, int t
   struct stat sbuf;
   if(ulogpath && (stat(ulogpath, &sbuf) != 0 || !S_ISDIR(sbuf.st_mode)))
     ttservlog(g_serv, TTLOGINFO, "warning: ulog(%s) is not a directory", ulogpath);
+  if(cappath && (stat(cappath, &sbuf) != 0 || !S_ISDIR(sbuf.st_mode)))
+    ttservlog(g_serv, TTLOGINFO, "warning: cap(%s) is not a directory", cappath);
   if(pidpath){
     char *numstr = tcreadfile(pidpath, -1, NULL);
     if(numstr && kl){
@@ -585,6 +914,8 @@ static int proc(const char *dbname, const char *host, int port, int thnum, int t
       ttservlog(g_serv, TTLOGERROR, "dlopen failed: %s", dlerror());
     }
   }
+  TTMETRICS *metrics = newmetrics(thnum + ADMTHNUM);
+  ttservsetmetrics(g_serv, metrics);
   TCADB *adb = tcadbnew();
   if(skellib){
     void *initsym = dlsym(skellib, "initialize");
@@ -606,6 +937,12 @@ static int proc(const char *dbname, const char *host, int port, int thnum, int t
       err = true;
       ttservlog(g_serv, TTLOGERROR, "dlsym failed: %s", dlerror());
     }
+    initsym = dlsym(skellib, "initmetrics");
+    if(initsym){
+      void (*initfunc)(TTMETRICS *);
+      memcpy(&initfunc, &initsym, sizeof(initsym));
+      initfunc(metrics);
+    }
   }
   ttservlog(g_serv, TTLOGSYSTEM, "opening the database: %s", dbname);
   if(mulnum > 0 && !tcadbsetskelmulti(adb, mulnum)){
@@ -616,40 +953,60 @@ static int proc(const char *dbname, const char *host, int port, int thnum, int t
     err = true;
     ttservlog(g_serv, TTLOGERROR, "tcadbopen failed");
   }
+  uint64_t *slats = tccalloc(sizeof(*slats), LATBKTNUM);
   TCULOG *ulog = tculognew();
+  tculogsetmetrics(ulog, metrics);
+  tculogsetsyncproc(ulog, countsync, slats);
   if(ulogpath){
     ttservlog(g_serv, TTLOGSYSTEM,
-              "update log configuration: path=%s limit=%llu async=%d sid=%d",
-              ulogpath, (unsigned long long)ulim, uas, sid);
+              "update log configuration: path=%s limit=%llu async=%d sync=%s sid=%d",
+              ulogpath, (unsigned long long)ulim, uas, g_ulsnames[ulsync], sid);
     if(uas && !tculogsetaio(ulog)){
       err = true;
       ttservlog(g_serv, TTLOGERROR, "tculogsetaio failed");
+    } else if(ulog->uring){
+      ttservlog(g_serv, TTLOGSYSTEM, "update log AIO is carried by io_uring");
+    }
+    if(!tculogsetsync(ulog, ulsync)){
+      err = true;
+      ttservlog(g_serv, TTLOGERROR, "tculogsetsync failed");
     }
     if(!tculogopen(ulog, ulogpath, ulim)){
       err = true;
       ttservlog(g_serv, TTLOGERROR, "tculogopen failed");
     }
+    if(ulsync == TCULSINTERVAL &&
+       !ttservaddtimedhandler(g_serv, ulsint / 1000.0, do_ulsync, ulog)) err = true;
   }
   ttservtune(g_serv, thnum, tout);
+  if(reactor){
+    ttservlog(g_serv, TTLOGSYSTEM, "reactor configuration: reactors=%d", thnum);
+    ttservsetreactor(g_serv, true);
+  }
   if(mhost)
     ttservlog(g_serv, TTLOGSYSTEM, "replication configuration: host=%s port=%d ropts=%d",
               mhost, mport, ropts);
-  uint64_t *counts = tccalloc(sizeof(*counts), (TTSEQNUM) * thnum);
-  void *screxts[thnum];
+  int wknum = thnum + ADMTHNUM;
+  LATHIST *lats = tccalloc(sizeof(*lats), wknum);
+  TCXSTR *mtbufs[wknum];
+  for(int i = 0; i < wknum; i++){
+    mtbufs[i] = tcxstrnew3(TTIOBUFSIZ);
+  }
+  void *screxts[wknum];
   TCMDB *scrstash = NULL;
   TCMDB *scrlock = NULL;
   pthread_mutex_t *scrlcks = NULL;
   if(extpath){
     ttservlog(g_serv, TTLOGSYSTEM, "scripting extension: %s", extpath);
     scrstash = tcmdbnew2(STASHBNUM);
-    scrlock = tcmdbnew2(thnum * 2 + 1);
+    scrlock = tcmdbnew2(wknum * 2 + 1);
     bool screrr = false;
-    for(int i = 0; i < thnum; i++){
+    for(int i = 0; i < wknum; i++){
       screxts[i] = NULL;
     }
-    for(int i = 0; i < thnum; i++){
-      screxts[i] = scrextnew(screxts, thnum, i, extpath, adb, ulog, sid, scrstash, scrlock,
-                             do_log, &larg);
+    for(int i = 0; i < wknum; i++){
+      screxts[i] = scrextnew(screxts, wknum, i, extpath, adb, ulog, sid, scrstash, scrlock,
+                             metrics, do_log, &larg);
       if(!screxts[i]) screrr = true;
     }
     if(screrr){
@@ -657,7 +1014,7 @@ static int proc(const char *dbname, const char *host, int port, int thnum, int t
       ttservlog(g_serv, TTLOGERROR, "scrextnew failed");
     }
   } else {
-    for(int i = 0; i < thnum; i++){
+    for(int i = 0; i < wknum; i++){
       screxts[i] = NULL;
     }
   }
@@ -676,7 +1033,47 @@ static int proc(const char *dbname, const char *host, int port, int thnum, int t
   sarg.recon = false;
   sarg.fatal = false;
   sarg.mts = 0;
-  if(!(mask & (1ULL << TTSEQSLAVE))) ttservaddtimedhandler(g_serv, REPLPERIOD, do_slave, &sarg);
+  sarg.metrics = metrics;
+  if(!(mask & (1ULL << TTSEQSLAVE)) &&
+     !ttservaddtimedhandler(g_serv, REPLPERIOD, do_slave, &sarg)) err = true;
+  SLOWLOG *slow = NULL;
+  if(slogpath){
+    ttservlog(g_serv, TTLOGSYSTEM, "slow request log: %s", slogpath);
+    slow = slownew();
+    if(slths){
+      for(int i = 0; i < tclistnum(slths) - 1; i += 2){
+        const char *name = tclistval2(slths, i);
+        if(!setslowth(slow, name, tcatof(tclistval2(slths, i + 1)))){
+          err = true;
+          ttservlog(g_serv, TTLOGERROR, "unknown command name for the slow log: %s", name);
+        }
+      }
+    }
+  }
+  TTTRACER *tracer = NULL;
+  TRACESTATE *traces = NULL;
+  if(trpath){
+    ttservlog(g_serv, TTLOGSYSTEM, "request tracer: path=%s rate=%d", trpath, trrate);
+    tracer = tttracernew(trpath, TRACESLOTNUM);
+    if(tracer){
+      traces = tccalloc(sizeof(*traces), wknum);
+    } else {
+      err = true;
+      ttservlog(g_serv, TTLOGERROR, "tttracernew failed");
+    }
+  }
+  TCULOG *cap = NULL;
+  if(cappath){
+    ttservlog(g_serv, TTLOGSYSTEM, "traffic capture: path=%s limit=%llu",
+              cappath, (unsigned long long)ulim);
+    cap = tculognew();
+    if(!tculogopen(cap, cappath, ulim)){
+      err = true;
+      ttservlog(g_serv, TTLOGERROR, "tculogopen failed");
+      tculogdel(cap);
+      cap = NULL;
+    }
+  }
   EXTPCARG *pcargs = NULL;
   int pcnum = 0;
   if(extpath && extpcs){
@@ -691,19 +1088,24 @@ static int proc(const char *dbname, const char *host, int port, int thnum, int t
       pcarg->ulog = ulog;
       pcarg->sid = sid;
       pcarg->sarg = &sarg;
-      pcarg->scrext = scrextnew(screxts, thnum, thnum + i, extpath, adb, ulog, sid,
-                                scrstash, scrlock, do_log, &larg);
+      pcarg->scrext = scrextnew(screxts, wknum, wknum + i, extpath, adb, ulog, sid,
+                                scrstash, scrlock, metrics, do_log, &larg);
       if(pcarg->scrext){
-        if(*name && period > 0) ttservaddtimedhandler(g_serv, period, do_extpc, pcarg);
+        if(*name && period > 0 && !ttservaddtimedhandler(g_serv, period, do_extpc, pcarg))
+          err = true;
       } else {
         err = true;
         ttservlog(g_serv, TTLOGERROR, "scrextnew failed");
       }
     }
   }
+  if(slow && !ttservaddtimedhandler(g_serv, SLOWPERIOD, do_slowlog, slow)) err = true;
   TASKARG targ;
   targ.thnum = thnum;
-  targ.counts = counts;
+  targ.metrics = metrics;
+  targ.lats = lats;
+  targ.slats = slats;
+  targ.mtbufs = mtbufs;
   targ.mask = mask;
   targ.adb = adb;
   targ.ulog = ulog;
@@ -713,15 +1115,47 @@ static int proc(const char *dbname, const char *host, int port, int thnum, int t
     if(pthread_mutex_init(targ.rmtxs + i, NULL) != 0)
       ttservlog(g_serv, TTLOGERROR, "pthread_mutex_init failed");
   }
+  if(pthread_mutex_init(&targ.itmtx, NULL) != 0)
+    ttservlog(g_serv, TTLOGERROR, "pthread_mutex_init failed");
+  targ.itkeys = tclistnew2(CURLOOKNUM);
+  targ.itpark = false;
   targ.screxts = screxts;
+  for(int i = 0; i < REPLTHNUM; i++){
+    targ.rsends[i].alive = false;
+    targ.rsends[i].slaves = tclistnew();
+    targ.rsends[i].targ = &targ;
+  }
+  if(pthread_mutex_init(&targ.rsmtx, NULL) != 0)
+    ttservlog(g_serv, TTLOGERROR, "pthread_mutex_init failed");
+  if(pthread_cond_init(&targ.rscnd, NULL) != 0)
+    ttservlog(g_serv, TTLOGERROR, "pthread_cond_init failed");
+  targ.extheavies = extheavies;
+  targ.slow = slow;
+  targ.tracer = tracer;
+  targ.trrate = trrate;
+  targ.traces = traces;
+  targ.cap = cap;
+  for(int i = 0; i < ADMTHNUM; i++){
+    targ.admths[i].alive = false;
+    targ.admths[i].idx = thnum + i;
+    targ.admths[i].targ = &targ;
+  }
+  targ.admjobs = tclistnew();
+  if(pthread_mutex_init(&targ.admmtx, NULL) != 0)
+    ttservlog(g_serv, TTLOGERROR, "pthread_mutex_init failed");
+  if(pthread_cond_init(&targ.admcnd, NULL) != 0)
+    ttservlog(g_serv, TTLOGERROR, "pthread_cond_init failed");
   ttservsettaskhandler(g_serv, do_task, &targ);
+  ttservsetcheckhandler(g_serv, do_check, NULL);
+  ttservsetclosehandler(g_serv, do_close, &targ);
   TERMARG karg;
-  karg.thnum = thnum;
+  karg.thnum = wknum;
   karg.adb = adb;
   karg.sarg = &sarg;
   karg.screxts = screxts;
   karg.pcargs = pcargs;
   karg.pcnum = pcnum;
+  karg.targ = &targ;
   karg.err = false;
   ttservsettermhandler(g_serv, do_term, &karg);
   if(larg.fd != 1){
@@ -739,14 +1173,29 @@ static int proc(const char *dbname, const char *host, int port, int thnum, int t
         ttservlog(g_serv, TTLOGERROR, "open failed");
       }
     }
+    if(slow){
+      slow->fd = open(slogpath, O_WRONLY | O_APPEND | O_CREAT, 00644);
+      if(slow->fd == -1){
+        err = true;
+        ttservlog(g_serv, TTLOGERROR, "open failed");
+      }
+    }
     if(signal(SIGTERM, sigtermhandler) == SIG_ERR || signal(SIGINT, sigtermhandler) == SIG_ERR ||
        signal(SIGHUP, sigtermhandler) == SIG_ERR || signal(SIGPIPE, SIG_IGN) == SIG_ERR ||
        signal(SIGCHLD, sigchldhandler) == SIG_ERR){
       err = true;
       ttservlog(g_serv, TTLOGERROR, "signal failed");
     }
+    if(!startadmthreads(&targ)) err = true;
+    if(!startreplsenders(&targ)) err = true;
     if(!ttservstart(g_serv)) err = true;
+    if(slow){
+      do_slowlog(slow);
+      if(slow->fd != -1 && close(slow->fd) == -1) err = true;
+      slow->fd = -1;
+    }
   } while(g_restart);
+  if(!stopadmthreads(&targ)) err = true;
   if(karg.err) err = true;
   if(pcargs){
     for(int i = 0; i < pcnum; i++){
@@ -759,11 +1208,26 @@ static int proc(const char *dbname, const char *host, int port, int thnum, int t
     }
     tcfree(pcargs);
   }
+  if(pthread_cond_destroy(&targ.admcnd) != 0)
+    ttservlog(g_serv, TTLOGERROR, "pthread_cond_destroy failed");
+  if(pthread_mutex_destroy(&targ.admmtx) != 0)
+    ttservlog(g_serv, TTLOGERROR, "pthread_mutex_destroy failed");
+  tclistdel(targ.admjobs);
+  if(pthread_cond_destroy(&targ.rscnd) != 0)
+    ttservlog(g_serv, TTLOGERROR, "pthread_cond_destroy failed");
+  if(pthread_mutex_destroy(&targ.rsmtx) != 0)
+    ttservlog(g_serv, TTLOGERROR, "pthread_mutex_destroy failed");
+  for(int i = 0; i < REPLTHNUM; i++){
+    tclistdel(targ.rsends[i].slaves);
+  }
+  tclistdel(targ.itkeys);
+  if(pthread_mutex_destroy(&targ.itmtx) != 0)
+    ttservlog(g_serv, TTLOGERROR, "pthread_mutex_destroy failed");
   for(int i = 0; i < RECMTXNUM; i++){
     if(pthread_mutex_destroy(targ.rmtxs + i) != 0)
       ttservlog(g_serv, TTLOGERROR, "pthread_mutex_destroy failed");
   }
-  for(int i = 0; i < thnum; i++){
+  for(int i = 0; i < wknum; i++){
     if(!screxts[i]) continue;
     if(!scrextdel(screxts[i])){
       err = true;
@@ -779,13 +1243,31 @@ static int proc(const char *dbname, const char *host, int port, int thnum, int t
   }
   if(scrlock) tcmdbdel(scrlock);
   if(scrstash) tcmdbdel(scrstash);
-  tcfree(counts);
+  for(int i = 0; i < wknum; i++){
+    tcxstrdel(mtbufs[i]);
+  }
+  tcfree(lats);
+  if(slow) slowdel(slow);
+  if(traces) tcfree(traces);
+  if(tracer && !tttracerdel(tracer)){
+    err = true;
+    ttservlog(g_serv, TTLOGERROR, "tttracerdel failed");
+  }
+  if(cap){
+    if(!tculogclose(cap)){
+      err = true;
+      ttservlog(g_serv, TTLOGERROR, "tculogclose failed");
+    }
+    tculogdel(cap);
+  }
   if(ulogpath && !tculogclose(ulog)){
     err = true;
     ttservlog(g_serv, TTLOGERROR, "tculogclose failed");
   }
   tculogdel(ulog);
+  tcfree(slats);
   tcadbdel(adb);
+  ttmetricsdel(metrics);
   if(skellib && dlclose(skellib) != 0){
     err = true;
     ttservlog(g_serv, TTLOGERROR, "dlclose failed");
@@ -869,6 +1351,9 @@ static void do_slave(void *opq){
     while(!err && !ttserviskilled(g_serv) && !arg->recon &&
           (rbuf = tcreplread(repl, &rsiz, &rts, &rsid)) != NULL){
       if(rsiz < 1) continue;
+      ttmetricsadd(arg->metrics, -1, MTREPLIN,
+                   sizeof(uint8_t) + sizeof(uint64_t) + sizeof(uint32_t) * 2 + rsiz);
+      ttmetricsadd(arg->metrics, -1, TTSEQSLAVE, 1);
       bool cc;
       if(!tculogadbredo(adb, rbuf, rsiz, ulog, rsid, repl->mid, &cc)){
         err = true;
@@ -917,12 +1402,31 @@ static void do_extpc(void *opq){
 }
 
 
+/* synchronize the update log */
+static void do_ulsync(void *opq){
+  TCULOG *ulog = (TCULOG *)opq;
+  if(!tculogsync(ulog)) ttservlog(g_serv, TTLOGERROR, "do_ulsync: tculogsync failed");
+}
+
+
 /* handle a task and dispatch it */
 static void do_task(TTSOCK *sock, void *opq, TTREQ *req){
   TASKARG *arg = (TASKARG *)opq;
+  CMDMARK mark;
+  markcmd(sock, &mark);
+  if(arg->slow){
+    mark.hsiz = tclmin(sock->ep - sock->rp, SLOWHEADSIZ);
+    memcpy(mark.head, sock->rp, mark.hsiz);
+  }
+  if(arg->cap) begincap(sock, &mark);
+  arg->lats[req->idx].seq = -1;
   int c = ttsockgetc(sock);
-  if(c == TTMAGICNUM){
-    switch(ttsockgetc(sock)){
+  if(c == TTMAGICNUM || c == TTMAGICTRACE){
+    mark.proto = PROTOBIN;
+    int cmd = ttsockgetc(sock);
+    if(isadmcmd(sock, arg, cmd) && pushadmjob(sock, arg, req, cmd, &mark)) return;
+    if(arg->tracer) begintrace(arg, req, c == TTMAGICTRACE);
+    switch(cmd){
       case TTCMDPUT:
         do_put(sock, arg, req);
         break;
@@ -956,6 +1460,21 @@ static void do_task(TTSOCK *sock, void *opq, TTREQ *req){
       case TTCMDITERNEXT:
         do_iternext(sock, arg, req);
         break;
+      case TTCMDCURNEW:
+        do_curnew(sock, arg, req);
+        break;
+      case TTCMDCURJUMP:
+        do_curjump(sock, arg, req);
+        break;
+      case TTCMDCURNEXT:
+        do_curmove(sock, arg, req, false);
+        break;
+      case TTCMDCURPREV:
+        do_curmove(sock, arg, req, true);
+        break;
+      case TTCMDCURDEL:
+        do_curdel(sock, arg, req);
+        break;
       case TTCMDFWMKEYS:
         do_fwmkeys(sock, arg, req);
         break;
@@ -998,6 +1517,15 @@ static void do_task(TTSOCK *sock, void *opq, TTREQ *req){
       case TTCMDMISC:
         do_misc(sock, arg, req);
         break;
+      case TTCMDMPUT:
+        do_mput(sock, arg, req);
+        break;
+      case TTCMDMOUT:
+        do_mout(sock, arg, req);
+        break;
+      case TTCMDBATCH:
+        do_batch(sock, arg, req);
+        break;
       case TTCMDREPL:
         do_repl(sock, arg, req);
         break;
@@ -1015,6 +1543,8 @@ static void do_task(TTSOCK *sock, void *opq, TTREQ *req){
       pthread_cleanup_push(tcfree, tokens);
       if(tnum > 0){
         const char *cmd = tokens[0];
+        mark.proto = (tnum > 2 && tcstrfwm(tokens[2], "HTTP/1.")) ? PROTOHTTP : PROTOMC;
+        if(arg->tracer) begintrace(arg, req, false);
         if(!strcmp(cmd, "set")){
           do_mc_set(sock, arg, req, tokens, tnum);
         } else if(!strcmp(cmd, "add")){
@@ -1049,7 +1579,13 @@ static void do_task(TTSOCK *sock, void *opq, TTREQ *req){
             if(pv) uri = pv;
           }
           if(!strcmp(cmd, "GET")){
-            do_http_get(sock, arg, req, ver, uri);
+            if(!strcmp(uri, "/_latency")){
+              do_http_latency(sock, arg, req, ver);
+            } else if(!strcmp(uri, "/_metrics")){
+              do_http_metrics(sock, arg, req, ver);
+            } else {
+              do_http_get(sock, arg, req, ver, uri);
+            }
           } else if(!strcmp(cmd, "HEAD")){
             do_http_head(sock, arg, req, ver, uri);
           } else if(!strcmp(cmd, "PUT")){
@@ -1067,6 +1603,490 @@ static void do_task(TTSOCK *sock, void *opq, TTREQ *req){
       pthread_cleanup_pop(1);
     }
   }
+  donecmd(sock, arg, req, &mark);
+}
+
+
+/* check whether a command should be carried by the admin threads */
+static bool isadmcmd(TTSOCK *sock, TASKARG *arg, int cmd){
+  const unsigned char *rp = (unsigned char *)sock->rp;
+  int size = sock->ep - sock->rp;
+  uint32_t num;
+  switch(cmd){
+    case TTCMDOPTIMIZE:
+    case TTCMDVANISH:
+    case TTCMDCOPY:
+    case TTCMDRESTORE:
+      return true;
+    case TTCMDEXT:
+      if(!arg->extheavies || size < 16) return false;
+      memcpy(&num, rp, sizeof(num));
+      num = TTNTOHL(num);
+      if(num > size - 16) return false;
+      return isextheavy(arg, rp + 16, num);
+    case TTCMDBATCH:
+      return arg->extheavies && isbatchheavy(arg, rp, size);
+    case TTCMDMISC:
+      if(size < 12) return false;
+      memcpy(&num, rp, sizeof(num));
+      num = TTNTOHL(num);
+      if(num > size - 12) return false;
+      rp += 12;
+      return (num == 8 && !memcmp(rp, "optimize", 8)) || (num == 6 && !memcmp(rp, "vanish", 6)) ||
+        (num == 6 && !memcmp(rp, "defrag", 6)) || (num == 8 && !memcmp(rp, "setindex", 8));
+  }
+  return false;
+}
+
+
+/* check whether the name of an extension function is heavy */
+static bool isextheavy(TASKARG *arg, const void *name, int nsiz){
+  for(int i = 0; i < tclistnum(arg->extheavies); i++){
+    int hsiz;
+    const char *hbuf = tclistval(arg->extheavies, i, &hsiz);
+    if(hsiz == nsiz && !memcmp(hbuf, name, nsiz)) return true;
+  }
+  return false;
+}
+
+
+/* check whether a batch command includes a sub-command of a heavy extension function */
+static bool isbatchheavy(TASKARG *arg, const unsigned char *rp, int size){
+  const unsigned char *ep = rp + size;
+  uint32_t nums[4];
+  if(ep - rp < sizeof(nums[0])) return false;
+  memcpy(nums, rp, sizeof(nums[0]));
+  int rnum = TTNTOHL(nums[0]);
+  rp += sizeof(nums[0]);
+  for(int i = 0; i < rnum; i++){
+    if(rp >= ep) return false;
+    int cmd = *(rp++);
+    int hnum;
+    switch(cmd){
+      case TTCMDPUT: hnum = 2; break;
+      case TTCMDOUT: hnum = 1; break;
+      case TTCMDGET: hnum = 1; break;
+      case TTCMDVSIZ: hnum = 1; break;
+      case TTCMDADDINT: hnum = 2; break;
+      case TTCMDEXT: hnum = 4; break;
+      default: return false;
+    }
+    if(ep - rp < sizeof(nums[0]) * hnum) return false;
+    memcpy(nums, rp, sizeof(nums[0]) * hnum);
+    rp += sizeof(nums[0]) * hnum;
+    for(int j = 0; j < hnum; j++){
+      nums[j] = TTNTOHL(nums[j]);
+    }
+    uint64_t bsiz;
+    switch(cmd){
+      case TTCMDPUT: bsiz = (uint64_t)nums[0] + nums[1]; break;
+      case TTCMDADDINT: bsiz = nums[0]; break;
+      case TTCMDEXT: bsiz = (uint64_t)nums[0] + nums[2] + nums[3]; break;
+      default: bsiz = nums[0]; break;
+    }
+    if(bsiz > ep - rp) return false;
+    if(cmd == TTCMDEXT && isextheavy(arg, rp, nums[0])) return true;
+    rp += bsiz;
+  }
+  return false;
+}
+
+
+/* put a command into the queue of the admin threads */
+static bool pushadmjob(TTSOCK *sock, TASKARG *arg, TTREQ *req, int cmd, const CMDMARK *mark){
+  if(!ttsockflush(sock)) return false;
+  if(pthread_mutex_lock(&arg->admmtx) != 0) return false;
+  bool rv = false;
+  if(!arg->admterm && tclistnum(arg->admjobs) < ADMQUEUEMAX){
+    ADMJOB job;
+    job.sock = sock;
+    job.req = *req;
+    job.cmd = cmd;
+    job.mark = *mark;
+    tclistpush(arg->admjobs, &job, sizeof(job));
+    req->suspend = true;
+    rv = true;
+    if(pthread_cond_signal(&arg->admcnd) != 0)
+      ttservlog(g_serv, TTLOGERROR, "pthread_cond_signal failed");
+  }
+  pthread_mutex_unlock(&arg->admmtx);
+  if(!rv) ttservlog(g_serv, TTLOGINFO, "admin queue is not available");
+  return rv;
+}
+
+
+/* handle a command carried by an admin thread */
+static void do_admin(TTSOCK *sock, TASKARG *arg, TTREQ *req, int cmd){
+  switch(cmd){
+    case TTCMDEXT:
+      do_ext(sock, arg, req);
+      break;
+    case TTCMDBATCH:
+      do_batch(sock, arg, req);
+      break;
+    case TTCMDOPTIMIZE:
+      do_optimize(sock, arg, req);
+      break;
+    case TTCMDVANISH:
+      do_vanish(sock, arg, req);
+      break;
+    case TTCMDCOPY:
+      do_copy(sock, arg, req);
+      break;
+    case TTCMDRESTORE:
+      do_restore(sock, arg, req);
+      break;
+    case TTCMDMISC:
+      do_misc(sock, arg, req);
+      break;
+  }
+}
+
+
+/* carry commands in the queue of the admin threads */
+static void *admworker(void *opq){
+  ADMTHREAD *ath = (ADMTHREAD *)opq;
+  TASKARG *arg = (TASKARG *)ath->targ;
+  bool err = false;
+  if(pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, NULL) != 0){
+    err = true;
+    ttservlog(g_serv, TTLOGERROR, "pthread_setcancelstate failed");
+  }
+  while(true){
+    if(pthread_mutex_lock(&arg->admmtx) != 0){
+      err = true;
+      ttservlog(g_serv, TTLOGERROR, "pthread_mutex_lock failed");
+      break;
+    }
+    while(!arg->admterm && tclistnum(arg->admjobs) < 1){
+      if(pthread_cond_wait(&arg->admcnd, &arg->admmtx) != 0){
+        err = true;
+        ttservlog(g_serv, TTLOGERROR, "pthread_cond_wait failed");
+        break;
+      }
+    }
+    int jsiz;
+    ADMJOB *job = arg->admterm ? NULL : tclistshift(arg->admjobs, &jsiz);
+    pthread_mutex_unlock(&arg->admmtx);
+    if(!job) break;
+    job->req.idx = ath->idx;
+    job->mark.stime = tctime();
+    job->mark.wtime = job->sock->wtime;
+    arg->lats[ath->idx].seq = -1;
+    do_admin(job->sock, arg, &job->req, job->cmd);
+    donecmd(job->sock, arg, &job->req, &job->mark);
+    if(!ttservresume(&job->req, job->sock)) err = true;
+    tcfree(job);
+  }
+  return err ? "error" : NULL;
+}
+
+
+/* start the admin threads */
+static bool startadmthreads(TASKARG *arg){
+  bool err = false;
+  arg->admterm = false;
+  for(int i = 0; i < ADMTHNUM; i++){
+    ADMTHREAD *ath = arg->admths + i;
+    if(ath->alive) continue;
+    if(pthread_create(&ath->thid, NULL, admworker, ath) == 0){
+      ath->alive = true;
+    } else {
+      err = true;
+      ttservlog(g_serv, TTLOGERROR, "pthread_create (admworker) failed");
+    }
+  }
+  return !err;
+}
+
+
+/* stop the admin threads and close connections of the commands left in the queue */
+static bool stopadmthreads(TASKARG *arg){
+  if(pthread_mutex_lock(&arg->admmtx) != 0) return false;
+  bool err = false;
+  arg->admterm = true;
+  if(pthread_cond_broadcast(&arg->admcnd) != 0){
+    err = true;
+    ttservlog(g_serv, TTLOGERROR, "pthread_cond_broadcast failed");
+  }
+  pthread_mutex_unlock(&arg->admmtx);
+  for(int i = 0; i < ADMTHNUM; i++){
+    ADMTHREAD *ath = arg->admths + i;
+    if(!ath->alive) continue;
+    void *rv;
+    if(pthread_join(ath->thid, &rv) == 0){
+      if(rv) err = true;
+    } else {
+      err = true;
+      ttservlog(g_serv, TTLOGERROR, "pthread_join failed");
+    }
+    ath->alive = false;
+  }
+  int dnum = 0;
+  ADMJOB *job;
+  int jsiz;
+  while((job = tclistshift(arg->admjobs, &jsiz)) != NULL){
+    job->req.idx = -1;
+    job->req.keep = false;
+    job->sock->end = true;
+    if(job->mark.cap){
+      ttsocksetrec(job->sock, NULL);
+      tcxstrdel(job->mark.cap);
+    }
+    if(!ttservresume(&job->req, job->sock)) err = true;
+    tcfree(job);
+    dnum++;
+  }
+  if(dnum > 0) ttservlog(g_serv, TTLOGINFO, "%d admin commands discarded", dnum);
+  return !err;
+}
+
+
+/* measure the first request in received data */
+static int do_check(const char *ptr, int size, void *opq){
+  if(size < 1) return 1;
+  int c = *(unsigned char *)ptr;
+  if(c == TTMAGICNUM || c == TTMAGICTRACE) return binreqsize((unsigned char *)ptr, size);
+  return textreqsize(ptr, size);
+}
+
+
+/* get the size of a request of the binary protocol */
+static int binreqsize(const unsigned char *ptr, int size){
+  if(size < 2) return 2;
+  int hsiz;
+  switch(ptr[1]){
+    case TTCMDPUT:
+    case TTCMDPUTKEEP:
+    case TTCMDPUTCAT:
+    case TTCMDPUTNR:
+    case TTCMDFWMKEYS:
+    case TTCMDADDINT:
+      hsiz = 10;
+      break;
+    case TTCMDPUTSHL:
+      hsiz = 14;
+      break;
+    case TTCMDOUT:
+    case TTCMDGET:
+    case TTCMDVSIZ:
+    case TTCMDMGET:
+    case TTCMDMPUT:
+    case TTCMDMOUT:
+    case TTCMDBATCH:
+    case TTCMDCURDEL:
+    case TTCMDOPTIMIZE:
+    case TTCMDCOPY:
+      hsiz = 6;
+      break;
+    case TTCMDMISC:
+    case TTCMDCURNEXT:
+    case TTCMDCURPREV:
+      hsiz = 14;
+      break;
+    case TTCMDCURJUMP:
+      hsiz = 10;
+      break;
+    case TTCMDEXT:
+    case TTCMDRESTORE:
+      hsiz = 18;
+      break;
+    case TTCMDADDDOUBLE:
+    case TTCMDSETMST:
+      hsiz = 22;
+      break;
+    case TTCMDITERINIT:
+    case TTCMDITERNEXT:
+    case TTCMDCURNEW:
+    case TTCMDSYNC:
+    case TTCMDVANISH:
+    case TTCMDRNUM:
+    case TTCMDSIZE:
+    case TTCMDSTAT:
+      return 2;
+    default:
+      return 0;
+  }
+  if(size < hsiz) return hsiz;
+  uint32_t nums[4];
+  int nnum = (hsiz - 2) / sizeof(*nums);
+  if(nnum > 4) nnum = 4;
+  memcpy(nums, ptr + 2, sizeof(*nums) * nnum);
+  int64_t rsiz;
+  switch(ptr[1]){
+    case TTCMDPUT:
+    case TTCMDPUTKEEP:
+    case TTCMDPUTCAT:
+    case TTCMDPUTNR:
+    case TTCMDPUTSHL:
+      rsiz = hsiz + (int64_t)TTNTOHL(nums[0]) + TTNTOHL(nums[1]);
+      break;
+    case TTCMDMGET:
+    case TTCMDMOUT:
+      rsiz = listreqsize(ptr, size, hsiz, TTNTOHL(nums[0]));
+      break;
+    case TTCMDMPUT:
+      rsiz = pairreqsize(ptr, size, hsiz, TTNTOHL(nums[0]));
+      break;
+    case TTCMDBATCH:
+      rsiz = batchreqsize(ptr, size, hsiz, TTNTOHL(nums[0]));
+      break;
+    case TTCMDCURJUMP:
+      rsiz = hsiz + (int64_t)TTNTOHL(nums[1]);
+      break;
+    case TTCMDCURNEXT:
+    case TTCMDCURPREV:
+    case TTCMDCURDEL:
+      rsiz = hsiz;
+      break;
+    case TTCMDMISC:
+      rsiz = listreqsize(ptr, size, hsiz + (int64_t)TTNTOHL(nums[0]), TTNTOHL(nums[2]));
+      break;
+    case TTCMDEXT:
+      rsiz = hsiz + (int64_t)TTNTOHL(nums[0]) + TTNTOHL(nums[2]) + TTNTOHL(nums[3]);
+      break;
+    default:
+      rsiz = hsiz + (int64_t)TTNTOHL(nums[0]);
+      break;
+  }
+  return rsiz > INT_MAX ? INT_MAX : rsiz;
+}
+
+
+/* get the size of a request containing a list of length-prefixed elements */
+static int64_t listreqsize(const unsigned char *ptr, int size, int64_t off, int64_t rnum){
+  for(int64_t i = 0; i < rnum && off <= INT_MAX; i++){
+    uint32_t num;
+    if(off + (int64_t)sizeof(num) > size) return off + sizeof(num);
+    memcpy(&num, ptr + off, sizeof(num));
+    off += sizeof(num) + (int64_t)TTNTOHL(num);
+  }
+  return off;
+}
+
+
+/* get the size of a request containing a list of length-prefixed pairs */
+static int64_t pairreqsize(const unsigned char *ptr, int size, int64_t off, int64_t rnum){
+  for(int64_t i = 0; i < rnum && off <= INT_MAX; i++){
+    uint32_t nums[2];
+    if(off + (int64_t)sizeof(nums) > size) return off + sizeof(nums);
+    memcpy(nums, ptr + off, sizeof(nums));
+    off += sizeof(nums) + (int64_t)TTNTOHL(nums[0]) + TTNTOHL(nums[1]);
+  }
+  return off;
+}
+
+
+/* get the size of a request containing a sequence of sub-commands */
+static int64_t batchreqsize(const unsigned char *ptr, int size, int64_t off, int64_t rnum){
+  for(int64_t i = 0; i < rnum && off <= INT_MAX; i++){
+    if(off + 1 > size) return off + 1;
+    int nnum;
+    switch(ptr[off]){
+      case TTCMDOUT:
+      case TTCMDGET:
+      case TTCMDVSIZ:
+        nnum = 1;
+        break;
+      case TTCMDPUT:
+      case TTCMDADDINT:
+        nnum = 2;
+        break;
+      case TTCMDEXT:
+        nnum = 4;
+        break;
+      default:
+        return off;
+    }
+    uint32_t nums[4];
+    off++;
+    if(off + (int64_t)sizeof(*nums) * nnum > size) return off + sizeof(*nums) * nnum;
+    memcpy(nums, ptr + off, sizeof(*nums) * nnum);
+    switch(ptr[off-1]){
+      case TTCMDPUT:
+        off += (int64_t)TTNTOHL(nums[0]) + TTNTOHL(nums[1]);
+        break;
+      case TTCMDEXT:
+        off += (int64_t)TTNTOHL(nums[0]) + TTNTOHL(nums[2]) + TTNTOHL(nums[3]);
+        break;
+      default:
+        off += (int64_t)TTNTOHL(nums[0]);
+        break;
+    }
+    off += sizeof(*nums) * nnum;
+  }
+  return off;
+}
+
+
+/* get the size of a request of the memcached protocol or HTTP */
+static int textreqsize(const char *ptr, int size){
+  const char *ep = memchr(ptr, '\n', size);
+  if(!ep) return size + 1;
+  const char *tokens[5];
+  int tsizs[5];
+  int tnum = 0;
+  const char *rp = ptr;
+  while(tnum < 5){
+    while(rp < ep && (*rp == ' ' || *rp == '\t' || *rp == '\r')){
+      rp++;
+    }
+    if(rp >= ep) break;
+    tokens[tnum] = rp;
+    while(rp < ep && *rp != ' ' && *rp != '\t' && *rp != '\r'){
+      rp++;
+    }
+    tsizs[tnum] = rp - tokens[tnum];
+    tnum++;
+  }
+  int64_t rsiz = ep - ptr + 1;
+  if(tnum < 1) return rsiz;
+  const char *cmd = tokens[0];
+  int csiz = tsizs[0];
+  if((csiz == 3 && (!memcmp(cmd, "set", 3) || !memcmp(cmd, "add", 3))) ||
+     (csiz == 7 && (!memcmp(cmd, "replace", 7) || !memcmp(cmd, "prepend", 7))) ||
+     (csiz == 6 && !memcmp(cmd, "append", 6))){
+    if(tnum < 5) return rsiz;
+    int64_t vsiz = 0;
+    for(int i = 0; i < tsizs[4] && tokens[4][i] >= '0' && tokens[4][i] <= '9'; i++){
+      vsiz = vsiz * 10 + tokens[4][i] - '0';
+      if(vsiz > INT_MAX) return INT_MAX;
+    }
+    rsiz += vsiz + 2;
+    return rsiz > INT_MAX ? INT_MAX : rsiz;
+  }
+  if(tnum < 3 || tsizs[2] < 7 || memcmp(tokens[2], "HTTP/1.", 7)) return rsiz;
+  bool body = (csiz == 3 && !memcmp(cmd, "PUT", 3)) || (csiz == 4 && !memcmp(cmd, "POST", 4));
+  int64_t vsiz = 0;
+  while(true){
+    rp = ep + 1;
+    if(rp >= ptr + size) return size + 1;
+    ep = memchr(rp, '\n', ptr + size - rp);
+    if(!ep) return size + 1;
+    const char *lp = ep;
+    if(lp > rp && lp[-1] == '\r') lp--;
+    if(lp == rp) break;
+    const char *name = "content-length:";
+    int nsiz = strlen(name);
+    if(body && lp - rp > nsiz){
+      int i = 0;
+      while(i < nsiz && tolower(*(unsigned char *)(rp + i)) == name[i]){
+        i++;
+      }
+      if(i >= nsiz){
+        const char *pv = rp + nsiz;
+        while(pv < lp && (*pv == ' ' || *pv == '\t')){
+          pv++;
+        }
+        vsiz = 0;
+        while(pv < lp && *pv >= '0' && *pv <= '9' && vsiz <= INT_MAX){
+          vsiz = vsiz * 10 + *(pv++) - '0';
+        }
+      }
+    }
+  }
+  rsiz = ep - ptr + 1 + vsiz;
+  return rsiz > INT_MAX ? INT_MAX : rsiz;
 }
 
 
@@ -1106,66 +2126,518 @@ static uint32_t recmtxidx(const char *kbuf, int ksiz){
 }
 
 
-/* get the summation of status information of a command */
-static uint64_t sumstat(TASKARG *arg, int seq){
-  int thnum = arg->thnum;
-  uint64_t *counts = arg->counts;
+/* create the metrics registry whose ID numbers of commands are their sequential numbers */
+static TTMETRICS *newmetrics(int thnum){
+  TTMETRICS *metrics = ttmetricsnew(thnum, METRICSMAX);
+  char name[TTADDRBUFSIZ];
+  for(int i = 0; i < TTSEQCMDNUM; i++){
+    sprintf(name, "cnt_%s", g_seqnames[i]);
+    ttmetricsreg(metrics, name, TTMTCOUNTER);
+  }
+  ttmetricsreg(metrics, "cnt_put_miss", TTMTCOUNTER);
+  ttmetricsreg(metrics, "cnt_out_miss", TTMTCOUNTER);
+  ttmetricsreg(metrics, "cnt_get_miss", TTMTCOUNTER);
+  ttmetricsreg(metrics, "bin_bytes_in", TTMTBYTES);
+  ttmetricsreg(metrics, "bin_bytes_out", TTMTBYTES);
+  ttmetricsreg(metrics, "mc_bytes_in", TTMTBYTES);
+  ttmetricsreg(metrics, "mc_bytes_out", TTMTBYTES);
+  ttmetricsreg(metrics, "http_bytes_in", TTMTBYTES);
+  ttmetricsreg(metrics, "http_bytes_out", TTMTBYTES);
+  ttmetricsreg(metrics, "repl_bytes_out", TTMTBYTES);
+  ttmetricsreg(metrics, "repl_bytes_in", TTMTBYTES);
+  return metrics;
+}
+
+
+/* count a command and mark it as the current one of the thread */
+static void countcmd(TASKARG *arg, TTREQ *req, int seq){
+  ttmetricsadd(arg->metrics, req->idx, seq, 1);
+  arg->lats[req->idx].seq = seq;
+}
+
+
+/* mark the beginning of a command */
+static void markcmd(TTSOCK *sock, CMDMARK *mark){
+  mark->stime = tctime();
+  mark->wtime = sock->wtime;
+  mark->rbase = sock->rsum - (sock->ep - sock->rp);
+  mark->sbase = sock->ssum + sock->wnum;
+  mark->proto = -1;
+  mark->hsiz = 0;
+  mark->cap = NULL;
+}
+
+
+/* get the index of the bucket of latency histograms for a duration */
+static int latbucket(double sec){
+  uint64_t usec = sec > 0 ? sec * 1000000 : 0;
+  if(usec < LATSUBNUM) return usec;
+  int mag = 63 - __builtin_clzll(usec);
+  int idx = (mag - LATSUBBITS + 1) * LATSUBNUM + ((usec >> (mag - LATSUBBITS)) & (LATSUBNUM - 1));
+  return idx < LATBKTNUM ? idx : LATBKTNUM - 1;
+}
+
+
+/* get the upper bound in microseconds of a bucket of latency histograms */
+static uint64_t latbound(int idx){
+  if(idx + 1 < LATSUBNUM) return idx;
+  int mag = (idx + 1) / LATSUBNUM + LATSUBBITS - 1;
+  int sub = (idx + 1) % LATSUBNUM;
+  return ((uint64_t)(LATSUBNUM + sub) << (mag - LATSUBBITS)) - 1;
+}
+
+
+/* finish a command by flushing the responses of a batch and recording the latency */
+static void donecmd(TTSOCK *sock, TASKARG *arg, TTREQ *req, const CMDMARK *mark){
+  if(req->suspend || req->detach){
+    if(arg->tracer) endtrace(arg, req);
+    if(mark->cap && req->detach) endcap(sock, arg, req, mark);
+    return;
+  }
+  if(sock->rp >= sock->ep && !ttsockflush(sock)) req->keep = false;
+  if(arg->tracer){
+    tttracemark(TTTSSEND);
+    endtrace(arg, req);
+  }
+  if(mark->cap) endcap(sock, arg, req, mark);
+  if(mark->proto >= 0){
+    int id = MTBININ + mark->proto * 2;
+    ttmetricsadd(arg->metrics, req->idx, id, sock->rsum - (sock->ep - sock->rp) - mark->rbase);
+    ttmetricsadd(arg->metrics, req->idx, id + 1, sock->ssum + sock->wnum - mark->sbase);
+  }
+  LATHIST *lat = arg->lats + req->idx;
+  if(lat->seq < 0) return;
+  double etime = tctime();
+  double send = sock->wtime - mark->wtime;
+  uint64_t (*buckets)[LATBKTNUM] = lat->buckets[lat->seq];
+  buckets[LATPHQUEUE][latbucket(mark->stime - req->rtime)]++;
+  buckets[LATPHEXEC][latbucket(etime - mark->stime - send)]++;
+  buckets[LATPHSEND][latbucket(send)]++;
+  SLOWLOG *slow = arg->slow;
+  if(slow && etime - req->rtime >= slow->ths[lat->seq])
+    pushslow(slow, lat->seq, mark, mark->stime - req->rtime, etime - mark->stime - send, send);
+}
+
+
+/* count a synchronization of the update log in its latency histogram */
+static void countsync(double sec, void *opq){
+  uint64_t *slats = opq;
+  __sync_fetch_and_add(slats + latbucket(sec), 1);
+}
+
+
+/* print percentiles of the latency histograms merged over the threads */
+static void printlats(TASKARG *arg, TCXSTR *xstr, const char *head, int delim, const char *tail){
+  const char *phnames[LATPHNUM] = { "queue", "exec", "send" };
+  int thnum = arg->thnum + ADMTHNUM;
+  for(int i = 0; i < TTSEQCMDNUM; i++){
+    for(int j = 0; j < LATPHNUM; j++){
+      uint64_t buckets[LATBKTNUM];
+      for(int k = 0; k < LATBKTNUM; k++){
+        buckets[k] = 0;
+        for(int t = 0; t < thnum; t++){
+          buckets[k] += arg->lats[t].buckets[i][j][k];
+        }
+      }
+      char name[LINEBUFSIZ];
+      sprintf(name, "lat_%s_%s", g_seqnames[i], phnames[j]);
+      printpcts(xstr, buckets, head, name, delim, tail);
+    }
+  }
+  printpcts(xstr, arg->slats, head, "lat_ulog_sync", delim, tail);
+}
+
+
+/* print percentiles of a latency histogram */
+static void printpcts(TCXSTR *xstr, const uint64_t *buckets, const char *head, const char *name,
+                      int delim, const char *tail){
   uint64_t sum = 0;
-  for(int i = 0; i < thnum; i++){
-    sum += counts[TTSEQNUM*i+seq];
+  for(int i = 0; i < LATBKTNUM; i++){
+    sum += buckets[i];
+  }
+  if(sum < 1) return;
+  double ratios[] = { 0.5, 0.9, 0.99, 0.999, 1.0 };
+  uint64_t usecs[sizeof(ratios)/sizeof(*ratios)];
+  uint64_t cnt = 0;
+  int rnum = sizeof(ratios) / sizeof(*ratios);
+  int ridx = 0;
+  for(int i = 0; i < LATBKTNUM && ridx < rnum; i++){
+    cnt += buckets[i];
+    while(ridx < rnum && cnt >= ratios[ridx] * sum && cnt > 0){
+      usecs[ridx++] = latbound(i);
+    }
   }
-  return sum;
+  tcxstrprintf(xstr, "%s%s%ccount=%llu,p50=%llu,p90=%llu,p99=%llu,p999=%llu,max=%llu%s",
+               head, name, delim, (unsigned long long)sum,
+               (unsigned long long)usecs[0], (unsigned long long)usecs[1],
+               (unsigned long long)usecs[2], (unsigned long long)usecs[3],
+               (unsigned long long)usecs[4], tail);
 }
 
 
-/* handle the put command */
-static void do_put(TTSOCK *sock, TASKARG *arg, TTREQ *req){
-  ttservlog(g_serv, TTLOGDEBUG, "doing put command");
-  arg->counts[TTSEQNUM*req->idx+TTSEQPUT]++;
-  uint64_t mask = arg->mask;
-  TCADB *adb = arg->adb;
-  TCULOG *ulog = arg->ulog;
-  uint32_t sid = arg->sid;
-  int ksiz = ttsockgetint32(sock);
-  int vsiz = ttsockgetint32(sock);
-  if(ttsockcheckend(sock) || ksiz < 0 || ksiz > MAXARGSIZ || vsiz < 0 || vsiz > MAXARGSIZ){
-    ttservlog(g_serv, TTLOGINFO, "do_put: invalid parameters");
-    return;
+/* create a slow request log object */
+static SLOWLOG *slownew(void){
+  SLOWLOG *slow = tcmalloc(sizeof(*slow));
+  for(int i = 0; i < TTSEQCMDNUM; i++){
+    slow->ths[i] = SLOWDEFTH / 1000.0;
+  }
+  slow->ents = tcmalloc(sizeof(*slow->ents) * SLOWRINGNUM);
+  for(int i = 0; i < SLOWRINGNUM; i++){
+    slow->ents[i].seq = i;
+  }
+  slow->head = 0;
+  slow->tail = 0;
+  slow->drops = 0;
+  slow->fd = -1;
+  slow->recs = tclistnew2(SLOWRECNUM);
+  if(pthread_mutex_init(&slow->mtx, NULL) != 0)
+    ttservlog(g_serv, TTLOGERROR, "pthread_mutex_init failed");
+  return slow;
+}
+
+
+/* delete a slow request log object */
+static void slowdel(SLOWLOG *slow){
+  pthread_mutex_destroy(&slow->mtx);
+  tclistdel(slow->recs);
+  tcfree(slow->ents);
+  tcfree(slow);
+}
+
+
+/* set the threshold of a command of a slow request log object */
+static bool setslowth(SLOWLOG *slow, const char *name, double msec){
+  double th = msec >= 0 ? msec / 1000.0 : INT_MAX;
+  if(!tcstricmp(name, "all")){
+    for(int i = 0; i < TTSEQCMDNUM; i++){
+      slow->ths[i] = th;
+    }
+    return true;
   }
-  int rsiz = ksiz + vsiz;
-  char stack[TTIOBUFSIZ];
-  char *buf = (rsiz < TTIOBUFSIZ) ? stack : tcmalloc(rsiz + 1);
-  pthread_cleanup_push(free, (buf == stack) ? NULL : buf);
-  if(ttsockrecv(sock, buf, rsiz) && !ttsockcheckend(sock)){
-    uint8_t code = 0;
-    if(mask & ((1ULL << TTSEQPUT) | (1ULL << TTSEQALLORG) | (1ULL << TTSEQALLWRITE))){
-      code = 1;
-      ttservlog(g_serv, TTLOGINFO, "do_put: forbidden");
-    } else if(!tculogadbput(ulog, sid, 0, adb, buf, ksiz, buf + ksiz, vsiz)){
-      arg->counts[TTSEQNUM*req->idx+TTSEQPUTMISS]++;
-      code = 1;
-      ttservlog(g_serv, TTLOGERROR, "do_put: operation failed");
+  for(int i = 0; i < TTSEQCMDNUM; i++){
+    if(!tcstricmp(name, g_seqnames[i])){
+      slow->ths[i] = th;
+      return true;
     }
-    if(ttsocksend(sock, &code, sizeof(code))){
-      req->keep = true;
+  }
+  return false;
+}
+
+
+/* push a slow request into the ring of a slow request log object */
+static void pushslow(SLOWLOG *slow, int seq, const CMDMARK *mark,
+                     double qtime, double etime, double stime){
+  uint64_t pos = slow->head;
+  SLOWENT *ent;
+  while(true){
+    ent = slow->ents + (pos & (SLOWRINGNUM - 1));
+    int64_t diff = (int64_t)(ent->seq - pos);
+    if(diff == 0){
+      if(__sync_bool_compare_and_swap(&slow->head, pos, pos + 1)) break;
+      pos = slow->head;
+    } else if(diff < 0){
+      __sync_add_and_fetch(&slow->drops, 1);
+      return;
     } else {
-      ttservlog(g_serv, TTLOGINFO, "do_put: response failed");
+      pos = slow->head;
     }
-  } else {
-    ttservlog(g_serv, TTLOGINFO, "do_put: invalid entity");
   }
-  pthread_cleanup_pop(1);
+  ent->time = tctime();
+  ent->cmd = seq;
+  ent->proto = mark->proto;
+  slowkey(mark, ent);
+  ent->qtime = qtime;
+  ent->etime = etime;
+  ent->stime = stime;
+  __sync_synchronize();
+  ent->seq = pos + 1;
 }
 
 
-/* handle the putkeep command */
-static void do_putkeep(TTSOCK *sock, TASKARG *arg, TTREQ *req){
-  ttservlog(g_serv, TTLOGDEBUG, "doing putkeep command");
-  arg->counts[TTSEQNUM*req->idx+TTSEQPUTKEEP]++;
-  uint64_t mask = arg->mask;
-  TCADB *adb = arg->adb;
-  TCULOG *ulog = arg->ulog;
-  uint32_t sid = arg->sid;
+/* get a 32-bit integer in the head of a request */
+static int32_t slowheadint(const CMDMARK *mark, int off){
+  if(off + sizeof(uint32_t) > mark->hsiz) return -1;
+  uint32_t num;
+  memcpy(&num, mark->head + off, sizeof(num));
+  return TTNTOHL(num);
+}
+
+
+/* extract the key prefix and the sizes from the head of a request */
+static void slowkey(const CMDMARK *mark, SLOWENT *ent){
+  const char *head = mark->head;
+  int hsiz = mark->hsiz;
+  ent->kpsiz = 0;
+  ent->ksiz = -1;
+  ent->vsiz = -1;
+  int koff = -1;
+  if(mark->proto == PROTOBIN){
+    if(hsiz < 2) return;
+    switch(*(unsigned char *)(head + 1)){
+      case TTCMDPUT:
+      case TTCMDPUTKEEP:
+      case TTCMDPUTCAT:
+      case TTCMDPUTNR:
+        ent->ksiz = slowheadint(mark, 2);
+        ent->vsiz = slowheadint(mark, 6);
+        koff = 10;
+        break;
+      case TTCMDPUTSHL:
+        ent->ksiz = slowheadint(mark, 2);
+        ent->vsiz = slowheadint(mark, 6);
+        koff = 14;
+        break;
+      case TTCMDOUT:
+      case TTCMDGET:
+      case TTCMDVSIZ:
+        ent->ksiz = slowheadint(mark, 2);
+        koff = 6;
+        break;
+      case TTCMDADDINT:
+        ent->ksiz = slowheadint(mark, 2);
+        koff = 10;
+        break;
+      case TTCMDCURJUMP:
+        ent->ksiz = slowheadint(mark, 6);
+        koff = 10;
+        break;
+      case TTCMDADDDOUBLE:
+        ent->ksiz = slowheadint(mark, 2);
+        koff = 22;
+        break;
+      case TTCMDMGET:
+      case TTCMDMOUT:
+        ent->ksiz = slowheadint(mark, 6);
+        koff = 10;
+        break;
+      case TTCMDMPUT:
+        ent->ksiz = slowheadint(mark, 6);
+        ent->vsiz = slowheadint(mark, 10);
+        koff = 14;
+        break;
+      case TTCMDFWMKEYS:
+        ent->ksiz = slowheadint(mark, 2);
+        koff = 10;
+        break;
+      case TTCMDEXT:
+        ent->ksiz = slowheadint(mark, 10);
+        ent->vsiz = slowheadint(mark, 14);
+        koff = slowheadint(mark, 2);
+        koff = (koff >= 0 && koff < hsiz) ? koff + 18 : -1;
+        break;
+      case TTCMDMISC:
+        ent->ksiz = slowheadint(mark, 2);
+        koff = 14;
+        break;
+    }
+  } else if(mark->proto >= 0){
+    const char *ep = head + hsiz;
+    const char *rp = memchr(head, ' ', hsiz);
+    if(!rp) return;
+    while(rp < ep && *rp == ' '){
+      rp++;
+    }
+    if(mark->proto == PROTOHTTP && rp < ep && *rp == '/') rp++;
+    const char *pv = rp;
+    while(pv < ep && *pv != ' ' && *pv != '\r' && *pv != '\n'){
+      pv++;
+    }
+    ent->ksiz = pv - rp;
+    koff = rp - head;
+    if(mark->proto == PROTOMC && pv < ep && *pv == ' ' &&
+       (tcstrfwm(head, "set ") || tcstrfwm(head, "add ") || tcstrfwm(head, "replace ") ||
+        tcstrfwm(head, "append ") || tcstrfwm(head, "prepend "))){
+      int fnum = 0;
+      while(pv < ep && *pv != '\r' && *pv != '\n'){
+        if(*pv == ' ' && pv + 1 < ep && pv[1] != ' ' && ++fnum == 3){
+          ent->vsiz = tcatoi(pv + 1);
+          break;
+        }
+        pv++;
+      }
+    }
+  }
+  if(koff < 0 || koff >= hsiz || ent->ksiz < 0) return;
+  int psiz = tclmin(tclmin(ent->ksiz, hsiz - koff), SLOWKEYSIZ);
+  memcpy(ent->kbuf, head + koff, psiz);
+  ent->kpsiz = psiz;
+}
+
+
+/* drain the slow requests into the log file */
+static void do_slowlog(void *opq){
+  SLOWLOG *slow = (SLOWLOG *)opq;
+  const char *pnames[] = { "bin", "mc", "http" };
+  uint64_t drops = __sync_lock_test_and_set(&slow->drops, 0);
+  if(drops > 0) ttservlog(g_serv, TTLOGINFO, "%llu slow requests dropped",
+                          (unsigned long long)drops);
+  while(true){
+    SLOWENT *ent = slow->ents + (slow->tail & (SLOWRINGNUM - 1));
+    if(ent->seq != slow->tail + 1) break;
+    __sync_synchronize();
+    char date[48];
+    tcdatestrwww((int64_t)ent->time, INT_MAX, date);
+    char kbuf[SLOWKEYSIZ*3+1];
+    char *wp = kbuf;
+    for(int i = 0; i < ent->kpsiz; i++){
+      int c = ((unsigned char *)ent->kbuf)[i];
+      if(c > ' ' && c < 0x7f && c != '%'){
+        *(wp++) = c;
+      } else {
+        wp += sprintf(wp, "%%%02X", c);
+      }
+    }
+    *wp = '\0';
+    char line[LINEBUFSIZ];
+    int len = sprintf(line, "%s\t%s\t%s\t%s\t%d\t%d\t%.3f\t%.3f\t%.3f\t%.3f\n",
+                      date, g_seqnames[ent->cmd], ent->proto >= 0 ? pnames[ent->proto] : "-",
+                      kbuf, ent->ksiz, ent->vsiz, ent->qtime * 1000, ent->etime * 1000,
+                      ent->stime * 1000, (ent->qtime + ent->etime + ent->stime) * 1000);
+    __sync_synchronize();
+    ent->seq = slow->tail + SLOWRINGNUM;
+    slow->tail++;
+    if(slow->fd != -1 && !tcwrite(slow->fd, line, len))
+      ttservlog(g_serv, TTLOGERROR, "do_slowlog: tcwrite failed");
+    if(pthread_mutex_lock(&slow->mtx) == 0){
+      tclistpush(slow->recs, line, len - 1);
+      if(tclistnum(slow->recs) > SLOWRECNUM) tcfree(tclistshift2(slow->recs));
+      pthread_mutex_unlock(&slow->mtx);
+    }
+  }
+}
+
+
+/* handle the misc functions of the slow request log */
+static TCLIST *miscslow(TASKARG *arg, const char *name, const TCLIST *args){
+  SLOWLOG *slow = arg->slow;
+  if(!slow) return NULL;
+  TCLIST *res = NULL;
+  if(!strcmp(name, "slowlog")){
+    int max = tclistnum(args) > 0 ? tcatoi(tclistval2(args, 0)) : 0;
+    if(pthread_mutex_lock(&slow->mtx) != 0) return NULL;
+    int num = tclistnum(slow->recs);
+    int start = (max > 0 && max < num) ? num - max : 0;
+    res = tclistnew2(num - start);
+    for(int i = start; i < num; i++){
+      int rsiz;
+      const char *rbuf = tclistval(slow->recs, i, &rsiz);
+      tclistpush(res, rbuf, rsiz);
+    }
+    pthread_mutex_unlock(&slow->mtx);
+  } else if(!strcmp(name, "slowth")){
+    for(int i = 0; i < tclistnum(args) - 1; i += 2){
+      if(!setslowth(slow, tclistval2(args, i), tcatof(tclistval2(args, i + 1)))) return NULL;
+    }
+    res = tclistnew2(TTSEQCMDNUM);
+    for(int i = 0; i < TTSEQCMDNUM; i++){
+      double th = slow->ths[i];
+      if(th >= INT_MAX){
+        tclistprintf(res, "%s\t-1", g_seqnames[i]);
+      } else {
+        tclistprintf(res, "%s\t%.3f", g_seqnames[i], th * 1000);
+      }
+    }
+  }
+  return res;
+}
+
+
+/* begin tracing the current command of a thread if it is sampled */
+static void begintrace(TASKARG *arg, TTREQ *req, bool force){
+  TRACESTATE *trace = arg->traces + req->idx;
+  if(!force){
+    if(arg->trrate < 1 || ++trace->cnt < arg->trrate) return;
+    trace->cnt = 0;
+  }
+  tttracebegin(&trace->span, force ? TTTFFORCED : 0, req->rtime, req->ptime);
+}
+
+
+/* end tracing the current command of a thread */
+static void endtrace(TASKARG *arg, TTREQ *req){
+  int seq = arg->lats[req->idx].seq;
+  tttraceend(arg->tracer, seq >= 0 ? g_seqnames[seq] : "unknown");
+}
+
+
+/* begin capturing the request of the current command */
+static void begincap(TTSOCK *sock, CMDMARK *mark){
+  mark->cap = tcxstrnew3(SLOWHEADSIZ + CAPHEADSIZ);
+  char head[CAPHEADSIZ];
+  memset(head, 0, sizeof(head));
+  tcxstrcat(mark->cap, head, sizeof(head));
+  ttsocksetrec(sock, mark->cap);
+}
+
+
+/* finish capturing the request of the current command and write it into the capture log */
+static void endcap(TTSOCK *sock, TASKARG *arg, TTREQ *req, const CMDMARK *mark){
+  ttsocksetrec(sock, NULL);
+  TCXSTR *xstr = mark->cap;
+  int size = tcxstrsize(xstr);
+  if(!req->detach && mark->proto >= 0 && size > CAPHEADSIZ){
+    char *buf = (char *)tcxstrptr(xstr);
+    double etime = tctime();
+    uint32_t num = TTHTONL(sock->id);
+    memcpy(buf, &num, sizeof(num));
+    num = TTHTONL((uint32_t)tclmin((etime - req->rtime) * 1000000, UINT32_MAX));
+    memcpy(buf + sizeof(num), &num, sizeof(num));
+    if(!tculogwrite(arg->cap, (uint64_t)(req->rtime * 1000000), arg->sid, mark->proto,
+                    buf, size))
+      ttservlog(g_serv, TTLOGERROR, "tculogwrite failed");
+  }
+  tcxstrdel(xstr);
+}
+
+
+/* handle the put command */
+static void do_put(TTSOCK *sock, TASKARG *arg, TTREQ *req){
+  ttservlog(g_serv, TTLOGDEBUG, "doing put command");
+  countcmd(arg, req, TTSEQPUT);
+  uint64_t mask = arg->mask;
+  TCADB *adb = arg->adb;
+  TCULOG *ulog = arg->ulog;
+  uint32_t sid = arg->sid;
+  int ksiz = ttsockgetint32(sock);
+  int vsiz = ttsockgetint32(sock);
+  if(ttsockcheckend(sock) || ksiz < 0 || ksiz > MAXARGSIZ || vsiz < 0 || vsiz > MAXARGSIZ){
+    ttservlog(g_serv, TTLOGINFO, "do_put: invalid parameters");
+    return;
+  }
+  int rsiz = ksiz + vsiz;
+  char stack[TTIOBUFSIZ];
+  char *buf = (rsiz < TTIOBUFSIZ) ? stack : tcmalloc(rsiz + 1);
+  pthread_cleanup_push(free, (buf == stack) ? NULL : buf);
+  if(ttsockrecv(sock, buf, rsiz) && !ttsockcheckend(sock)){
+    uint8_t code = 0;
+    if(mask & ((1ULL << TTSEQPUT) | (1ULL << TTSEQALLORG) | (1ULL << TTSEQALLWRITE))){
+      code = 1;
+      ttservlog(g_serv, TTLOGINFO, "do_put: forbidden");
+    } else if(!tculogadbput(ulog, sid, 0, adb, buf, ksiz, buf + ksiz, vsiz)){
+      ttmetricsadd(arg->metrics, req->idx, TTSEQPUTMISS, 1);
+      code = 1;
+      ttservlog(g_serv, TTLOGERROR, "do_put: operation failed");
+    }
+    if(ttsocksend(sock, &code, sizeof(code))){
+      req->keep = true;
+    } else {
+      ttservlog(g_serv, TTLOGINFO, "do_put: response failed");
+    }
+  } else {
+    ttservlog(g_serv, TTLOGINFO, "do_put: invalid entity");
+  }
+  pthread_cleanup_pop(1);
+}
+
+
+/* handle the putkeep command */
+static void do_putkeep(TTSOCK *sock, TASKARG *arg, TTREQ *req){
+  ttservlog(g_serv, TTLOGDEBUG, "doing putkeep command");
+  countcmd(arg, req, TTSEQPUTKEEP);
+  uint64_t mask = arg->mask;
+  TCADB *adb = arg->adb;
+  TCULOG *ulog = arg->ulog;
+  uint32_t sid = arg->sid;
   int ksiz = ttsockgetint32(sock);
   int vsiz = ttsockgetint32(sock);
   if(ttsockcheckend(sock) || ksiz < 0 || ksiz > MAXARGSIZ || vsiz < 0 || vsiz > MAXARGSIZ){
@@ -1182,7 +2654,7 @@ static void do_putkeep(TTSOCK *sock, TASKARG *arg, TTREQ *req){
       code = 1;
       ttservlog(g_serv, TTLOGINFO, "do_putkeep: forbidden");
     } else if(!tculogadbputkeep(ulog, sid, 0, adb, buf, ksiz, buf + ksiz, vsiz)){
-      arg->counts[TTSEQNUM*req->idx+TTSEQPUTMISS]++;
+      ttmetricsadd(arg->metrics, req->idx, TTSEQPUTMISS, 1);
       code = 1;
     }
     if(ttsocksend(sock, &code, sizeof(code))){
@@ -1200,7 +2672,7 @@ static void do_putkeep(TTSOCK *sock, TASKARG *arg, TTREQ *req){
 /* handle the putcat command */
 static void do_putcat(TTSOCK *sock, TASKARG *arg, TTREQ *req){
   ttservlog(g_serv, TTLOGDEBUG, "doing putcat command");
-  arg->counts[TTSEQNUM*req->idx+TTSEQPUTCAT]++;
+  countcmd(arg, req, TTSEQPUTCAT);
   uint64_t mask = arg->mask;
   TCADB *adb = arg->adb;
   TCULOG *ulog = arg->ulog;
@@ -1221,7 +2693,7 @@ static void do_putcat(TTSOCK *sock, TASKARG *arg, TTREQ *req){
       code = 1;
       ttservlog(g_serv, TTLOGINFO, "do_putcat: forbidden");
     } else if(!tculogadbputcat(ulog, sid, 0, adb, buf, ksiz, buf + ksiz, vsiz)){
-      arg->counts[TTSEQNUM*req->idx+TTSEQPUTMISS]++;
+      ttmetricsadd(arg->metrics, req->idx, TTSEQPUTMISS, 1);
       code = 1;
       ttservlog(g_serv, TTLOGERROR, "do_putcat: operation failed");
     }
@@ -1240,7 +2712,7 @@ static void do_putcat(TTSOCK *sock, TASKARG *arg, TTREQ *req){
 /* handle the putshl command */
 static void do_putshl(TTSOCK *sock, TASKARG *arg, TTREQ *req){
   ttservlog(g_serv, TTLOGDEBUG, "doing putshl command");
-  arg->counts[TTSEQNUM*req->idx+TTSEQPUTSHL]++;
+  countcmd(arg, req, TTSEQPUTSHL);
   uint64_t mask = arg->mask;
   TCADB *adb = arg->adb;
   TCULOG *ulog = arg->ulog;
@@ -1263,7 +2735,7 @@ static void do_putshl(TTSOCK *sock, TASKARG *arg, TTREQ *req){
       code = 1;
       ttservlog(g_serv, TTLOGINFO, "do_putshl: forbidden");
     } else if(!tculogadbputshl(ulog, sid, 0, adb, buf, ksiz, buf + ksiz, vsiz, width)){
-      arg->counts[TTSEQNUM*req->idx+TTSEQPUTMISS]++;
+      ttmetricsadd(arg->metrics, req->idx, TTSEQPUTMISS, 1);
       code = 1;
       ttservlog(g_serv, TTLOGERROR, "do_putshl: operation failed");
     }
@@ -1282,7 +2754,7 @@ static void do_putshl(TTSOCK *sock, TASKARG *arg, TTREQ *req){
 /* handle the putnr command */
 static void do_putnr(TTSOCK *sock, TASKARG *arg, TTREQ *req){
   ttservlog(g_serv, TTLOGDEBUG, "doing putnr command");
-  arg->counts[TTSEQNUM*req->idx+TTSEQPUTNR]++;
+  countcmd(arg, req, TTSEQPUTNR);
   uint64_t mask = arg->mask;
   TCADB *adb = arg->adb;
   TCULOG *ulog = arg->ulog;
@@ -1303,7 +2775,7 @@ static void do_putnr(TTSOCK *sock, TASKARG *arg, TTREQ *req){
       code = 1;
       ttservlog(g_serv, TTLOGINFO, "do_putnr: forbidden");
     } else if(!tculogadbput(ulog, sid, 0, adb, buf, ksiz, buf + ksiz, vsiz)){
-      arg->counts[TTSEQNUM*req->idx+TTSEQPUTMISS]++;
+      ttmetricsadd(arg->metrics, req->idx, TTSEQPUTMISS, 1);
       code = 1;
       ttservlog(g_serv, TTLOGERROR, "do_putnr: operation failed");
     }
@@ -1318,7 +2790,7 @@ static void do_putnr(TTSOCK *sock, TASKARG *arg, TTREQ *req){
 /* handle the out command */
 static void do_out(TTSOCK *sock, TASKARG *arg, TTREQ *req){
   ttservlog(g_serv, TTLOGDEBUG, "doing out command");
-  arg->counts[TTSEQNUM*req->idx+TTSEQOUT]++;
+  countcmd(arg, req, TTSEQOUT);
   uint64_t mask = arg->mask;
   TCADB *adb = arg->adb;
   TCULOG *ulog = arg->ulog;
@@ -1337,7 +2809,7 @@ static void do_out(TTSOCK *sock, TASKARG *arg, TTREQ *req){
       code = 1;
       ttservlog(g_serv, TTLOGINFO, "do_out: forbidden");
     } else if(!tculogadbout(ulog, sid, 0, adb, buf, ksiz)){
-      arg->counts[TTSEQNUM*req->idx+TTSEQOUTMISS]++;
+      ttmetricsadd(arg->metrics, req->idx, TTSEQOUTMISS, 1);
       code = 1;
     }
     if(ttsocksend(sock, &code, sizeof(code))){
@@ -1355,7 +2827,7 @@ static void do_out(TTSOCK *sock, TASKARG *arg, TTREQ *req){
 /* handle the get command */
 static void do_get(TTSOCK *sock, TASKARG *arg, TTREQ *req){
   ttservlog(g_serv, TTLOGDEBUG, "doing get command");
-  arg->counts[TTSEQNUM*req->idx+TTSEQGET]++;
+  countcmd(arg, req, TTSEQGET);
   uint64_t mask = arg->mask;
   TCADB *adb = arg->adb;
   int ksiz = ttsockgetint32(sock);
@@ -1374,7 +2846,9 @@ static void do_get(TTSOCK *sock, TASKARG *arg, TTREQ *req){
       vsiz = 0;
       ttservlog(g_serv, TTLOGINFO, "do_get: forbidden");
     } else {
+      tttracemark(TTTSDBBEGIN);
       vbuf = tcadbget(adb, buf, ksiz, &vsiz);
+      tttracemark(TTTSDBEND);
     }
     if(vbuf){
       int rsiz = vsiz + sizeof(uint8_t) + sizeof(uint32_t);
@@ -1393,7 +2867,7 @@ static void do_get(TTSOCK *sock, TASKARG *arg, TTREQ *req){
       }
       pthread_cleanup_pop(1);
     } else {
-      arg->counts[TTSEQNUM*req->idx+TTSEQGETMISS]++;
+      ttmetricsadd(arg->metrics, req->idx, TTSEQGETMISS, 1);
       uint8_t code = 1;
       if(ttsocksend(sock, &code, sizeof(code))){
         req->keep = true;
@@ -1411,7 +2885,7 @@ static void do_get(TTSOCK *sock, TASKARG *arg, TTREQ *req){
 /* handle the mget command */
 static void do_mget(TTSOCK *sock, TASKARG *arg, TTREQ *req){
   ttservlog(g_serv, TTLOGDEBUG, "doing mget command");
-  arg->counts[TTSEQNUM*req->idx+TTSEQMGET]++;
+  countcmd(arg, req, TTSEQMGET);
   uint64_t mask = arg->mask;
   TCADB *adb = arg->adb;
   int rnum = ttsockgetint32(sock);
@@ -1441,6 +2915,7 @@ static void do_mget(TTSOCK *sock, TASKARG *arg, TTREQ *req){
     if(mask & ((1ULL << TTSEQMGET) | (1ULL << TTSEQALLORG) | (1ULL << TTSEQALLREAD))){
       ttservlog(g_serv, TTLOGINFO, "do_mget: forbidden");
     } else {
+      tttracemark(TTTSDBBEGIN);
       for(int i = 0; i < tclistnum(keys); i++){
         int ksiz;
         const char *kbuf = tclistval(keys, i, &ksiz);
@@ -1457,6 +2932,7 @@ static void do_mget(TTSOCK *sock, TASKARG *arg, TTREQ *req){
           rnum++;
         }
       }
+      tttracemark(TTTSDBEND);
     }
     num = TTHTONL((uint32_t)rnum);
     memcpy((char *)tcxstrptr(xstr) + sizeof(code), &num, sizeof(num));
@@ -1476,7 +2952,7 @@ static void do_mget(TTSOCK *sock, TASKARG *arg, TTREQ *req){
 /* handle the vsiz command */
 static void do_vsiz(TTSOCK *sock, TASKARG *arg, TTREQ *req){
   ttservlog(g_serv, TTLOGDEBUG, "doing vsiz command");
-  arg->counts[TTSEQNUM*req->idx+TTSEQVSIZ]++;
+  countcmd(arg, req, TTSEQVSIZ);
   uint64_t mask = arg->mask;
   TCADB *adb = arg->adb;
   int ksiz = ttsockgetint32(sock);
@@ -1493,7 +2969,9 @@ static void do_vsiz(TTSOCK *sock, TASKARG *arg, TTREQ *req){
       vsiz = -1;
       ttservlog(g_serv, TTLOGINFO, "do_vsiz: forbidden");
     } else {
+      tttracemark(TTTSDBBEGIN);
       vsiz = tcadbvsiz(adb, buf, ksiz);
+      tttracemark(TTTSDBEND);
     }
     if(vsiz >= 0){
       *stack = 0;
@@ -1523,16 +3001,25 @@ static void do_vsiz(TTSOCK *sock, TASKARG *arg, TTREQ *req){
 /* handle the iterinit command */
 static void do_iterinit(TTSOCK *sock, TASKARG *arg, TTREQ *req){
   ttservlog(g_serv, TTLOGDEBUG, "doing iterinit command");
-  arg->counts[TTSEQNUM*req->idx+TTSEQITERINIT]++;
+  countcmd(arg, req, TTSEQITERINIT);
   uint64_t mask = arg->mask;
   TCADB *adb = arg->adb;
   uint8_t code = 0;
   if(mask & ((1ULL << TTSEQITERINIT) | (1ULL << TTSEQALLORG) | (1ULL << TTSEQALLREAD))){
     code = 1;
     ttservlog(g_serv, TTLOGINFO, "do_iterinit: forbidden");
-  } else if(!tcadbiterinit(adb)){
+  } else if(pthread_mutex_lock(&arg->itmtx) != 0){
     code = 1;
-    ttservlog(g_serv, TTLOGERROR, "do_iterinit: operation failed");
+    ttservlog(g_serv, TTLOGERROR, "do_iterinit: pthread_mutex_lock failed");
+  } else {
+    if(!tcadbiterinit(adb)){
+      code = 1;
+      ttservlog(g_serv, TTLOGERROR, "do_iterinit: operation failed");
+    }
+    tclistclear(arg->itkeys);
+    arg->itpark = false;
+    if(pthread_mutex_unlock(&arg->itmtx) != 0)
+      ttservlog(g_serv, TTLOGERROR, "do_iterinit: pthread_mutex_unlock failed");
   }
   if(ttsocksend(sock, &code, sizeof(code))){
     req->keep = true;
@@ -1545,7 +3032,7 @@ static void do_iterinit(TTSOCK *sock, TASKARG *arg, TTREQ *req){
 /* handle the iternext command */
 static void do_iternext(TTSOCK *sock, TASKARG *arg, TTREQ *req){
   ttservlog(g_serv, TTLOGDEBUG, "doing iternext command");
-  arg->counts[TTSEQNUM*req->idx+TTSEQITERNEXT]++;
+  countcmd(arg, req, TTSEQITERNEXT);
   uint64_t mask = arg->mask;
   TCADB *adb = arg->adb;
   int vsiz;
@@ -1554,8 +3041,20 @@ static void do_iternext(TTSOCK *sock, TASKARG *arg, TTREQ *req){
     vbuf = NULL;
     vsiz = 0;
     ttservlog(g_serv, TTLOGINFO, "do_iternext: forbidden");
+  } else if(pthread_mutex_lock(&arg->itmtx) != 0){
+    vbuf = NULL;
+    vsiz = 0;
+    ttservlog(g_serv, TTLOGERROR, "do_iternext: pthread_mutex_lock failed");
   } else {
-    vbuf = tcadbiternext(adb, &vsiz);
+    if(arg->itpark && !seekitkeys(adb, arg->itkeys)){
+      vbuf = NULL;
+      vsiz = 0;
+    } else {
+      arg->itpark = false;
+      vbuf = tcadbiternext(adb, &vsiz);
+    }
+    if(pthread_mutex_unlock(&arg->itmtx) != 0)
+      ttservlog(g_serv, TTLOGERROR, "do_iternext: pthread_mutex_unlock failed");
   }
   if(vbuf){
     int rsiz = vsiz + sizeof(uint8_t) + sizeof(uint32_t);
@@ -1585,10 +3084,325 @@ static void do_iternext(TTSOCK *sock, TASKARG *arg, TTREQ *req){
 }
 
 
+/* handle the curnew command */
+static void do_curnew(TTSOCK *sock, TASKARG *arg, TTREQ *req){
+  ttservlog(g_serv, TTLOGDEBUG, "doing curnew command");
+  countcmd(arg, req, TTSEQCURNEW);
+  uint64_t mask = arg->mask;
+  TCADB *adb = arg->adb;
+  int id = 0;
+  if(mask & ((1ULL << TTSEQCURNEW) | (1ULL << TTSEQALLORG) | (1ULL << TTSEQALLREAD))){
+    ttservlog(g_serv, TTLOGINFO, "do_curnew: forbidden");
+  } else {
+    CONNSTATE *cst = sock->opq;
+    if(!cst){
+      cst = tcmalloc(sizeof(*cst));
+      memset(cst, 0, sizeof(*cst));
+      sock->opq = cst;
+    }
+    CONNCUR *cur = NULL;
+    for(int i = 0; i < CURMAX; i++){
+      if(cst->curs[i].id < 1){
+        cur = cst->curs + i;
+        break;
+      }
+    }
+    if(cur){
+      if(tcadbomode(adb) == ADBOBDB){
+        cur->bcur = tcbdbcurnew(tcadbreveal(adb));
+        cur->keys = NULL;
+        tcbdbcurfirst(cur->bcur);
+      } else {
+        cur->bcur = NULL;
+        cur->keys = tclistnew2(CURLOOKNUM);
+      }
+      cur->pos = CURPFIRST;
+      if(cst->curid >= INT_MAX) cst->curid = 0;
+      cur->id = ++cst->curid;
+      id = cur->id;
+    } else {
+      ttservlog(g_serv, TTLOGINFO, "do_curnew: too many cursors");
+    }
+  }
+  char rbuf[sizeof(uint8_t)+sizeof(uint32_t)];
+  *rbuf = (id > 0) ? 0 : 1;
+  uint32_t num = TTHTONL((uint32_t)id);
+  memcpy(rbuf + sizeof(uint8_t), &num, sizeof(num));
+  if(ttsocksend(sock, rbuf, sizeof(rbuf))){
+    req->keep = true;
+  } else {
+    ttservlog(g_serv, TTLOGINFO, "do_curnew: response failed");
+  }
+}
+
+
+/* handle the curjump command */
+static void do_curjump(TTSOCK *sock, TASKARG *arg, TTREQ *req){
+  ttservlog(g_serv, TTLOGDEBUG, "doing curjump command");
+  countcmd(arg, req, TTSEQCURJUMP);
+  uint64_t mask = arg->mask;
+  int id = ttsockgetint32(sock);
+  int ksiz = ttsockgetint32(sock);
+  if(ttsockcheckend(sock) || ksiz < 0 || ksiz > MAXARGSIZ){
+    ttservlog(g_serv, TTLOGINFO, "do_curjump: invalid parameters");
+    return;
+  }
+  char stack[TTIOBUFSIZ];
+  char *buf = (ksiz < TTIOBUFSIZ) ? stack : tcmalloc(ksiz + 1);
+  pthread_cleanup_push(free, (buf == stack) ? NULL : buf);
+  if(ttsockrecv(sock, buf, ksiz) && !ttsockcheckend(sock)){
+    uint8_t code = 0;
+    CONNCUR *cur;
+    if(mask & ((1ULL << TTSEQCURJUMP) | (1ULL << TTSEQALLORG) | (1ULL << TTSEQALLREAD))){
+      code = 1;
+      ttservlog(g_serv, TTLOGINFO, "do_curjump: forbidden");
+    } else if(!(cur = getcur(sock, id))){
+      code = 1;
+      ttservlog(g_serv, TTLOGINFO, "do_curjump: no such cursor");
+    } else if(cur->bcur){
+      tttracemark(TTTSDBBEGIN);
+      if(!tcbdbcurjump(cur->bcur, buf, ksiz)) code = 1;
+      tttracemark(TTTSDBEND);
+    } else {
+      tclistclear(cur->keys);
+      tclistpush(cur->keys, buf, ksiz);
+      cur->pos = CURPAT;
+    }
+    if(ttsocksend(sock, &code, sizeof(code))){
+      req->keep = true;
+    } else {
+      ttservlog(g_serv, TTLOGINFO, "do_curjump: response failed");
+    }
+  } else {
+    ttservlog(g_serv, TTLOGINFO, "do_curjump: invalid entity");
+  }
+  pthread_cleanup_pop(1);
+}
+
+
+/* handle the curnext command or the curprev command */
+static void do_curmove(TTSOCK *sock, TASKARG *arg, TTREQ *req, bool back){
+  const char *name = back ? "curprev" : "curnext";
+  ttservlog(g_serv, TTLOGDEBUG, "doing %s command", name);
+  int seq = back ? TTSEQCURPREV : TTSEQCURNEXT;
+  countcmd(arg, req, seq);
+  uint64_t mask = arg->mask;
+  TCADB *adb = arg->adb;
+  int id = ttsockgetint32(sock);
+  int max = ttsockgetint32(sock);
+  int bmax = ttsockgetint32(sock);
+  if(ttsockcheckend(sock) || max < 0 || max > MAXARGNUM){
+    ttservlog(g_serv, TTLOGINFO, "do_%s: invalid parameters", name);
+    return;
+  }
+  if(bmax < 1 || bmax > MAXARGSIZ) bmax = MAXARGSIZ;
+  TCXSTR *xstr = tcxstrnew();
+  pthread_cleanup_push((void (*)(void *))tcxstrdel, xstr);
+  uint8_t code = 0;
+  uint32_t num = 0;
+  tcxstrcat(xstr, &code, sizeof(code));
+  tcxstrcat(xstr, &num, sizeof(num));
+  int rnum = 0;
+  CONNCUR *cur;
+  if(mask & ((1ULL << seq) | (1ULL << TTSEQALLORG) | (1ULL << TTSEQALLREAD))){
+    code = 1;
+    ttservlog(g_serv, TTLOGINFO, "do_%s: forbidden", name);
+  } else if(!(cur = getcur(sock, id))){
+    code = 1;
+    ttservlog(g_serv, TTLOGINFO, "do_%s: no such cursor", name);
+  } else if(cur->bcur){
+    TCXSTR *kxstr = tcxstrnew();
+    TCXSTR *vxstr = tcxstrnew();
+    tttracemark(TTTSDBBEGIN);
+    while(rnum < max && tcxstrsize(xstr) < bmax){
+      tcxstrclear(kxstr);
+      tcxstrclear(vxstr);
+      if(!tcbdbcurrec(cur->bcur, kxstr, vxstr)) break;
+      num = TTHTONL((uint32_t)tcxstrsize(kxstr));
+      tcxstrcat(xstr, &num, sizeof(num));
+      num = TTHTONL((uint32_t)tcxstrsize(vxstr));
+      tcxstrcat(xstr, &num, sizeof(num));
+      tcxstrcat(xstr, tcxstrptr(kxstr), tcxstrsize(kxstr));
+      tcxstrcat(xstr, tcxstrptr(vxstr), tcxstrsize(vxstr));
+      rnum++;
+      if(!(back ? tcbdbcurprev(cur->bcur) : tcbdbcurnext(cur->bcur))) break;
+    }
+    tttracemark(TTTSDBEND);
+    tcxstrdel(vxstr);
+    tcxstrdel(kxstr);
+  } else if(back){
+    code = 1;
+    ttservlog(g_serv, TTLOGINFO, "do_%s: not supported by the database", name);
+  } else if(cur->pos != CURPEND && max > 0){
+    if(pthread_mutex_lock(&arg->itmtx) == 0){
+      tttracemark(TTTSDBBEGIN);
+      if(!arg->itpark){
+        readitkeys(adb, arg->itkeys);
+        arg->itpark = true;
+      }
+      if(cur->pos == CURPFIRST){
+        if(!tcadbiterinit(adb)){
+          code = 1;
+          ttservlog(g_serv, TTLOGERROR, "do_%s: operation failed", name);
+        }
+      } else {
+        bool full = tclistnum(cur->keys) >= CURLOOKNUM;
+        if(!seekitkeys(adb, cur->keys)){
+          if(cur->pos == CURPAT || full){
+            code = 1;
+            ttservlog(g_serv, TTLOGINFO, "do_%s: the records of the cursor were removed", name);
+          } else {
+            cur->pos = CURPEND;
+          }
+        }
+      }
+      TCLIST *args = tclistnew2(1);
+      while(code == 0 && cur->pos != CURPEND && rnum < max && tcxstrsize(xstr) < bmax){
+        TCLIST *res = tcadbmisc(adb, "iternext", args);
+        int rn = res ? tclistnum(res) : 0;
+        if(rn < 1){
+          cur->pos = CURPEND;
+        } else {
+          int ksiz;
+          const char *kbuf = tclistval(res, 0, &ksiz);
+          int vsiz = (rn > 2) ? rn - 2 : 0;
+          for(int i = 1; i < rn; i++){
+            vsiz += TCLISTVALSIZ(res, i);
+          }
+          num = TTHTONL((uint32_t)ksiz);
+          tcxstrcat(xstr, &num, sizeof(num));
+          num = TTHTONL((uint32_t)vsiz);
+          tcxstrcat(xstr, &num, sizeof(num));
+          tcxstrcat(xstr, kbuf, ksiz);
+          for(int i = 1; i < rn; i++){
+            if(i > 1) tcxstrcat(xstr, "", 1);
+            int esiz;
+            const char *ebuf = tclistval(res, i, &esiz);
+            tcxstrcat(xstr, ebuf, esiz);
+          }
+          rnum++;
+          cur->pos = CURPAFTER;
+        }
+        if(res) tclistdel(res);
+      }
+      tclistdel(args);
+      if(code == 0 && cur->pos != CURPEND){
+        readitkeys(adb, cur->keys);
+        if(tclistnum(cur->keys) < 1) cur->pos = CURPEND;
+      }
+      tttracemark(TTTSDBEND);
+      if(pthread_mutex_unlock(&arg->itmtx) != 0)
+        ttservlog(g_serv, TTLOGERROR, "do_%s: pthread_mutex_unlock failed", name);
+    } else {
+      code = 1;
+      ttservlog(g_serv, TTLOGERROR, "do_%s: pthread_mutex_lock failed", name);
+    }
+  }
+  if(code != 0){
+    tcxstrclear(xstr);
+    tcxstrcat(xstr, &code, sizeof(code));
+    num = 0;
+    tcxstrcat(xstr, &num, sizeof(num));
+  } else {
+    num = TTHTONL((uint32_t)rnum);
+    memcpy((char *)tcxstrptr(xstr) + sizeof(code), &num, sizeof(num));
+  }
+  if(ttsocksend(sock, tcxstrptr(xstr), tcxstrsize(xstr))){
+    req->keep = true;
+  } else {
+    ttservlog(g_serv, TTLOGINFO, "do_%s: response failed", name);
+  }
+  pthread_cleanup_pop(1);
+}
+
+
+/* handle the curdel command */
+static void do_curdel(TTSOCK *sock, TASKARG *arg, TTREQ *req){
+  ttservlog(g_serv, TTLOGDEBUG, "doing curdel command");
+  countcmd(arg, req, TTSEQCURDEL);
+  int id = ttsockgetint32(sock);
+  if(ttsockcheckend(sock)){
+    ttservlog(g_serv, TTLOGINFO, "do_curdel: invalid parameters");
+    return;
+  }
+  uint8_t code = 0;
+  CONNCUR *cur;
+  if(arg->mask & ((1ULL << TTSEQCURDEL) | (1ULL << TTSEQALLORG) | (1ULL << TTSEQALLREAD))){
+    code = 1;
+    ttservlog(g_serv, TTLOGINFO, "do_curdel: forbidden");
+  } else if((cur = getcur(sock, id)) != NULL){
+    delcur(cur);
+  } else {
+    code = 1;
+    ttservlog(g_serv, TTLOGINFO, "do_curdel: no such cursor");
+  }
+  if(ttsocksend(sock, &code, sizeof(code))){
+    req->keep = true;
+  } else {
+    ttservlog(g_serv, TTLOGINFO, "do_curdel: response failed");
+  }
+}
+
+
+/* get a cursor of a connection */
+static CONNCUR *getcur(TTSOCK *sock, int id){
+  CONNSTATE *cst = sock->opq;
+  if(!cst || id < 1) return NULL;
+  for(int i = 0; i < CURMAX; i++){
+    if(cst->curs[i].id == id) return cst->curs + i;
+  }
+  return NULL;
+}
+
+
+/* delete a cursor of a connection */
+static void delcur(CONNCUR *cur){
+  if(cur->bcur) tcbdbcurdel(cur->bcur);
+  if(cur->keys) tclistdel(cur->keys);
+  cur->bcur = NULL;
+  cur->keys = NULL;
+  cur->id = 0;
+}
+
+
+/* read keys ahead of the iterator of the database as a position */
+static void readitkeys(TCADB *adb, TCLIST *keys){
+  tclistclear(keys);
+  for(int i = 0; i < CURLOOKNUM; i++){
+    int ksiz;
+    char *kbuf = tcadbiternext(adb, &ksiz);
+    if(!kbuf) break;
+    tclistpushmalloc(keys, kbuf, ksiz);
+  }
+}
+
+
+/* move the iterator of the database to the first remaining record of the keys of a position */
+static bool seekitkeys(TCADB *adb, TCLIST *keys){
+  TCLIST *args = tclistnew2(1);
+  bool hit = false;
+  while(!hit && tclistnum(keys) > 0){
+    int ksiz;
+    char *kbuf = tclistshift(keys, &ksiz);
+    tclistpush(args, kbuf, ksiz);
+    TCLIST *res = tcadbmisc(adb, "iterinit", args);
+    if(res){
+      tclistdel(res);
+      hit = true;
+    }
+    tclistclear(args);
+    tcfree(kbuf);
+  }
+  tclistclear(keys);
+  tclistdel(args);
+  return hit;
+}
+
+
 /* handle the fwmkeys command */
 static void do_fwmkeys(TTSOCK *sock, TASKARG *arg, TTREQ *req){
   ttservlog(g_serv, TTLOGDEBUG, "doing fwmkeys command");
-  arg->counts[TTSEQNUM*req->idx+TTSEQFWMKEYS]++;
+  countcmd(arg, req, TTSEQFWMKEYS);
   uint64_t mask = arg->mask;
   TCADB *adb = arg->adb;
   int psiz = ttsockgetint32(sock);
@@ -1641,7 +3455,7 @@ static void do_fwmkeys(TTSOCK *sock, TASKARG *arg, TTREQ *req){
 /* handle the addint command */
 static void do_addint(TTSOCK *sock, TASKARG *arg, TTREQ *req){
   ttservlog(g_serv, TTLOGDEBUG, "doing addint command");
-  arg->counts[TTSEQNUM*req->idx+TTSEQADDINT]++;
+  countcmd(arg, req, TTSEQADDINT);
   uint64_t mask = arg->mask;
   TCADB *adb = arg->adb;
   TCULOG *ulog = arg->ulog;
@@ -1691,7 +3505,7 @@ static void do_addint(TTSOCK *sock, TASKARG *arg, TTREQ *req){
 /* handle the adddouble command */
 static void do_adddouble(TTSOCK *sock, TASKARG *arg, TTREQ *req){
   ttservlog(g_serv, TTLOGDEBUG, "doing adddouble command");
-  arg->counts[TTSEQNUM*req->idx+TTSEQADDDOUBLE]++;
+  countcmd(arg, req, TTSEQADDDOUBLE);
   uint64_t mask = arg->mask;
   TCADB *adb = arg->adb;
   TCULOG *ulog = arg->ulog;
@@ -1742,7 +3556,7 @@ static void do_adddouble(TTSOCK *sock, TASKARG *arg, TTREQ *req){
 /* handle the ext command */
 static void do_ext(TTSOCK *sock, TASKARG *arg, TTREQ *req){
   ttservlog(g_serv, TTLOGDEBUG, "doing ext command");
-  arg->counts[TTSEQNUM*req->idx+TTSEQEXT]++;
+  countcmd(arg, req, TTSEQEXT);
   uint64_t mask = arg->mask;
   pthread_mutex_t *rmtxs = arg->rmtxs;
   void *scr = arg->screxts[req->idx];
@@ -1770,37 +3584,7 @@ static void do_ext(TTSOCK *sock, TASKARG *arg, TTREQ *req){
     if(mask & ((1ULL << TTSEQEXT) | (1ULL << TTSEQALLORG))){
       ttservlog(g_serv, TTLOGINFO, "do_ext: forbidden");
     } else if(scr){
-      if(opts & RDBXOLCKGLB){
-        bool err = false;
-        for(int i = 0; i < RECMTXNUM; i++){
-          if(pthread_mutex_lock(rmtxs + i) != 0){
-            ttservlog(g_serv, TTLOGERROR, "do_ext: pthread_mutex_lock failed");
-            while(--i >= 0){
-              pthread_mutex_unlock(rmtxs + i);
-            }
-            err = true;
-            break;
-          }
-        }
-        if(!err){
-          xbuf = scrextcallmethod(scr, name, kbuf, ksiz, vbuf, vsiz, &xsiz);
-          for(int i = RECMTXNUM - 1; i >= 0; i--){
-            if(pthread_mutex_unlock(rmtxs + i) != 0)
-              ttservlog(g_serv, TTLOGERROR, "do_ext: pthread_mutex_unlock failed");
-          }
-        }
-      } else if(opts & RDBXOLCKREC){
-        int mtxidx = recmtxidx(kbuf, ksiz);
-        if(pthread_mutex_lock(rmtxs + mtxidx) == 0){
-          xbuf = scrextcallmethod(scr, name, kbuf, ksiz, vbuf, vsiz, &xsiz);
-          if(pthread_mutex_unlock(rmtxs + mtxidx) != 0)
-            ttservlog(g_serv, TTLOGERROR, "do_ext: pthread_mutex_unlock failed");
-        } else {
-          ttservlog(g_serv, TTLOGERROR, "do_ext: pthread_mutex_lock failed");
-        }
-      } else {
-        xbuf = scrextcallmethod(scr, name, kbuf, ksiz, vbuf, vsiz, &xsiz);
-      }
+      xbuf = callext(scr, rmtxs, name, opts, kbuf, ksiz, vbuf, vsiz, &xsiz);
     }
     if(xbuf){
       int rsiz = xsiz + sizeof(uint8_t) + sizeof(uint32_t);
@@ -1832,11 +3616,46 @@ static void do_ext(TTSOCK *sock, TASKARG *arg, TTREQ *req){
   pthread_cleanup_pop(1);
 }
 
+/* call a function of the script extension under the record locks of its options */
+static char *callext(void *scr, pthread_mutex_t *rmtxs, const char *name, int opts,
+                     const char *kbuf, int ksiz, const char *vbuf, int vsiz, int *sp){
+  char *xbuf = NULL;
+  if(opts & RDBXOLCKGLB){
+    for(int i = 0; i < RECMTXNUM; i++){
+      if(pthread_mutex_lock(rmtxs + i) != 0){
+        ttservlog(g_serv, TTLOGERROR, "callext: pthread_mutex_lock failed");
+        while(--i >= 0){
+          pthread_mutex_unlock(rmtxs + i);
+        }
+        return NULL;
+      }
+    }
+    xbuf = scrextcallmethod(scr, name, kbuf, ksiz, vbuf, vsiz, sp);
+    for(int i = RECMTXNUM - 1; i >= 0; i--){
+      if(pthread_mutex_unlock(rmtxs + i) != 0)
+        ttservlog(g_serv, TTLOGERROR, "callext: pthread_mutex_unlock failed");
+    }
+  } else if(opts & RDBXOLCKREC){
+    int mtxidx = recmtxidx(kbuf, ksiz);
+    if(pthread_mutex_lock(rmtxs + mtxidx) == 0){
+      xbuf = scrextcallmethod(scr, name, kbuf, ksiz, vbuf, vsiz, sp);
+      if(pthread_mutex_unlock(rmtxs + mtxidx) != 0)
+        ttservlog(g_serv, TTLOGERROR, "callext: pthread_mutex_unlock failed");
+    } else {
+      ttservlog(g_serv, TTLOGERROR, "callext: pthread_mutex_lock failed");
+    }
+  } else {
+    xbuf = scrextcallmethod(scr, name, kbuf, ksiz, vbuf, vsiz, sp);
+  }
+  return xbuf;
+}
+
+
 
 /* handle the sync command */
 static void do_sync(TTSOCK *sock, TASKARG *arg, TTREQ *req){
   ttservlog(g_serv, TTLOGINFO, "doing sync command");
-  arg->counts[TTSEQNUM*req->idx+TTSEQSYNC]++;
+  countcmd(arg, req, TTSEQSYNC);
   uint64_t mask = arg->mask;
   TCADB *adb = arg->adb;
   TCULOG *ulog = arg->ulog;
@@ -1860,7 +3679,7 @@ static void do_sync(TTSOCK *sock, TASKARG *arg, TTREQ *req){
 /* handle the optimize command */
 static void do_optimize(TTSOCK *sock, TASKARG *arg, TTREQ *req){
   ttservlog(g_serv, TTLOGINFO, "doing optimize command");
-  arg->counts[TTSEQNUM*req->idx+TTSEQOPTIMIZE]++;
+  countcmd(arg, req, TTSEQOPTIMIZE);
   uint64_t mask = arg->mask;
   TCADB *adb = arg->adb;
   TCULOG *ulog = arg->ulog;
@@ -1897,7 +3716,7 @@ static void do_optimize(TTSOCK *sock, TASKARG *arg, TTREQ *req){
 /* handle the vanish command */
 static void do_vanish(TTSOCK *sock, TASKARG *arg, TTREQ *req){
   ttservlog(g_serv, TTLOGINFO, "doing vanish command");
-  arg->counts[TTSEQNUM*req->idx+TTSEQVANISH]++;
+  countcmd(arg, req, TTSEQVANISH);
   uint64_t mask = arg->mask;
   TCADB *adb = arg->adb;
   TCULOG *ulog = arg->ulog;
@@ -1921,7 +3740,7 @@ static void do_vanish(TTSOCK *sock, TASKARG *arg, TTREQ *req){
 /* handle the copy command */
 static void do_copy(TTSOCK *sock, TASKARG *arg, TTREQ *req){
   ttservlog(g_serv, TTLOGINFO, "doing copy command");
-  arg->counts[TTSEQNUM*req->idx+TTSEQCOPY]++;
+  countcmd(arg, req, TTSEQCOPY);
   uint64_t mask = arg->mask;
   TCADB *adb = arg->adb;
   int psiz = ttsockgetint32(sock);
@@ -1957,7 +3776,7 @@ static void do_copy(TTSOCK *sock, TASKARG *arg, TTREQ *req){
 /* handle the restore command */
 static void do_restore(TTSOCK *sock, TASKARG *arg, TTREQ *req){
   ttservlog(g_serv, TTLOGINFO, "doing restore command");
-  arg->counts[TTSEQNUM*req->idx+TTSEQRESTORE]++;
+  countcmd(arg, req, TTSEQRESTORE);
   uint64_t mask = arg->mask;
   TCADB *adb = arg->adb;
   TCULOG *ulog = arg->ulog;
@@ -1997,7 +3816,7 @@ static void do_restore(TTSOCK *sock, TASKARG *arg, TTREQ *req){
 /* handle the setmst command */
 static void do_setmst(TTSOCK *sock, TASKARG *arg, TTREQ *req){
   ttservlog(g_serv, TTLOGINFO, "doing setmst command");
-  arg->counts[TTSEQNUM*req->idx+TTSEQSETMST]++;
+  countcmd(arg, req, TTSEQSETMST);
   uint64_t mask = arg->mask;
   REPLARG *sarg = arg->sarg;
   int hsiz = ttsockgetint32(sock);
@@ -2040,7 +3859,7 @@ static void do_setmst(TTSOCK *sock, TASKARG *arg, TTREQ *req){
 /* handle the rnum command */
 static void do_rnum(TTSOCK *sock, TASKARG *arg, TTREQ *req){
   ttservlog(g_serv, TTLOGDEBUG, "doing rnum command");
-  arg->counts[TTSEQNUM*req->idx+TTSEQRNUM]++;
+  countcmd(arg, req, TTSEQRNUM);
   uint64_t mask = arg->mask;
   TCADB *adb = arg->adb;
   char buf[LINEBUFSIZ];
@@ -2065,7 +3884,7 @@ static void do_rnum(TTSOCK *sock, TASKARG *arg, TTREQ *req){
 /* handle the size command */
 static void do_size(TTSOCK *sock, TASKARG *arg, TTREQ *req){
   ttservlog(g_serv, TTLOGDEBUG, "doing size command");
-  arg->counts[TTSEQNUM*req->idx+TTSEQSIZE]++;
+  countcmd(arg, req, TTSEQSIZE);
   uint64_t mask = arg->mask;
   TCADB *adb = arg->adb;
   char buf[LINEBUFSIZ];
@@ -2090,37 +3909,41 @@ static void do_size(TTSOCK *sock, TASKARG *arg, TTREQ *req){
 /* handle the stat command */
 static void do_stat(TTSOCK *sock, TASKARG *arg, TTREQ *req){
   ttservlog(g_serv, TTLOGDEBUG, "doing stat command");
-  arg->counts[TTSEQNUM*req->idx+TTSEQSTAT]++;
+  countcmd(arg, req, TTSEQSTAT);
   uint64_t mask = arg->mask;
   TCADB *adb = arg->adb;
   REPLARG *sarg = arg->sarg;
-  char buf[TTIOBUFSIZ];
-  char *wp = buf + sizeof(uint8_t) + sizeof(uint32_t);
+  TCXSTR *xstr = tcxstrnew();
+  pthread_cleanup_push((void (*)(void *))tcxstrdel, xstr);
+  uint8_t code = 0;
+  tcxstrcat(xstr, &code, sizeof(code));
+  uint32_t size = 0;
+  tcxstrcat(xstr, &size, sizeof(size));
   if(mask & ((1ULL << TTSEQSTAT) | (1ULL << TTSEQALLORG) | (1ULL << TTSEQALLREAD))){
     ttservlog(g_serv, TTLOGINFO, "do_stat: forbidden");
   } else {
     double now = tctime();
-    wp += sprintf(wp, "version\t%s\n", ttversion);
-    wp += sprintf(wp, "libver\t%d\n", _TT_LIBVER);
-    wp += sprintf(wp, "protver\t%s\n", _TT_PROTVER);
-    wp += sprintf(wp, "os\t%s\n", TTSYSNAME);
-    wp += sprintf(wp, "time\t%.6f\n", now);
-    wp += sprintf(wp, "pid\t%lld\n", (long long)getpid());
-    wp += sprintf(wp, "sid\t%d\n", arg->sid);
+    tcxstrprintf(xstr, "version\t%s\n", ttversion);
+    tcxstrprintf(xstr, "libver\t%d\n", _TT_LIBVER);
+    tcxstrprintf(xstr, "protver\t%s\n", _TT_PROTVER);
+    tcxstrprintf(xstr, "os\t%s\n", TTSYSNAME);
+    tcxstrprintf(xstr, "time\t%.6f\n", now);
+    tcxstrprintf(xstr, "pid\t%lld\n", (long long)getpid());
+    tcxstrprintf(xstr, "sid\t%d\n", arg->sid);
     switch(tcadbomode(adb)){
-      case ADBOVOID: wp += sprintf(wp, "type\tvoid\n"); break;
-      case ADBOMDB: wp += sprintf(wp, "type\ton-memory hash\n"); break;
-      case ADBONDB: wp += sprintf(wp, "type\ton-memory tree\n"); break;
-      case ADBOHDB: wp += sprintf(wp, "type\thash\n"); break;
-      case ADBOBDB: wp += sprintf(wp, "type\tB+ tree\n"); break;
-      case ADBOFDB: wp += sprintf(wp, "type\tfixed-length\n"); break;
-      case ADBOTDB: wp += sprintf(wp, "type\ttable\n"); break;
-      case ADBOSKEL: wp += sprintf(wp, "type\tskeleton\n"); break;
+      case ADBOVOID: tcxstrprintf(xstr, "type\tvoid\n"); break;
+      case ADBOMDB: tcxstrprintf(xstr, "type\ton-memory hash\n"); break;
+      case ADBONDB: tcxstrprintf(xstr, "type\ton-memory tree\n"); break;
+      case ADBOHDB: tcxstrprintf(xstr, "type\thash\n"); break;
+      case ADBOBDB: tcxstrprintf(xstr, "type\tB+ tree\n"); break;
+      case ADBOFDB: tcxstrprintf(xstr, "type\tfixed-length\n"); break;
+      case ADBOTDB: tcxstrprintf(xstr, "type\ttable\n"); break;
+      case ADBOSKEL: tcxstrprintf(xstr, "type\tskeleton\n"); break;
     }
     const char *path = tcadbpath(adb);
-    if(path) wp += sprintf(wp, "path\t%s\n", path);
-    wp += sprintf(wp, "rnum\t%llu\n", (unsigned long long)tcadbrnum(adb));
-    wp += sprintf(wp, "size\t%llu\n", (unsigned long long)tcadbsize(adb));
+    if(path) tcxstrprintf(xstr, "path\t%s\n", path);
+    tcxstrprintf(xstr, "rnum\t%llu\n", (unsigned long long)tcadbrnum(adb));
+    tcxstrprintf(xstr, "size\t%llu\n", (unsigned long long)tcadbsize(adb));
     TCLIST *args = tclistnew2(1);
     pthread_cleanup_push((void (*)(void *))tclistdel, args);
     TCLIST *res = tcadbmisc(adb, "error", args);
@@ -2136,79 +3959,61 @@ static void do_stat(TTSOCK *sock, TASKARG *arg, TTREQ *req){
           emsg = vbuf;
         }
       }
-      if(fatal) wp += sprintf(wp, "fatal\t%s\n", emsg);
+      if(fatal) tcxstrprintf(xstr, "fatal\t%s\n", emsg);
       tclistdel(res);
     }
     pthread_cleanup_pop(1);
-    wp += sprintf(wp, "bigend\t%d\n", TTBIGEND);
+    tcxstrprintf(xstr, "bigend\t%d\n", TTBIGEND);
+    if(arg->ulog->base) tcxstrprintf(xstr, "ulsync\t%s\n", g_ulsnames[arg->ulog->spol]);
     if(sarg->host[0] != '\0'){
-      wp += sprintf(wp, "mhost\t%s\n", sarg->host);
-      wp += sprintf(wp, "mport\t%d\n", sarg->port);
-      wp += sprintf(wp, "rts\t%llu\n", (unsigned long long)sarg->rts);
+      tcxstrprintf(xstr, "mhost\t%s\n", sarg->host);
+      tcxstrprintf(xstr, "mport\t%d\n", sarg->port);
+      tcxstrprintf(xstr, "rts\t%llu\n", (unsigned long long)sarg->rts);
       double delay = now - sarg->rts / 1000000.0;
-      wp += sprintf(wp, "delay\t%.6f\n", delay >= 0 ? delay : 0.0);
+      tcxstrprintf(xstr, "delay\t%.6f\n", delay >= 0 ? delay : 0.0);
+    }
+    tcxstrprintf(xstr, "fd\t%d\n", sock->fd);
+    tcxstrprintf(xstr, "queue\t%d\n", ttservqueuenum(g_serv));
+    if(pthread_mutex_lock(&arg->admmtx) == 0){
+      tcxstrprintf(xstr, "admqueue\t%d\n", tclistnum(arg->admjobs));
+      pthread_mutex_unlock(&arg->admmtx);
     }
-    wp += sprintf(wp, "fd\t%d\n", sock->fd);
-    wp += sprintf(wp, "loadavg\t%.6f\n", ttgetloadavg());
+    tcxstrprintf(xstr, "loadavg\t%.6f\n", ttgetloadavg());
     TCMAP *info = tcsysinfo();
     if(info){
       const char *vbuf = tcmapget2(info, "size");
-      if(vbuf) wp += sprintf(wp, "memsize\t%s\n", vbuf);
+      if(vbuf) tcxstrprintf(xstr, "memsize\t%s\n", vbuf);
       vbuf = tcmapget2(info, "rss");
-      if(vbuf) wp += sprintf(wp, "memrss\t%s\n", vbuf);
+      if(vbuf) tcxstrprintf(xstr, "memrss\t%s\n", vbuf);
       vbuf = tcmapget2(info, "utime");
-      if(vbuf) wp += sprintf(wp, "ru_user\t%s\n", vbuf);
+      if(vbuf) tcxstrprintf(xstr, "ru_user\t%s\n", vbuf);
       vbuf = tcmapget2(info, "stime");
-      if(vbuf) wp += sprintf(wp, "ru_sys\t%s\n", vbuf);
+      if(vbuf) tcxstrprintf(xstr, "ru_sys\t%s\n", vbuf);
       tcmapdel(info);
     }
-    wp += sprintf(wp, "ru_real\t%.6f\n", now - g_starttime);
-  }
-  wp += sprintf(wp, "cnt_put\t%llu\n", (unsigned long long)sumstat(arg, TTSEQPUT));
-  wp += sprintf(wp, "cnt_putkeep\t%llu\n", (unsigned long long)sumstat(arg, TTSEQPUTKEEP));
-  wp += sprintf(wp, "cnt_putcat\t%llu\n", (unsigned long long)sumstat(arg, TTSEQPUTCAT));
-  wp += sprintf(wp, "cnt_putshl\t%llu\n", (unsigned long long)sumstat(arg, TTSEQPUTSHL));
-  wp += sprintf(wp, "cnt_putnr\t%llu\n", (unsigned long long)sumstat(arg, TTSEQPUTNR));
-  wp += sprintf(wp, "cnt_out\t%llu\n", (unsigned long long)sumstat(arg, TTSEQOUT));
-  wp += sprintf(wp, "cnt_get\t%llu\n", (unsigned long long)sumstat(arg, TTSEQGET));
-  wp += sprintf(wp, "cnt_mget\t%llu\n", (unsigned long long)sumstat(arg, TTSEQMGET));
-  wp += sprintf(wp, "cnt_vsiz\t%llu\n", (unsigned long long)sumstat(arg, TTSEQVSIZ));
-  wp += sprintf(wp, "cnt_iterinit\t%llu\n", (unsigned long long)sumstat(arg, TTSEQITERINIT));
-  wp += sprintf(wp, "cnt_iternext\t%llu\n", (unsigned long long)sumstat(arg, TTSEQITERNEXT));
-  wp += sprintf(wp, "cnt_fwmkeys\t%llu\n", (unsigned long long)sumstat(arg, TTSEQFWMKEYS));
-  wp += sprintf(wp, "cnt_addint\t%llu\n", (unsigned long long)sumstat(arg, TTSEQADDINT));
-  wp += sprintf(wp, "cnt_adddouble\t%llu\n", (unsigned long long)sumstat(arg, TTSEQADDDOUBLE));
-  wp += sprintf(wp, "cnt_ext\t%llu\n", (unsigned long long)sumstat(arg, TTSEQEXT));
-  wp += sprintf(wp, "cnt_sync\t%llu\n", (unsigned long long)sumstat(arg, TTSEQSYNC));
-  wp += sprintf(wp, "cnt_optimize\t%llu\n", (unsigned long long)sumstat(arg, TTSEQOPTIMIZE));
-  wp += sprintf(wp, "cnt_vanish\t%llu\n", (unsigned long long)sumstat(arg, TTSEQVANISH));
-  wp += sprintf(wp, "cnt_copy\t%llu\n", (unsigned long long)sumstat(arg, TTSEQCOPY));
-  wp += sprintf(wp, "cnt_restore\t%llu\n", (unsigned long long)sumstat(arg, TTSEQRESTORE));
-  wp += sprintf(wp, "cnt_setmst\t%llu\n", (unsigned long long)sumstat(arg, TTSEQSETMST));
-  wp += sprintf(wp, "cnt_rnum\t%llu\n", (unsigned long long)sumstat(arg, TTSEQRNUM));
-  wp += sprintf(wp, "cnt_size\t%llu\n", (unsigned long long)sumstat(arg, TTSEQSIZE));
-  wp += sprintf(wp, "cnt_stat\t%llu\n", (unsigned long long)sumstat(arg, TTSEQSTAT));
-  wp += sprintf(wp, "cnt_misc\t%llu\n", (unsigned long long)sumstat(arg, TTSEQMISC));
-  wp += sprintf(wp, "cnt_repl\t%llu\n", (unsigned long long)sumstat(arg, TTSEQREPL));
-  wp += sprintf(wp, "cnt_put_miss\t%llu\n", (unsigned long long)sumstat(arg, TTSEQPUTMISS));
-  wp += sprintf(wp, "cnt_out_miss\t%llu\n", (unsigned long long)sumstat(arg, TTSEQOUTMISS));
-  wp += sprintf(wp, "cnt_get_miss\t%llu\n", (unsigned long long)sumstat(arg, TTSEQGETMISS));
-  *buf = 0;
-  uint32_t size = wp - buf - (sizeof(uint8_t) + sizeof(uint32_t));
-  size = TTHTONL(size);
-  memcpy(buf + sizeof(uint8_t), &size, sizeof(uint32_t));
-  if(ttsocksend(sock, buf, wp - buf)){
+    tcxstrprintf(xstr, "ru_real\t%.6f\n", now - g_starttime);
+  }
+  int mnum = ttmetricsnum(arg->metrics);
+  for(int i = 0; i < mnum; i++){
+    tcxstrprintf(xstr, "%s\t%lld\n", ttmetricsname(arg->metrics, i),
+                 (long long)ttmetricssum(arg->metrics, i));
+  }
+  printlats(arg, xstr, "", '\t', "\n");
+  size = TTHTONL((uint32_t)(tcxstrsize(xstr) - sizeof(code) - sizeof(size)));
+  memcpy((char *)tcxstrptr(xstr) + sizeof(code), &size, sizeof(size));
+  if(ttsocksend(sock, tcxstrptr(xstr), tcxstrsize(xstr))){
     req->keep = true;
   } else {
     ttservlog(g_serv, TTLOGINFO, "do_stat: response failed");
   }
+  pthread_cleanup_pop(1);
 }
 
 
 /* handle the misc command */
 static void do_misc(TTSOCK *sock, TASKARG *arg, TTREQ *req){
   ttservlog(g_serv, TTLOGDEBUG, "doing misc command");
-  arg->counts[TTSEQNUM*req->idx+TTSEQMISC]++;
+  countcmd(arg, req, TTSEQMISC);
   uint64_t mask = arg->mask;
   TCADB *adb = arg->adb;
   TCULOG *ulog = arg->ulog;
@@ -2234,57 +4039,406 @@ static void do_misc(TTSOCK *sock, TASKARG *arg, TTREQ *req){
     if(ttsockcheckend(sock) || rsiz < 0 || rsiz > MAXARGSIZ) break;
     char *buf = (rsiz < TTIOBUFSIZ) ? stack : tcmalloc(rsiz + 1);
     pthread_cleanup_push(free, (buf == stack) ? NULL : buf);
-    if(ttsockrecv(sock, buf, rsiz)) tclistpush(args, buf, rsiz);
+    if(ttsockrecv(sock, buf, rsiz)) tclistpush(args, buf, rsiz);
+    pthread_cleanup_pop(1);
+  }
+  if(!ttsockcheckend(sock)){
+    TCXSTR *xstr = tcxstrnew();
+    pthread_cleanup_push((void (*)(void *))tcxstrdel, xstr);
+    uint8_t code = 0;
+    tcxstrcat(xstr, &code, sizeof(code));
+    uint32_t num = 0;
+    tcxstrcat(xstr, &num, sizeof(num));
+    rnum = 0;
+    if(mask & ((1ULL << TTSEQMISC) | (1ULL << TTSEQALLORG) | (1ULL << TTSEQALLWRITE))){
+      ttservlog(g_serv, TTLOGINFO, "do_misc: forbidden");
+    } else {
+      TCLIST *res;
+      if(!strcmp(name, "slowlog") || !strcmp(name, "slowth")){
+        res = miscslow(arg, name, args);
+      } else {
+        res = (opts & RDBMONOULOG) ?
+          tcadbmisc(adb, name, args) : tculogadbmisc(ulog, sid, 0, adb, name, args);
+      }
+      if(res){
+        for(int i = 0; i < tclistnum(res); i++){
+          int esiz;
+          const char *ebuf = tclistval(res, i, &esiz);
+          num = TTHTONL((uint32_t)esiz);
+          tcxstrcat(xstr, &num, sizeof(num));
+          tcxstrcat(xstr, ebuf, esiz);
+          rnum++;
+        }
+        tclistdel(res);
+      } else {
+        *(uint8_t *)tcxstrptr(xstr) = 1;
+      }
+    }
+    num = TTHTONL((uint32_t)rnum);
+    memcpy((char *)tcxstrptr(xstr) + sizeof(code), &num, sizeof(num));
+    if(ttsocksend(sock, tcxstrptr(xstr), tcxstrsize(xstr))){
+      req->keep = true;
+    } else {
+      ttservlog(g_serv, TTLOGINFO, "do_misc: response failed");
+    }
+    pthread_cleanup_pop(1);
+  } else {
+    ttservlog(g_serv, TTLOGINFO, "do_misc: invalid entity");
+  }
+  pthread_cleanup_pop(1);
+}
+
+
+/* handle the mput command */
+static void do_mput(TTSOCK *sock, TASKARG *arg, TTREQ *req){
+  ttservlog(g_serv, TTLOGDEBUG, "doing mput command");
+  countcmd(arg, req, TTSEQMPUT);
+  uint64_t mask = arg->mask;
+  TCADB *adb = arg->adb;
+  TCULOG *ulog = arg->ulog;
+  uint32_t sid = arg->sid;
+  int rnum = ttsockgetint32(sock);
+  if(ttsockcheckend(sock) || rnum < 0 || rnum > MAXARGNUM){
+    ttservlog(g_serv, TTLOGINFO, "do_mput: invalid parameters");
+    return;
+  }
+  TCLIST *recs = tclistnew2(rnum * 2);
+  pthread_cleanup_push((void (*)(void *))tclistdel, recs);
+  char stack[TTIOBUFSIZ];
+  for(int i = 0; i < rnum; i++){
+    int ksiz = ttsockgetint32(sock);
+    int vsiz = ttsockgetint32(sock);
+    if(ttsockcheckend(sock) || ksiz < 0 || ksiz > MAXARGSIZ || vsiz < 0 || vsiz > MAXARGSIZ)
+      break;
+    int rsiz = ksiz + vsiz;
+    char *buf = (rsiz < TTIOBUFSIZ) ? stack : tcmalloc(rsiz + 1);
+    pthread_cleanup_push(free, (buf == stack) ? NULL : buf);
+    if(ttsockrecv(sock, buf, rsiz)){
+      tclistpush(recs, buf, ksiz);
+      tclistpush(recs, buf + ksiz, vsiz);
+    }
+    pthread_cleanup_pop(1);
+  }
+  if(!ttsockcheckend(sock) && tclistnum(recs) == rnum * 2){
+    char rbuf[sizeof(uint8_t)+sizeof(uint32_t)];
+    int num = 0;
+    if(mask & ((1ULL << TTSEQMPUT) | (1ULL << TTSEQALLORG) | (1ULL << TTSEQALLWRITE))){
+      ttservlog(g_serv, TTLOGINFO, "do_mput: forbidden");
+    } else {
+      num = tculogadbmput(ulog, sid, 0, adb, recs);
+      if(num < 0){
+        num = 0;
+        ttservlog(g_serv, TTLOGERROR, "do_mput: operation failed");
+      }
+      if(num < rnum) ttmetricsadd(arg->metrics, req->idx, TTSEQPUTMISS, rnum - num);
+    }
+    *rbuf = (num == rnum) ? 0 : 1;
+    uint32_t lnum = TTHTONL((uint32_t)num);
+    memcpy(rbuf + sizeof(uint8_t), &lnum, sizeof(lnum));
+    if(ttsocksend(sock, rbuf, sizeof(rbuf))){
+      req->keep = true;
+    } else {
+      ttservlog(g_serv, TTLOGINFO, "do_mput: response failed");
+    }
+  } else {
+    ttservlog(g_serv, TTLOGINFO, "do_mput: invalid entity");
+  }
+  pthread_cleanup_pop(1);
+}
+
+
+/* handle the mout command */
+static void do_mout(TTSOCK *sock, TASKARG *arg, TTREQ *req){
+  ttservlog(g_serv, TTLOGDEBUG, "doing mout command");
+  countcmd(arg, req, TTSEQMOUT);
+  uint64_t mask = arg->mask;
+  TCADB *adb = arg->adb;
+  TCULOG *ulog = arg->ulog;
+  uint32_t sid = arg->sid;
+  int rnum = ttsockgetint32(sock);
+  if(ttsockcheckend(sock) || rnum < 0 || rnum > MAXARGNUM){
+    ttservlog(g_serv, TTLOGINFO, "do_mout: invalid parameters");
+    return;
+  }
+  TCLIST *keys = tclistnew2(rnum);
+  pthread_cleanup_push((void (*)(void *))tclistdel, keys);
+  char stack[TTIOBUFSIZ];
+  for(int i = 0; i < rnum; i++){
+    int ksiz = ttsockgetint32(sock);
+    if(ttsockcheckend(sock) || ksiz < 0 || ksiz > MAXARGSIZ) break;
+    char *buf = (ksiz < TTIOBUFSIZ) ? stack : tcmalloc(ksiz + 1);
+    pthread_cleanup_push(free, (buf == stack) ? NULL : buf);
+    if(ttsockrecv(sock, buf, ksiz)) tclistpush(keys, buf, ksiz);
+    pthread_cleanup_pop(1);
+  }
+  if(!ttsockcheckend(sock) && tclistnum(keys) == rnum){
+    char rbuf[sizeof(uint8_t)+sizeof(uint32_t)];
+    int num = 0;
+    if(mask & ((1ULL << TTSEQMOUT) | (1ULL << TTSEQALLORG) | (1ULL << TTSEQALLWRITE))){
+      ttservlog(g_serv, TTLOGINFO, "do_mout: forbidden");
+    } else {
+      num = tculogadbmout(ulog, sid, 0, adb, keys);
+      if(num < 0){
+        num = 0;
+        ttservlog(g_serv, TTLOGERROR, "do_mout: operation failed");
+      }
+      if(num < rnum) ttmetricsadd(arg->metrics, req->idx, TTSEQOUTMISS, rnum - num);
+    }
+    *rbuf = (num == rnum) ? 0 : 1;
+    uint32_t lnum = TTHTONL((uint32_t)num);
+    memcpy(rbuf + sizeof(uint8_t), &lnum, sizeof(lnum));
+    if(ttsocksend(sock, rbuf, sizeof(rbuf))){
+      req->keep = true;
+    } else {
+      ttservlog(g_serv, TTLOGINFO, "do_mout: response failed");
+    }
+  } else {
+    ttservlog(g_serv, TTLOGINFO, "do_mout: invalid entity");
+  }
+  pthread_cleanup_pop(1);
+}
+
+/* handle the batch command */
+static void do_batch(TTSOCK *sock, TASKARG *arg, TTREQ *req){
+  ttservlog(g_serv, TTLOGDEBUG, "doing batch command");
+  countcmd(arg, req, TTSEQBATCH);
+  uint64_t mask = arg->mask;
+  TCULOG *ulog = arg->ulog;
+  int rnum = ttsockgetint32(sock);
+  if(ttsockcheckend(sock) || rnum < 0 || rnum > MAXARGNUM){
+    ttservlog(g_serv, TTLOGINFO, "do_batch: invalid parameters");
+    return;
+  }
+  BATCHOP *ops = tcmalloc(sizeof(*ops) * rnum + 1);
+  pthread_cleanup_push(free, ops);
+  TCLIST *bufs = tclistnew2(rnum);
+  pthread_cleanup_push((void (*)(void *))tclistdel, bufs);
+  char stack[TTIOBUFSIZ];
+  for(int i = 0; i < rnum; i++){
+    BATCHOP *op = ops + i;
+    memset(op, 0, sizeof(*op));
+    op->cmd = ttsockgetc(sock);
+    switch(op->cmd){
+      case TTCMDPUT:
+        op->ksiz = ttsockgetint32(sock);
+        op->vsiz = ttsockgetint32(sock);
+        break;
+      case TTCMDOUT:
+      case TTCMDGET:
+      case TTCMDVSIZ:
+        op->ksiz = ttsockgetint32(sock);
+        break;
+      case TTCMDADDINT:
+        op->ksiz = ttsockgetint32(sock);
+        op->num = ttsockgetint32(sock);
+        break;
+      case TTCMDEXT:
+        op->nsiz = ttsockgetint32(sock);
+        op->opts = ttsockgetint32(sock);
+        op->ksiz = ttsockgetint32(sock);
+        op->vsiz = ttsockgetint32(sock);
+        break;
+      default:
+        op->cmd = -1;
+        break;
+    }
+    if(ttsockcheckend(sock) || op->cmd < 0 || op->nsiz < 0 || op->nsiz >= TTADDRBUFSIZ ||
+       op->ksiz < 0 || op->ksiz > MAXARGSIZ || op->vsiz < 0 || op->vsiz > MAXARGSIZ) break;
+    int bsiz = op->nsiz + op->ksiz + op->vsiz;
+    char *buf = (bsiz < TTIOBUFSIZ) ? stack : tcmalloc(bsiz + 1);
+    pthread_cleanup_push(free, (buf == stack) ? NULL : buf);
+    if(ttsockrecv(sock, buf, bsiz)) tclistpush(bufs, buf, bsiz);
     pthread_cleanup_pop(1);
   }
-  if(!ttsockcheckend(sock)){
+  if(!ttsockcheckend(sock) && tclistnum(bufs) == rnum){
     TCXSTR *xstr = tcxstrnew();
     pthread_cleanup_push((void (*)(void *))tcxstrdel, xstr);
-    uint8_t code = 0;
-    tcxstrcat(xstr, &code, sizeof(code));
-    uint32_t num = 0;
-    tcxstrcat(xstr, &num, sizeof(num));
-    rnum = 0;
-    if(mask & ((1ULL << TTSEQMISC) | (1ULL << TTSEQALLORG) | (1ULL << TTSEQALLWRITE))){
-      ttservlog(g_serv, TTLOGINFO, "do_misc: forbidden");
+    if(mask & ((1ULL << TTSEQBATCH) | (1ULL << TTSEQALLORG))){
+      uint8_t code = 1;
+      tcxstrcat(xstr, &code, sizeof(code));
+      ttservlog(g_serv, TTLOGINFO, "do_batch: forbidden");
     } else {
-      TCLIST *res = (opts & RDBMONOULOG) ?
-        tcadbmisc(adb, name, args) : tculogadbmisc(ulog, sid, 0, adb, name, args);
-      if(res){
-        for(int i = 0; i < tclistnum(res); i++){
-          int esiz;
-          const char *ebuf = tclistval(res, i, &esiz);
-          num = TTHTONL((uint32_t)esiz);
-          tcxstrcat(xstr, &num, sizeof(num));
-          tcxstrcat(xstr, ebuf, esiz);
-          rnum++;
+      uint8_t code = 0;
+      tcxstrcat(xstr, &code, sizeof(code));
+      uint32_t lnum = TTHTONL((uint32_t)rnum);
+      tcxstrcat(xstr, &lnum, sizeof(lnum));
+      for(int i = 0; i < rnum; i++){
+        BATCHOP *op = ops + i;
+        int bsiz;
+        op->nbuf = tclistval(bufs, i, &bsiz);
+        op->kbuf = op->nbuf + op->nsiz;
+        op->vbuf = op->kbuf + op->ksiz;
+      }
+      TCLIST *keys = tclistnew();
+      pthread_cleanup_push((void (*)(void *))tclistdel, keys);
+      int i = 0;
+      while(i < rnum){
+        int end = i;
+        while(end < rnum && ops[end].cmd != TTCMDEXT){
+          end++;
         }
-        tclistdel(res);
-      } else {
-        *(uint8_t *)tcxstrptr(xstr) = 1;
+        if(end <= i) end = i + 1;
+        tclistclear(keys);
+        for(int j = i; j < end; j++){
+          BATCHOP *op = ops + j;
+          if(op->cmd == TTCMDPUT || op->cmd == TTCMDOUT || op->cmd == TTCMDADDINT)
+            tclistpush(keys, op->kbuf, op->ksiz);
+        }
+        bool hold = false;
+        if(ulog->base && tclistnum(keys) > 1){
+          if(tculogbeginrecs(ulog, keys)){
+            hold = true;
+          } else {
+            ttservlog(g_serv, TTLOGERROR, "do_batch: tculogbeginrecs failed");
+          }
+        }
+        pthread_cleanup_push((void (*)(void *))tculogendrecs, ulog);
+        for(int j = i; j < end; j++){
+          dobatchop(arg, req, ops + j, xstr);
+        }
+        pthread_cleanup_pop(0);
+        if(hold && !tculogendrecs(ulog))
+          ttservlog(g_serv, TTLOGERROR, "do_batch: tculogendrecs failed");
+        i = end;
       }
+      pthread_cleanup_pop(1);
     }
-    num = TTHTONL((uint32_t)rnum);
-    memcpy((char *)tcxstrptr(xstr) + sizeof(code), &num, sizeof(num));
     if(ttsocksend(sock, tcxstrptr(xstr), tcxstrsize(xstr))){
       req->keep = true;
     } else {
-      ttservlog(g_serv, TTLOGINFO, "do_misc: response failed");
+      ttservlog(g_serv, TTLOGINFO, "do_batch: response failed");
     }
     pthread_cleanup_pop(1);
   } else {
-    ttservlog(g_serv, TTLOGINFO, "do_misc: invalid entity");
+    ttservlog(g_serv, TTLOGINFO, "do_batch: invalid entity");
   }
   pthread_cleanup_pop(1);
+  pthread_cleanup_pop(1);
+}
+
+
+/* perform a sub-command of the batch command and append its response */
+static void dobatchop(TASKARG *arg, TTREQ *req, const BATCHOP *op, TCXSTR *xstr){
+  uint64_t mask = arg->mask;
+  TCADB *adb = arg->adb;
+  TCULOG *ulog = arg->ulog;
+  uint32_t sid = arg->sid;
+  uint8_t code = 1;
+  uint32_t lnum;
+  switch(op->cmd){
+    case TTCMDPUT:
+      ttmetricsadd(arg->metrics, req->idx, TTSEQPUT, 1);
+      if(mask & ((1ULL << TTSEQPUT) | (1ULL << TTSEQALLWRITE))){
+        ttservlog(g_serv, TTLOGINFO, "do_batch: put forbidden");
+      } else if(tculogadbput(ulog, sid, 0, adb, op->kbuf, op->ksiz, op->vbuf, op->vsiz)){
+        code = 0;
+      } else {
+        ttmetricsadd(arg->metrics, req->idx, TTSEQPUTMISS, 1);
+        ttservlog(g_serv, TTLOGERROR, "do_batch: put failed");
+      }
+      tcxstrcat(xstr, &code, sizeof(code));
+      break;
+    case TTCMDOUT:
+      ttmetricsadd(arg->metrics, req->idx, TTSEQOUT, 1);
+      if(mask & ((1ULL << TTSEQOUT) | (1ULL << TTSEQALLWRITE))){
+        ttservlog(g_serv, TTLOGINFO, "do_batch: out forbidden");
+      } else if(tculogadbout(ulog, sid, 0, adb, op->kbuf, op->ksiz)){
+        code = 0;
+      } else {
+        ttmetricsadd(arg->metrics, req->idx, TTSEQOUTMISS, 1);
+      }
+      tcxstrcat(xstr, &code, sizeof(code));
+      break;
+    case TTCMDGET:
+      ttmetricsadd(arg->metrics, req->idx, TTSEQGET, 1);
+      if(mask & ((1ULL << TTSEQGET) | (1ULL << TTSEQALLREAD))){
+        ttservlog(g_serv, TTLOGINFO, "do_batch: get forbidden");
+        tcxstrcat(xstr, &code, sizeof(code));
+      } else {
+        int vsiz;
+        tttracemark(TTTSDBBEGIN);
+        char *vbuf = tcadbget(adb, op->kbuf, op->ksiz, &vsiz);
+        tttracemark(TTTSDBEND);
+        if(vbuf){
+          code = 0;
+          tcxstrcat(xstr, &code, sizeof(code));
+          lnum = TTHTONL((uint32_t)vsiz);
+          tcxstrcat(xstr, &lnum, sizeof(lnum));
+          tcxstrcat(xstr, vbuf, vsiz);
+          tcfree(vbuf);
+        } else {
+          ttmetricsadd(arg->metrics, req->idx, TTSEQGETMISS, 1);
+          tcxstrcat(xstr, &code, sizeof(code));
+        }
+      }
+      break;
+    case TTCMDVSIZ:
+      ttmetricsadd(arg->metrics, req->idx, TTSEQVSIZ, 1);
+      if(mask & ((1ULL << TTSEQVSIZ) | (1ULL << TTSEQALLREAD))){
+        ttservlog(g_serv, TTLOGINFO, "do_batch: vsiz forbidden");
+        tcxstrcat(xstr, &code, sizeof(code));
+      } else {
+        tttracemark(TTTSDBBEGIN);
+        int vsiz = tcadbvsiz(adb, op->kbuf, op->ksiz);
+        tttracemark(TTTSDBEND);
+        if(vsiz >= 0) code = 0;
+        tcxstrcat(xstr, &code, sizeof(code));
+        if(vsiz >= 0){
+          lnum = TTHTONL((uint32_t)vsiz);
+          tcxstrcat(xstr, &lnum, sizeof(lnum));
+        }
+      }
+      break;
+    case TTCMDADDINT:
+      ttmetricsadd(arg->metrics, req->idx, TTSEQADDINT, 1);
+      if(mask & ((1ULL << TTSEQADDINT) | (1ULL << TTSEQALLWRITE))){
+        ttservlog(g_serv, TTLOGINFO, "do_batch: addint forbidden");
+        tcxstrcat(xstr, &code, sizeof(code));
+      } else {
+        int snum = tculogadbaddint(ulog, sid, 0, adb, op->kbuf, op->ksiz, op->num);
+        if(snum != INT_MIN) code = 0;
+        tcxstrcat(xstr, &code, sizeof(code));
+        if(snum != INT_MIN){
+          lnum = TTHTONL((uint32_t)snum);
+          tcxstrcat(xstr, &lnum, sizeof(lnum));
+        }
+      }
+      break;
+    case TTCMDEXT:
+      ttmetricsadd(arg->metrics, req->idx, TTSEQEXT, 1);
+      if(mask & (1ULL << TTSEQEXT)){
+        ttservlog(g_serv, TTLOGINFO, "do_batch: ext forbidden");
+        tcxstrcat(xstr, &code, sizeof(code));
+      } else {
+        void *scr = arg->screxts[req->idx];
+        char name[TTADDRBUFSIZ];
+        memcpy(name, op->nbuf, op->nsiz);
+        name[op->nsiz] = '\0';
+        int xsiz = 0;
+        char *xbuf = scr ? callext(scr, arg->rmtxs, name, op->opts, op->kbuf, op->ksiz,
+                                   op->vbuf, op->vsiz, &xsiz) : NULL;
+        if(xbuf){
+          code = 0;
+          tcxstrcat(xstr, &code, sizeof(code));
+          lnum = TTHTONL((uint32_t)xsiz);
+          tcxstrcat(xstr, &lnum, sizeof(lnum));
+          tcxstrcat(xstr, xbuf, xsiz);
+          tcfree(xbuf);
+        } else {
+          tcxstrcat(xstr, &code, sizeof(code));
+        }
+      }
+      break;
+  }
 }
 
 
+
 /* handle the repl command */
 static void do_repl(TTSOCK *sock, TASKARG *arg, TTREQ *req){
   ttservlog(g_serv, TTLOGINFO, "doing repl command");
-  arg->counts[TTSEQNUM*req->idx+TTSEQREPL]++;
+  countcmd(arg, req, TTSEQREPL);
   uint64_t mask = arg->mask;
-  TCULOG *ulog = arg->ulog;
   uint64_t ts = ttsockgetint64(sock);
   uint32_t sid = ttsockgetint32(sock);
   if(ttsockcheckend(sock) || ts < 1 || sid < 1){
@@ -2300,84 +4454,241 @@ static void do_repl(TTSOCK *sock, TASKARG *arg, TTREQ *req){
     return;
   }
   uint32_t lnum = TTHTONL(arg->sid);
-  if(!ttsocksend(sock, &lnum, sizeof(lnum))){
+  if(!ttsocksend(sock, &lnum, sizeof(lnum)) || !ttsockflush(sock)){
     ttservlog(g_serv, TTLOGINFO, "do_repl: response failed");
     return;
   }
-  TCULRD *ulrd = tculrdnew(ulog, ts);
-  if(ulrd){
+  int fd = dup(sock->fd);
+  if(fd == -1){
+    ttservlog(g_serv, TTLOGERROR, "do_repl: dup failed");
+    return;
+  }
+  REPLSLAVE *slave = tcmalloc(sizeof(*slave));
+  slave->sock = ttsocknew(fd);
+  slave->ulrd = NULL;
+  slave->ts = ts;
+  slave->sid = sid;
+  slave->noptime = 0;
+  slave->ssum = 0;
+  ttsocksetdefer(slave->sock, true);
+  if(pthread_mutex_lock(&arg->rsmtx) != 0){
+    replslavedel(slave);
+    ttservlog(g_serv, TTLOGERROR, "do_repl: pthread_mutex_lock failed");
+    return;
+  }
+  REPLSEND *rsend = NULL;
+  if(!arg->rsterm){
+    for(int i = 0; i < REPLTHNUM; i++){
+      REPLSEND *cur = arg->rsends + i;
+      if(cur->alive && (!rsend || tclistnum(cur->slaves) < tclistnum(rsend->slaves))) rsend = cur;
+    }
+  }
+  if(rsend){
+    tclistpush(rsend->slaves, &slave, sizeof(slave));
+    if(pthread_cond_broadcast(&arg->rscnd) != 0)
+      ttservlog(g_serv, TTLOGERROR, "pthread_cond_broadcast failed");
+    req->detach = true;
+  }
+  pthread_mutex_unlock(&arg->rsmtx);
+  if(!rsend){
+    replslavedel(slave);
+    ttservlog(g_serv, TTLOGINFO, "do_repl: no replication sender is available");
+  }
+}
+
+
+/* send a turn of update logs to a slave and return whether records are left or it finished */
+static int replsendslave(TASKARG *arg, REPLSLAVE *slave){
+  if(!slave->ulrd){
+    slave->ulrd = tculrdnew(arg->ulog, slave->ts);
+    if(!slave->ulrd){
+      ttservlog(g_serv, TTLOGERROR, "replsender: tculrdnew failed");
+      return -1;
+    }
     ttservlog(g_serv, TTLOGINFO, "replicating to sid=%u after %llu",
-              (unsigned int)sid, (unsigned long long)ts - 1);
-    pthread_cleanup_push((void (*)(void *))tculrddel, ulrd);
-    bool err = false;
-    double noptime = 0;
-    char stack[TTIOBUFSIZ];
-    while(!err && !ttserviskilled(g_serv)){
-      ttsocksetlife(sock, UINT_MAX);
-      double now = tctime();
-      req->mtime = now + UINT_MAX;
-      if(now - noptime >= 1.0){
-        *(unsigned char *)stack = TCULMAGICNOP;
-        if(!ttsocksend(sock, stack, sizeof(uint8_t))){
-          err = true;
-          ttservlog(g_serv, TTLOGINFO, "do_repl: connection closed");
-        }
-        noptime = now;
+              (unsigned int)slave->sid, (unsigned long long)slave->ts - 1);
+  }
+  TTSOCK *sock = slave->sock;
+  uint32_t sid = slave->sid;
+  bool err = false;
+  char stack[TTIOBUFSIZ];
+  ttsocksetlife(sock, REPLSENDTIMEO);
+  double now = tctime();
+  if(now - slave->noptime >= 1.0){
+    *(unsigned char *)stack = TCULMAGICNOP;
+    if(!ttsocksend(sock, stack, sizeof(uint8_t))){
+      err = true;
+      ttservlog(g_serv, TTLOGINFO, "replsender: connection closed");
+    }
+    slave->noptime = now;
+  }
+  int rnum = 0;
+  const char *rbuf;
+  int rsiz;
+  uint64_t rts;
+  uint32_t rsid, rmid;
+  while(!err && rnum < REPLBATCHNUM &&
+        (rbuf = tculrdread(slave->ulrd, &rsiz, &rts, &rsid, &rmid)) != NULL){
+    rnum++;
+    if(rsid == sid || rmid == sid) continue;
+    int msiz = sizeof(uint8_t) + sizeof(uint64_t) + sizeof(uint32_t) * 2 + rsiz;
+    char *mbuf = (msiz < TTIOBUFSIZ) ? stack : tcmalloc(msiz);
+    unsigned char *wp = (unsigned char *)mbuf;
+    *(wp++) = TCULMAGICNUM;
+    uint64_t llnum = TTHTONLL(rts);
+    memcpy(wp, &llnum, sizeof(llnum));
+    wp += sizeof(llnum);
+    uint32_t lnum = TTHTONL(rsid);
+    memcpy(wp, &lnum, sizeof(lnum));
+    wp += sizeof(lnum);
+    lnum = TTHTONL(rsiz);
+    memcpy(wp, &lnum, sizeof(lnum));
+    wp += sizeof(lnum);
+    memcpy(wp, rbuf, rsiz);
+    if(!ttsocksend(sock, mbuf, msiz)){
+      err = true;
+      ttservlog(g_serv, TTLOGINFO, "replsender: response failed");
+    }
+    if(mbuf != stack) tcfree(mbuf);
+  }
+  if(!err && !ttsockflush(sock)){
+    err = true;
+    ttservlog(g_serv, TTLOGINFO, "replsender: connection closed");
+  }
+  ttmetricsadd(arg->metrics, -1, MTREPLOUT, sock->ssum - slave->ssum);
+  slave->ssum = sock->ssum;
+  if(err || ttserviskilled(g_serv)) return -1;
+  return rnum >= REPLBATCHNUM ? 1 : 0;
+}
+
+
+/* close the connection of a slave and delete its object */
+static void replslavedel(REPLSLAVE *slave){
+  if(slave->ulrd){
+    tculrddel(slave->ulrd);
+    ttservlog(g_serv, TTLOGINFO, "replication to sid=%u finished", (unsigned int)slave->sid);
+  }
+  ttclosesock(slave->sock->fd);
+  ttsockdel(slave->sock);
+  tcfree(slave);
+}
+
+
+/* send update logs to slaves by a replication sender thread */
+static void *replsender(void *opq){
+  REPLSEND *rsend = (REPLSEND *)opq;
+  TASKARG *arg = (TASKARG *)rsend->targ;
+  bool err = false;
+  if(pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, NULL) != 0){
+    err = true;
+    ttservlog(g_serv, TTLOGERROR, "pthread_setcancelstate failed");
+  }
+  while(true){
+    if(pthread_mutex_lock(&arg->rsmtx) != 0){
+      err = true;
+      ttservlog(g_serv, TTLOGERROR, "pthread_mutex_lock failed");
+      break;
+    }
+    while(!arg->rsterm && tclistnum(rsend->slaves) < 1){
+      if(pthread_cond_wait(&arg->rscnd, &arg->rsmtx) != 0){
+        err = true;
+        ttservlog(g_serv, TTLOGERROR, "pthread_cond_wait failed");
+        break;
       }
-      tculrdwait(ulrd);
-      uint32_t nopcnt = 0;
-      const char *rbuf;
-      int rsiz;
-      uint64_t rts;
-      uint32_t rsid, rmid;
-      while(!err && (rbuf = tculrdread(ulrd, &rsiz, &rts, &rsid, &rmid)) != NULL){
-        if(rsid == sid || rmid == sid){
-          if((nopcnt++ & 0xff) == 0){
-            now = tctime();
-            if(now - noptime >= 1.0){
-              *(unsigned char *)stack = TCULMAGICNOP;
-              if(!ttsocksend(sock, stack, sizeof(uint8_t))){
-                err = true;
-                ttservlog(g_serv, TTLOGINFO, "do_repl: connection closed");
-              }
-              noptime = now;
-            }
-          }
-          continue;
-        }
-        int msiz = sizeof(uint8_t) + sizeof(uint64_t) + sizeof(uint32_t) * 2 + rsiz;
-        char *mbuf = (msiz < TTIOBUFSIZ) ? stack : tcmalloc(msiz);
-        pthread_cleanup_push(free, (mbuf == stack) ? NULL : mbuf);
-        unsigned char *wp = (unsigned char *)mbuf;
-        *(wp++) = TCULMAGICNUM;
-        uint64_t llnum = TTHTONLL(rts);
-        memcpy(wp, &llnum, sizeof(llnum));
-        wp += sizeof(llnum);
-        lnum = TTHTONL(rsid);
-        memcpy(wp, &lnum, sizeof(lnum));
-        wp += sizeof(lnum);
-        lnum = TTHTONL(rsiz);
-        memcpy(wp, &lnum, sizeof(lnum));
-        wp += sizeof(lnum);
-        memcpy(wp, rbuf, rsiz);
-        if(!ttsocksend(sock, mbuf, msiz)){
-          err = true;
-          ttservlog(g_serv, TTLOGINFO, "do_repl: response failed");
-        }
-        pthread_cleanup_pop(1);
+    }
+    bool term = arg->rsterm || err;
+    pthread_mutex_unlock(&arg->rsmtx);
+    if(term) break;
+    bool busy = false;
+    REPLSLAVE *idle = NULL;
+    for(int i = 0; true; i++){
+      REPLSLAVE *slave = NULL;
+      if(pthread_mutex_lock(&arg->rsmtx) != 0) break;
+      if(i < tclistnum(rsend->slaves)) slave = *(REPLSLAVE **)tclistval2(rsend->slaves, i);
+      pthread_mutex_unlock(&arg->rsmtx);
+      if(!slave) break;
+      int rv = replsendslave(arg, slave);
+      if(rv < 0){
+        if(pthread_mutex_lock(&arg->rsmtx) != 0) break;
+        tcfree(tclistremove2(rsend->slaves, i--));
+        pthread_mutex_unlock(&arg->rsmtx);
+        replslavedel(slave);
+      } else if(rv > 0){
+        busy = true;
+      } else if(!idle){
+        idle = slave;
       }
     }
-    pthread_cleanup_pop(1);
-  } else {
-    ttservlog(g_serv, TTLOGERROR, "do_repl: tculrdnew failed");
+    if(!busy && idle) tculrdwait(idle->ulrd);
+  }
+  if(pthread_mutex_lock(&arg->rsmtx) == 0){
+    REPLSLAVE **slavep;
+    int ssiz;
+    while((slavep = tclistpop(rsend->slaves, &ssiz)) != NULL){
+      replslavedel(*slavep);
+      tcfree(slavep);
+    }
+    pthread_mutex_unlock(&arg->rsmtx);
+  }
+  return err ? "error" : NULL;
+}
+
+
+/* start the replication sender threads */
+static bool startreplsenders(TASKARG *arg){
+  bool err = false;
+  arg->rsterm = false;
+  for(int i = 0; i < REPLTHNUM; i++){
+    REPLSEND *rsend = arg->rsends + i;
+    if(rsend->alive) continue;
+    if(pthread_create(&rsend->thid, NULL, replsender, rsend) == 0){
+      rsend->alive = true;
+    } else {
+      err = true;
+      ttservlog(g_serv, TTLOGERROR, "pthread_create (replsender) failed");
+    }
+  }
+  return !err;
+}
+
+
+/* stop the replication sender threads and close the connections of their slaves */
+static bool stopreplsenders(TASKARG *arg){
+  if(pthread_mutex_lock(&arg->rsmtx) != 0) return false;
+  bool err = false;
+  arg->rsterm = true;
+  for(int i = 0; i < REPLTHNUM; i++){
+    TCLIST *slaves = arg->rsends[i].slaves;
+    for(int j = 0; j < tclistnum(slaves); j++){
+      REPLSLAVE *slave = *(REPLSLAVE **)tclistval2(slaves, j);
+      shutdown(slave->sock->fd, SHUT_RDWR);
+    }
+  }
+  if(pthread_cond_broadcast(&arg->rscnd) != 0){
+    err = true;
+    ttservlog(g_serv, TTLOGERROR, "pthread_cond_broadcast failed");
+  }
+  pthread_mutex_unlock(&arg->rsmtx);
+  for(int i = 0; i < REPLTHNUM; i++){
+    REPLSEND *rsend = arg->rsends + i;
+    if(!rsend->alive) continue;
+    void *rv;
+    if(pthread_join(rsend->thid, &rv) == 0){
+      if(rv) err = true;
+    } else {
+      err = true;
+      ttservlog(g_serv, TTLOGERROR, "pthread_join failed");
+    }
+    rsend->alive = false;
   }
+  return !err;
 }
 
 
 /* handle the memcached set command */
 static void do_mc_set(TTSOCK *sock, TASKARG *arg, TTREQ *req, char **tokens, int tnum){
   ttservlog(g_serv, TTLOGDEBUG, "doing mc_set command");
-  arg->counts[TTSEQNUM*req->idx+TTSEQPUT]++;
+  countcmd(arg, req, TTSEQPUT);
   uint64_t mask = arg->mask;
   TCADB *adb = arg->adb;
   TCULOG *ulog = arg->ulog;
@@ -2402,7 +4713,7 @@ static void do_mc_set(TTSOCK *sock, TASKARG *arg, TTREQ *req, char **tokens, int
     } else if(tculogadbput(ulog, sid, 0, adb, kbuf, ksiz, vbuf, vsiz)){
       len = sprintf(stack, "STORED\r\n");
     } else {
-      arg->counts[TTSEQNUM*req->idx+TTSEQPUTMISS]++;
+      ttmetricsadd(arg->metrics, req->idx, TTSEQPUTMISS, 1);
       len = sprintf(stack, "SERVER_ERROR unexpected\r\n");
       ttservlog(g_serv, TTLOGERROR, "do_mc_set: operation failed");
     }
@@ -2421,7 +4732,7 @@ static void do_mc_set(TTSOCK *sock, TASKARG *arg, TTREQ *req, char **tokens, int
 /* handle the memcached add command */
 static void do_mc_add(TTSOCK *sock, TASKARG *arg, TTREQ *req, char **tokens, int tnum){
   ttservlog(g_serv, TTLOGDEBUG, "doing mc_add command");
-  arg->counts[TTSEQNUM*req->idx+TTSEQPUTKEEP]++;
+  countcmd(arg, req, TTSEQPUTKEEP);
   uint64_t mask = arg->mask;
   TCADB *adb = arg->adb;
   TCULOG *ulog = arg->ulog;
@@ -2446,7 +4757,7 @@ static void do_mc_add(TTSOCK *sock, TASKARG *arg, TTREQ *req, char **tokens, int
     } else if(tculogadbputkeep(ulog, sid, 0, adb, kbuf, ksiz, vbuf, vsiz)){
       len = sprintf(stack, "STORED\r\n");
     } else {
-      arg->counts[TTSEQNUM*req->idx+TTSEQPUTMISS]++;
+      ttmetricsadd(arg->metrics, req->idx, TTSEQPUTMISS, 1);
       len = sprintf(stack, "NOT_STORED\r\n");
     }
     if(nr || ttsocksend(sock, stack, len)){
@@ -2464,7 +4775,7 @@ static void do_mc_add(TTSOCK *sock, TASKARG *arg, TTREQ *req, char **tokens, int
 /* handle the memcached replace command */
 static void do_mc_replace(TTSOCK *sock, TASKARG *arg, TTREQ *req, char **tokens, int tnum){
   ttservlog(g_serv, TTLOGDEBUG, "doing mc_replace command");
-  arg->counts[TTSEQNUM*req->idx+TTSEQPUT]++;
+  countcmd(arg, req, TTSEQPUT);
   uint64_t mask = arg->mask;
   TCADB *adb = arg->adb;
   TCULOG *ulog = arg->ulog;
@@ -2500,7 +4811,7 @@ static void do_mc_replace(TTSOCK *sock, TASKARG *arg, TTREQ *req, char **tokens,
           ttservlog(g_serv, TTLOGERROR, "do_mc_replace: operation failed");
         }
       } else {
-        arg->counts[TTSEQNUM*req->idx+TTSEQPUTMISS]++;
+        ttmetricsadd(arg->metrics, req->idx, TTSEQPUTMISS, 1);
         len = sprintf(stack, "NOT_STORED\r\n");
       }
       if(pthread_mutex_unlock(rmtxs + mtxidx) != 0)
@@ -2521,7 +4832,7 @@ static void do_mc_replace(TTSOCK *sock, TASKARG *arg, TTREQ *req, char **tokens,
 /* handle the memcached append command */
 static void do_mc_append(TTSOCK *sock, TASKARG *arg, TTREQ *req, char **tokens, int tnum){
   ttservlog(g_serv, TTLOGDEBUG, "doing mc_append command");
-  arg->counts[TTSEQNUM*req->idx+TTSEQPUT]++;
+  countcmd(arg, req, TTSEQPUT);
   uint64_t mask = arg->mask;
   TCADB *adb = arg->adb;
   TCULOG *ulog = arg->ulog;
@@ -2557,7 +4868,7 @@ static void do_mc_append(TTSOCK *sock, TASKARG *arg, TTREQ *req, char **tokens,
           ttservlog(g_serv, TTLOGERROR, "do_mc_append: operation failed");
         }
       } else {
-        arg->counts[TTSEQNUM*req->idx+TTSEQPUTMISS]++;
+        ttmetricsadd(arg->metrics, req->idx, TTSEQPUTMISS, 1);
         len = sprintf(stack, "NOT_STORED\r\n");
       }
       if(pthread_mutex_unlock(rmtxs + mtxidx) != 0)
@@ -2578,7 +4889,7 @@ static void do_mc_append(TTSOCK *sock, TASKARG *arg, TTREQ *req, char **tokens,
 /* handle the memcached prepend command */
 static void do_mc_prepend(TTSOCK *sock, TASKARG *arg, TTREQ *req, char **tokens, int tnum){
   ttservlog(g_serv, TTLOGDEBUG, "doing mc_prepend command");
-  arg->counts[TTSEQNUM*req->idx+TTSEQPUT]++;
+  countcmd(arg, req, TTSEQPUT);
   uint64_t mask = arg->mask;
   TCADB *adb = arg->adb;
   TCULOG *ulog = arg->ulog;
@@ -2617,7 +4928,7 @@ static void do_mc_prepend(TTSOCK *sock, TASKARG *arg, TTREQ *req, char **tokens,
         tcfree(nbuf);
         tcfree(obuf);
       } else {
-        arg->counts[TTSEQNUM*req->idx+TTSEQPUTMISS]++;
+        ttmetricsadd(arg->metrics, req->idx, TTSEQPUTMISS, 1);
         len = sprintf(stack, "NOT_STORED\r\n");
       }
       if(pthread_mutex_unlock(rmtxs + mtxidx) != 0)
@@ -2638,6 +4949,7 @@ static void do_mc_prepend(TTSOCK *sock, TASKARG *arg, TTREQ *req, char **tokens,
 /* handle the memcached get command */
 static void do_mc_get(TTSOCK *sock, TASKARG *arg, TTREQ *req, char **tokens, int tnum){
   ttservlog(g_serv, TTLOGDEBUG, "doing mc_get command");
+  arg->lats[req->idx].seq = TTSEQGET;
   uint64_t mask = arg->mask;
   TCADB *adb = arg->adb;
   if(tnum < 2){
@@ -2647,7 +4959,7 @@ static void do_mc_get(TTSOCK *sock, TASKARG *arg, TTREQ *req, char **tokens, int
   TCXSTR *xstr = tcxstrnew();
   pthread_cleanup_push((void (*)(void *))tcxstrdel, xstr);
   for(int i = 1; i < tnum; i++){
-    arg->counts[TTSEQNUM*req->idx+TTSEQGET]++;
+    ttmetricsadd(arg->metrics, req->idx, TTSEQGET, 1);
     const char *kbuf = tokens[i];
     int ksiz = strlen(kbuf);
     int vsiz;
@@ -2657,7 +4969,9 @@ static void do_mc_get(TTSOCK *sock, TASKARG *arg, TTREQ *req, char **tokens, int
       vsiz = 0;
       ttservlog(g_serv, TTLOGINFO, "do_mc_get: forbidden");
     } else {
+      tttracemark(TTTSDBBEGIN);
       vbuf = tcadbget(adb, kbuf, ksiz, &vsiz);
+      tttracemark(TTTSDBEND);
     }
     if(vbuf){
       tcxstrprintf(xstr, "VALUE %s 0 %d\r\n", kbuf, vsiz);
@@ -2665,7 +4979,7 @@ static void do_mc_get(TTSOCK *sock, TASKARG *arg, TTREQ *req, char **tokens, int
       tcxstrcat(xstr, "\r\n", 2);
       tcfree(vbuf);
     } else {
-      arg->counts[TTSEQNUM*req->idx+TTSEQGETMISS]++;
+      ttmetricsadd(arg->metrics, req->idx, TTSEQGETMISS, 1);
     }
   }
   tcxstrprintf(xstr, "END\r\n");
@@ -2681,7 +4995,7 @@ static void do_mc_get(TTSOCK *sock, TASKARG *arg, TTREQ *req, char **tokens, int
 /* handle the memcached delete command */
 static void do_mc_delete(TTSOCK *sock, TASKARG *arg, TTREQ *req, char **tokens, int tnum){
   ttservlog(g_serv, TTLOGDEBUG, "doing mc_delete command");
-  arg->counts[TTSEQNUM*req->idx+TTSEQOUT]++;
+  countcmd(arg, req, TTSEQOUT);
   uint64_t mask = arg->mask;
   TCADB *adb = arg->adb;
   TCULOG *ulog = arg->ulog;
@@ -2702,7 +5016,7 @@ static void do_mc_delete(TTSOCK *sock, TASKARG *arg, TTREQ *req, char **tokens,
   } else if(tculogadbout(ulog, sid, 0, adb, kbuf, ksiz)){
     len = sprintf(stack, "DELETED\r\n");
   } else {
-    arg->counts[TTSEQNUM*req->idx+TTSEQOUTMISS]++;
+    ttmetricsadd(arg->metrics, req->idx, TTSEQOUTMISS, 1);
     len = sprintf(stack, "NOT_FOUND\r\n");
   }
   if(nr || ttsocksend(sock, stack, len)){
@@ -2716,7 +5030,7 @@ static void do_mc_delete(TTSOCK *sock, TASKARG *arg, TTREQ *req, char **tokens,
 /* handle the memcached incr command */
 static void do_mc_incr(TTSOCK *sock, TASKARG *arg, TTREQ *req, char **tokens, int tnum){
   ttservlog(g_serv, TTLOGDEBUG, "doing mc_incr command");
-  arg->counts[TTSEQNUM*req->idx+TTSEQADDINT]++;
+  countcmd(arg, req, TTSEQADDINT);
   uint64_t mask = arg->mask;
   TCADB *adb = arg->adb;
   TCULOG *ulog = arg->ulog;
@@ -2772,7 +5086,7 @@ static void do_mc_incr(TTSOCK *sock, TASKARG *arg, TTREQ *req, char **tokens, in
 /* handle the memcached decr command */
 static void do_mc_decr(TTSOCK *sock, TASKARG *arg, TTREQ *req, char **tokens, int tnum){
   ttservlog(g_serv, TTLOGDEBUG, "doing mc_decr command");
-  arg->counts[TTSEQNUM*req->idx+TTSEQADDINT]++;
+  countcmd(arg, req, TTSEQADDINT);
   uint64_t mask = arg->mask;
   TCADB *adb = arg->adb;
   TCULOG *ulog = arg->ulog;
@@ -2828,64 +5142,83 @@ static void do_mc_decr(TTSOCK *sock, TASKARG *arg, TTREQ *req, char **tokens, in
 /* handle the memcached stat command */
 static void do_mc_stats(TTSOCK *sock, TASKARG *arg, TTREQ *req, char **tokens, int tnum){
   ttservlog(g_serv, TTLOGDEBUG, "doing mc_stats command");
-  arg->counts[TTSEQNUM*req->idx+TTSEQSTAT]++;
+  countcmd(arg, req, TTSEQSTAT);
   uint64_t mask = arg->mask;
   TCADB *adb = arg->adb;
-  char stack[TTIOBUFSIZ];
-  char *wp = stack;
+  TCXSTR *xstr = tcxstrnew();
+  pthread_cleanup_push((void (*)(void *))tcxstrdel, xstr);
   if(mask & ((1ULL << TTSEQSTAT) | (1ULL << TTSEQALLMC) | (1ULL << TTSEQALLREAD))){
     ttservlog(g_serv, TTLOGINFO, "do_mc_stats: forbidden");
   } else {
-    wp += sprintf(wp, "STAT pid %lld\r\n", (long long)getpid());
+    tcxstrprintf(xstr, "STAT pid %lld\r\n", (long long)getpid());
     time_t now = time(NULL);
-    wp += sprintf(wp, "STAT uptime %lld\r\n", (long long)(now - (int)g_starttime));
-    wp += sprintf(wp, "STAT time %lld\r\n", (long long)now);
-    wp += sprintf(wp, "STAT version %s\r\n", ttversion);
-    wp += sprintf(wp, "STAT pointer_size %d\r\n", (int)sizeof(void *) * 8);
+    tcxstrprintf(xstr, "STAT uptime %lld\r\n", (long long)(now - (int)g_starttime));
+    tcxstrprintf(xstr, "STAT time %lld\r\n", (long long)now);
+    tcxstrprintf(xstr, "STAT version %s\r\n", ttversion);
+    tcxstrprintf(xstr, "STAT pointer_size %d\r\n", (int)sizeof(void *) * 8);
     struct rusage ubuf;
     memset(&ubuf, 0, sizeof(ubuf));
     if(getrusage(RUSAGE_SELF, &ubuf) == 0){
-      wp += sprintf(wp, "STAT rusage_user %d.%06d\r\n",
-                    (int)ubuf.ru_utime.tv_sec, (int)ubuf.ru_utime.tv_usec);
-      wp += sprintf(wp, "STAT rusage_system %d.%06d\r\n",
-                    (int)ubuf.ru_stime.tv_sec, (int)ubuf.ru_stime.tv_usec);
-    }
-    uint64_t putsum = sumstat(arg, TTSEQPUT) + sumstat(arg, TTSEQPUTKEEP) +
-      sumstat(arg, TTSEQPUTCAT) + sumstat(arg, TTSEQPUTSHL) + sumstat(arg, TTSEQPUTNR);
-    uint64_t putmiss = sumstat(arg, TTSEQPUTMISS);
-    wp += sprintf(wp, "STAT cmd_set %llu\r\n", (unsigned long long)putsum);
-    wp += sprintf(wp, "STAT cmd_set_hits %llu\r\n", (unsigned long long)(putsum - putmiss));
-    wp += sprintf(wp, "STAT cmd_set_misses %llu\r\n", (unsigned long long)putmiss);
-    uint64_t outsum = sumstat(arg, TTSEQOUT);
-    uint64_t outmiss = sumstat(arg, TTSEQOUTMISS);
-    wp += sprintf(wp, "STAT cmd_delete %llu\r\n", (unsigned long long)outsum);
-    wp += sprintf(wp, "STAT cmd_delete_hits %llu\r\n", (unsigned long long)(outsum - outmiss));
-    wp += sprintf(wp, "STAT cmd_delete_misses %llu\r\n", (unsigned long long)outmiss);
-    uint64_t getsum = sumstat(arg, TTSEQGET);
-    uint64_t getmiss = sumstat(arg, TTSEQGETMISS);
-    wp += sprintf(wp, "STAT cmd_get %llu\r\n", (unsigned long long)getsum);
-    wp += sprintf(wp, "STAT cmd_get_hits %llu\r\n", (unsigned long long)(getsum - getmiss));
-    wp += sprintf(wp, "STAT cmd_get_misses %llu\r\n", (unsigned long long)getmiss);
-    wp += sprintf(wp, "STAT cmd_flush %llu\r\n", (unsigned long long)sumstat(arg, TTSEQVANISH));
+      tcxstrprintf(xstr, "STAT rusage_user %d.%06d\r\n",
+                   (int)ubuf.ru_utime.tv_sec, (int)ubuf.ru_utime.tv_usec);
+      tcxstrprintf(xstr, "STAT rusage_system %d.%06d\r\n",
+                   (int)ubuf.ru_stime.tv_sec, (int)ubuf.ru_stime.tv_usec);
+    }
+    TTMETRICS *metrics = arg->metrics;
+    uint64_t putsum = ttmetricssum(metrics, TTSEQPUT) + ttmetricssum(metrics, TTSEQPUTKEEP) +
+      ttmetricssum(metrics, TTSEQPUTCAT) + ttmetricssum(metrics, TTSEQPUTSHL) +
+      ttmetricssum(metrics, TTSEQPUTNR);
+    uint64_t putmiss = ttmetricssum(metrics, TTSEQPUTMISS);
+    tcxstrprintf(xstr, "STAT cmd_set %llu\r\n", (unsigned long long)putsum);
+    tcxstrprintf(xstr, "STAT cmd_set_hits %llu\r\n", (unsigned long long)(putsum - putmiss));
+    tcxstrprintf(xstr, "STAT cmd_set_misses %llu\r\n", (unsigned long long)putmiss);
+    uint64_t outsum = ttmetricssum(metrics, TTSEQOUT);
+    uint64_t outmiss = ttmetricssum(metrics, TTSEQOUTMISS);
+    tcxstrprintf(xstr, "STAT cmd_delete %llu\r\n", (unsigned long long)outsum);
+    tcxstrprintf(xstr, "STAT cmd_delete_hits %llu\r\n", (unsigned long long)(outsum - outmiss));
+    tcxstrprintf(xstr, "STAT cmd_delete_misses %llu\r\n", (unsigned long long)outmiss);
+    uint64_t getsum = ttmetricssum(metrics, TTSEQGET);
+    uint64_t getmiss = ttmetricssum(metrics, TTSEQGETMISS);
+    tcxstrprintf(xstr, "STAT cmd_get %llu\r\n", (unsigned long long)getsum);
+    tcxstrprintf(xstr, "STAT cmd_get_hits %llu\r\n", (unsigned long long)(getsum - getmiss));
+    tcxstrprintf(xstr, "STAT cmd_get_misses %llu\r\n", (unsigned long long)getmiss);
+    uint64_t flushsum = ttmetricssum(metrics, TTSEQVANISH);
+    tcxstrprintf(xstr, "STAT cmd_flush %llu\r\n", (unsigned long long)flushsum);
     int64_t rnum = tcadbrnum(adb);
-    wp += sprintf(wp, "STAT curr_items %lld\r\n", (long long)rnum);
-    wp += sprintf(wp, "STAT total_items %lld\r\n", (long long)rnum);
-    wp += sprintf(wp, "STAT bytes %lld\r\n", (long long)tcadbsize(adb));
-    wp += sprintf(wp, "STAT threads %d\r\n", arg->thnum);
-    wp += sprintf(wp, "END\r\n");
+    tcxstrprintf(xstr, "STAT curr_items %lld\r\n", (long long)rnum);
+    tcxstrprintf(xstr, "STAT total_items %lld\r\n", (long long)rnum);
+    tcxstrprintf(xstr, "STAT bytes %lld\r\n", (long long)tcadbsize(adb));
+    tcxstrprintf(xstr, "STAT threads %d\r\n", arg->thnum);
+    int mtid = ttmetricsfind(metrics, "connections");
+    if(mtid >= 0)
+      tcxstrprintf(xstr, "STAT curr_connections %lld\r\n", (long long)ttmetricssum(metrics, mtid));
+    mtid = ttmetricsfind(metrics, "conn_opened");
+    if(mtid >= 0)
+      tcxstrprintf(xstr, "STAT total_connections %lld\r\n", (long long)ttmetricssum(metrics, mtid));
+    uint64_t rsum = 0;
+    uint64_t ssum = 0;
+    for(int i = MTBININ; i < MTREPLOUT; i += 2){
+      rsum += ttmetricssum(metrics, i);
+      ssum += ttmetricssum(metrics, i + 1);
+    }
+    tcxstrprintf(xstr, "STAT bytes_read %llu\r\n", (unsigned long long)rsum);
+    tcxstrprintf(xstr, "STAT bytes_written %llu\r\n", (unsigned long long)ssum);
+    printlats(arg, xstr, "STAT ", ' ', "\r\n");
+    tcxstrprintf(xstr, "END\r\n");
   }
-  if(ttsocksend(sock, stack, wp - stack)){
+  if(ttsocksend(sock, tcxstrptr(xstr), tcxstrsize(xstr))){
     req->keep = true;
   } else {
     ttservlog(g_serv, TTLOGINFO, "do_mc_stats: response failed");
   }
+  pthread_cleanup_pop(1);
 }
 
 
 /* handle the memcached flush_all command */
 static void do_mc_flushall(TTSOCK *sock, TASKARG *arg, TTREQ *req, char **tokens, int tnum){
   ttservlog(g_serv, TTLOGINFO, "doing mc_flushall command");
-  arg->counts[TTSEQNUM*req->idx+TTSEQVANISH]++;
+  countcmd(arg, req, TTSEQVANISH);
   uint64_t mask = arg->mask;
   TCADB *adb = arg->adb;
   TCULOG *ulog = arg->ulog;
@@ -2914,7 +5247,7 @@ static void do_mc_flushall(TTSOCK *sock, TASKARG *arg, TTREQ *req, char **tokens
 /* handle the memcached version command */
 static void do_mc_version(TTSOCK *sock, TASKARG *arg, TTREQ *req, char **tokens, int tnum){
   ttservlog(g_serv, TTLOGDEBUG, "doing mc_version command");
-  arg->counts[TTSEQNUM*req->idx+TTSEQSTAT]++;
+  countcmd(arg, req, TTSEQSTAT);
   uint64_t mask = arg->mask;
   char stack[TTIOBUFSIZ];
   int len;
@@ -2941,7 +5274,7 @@ static void do_mc_quit(TTSOCK *sock, TASKARG *arg, TTREQ *req, char **tokens, in
 /* handle the HTTP GET command */
 static void do_http_get(TTSOCK *sock, TASKARG *arg, TTREQ *req, int ver, const char *uri){
   ttservlog(g_serv, TTLOGDEBUG, "doing http_get command");
-  arg->counts[TTSEQNUM*req->idx+TTSEQGET]++;
+  countcmd(arg, req, TTSEQGET);
   uint64_t mask = arg->mask;
   TCADB *adb = arg->adb;
   bool keep = ver >= 1;
@@ -2977,7 +5310,9 @@ static void do_http_get(TTSOCK *sock, TASKARG *arg, TTREQ *req, int ver, const c
     ttservlog(g_serv, TTLOGINFO, "do_http_get: forbidden");
   } else {
     int vsiz;
+    tttracemark(TTTSDBBEGIN);
     char *vbuf = tcadbget(adb, kbuf, ksiz, &vsiz);
+    tttracemark(TTTSDBEND);
     if(vbuf){
       tcxstrprintf(xstr, "HTTP/1.1 200 OK\r\n");
       tcxstrprintf(xstr, "Content-Type: application/octet-stream\r\n");
@@ -2986,7 +5321,7 @@ static void do_http_get(TTSOCK *sock, TASKARG *arg, TTREQ *req, int ver, const c
       tcxstrcat(xstr, vbuf, vsiz);
       tcfree(vbuf);
     } else {
-      arg->counts[TTSEQNUM*req->idx+TTSEQGETMISS]++;
+      ttmetricsadd(arg->metrics, req->idx, TTSEQGETMISS, 1);
       int len = sprintf(line, "Not Found\n");
       tcxstrprintf(xstr, "HTTP/1.1 404 Not Found\r\n");
       tcxstrprintf(xstr, "Content-Type: text/plain\r\n");
@@ -3005,10 +5340,250 @@ static void do_http_get(TTSOCK *sock, TASKARG *arg, TTREQ *req, int ver, const c
 }
 
 
+/* handle the HTTP GET command of the latency statistics */
+static void do_http_latency(TTSOCK *sock, TASKARG *arg, TTREQ *req, int ver){
+  ttservlog(g_serv, TTLOGDEBUG, "doing http_latency command");
+  countcmd(arg, req, TTSEQSTAT);
+  uint64_t mask = arg->mask;
+  bool keep = ver >= 1;
+  char line[LINEBUFSIZ];
+  while(ttsockgets(sock, line, LINEBUFSIZ) && *line != '\0'){
+    char *pv = strchr(line, ':');
+    if(!pv) continue;
+    *(pv++) = '\0';
+    while(*pv == ' ' || *pv == '\t'){
+      pv++;
+    }
+    if(!tcstricmp(line, "connection")){
+      if(!tcstricmp(pv, "close")){
+        keep = false;
+      } else if(!tcstricmp(pv, "keep-alive")){
+        keep = true;
+      }
+    }
+  }
+  TCXSTR *body = tcxstrnew();
+  pthread_cleanup_push((void (*)(void *))tcxstrdel, body);
+  int code = 200;
+  if(mask & ((1ULL << TTSEQSTAT) | (1ULL << TTSEQALLHTTP) | (1ULL << TTSEQALLREAD))){
+    code = 403;
+    tcxstrprintf(body, "Forbidden\n");
+    ttservlog(g_serv, TTLOGINFO, "do_http_latency: forbidden");
+  } else {
+    printlats(arg, body, "", '\t', "\n");
+  }
+  TCXSTR *xstr = tcxstrnew();
+  pthread_cleanup_push((void (*)(void *))tcxstrdel, xstr);
+  tcxstrprintf(xstr, "HTTP/1.1 %s\r\n", code == 200 ? "200 OK" : "403 Forbidden");
+  tcxstrprintf(xstr, "Content-Type: text/plain\r\n");
+  tcxstrprintf(xstr, "Content-Length: %d\r\n", tcxstrsize(body));
+  tcxstrprintf(xstr, "\r\n");
+  tcxstrcat(xstr, tcxstrptr(body), tcxstrsize(body));
+  if(ttsocksend(sock, tcxstrptr(xstr), tcxstrsize(xstr))){
+    req->keep = keep;
+  } else {
+    ttservlog(g_serv, TTLOGINFO, "do_http_latency: response failed");
+  }
+  pthread_cleanup_pop(1);
+  pthread_cleanup_pop(1);
+}
+
+
+/* handle the HTTP GET command of metrics */
+static void do_http_metrics(TTSOCK *sock, TASKARG *arg, TTREQ *req, int ver){
+  ttservlog(g_serv, TTLOGDEBUG, "doing http_metrics command");
+  countcmd(arg, req, TTSEQSTAT);
+  uint64_t mask = arg->mask;
+  bool keep = ver >= 1;
+  char line[LINEBUFSIZ];
+  while(ttsockgets(sock, line, LINEBUFSIZ) && *line != '\0'){
+    char *pv = strchr(line, ':');
+    if(!pv) continue;
+    *(pv++) = '\0';
+    while(*pv == ' ' || *pv == '\t'){
+      pv++;
+    }
+    if(!tcstricmp(line, "connection")){
+      if(!tcstricmp(pv, "close")){
+        keep = false;
+      } else if(!tcstricmp(pv, "keep-alive")){
+        keep = true;
+      }
+    }
+  }
+  TCXSTR *xstr = arg->mtbufs[req->idx];
+  tcxstrclear(xstr);
+  int code = 200;
+  if(mask & ((1ULL << TTSEQSTAT) | (1ULL << TTSEQALLHTTP) | (1ULL << TTSEQALLREAD))){
+    code = 403;
+    tcxstrcat2(xstr, "Forbidden\n");
+    ttservlog(g_serv, TTLOGINFO, "do_http_metrics: forbidden");
+  } else {
+    TTMETRICS *metrics = arg->metrics;
+    TCADB *adb = arg->adb;
+    TCULOG *ulog = arg->ulog;
+    REPLARG *sarg = arg->sarg;
+    double now = tctime();
+    tcxstrprintf(xstr, "# TYPE ttserver_commands counter\n");
+    for(int i = 0; i < TTSEQCMDNUM; i++){
+      tcxstrprintf(xstr, "ttserver_commands_total{command=\"%s\"} %lld\n",
+                   g_seqnames[i], (long long)ttmetricssum(metrics, i));
+    }
+    tcxstrprintf(xstr, "# TYPE ttserver_misses counter\n");
+    tcxstrprintf(xstr, "ttserver_misses_total{command=\"put\"} %lld\n",
+                 (long long)ttmetricssum(metrics, TTSEQPUTMISS));
+    tcxstrprintf(xstr, "ttserver_misses_total{command=\"out\"} %lld\n",
+                 (long long)ttmetricssum(metrics, TTSEQOUTMISS));
+    tcxstrprintf(xstr, "ttserver_misses_total{command=\"get\"} %lld\n",
+                 (long long)ttmetricssum(metrics, TTSEQGETMISS));
+    int mnum = ttmetricsnum(metrics);
+    for(int i = TTSEQNUM; i < mnum; i++){
+      char name[TTADDRBUFSIZ];
+      const char *rp = ttmetricsname(metrics, i);
+      int len = 0;
+      while(*rp != '\0' && len < TTADDRBUFSIZ - 1){
+        name[len++] = (isalnum(*(unsigned char *)rp) || *rp == '_') ? *rp : '_';
+        rp++;
+      }
+      name[len] = '\0';
+      if(ttmetricstype(metrics, i) == TTMTGAUGE){
+        tcxstrprintf(xstr, "# TYPE ttserver_%s gauge\n", name);
+        tcxstrprintf(xstr, "ttserver_%s %lld\n", name, (long long)ttmetricssum(metrics, i));
+      } else {
+        tcxstrprintf(xstr, "# TYPE ttserver_%s counter\n", name);
+        tcxstrprintf(xstr, "ttserver_%s_total %lld\n", name, (long long)ttmetricssum(metrics, i));
+      }
+    }
+    tcxstrprintf(xstr, "# TYPE ttserver_latency_seconds histogram\n");
+    tcxstrprintf(xstr, "# UNIT ttserver_latency_seconds seconds\n");
+    const char *phnames[LATPHNUM] = { "queue", "exec", "send" };
+    int thnum = arg->thnum + ADMTHNUM;
+    for(int i = 0; i < TTSEQCMDNUM; i++){
+      for(int j = 0; j < LATPHNUM; j++){
+        uint64_t buckets[LATBKTNUM];
+        uint64_t sum = 0;
+        for(int k = 0; k < LATBKTNUM; k++){
+          buckets[k] = 0;
+          for(int t = 0; t < thnum; t++){
+            buckets[k] += arg->lats[t].buckets[i][j][k];
+          }
+          sum += buckets[k];
+        }
+        if(sum < 1) continue;
+        uint64_t cnt = 0;
+        for(int k = 0; k < LATBKTNUM - 1 && cnt < sum; k++){
+          cnt += buckets[k];
+          if((k + 1) % LATSUBNUM != 0) continue;
+          tcxstrprintf(xstr, "ttserver_latency_seconds_bucket{command=\"%s\",phase=\"%s\","
+                       "le=\"%g\"} %llu\n", g_seqnames[i], phnames[j],
+                       (latbound(k) + 1) / 1000000.0, (unsigned long long)cnt);
+        }
+        tcxstrprintf(xstr, "ttserver_latency_seconds_bucket{command=\"%s\",phase=\"%s\","
+                     "le=\"+Inf\"} %llu\n", g_seqnames[i], phnames[j], (unsigned long long)sum);
+      }
+    }
+    if(ulog->base){
+      uint64_t buckets[LATBKTNUM];
+      uint64_t sum = 0;
+      for(int i = 0; i < LATBKTNUM; i++){
+        buckets[i] = arg->slats[i];
+        sum += buckets[i];
+      }
+      tcxstrprintf(xstr, "# TYPE ttserver_ulog_sync_seconds histogram\n");
+      tcxstrprintf(xstr, "# UNIT ttserver_ulog_sync_seconds seconds\n");
+      uint64_t cnt = 0;
+      for(int i = 0; i < LATBKTNUM - 1 && cnt < sum; i++){
+        cnt += buckets[i];
+        if((i + 1) % LATSUBNUM != 0) continue;
+        tcxstrprintf(xstr, "ttserver_ulog_sync_seconds_bucket{le=\"%g\"} %llu\n",
+                     (latbound(i) + 1) / 1000000.0, (unsigned long long)cnt);
+      }
+      tcxstrprintf(xstr, "ttserver_ulog_sync_seconds_bucket{le=\"+Inf\"} %llu\n",
+                   (unsigned long long)sum);
+    }
+    tcxstrprintf(xstr, "# TYPE ttserver_queue gauge\n");
+    tcxstrprintf(xstr, "ttserver_queue %d\n", ttservqueuenum(g_serv));
+    if(pthread_mutex_lock(&arg->admmtx) == 0){
+      tcxstrprintf(xstr, "# TYPE ttserver_admin_queue gauge\n");
+      tcxstrprintf(xstr, "ttserver_admin_queue %d\n", tclistnum(arg->admjobs));
+      pthread_mutex_unlock(&arg->admmtx);
+    }
+    if(sarg->host[0] != '\0'){
+      double delay = now - sarg->rts / 1000000.0;
+      tcxstrprintf(xstr, "# TYPE ttserver_replication_delay_seconds gauge\n");
+      tcxstrprintf(xstr, "# UNIT ttserver_replication_delay_seconds seconds\n");
+      tcxstrprintf(xstr, "ttserver_replication_delay_seconds %.6f\n", delay >= 0 ? delay : 0.0);
+    }
+    if(ulog->base){
+      tcxstrprintf(xstr, "# TYPE ttserver_ulog_files gauge\n");
+      tcxstrprintf(xstr, "ttserver_ulog_files %d\n", ulog->max);
+      tcxstrprintf(xstr, "# TYPE ttserver_ulog_file_size_bytes gauge\n");
+      tcxstrprintf(xstr, "# UNIT ttserver_ulog_file_size_bytes bytes\n");
+      tcxstrprintf(xstr, "ttserver_ulog_file_size_bytes %llu\n", (unsigned long long)ulog->size);
+      tcxstrprintf(xstr, "# TYPE ttserver_ulog_durable_size_bytes gauge\n");
+      tcxstrprintf(xstr, "# UNIT ttserver_ulog_durable_size_bytes bytes\n");
+      tcxstrprintf(xstr, "ttserver_ulog_durable_size_bytes %llu\n",
+                   (unsigned long long)ulog->dsize);
+    }
+    tcxstrprintf(xstr, "# TYPE ttserver_records gauge\n");
+    tcxstrprintf(xstr, "ttserver_records %llu\n", (unsigned long long)tcadbrnum(adb));
+    tcxstrprintf(xstr, "# TYPE ttserver_db_size_bytes gauge\n");
+    tcxstrprintf(xstr, "# UNIT ttserver_db_size_bytes bytes\n");
+    tcxstrprintf(xstr, "ttserver_db_size_bytes %llu\n", (unsigned long long)tcadbsize(adb));
+    tcxstrprintf(xstr, "# TYPE ttserver_load_average gauge\n");
+    tcxstrprintf(xstr, "ttserver_load_average %.6f\n", ttgetloadavg());
+    TCMAP *info = tcsysinfo();
+    if(info){
+      const char *vbuf = tcmapget2(info, "size");
+      if(vbuf){
+        tcxstrprintf(xstr, "# TYPE ttserver_memory_size_bytes gauge\n");
+        tcxstrprintf(xstr, "# UNIT ttserver_memory_size_bytes bytes\n");
+        tcxstrprintf(xstr, "ttserver_memory_size_bytes %s\n", vbuf);
+      }
+      vbuf = tcmapget2(info, "rss");
+      if(vbuf){
+        tcxstrprintf(xstr, "# TYPE ttserver_memory_rss_bytes gauge\n");
+        tcxstrprintf(xstr, "# UNIT ttserver_memory_rss_bytes bytes\n");
+        tcxstrprintf(xstr, "ttserver_memory_rss_bytes %s\n", vbuf);
+      }
+      vbuf = tcmapget2(info, "utime");
+      if(vbuf){
+        tcxstrprintf(xstr, "# TYPE ttserver_cpu_user_seconds counter\n");
+        tcxstrprintf(xstr, "# UNIT ttserver_cpu_user_seconds seconds\n");
+        tcxstrprintf(xstr, "ttserver_cpu_user_seconds_total %s\n", vbuf);
+      }
+      vbuf = tcmapget2(info, "stime");
+      if(vbuf){
+        tcxstrprintf(xstr, "# TYPE ttserver_cpu_system_seconds counter\n");
+        tcxstrprintf(xstr, "# UNIT ttserver_cpu_system_seconds seconds\n");
+        tcxstrprintf(xstr, "ttserver_cpu_system_seconds_total %s\n", vbuf);
+      }
+      tcmapdel(info);
+    }
+    tcxstrprintf(xstr, "# TYPE ttserver_uptime_seconds gauge\n");
+    tcxstrprintf(xstr, "# UNIT ttserver_uptime_seconds seconds\n");
+    tcxstrprintf(xstr, "ttserver_uptime_seconds %.6f\n", now - g_starttime);
+    tcxstrprintf(xstr, "# EOF\n");
+  }
+  char head[LINEBUFSIZ];
+  char *wp = head;
+  wp += sprintf(wp, "HTTP/1.1 %s\r\n", code == 200 ? "200 OK" : "403 Forbidden");
+  wp += sprintf(wp, "Content-Type: %s\r\n", code == 200 ?
+                "application/openmetrics-text; version=1.0.0; charset=utf-8" : "text/plain");
+  wp += sprintf(wp, "Content-Length: %d\r\n", tcxstrsize(xstr));
+  wp += sprintf(wp, "\r\n");
+  if(ttsocksend(sock, head, wp - head) && ttsocksend(sock, tcxstrptr(xstr), tcxstrsize(xstr))){
+    req->keep = keep;
+  } else {
+    ttservlog(g_serv, TTLOGINFO, "do_http_metrics: response failed");
+  }
+}
+
+
 /* handle the HTTP HEAD command */
 static void do_http_head(TTSOCK *sock, TASKARG *arg, TTREQ *req, int ver, const char *uri){
   ttservlog(g_serv, TTLOGDEBUG, "doing http_head command");
-  arg->counts[TTSEQNUM*req->idx+TTSEQVSIZ]++;
+  countcmd(arg, req, TTSEQVSIZ);
   uint64_t mask = arg->mask;
   TCADB *adb = arg->adb;
   bool keep = ver >= 1;
@@ -3039,7 +5614,9 @@ static void do_http_head(TTSOCK *sock, TASKARG *arg, TTREQ *req, int ver, const
     tcxstrprintf(xstr, "\r\n");
     ttservlog(g_serv, TTLOGINFO, "do_http_head: forbidden");
   } else {
+    tttracemark(TTTSDBBEGIN);
     int vsiz = tcadbvsiz(adb, kbuf, ksiz);
+    tttracemark(TTTSDBEND);
     if(vsiz >= 0){
       tcxstrprintf(xstr, "HTTP/1.1 200 OK\r\n");
       tcxstrprintf(xstr, "Content-Type: application/octet-stream\r\n");
@@ -3063,7 +5640,7 @@ static void do_http_head(TTSOCK *sock, TASKARG *arg, TTREQ *req, int ver, const
 /* handle the HTTP PUT command */
 static void do_http_put(TTSOCK *sock, TASKARG *arg, TTREQ *req, int ver, const char *uri){
   ttservlog(g_serv, TTLOGDEBUG, "doing http_put command");
-  arg->counts[TTSEQNUM*req->idx+TTSEQPUT]++;
+  countcmd(arg, req, TTSEQPUT);
   uint64_t mask = arg->mask;
   TCADB *adb = arg->adb;
   TCULOG *ulog = arg->ulog;
@@ -3120,7 +5697,7 @@ static void do_http_put(TTSOCK *sock, TASKARG *arg, TTREQ *req, int ver, const c
             tcxstrprintf(xstr, "\r\n");
             tcxstrcat(xstr, line, len);
           } else {
-            arg->counts[TTSEQNUM*req->idx+TTSEQPUTMISS]++;
+            ttmetricsadd(arg->metrics, req->idx, TTSEQPUTMISS, 1);
             int len = sprintf(line, "Conflict\n");
             tcxstrprintf(xstr, "HTTP/1.1 409 Conflict\r\n");
             tcxstrprintf(xstr, "Content-Type: text/plain\r\n");
@@ -3138,7 +5715,7 @@ static void do_http_put(TTSOCK *sock, TASKARG *arg, TTREQ *req, int ver, const c
             tcxstrprintf(xstr, "\r\n");
             tcxstrcat(xstr, line, len);
           } else {
-            arg->counts[TTSEQNUM*req->idx+TTSEQPUTMISS]++;
+            ttmetricsadd(arg->metrics, req->idx, TTSEQPUTMISS, 1);
             int len = sprintf(line, "Internal Server Error\n");
             tcxstrprintf(xstr, "HTTP/1.1 500 Internal Server Error\r\n");
             tcxstrprintf(xstr, "Content-Type: text/plain\r\n");
@@ -3157,7 +5734,7 @@ static void do_http_put(TTSOCK *sock, TASKARG *arg, TTREQ *req, int ver, const c
             tcxstrprintf(xstr, "\r\n");
             tcxstrcat(xstr, line, len);
           } else {
-            arg->counts[TTSEQNUM*req->idx+TTSEQPUTMISS]++;
+            ttmetricsadd(arg->metrics, req->idx, TTSEQPUTMISS, 1);
             int len = sprintf(line, "Internal Server Error\n");
             tcxstrprintf(xstr, "HTTP/1.1 500 Internal Server Error\r\n");
             tcxstrprintf(xstr, "Content-Type: text/plain\r\n");
@@ -3185,7 +5762,7 @@ static void do_http_put(TTSOCK *sock, TASKARG *arg, TTREQ *req, int ver, const c
 /* handle the HTTP POST command */
 static void do_http_post(TTSOCK *sock, TASKARG *arg, TTREQ *req, int ver, const char *uri){
   ttservlog(g_serv, TTLOGDEBUG, "doing http_post command");
-  arg->counts[TTSEQNUM*req->idx+TTSEQEXT]++;
+  countcmd(arg, req, TTSEQEXT);
   uint64_t mask = arg->mask;
   pthread_mutex_t *rmtxs = arg->rmtxs;
   void *scr = arg->screxts[req->idx];
@@ -3376,7 +5953,7 @@ static void do_http_post(TTSOCK *sock, TASKARG *arg, TTREQ *req, int ver, const
 /* handle the HTTP DELETE command */
 static void do_http_delete(TTSOCK *sock, TASKARG *arg, TTREQ *req, int ver, const char *uri){
   ttservlog(g_serv, TTLOGDEBUG, "doing http_delete command");
-  arg->counts[TTSEQNUM*req->idx+TTSEQOUT]++;
+  countcmd(arg, req, TTSEQOUT);
   uint64_t mask = arg->mask;
   TCADB *adb = arg->adb;
   TCULOG *ulog = arg->ulog;
@@ -3421,7 +5998,7 @@ static void do_http_delete(TTSOCK *sock, TASKARG *arg, TTREQ *req, int ver, cons
       tcxstrprintf(xstr, "\r\n");
       tcxstrcat(xstr, line, len);
     } else {
-      arg->counts[TTSEQNUM*req->idx+TTSEQOUTMISS]++;
+      ttmetricsadd(arg->metrics, req->idx, TTSEQOUTMISS, 1);
       int len = sprintf(line, "Not Found\n");
       tcxstrprintf(xstr, "HTTP/1.1 404 Not Found\r\n");
       tcxstrprintf(xstr, "Content-Type: text/plain\r\n");
@@ -3443,7 +6020,7 @@ static void do_http_delete(TTSOCK *sock, TASKARG *arg, TTREQ *req, int ver, cons
 /* handle the HTTP OPTIONS command */
 static void do_http_options(TTSOCK *sock, TASKARG *arg, TTREQ *req, int ver, const char *uri){
   ttservlog(g_serv, TTLOGDEBUG, "doing http_options command");
-  arg->counts[TTSEQNUM*req->idx+TTSEQSTAT]++;
+  countcmd(arg, req, TTSEQSTAT);
   uint64_t mask = arg->mask;
   TCADB *adb = arg->adb;
   REPLARG *sarg = arg->sarg;
@@ -3554,6 +6131,8 @@ static void do_term(void *opq){
   EXTPCARG *pcargs = arg->pcargs;
   int pcnum = arg->pcnum;
   if(sarg->host[0] != '\0') tcsleep(REPLPERIOD * 1.2);
+  if(!stopreplsenders(arg->targ)) arg->err = true;
+  if(!stopadmthreads(arg->targ)) arg->err = true;
   if(g_restart) return;
   if(pcargs){
     for(int i = 0; i < pcnum; i++){
@@ -3580,5 +6159,15 @@ static void do_term(void *opq){
 }
 
 
+/* handle the closing event of a connection */
+static void do_close(void *opq, void *hopq){
+  CONNSTATE *cst = opq;
+  for(int i = 0; i < CURMAX; i++){
+    if(cst->curs[i].id > 0) delcur(cst->curs + i);
+  }
+  tcfree(cst);
+}
+
+
 
 // END OF FILE
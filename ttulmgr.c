@@ -18,6 +18,16 @@
 #include "myconf.h"
 
 #define RECBUFSIZ      32                // buffer for records
+#define CAPHEADSIZ     8                 // size of the header of a captured request
+#define REPLTOUT       30.0              // timeout of each replayed request
+#define REPLNAMESIZ    32                // maximum size of the name of a command
+#define REPLTHMAX      256               // maximum number of replay threads running at once
+
+enum {                                   // enumeration for protocols of captured requests
+  PROTOBIN,                              // original binary protocol
+  PROTOMC,                               // memcached compatible protocol
+  PROTOHTTP                              // HTTP compatible protocol
+};
 
 typedef struct {                         // type of structure for read thread
   TCULRD *ulrd;
@@ -25,6 +35,35 @@ typedef struct {                         // type of structure for read thread
   int rnum;
 } TARGREAD;
 
+typedef struct {                         // type of structure for a captured request
+  uint64_t ts;                           // time stamp of the original request
+  int proto;                             // protocol
+  int nidx;                              // index of the command name
+  double olat;                           // original latency in seconds
+  double rlat;                           // replayed latency in seconds
+  bool err;                              // whether the replay failed
+  char *buf;                             // request data
+  int size;                              // size of the request data
+} REPLREQ;
+
+typedef struct {                         // type of structure for the pool of replay threads
+  pthread_mutex_t mtx;                   // mutex for the number of running threads
+  pthread_cond_t cnd;                    // condition for the end of a thread
+  int num;                               // number of running threads
+} REPLPOOL;
+
+typedef struct {                         // type of structure for replay thread
+  REPLPOOL *pool;
+  const char *host;
+  int port;
+  double speed;
+  double stime;
+  uint64_t bts;
+  REPLREQ *reqs;
+  int rnum;
+  int rcap;
+} TARGREPLAY;
+
 
 /* global variables */
 const char *g_progname;                  // program name
@@ -38,8 +77,22 @@ static int printhex(const char *ptr, int size);
 static char *mygetline(FILE *ifp);
 static int runexport(int argc, char **argv);
 static int runimport(int argc, char **argv);
+static int runtrace(int argc, char **argv);
+static int runreplay(int argc, char **argv);
 static int procexport(const char *upath, uint64_t ts, uint32_t sid);
 static int procimport(const char *upath, uint64_t lim);
+static int proctrace(const char *tpath);
+static int procreplay(const char *cpath, const char *host, int port, double speed, uint64_t ts);
+static TTSOCK *replopen(const char *host, int port);
+static void replclose(TTSOCK *sock);
+static bool replskip(TTSOCK *sock, int64_t size);
+static bool replrecvbin(TTSOCK *sock, const REPLREQ *req);
+static bool replrecvbatch(TTSOCK *sock, const REPLREQ *req);
+static bool replrecvmc(TTSOCK *sock, const REPLREQ *req, bool *close);
+static bool replrecvhttp(TTSOCK *sock, const REPLREQ *req, bool *close);
+static void replname(const REPLREQ *req, char *name);
+static int repldblcmp(const void *a, const void *b);
+static void *threadreplay(void *targ);
 
 
 /* main routine */
@@ -51,6 +104,10 @@ int main(int argc, char **argv){
     rv = runexport(argc, argv);
   } else if(!strcmp(argv[1], "import")){
     rv = runimport(argc, argv);
+  } else if(!strcmp(argv[1], "trace")){
+    rv = runtrace(argc, argv);
+  } else if(!strcmp(argv[1], "replay")){
+    rv = runreplay(argc, argv);
   } else {
     usage();
   }
@@ -65,6 +122,8 @@ static void usage(void){
   fprintf(stderr, "usage:\n");
   fprintf(stderr, "  %s export [-ts num] [-sid num] upath\n", g_progname);
   fprintf(stderr, "  %s import upath\n", g_progname);
+  fprintf(stderr, "  %s trace tpath\n", g_progname);
+  fprintf(stderr, "  %s replay [-port num] [-speed num] [-ts num] cpath host\n", g_progname);
   fprintf(stderr, "\n");
   exit(1);
 }
@@ -167,6 +226,59 @@ static int runimport(int argc, char **argv){
 }
 
 
+/* parse arguments of trace command */
+static int runtrace(int argc, char **argv){
+  char *tpath = NULL;
+  for(int i = 2; i < argc; i++){
+    if(!tpath && argv[i][0] == '-'){
+      usage();
+    } else if(!tpath){
+      tpath = argv[i];
+    } else {
+      usage();
+    }
+  }
+  if(!tpath) usage();
+  int rv = proctrace(tpath);
+  return rv;
+}
+
+
+/* parse arguments of replay command */
+static int runreplay(int argc, char **argv){
+  char *cpath = NULL;
+  char *host = NULL;
+  int port = TTDEFPORT;
+  double speed = 1.0;
+  uint64_t ts = 0;
+  for(int i = 2; i < argc; i++){
+    if(!cpath && argv[i][0] == '-'){
+      if(!strcmp(argv[i], "-port")){
+        if(++i >= argc) usage();
+        port = tcatoi(argv[i]);
+      } else if(!strcmp(argv[i], "-speed")){
+        if(++i >= argc) usage();
+        speed = tcatof(argv[i]);
+      } else if(!strcmp(argv[i], "-ts")){
+        if(++i >= argc) usage();
+        ts = ttstrtots(argv[i]);
+      } else {
+        usage();
+      }
+    } else if(!cpath){
+      cpath = argv[i];
+    } else if(!host){
+      host = argv[i];
+    } else {
+      usage();
+    }
+  }
+  if(!cpath || !host || speed < 0.0) usage();
+  int rv = procreplay(cpath, host, port, speed, ts);
+  return rv;
+}
+
+
 /* perform export command */
 static int procexport(const char *upath, uint64_t ts, uint32_t sid){
   TCULOG *ulog = tculognew();
@@ -262,5 +374,512 @@ static int procimport(const char *upath, uint64_t lim){
 }
 
 
+/* perform trace command */
+static int proctrace(const char *tpath){
+  int snum;
+  TTSPAN *spans = tttraceload(tpath, &snum);
+  if(!spans){
+    printerr("tttraceload");
+    return 1;
+  }
+  for(int i = 0; i < snum; i++){
+    TTSPAN *span = spans + i;
+    int64_t base = span->stamps[TTTSREADY];
+    printf("%llu\t%s\t%s\t%lld", (unsigned long long)span->seq - 1, span->name,
+           (span->flags & TTTFFORCED) ? "forced" : "sampled", (long long)(base / 1000));
+    for(int j = TTTSREADY + 1; j < TTTSNUM; j++){
+      if(span->stamps[j] > 0){
+        printf("\t%.3f", (span->stamps[j] - base) / 1000.0);
+      } else {
+        printf("\t-");
+      }
+    }
+    putchar('\n');
+  }
+  tcfree(spans);
+  return 0;
+}
+
+
+
+/* perform replay command */
+static int procreplay(const char *cpath, const char *host, int port, double speed, uint64_t ts){
+  TCULOG *ulog = tculognew();
+  if(!tculogopen(ulog, cpath, 0)){
+    printerr("tculogopen");
+    return 1;
+  }
+  bool err = false;
+  TCMAP *conns = tcmapnew();
+  TCLIST *names = tclistnew();
+  TCMAP *nidxs = tcmapnew();
+  TARGREPLAY *targs = NULL;
+  int tnum = 0;
+  uint64_t bts = 0;
+  TCULRD *ulrd = tculrdnew(ulog, ts);
+  if(ulrd){
+    const char *rbuf;
+    int rsiz;
+    uint64_t rts;
+    uint32_t rsid, rmid;
+    while((rbuf = tculrdread(ulrd, &rsiz, &rts, &rsid, &rmid)) != NULL){
+      if(rsiz < CAPHEADSIZ + 2 || rmid > PROTOHTTP) continue;
+      if(rmid == PROTOBIN && ((unsigned char *)rbuf)[CAPHEADSIZ+1] == TTCMDREPL) continue;
+      uint32_t cid;
+      memcpy(&cid, rbuf, sizeof(cid));
+      uint32_t olat;
+      memcpy(&olat, rbuf + sizeof(cid), sizeof(olat));
+      int tidx;
+      int vsiz;
+      const char *vbuf = tcmapget(conns, &cid, sizeof(cid), &vsiz);
+      if(vbuf){
+        tidx = *(int *)vbuf;
+      } else {
+        tidx = tnum++;
+        tcmapput(conns, &cid, sizeof(cid), &tidx, sizeof(tidx));
+        targs = tcrealloc(targs, sizeof(*targs) * tnum);
+        memset(targs + tidx, 0, sizeof(*targs));
+      }
+      TARGREPLAY *targ = targs + tidx;
+      if(targ->rnum >= targ->rcap){
+        targ->rcap = targ->rcap * 2 + 16;
+        targ->reqs = tcrealloc(targ->reqs, sizeof(*targ->reqs) * targ->rcap);
+      }
+      REPLREQ *req = targ->reqs + targ->rnum++;
+      memset(req, 0, sizeof(*req));
+      req->ts = rts;
+      req->proto = rmid;
+      req->olat = TTNTOHL(olat) / 1000000.0;
+      req->size = rsiz - CAPHEADSIZ;
+      req->buf = tcmemdup(rbuf + CAPHEADSIZ, req->size);
+      char name[REPLNAMESIZ];
+      replname(req, name);
+      vbuf = tcmapget(nidxs, name, strlen(name), &vsiz);
+      if(vbuf){
+        req->nidx = *(int *)vbuf;
+      } else {
+        req->nidx = tclistnum(names);
+        tcmapput(nidxs, name, strlen(name), &req->nidx, sizeof(req->nidx));
+        tclistpush2(names, name);
+      }
+      if(bts < 1 || rts < bts) bts = rts;
+    }
+    tculrddel(ulrd);
+  } else {
+    printerr("tculrdnew");
+    err = true;
+  }
+  if(!tculogclose(ulog)){
+    printerr("tculogclose");
+    err = true;
+  }
+  tculogdel(ulog);
+  if(!err && tnum > 0){
+    REPLPOOL pool;
+    if(pthread_mutex_init(&pool.mtx, NULL) != 0) tcmyfatal("pthread_mutex_init failed");
+    if(pthread_cond_init(&pool.cnd, NULL) != 0) tcmyfatal("pthread_cond_init failed");
+    pool.num = 0;
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    double stime = tctime();
+    for(int i = 0; i < tnum; i++){
+      TARGREPLAY *targ = targs + i;
+      targ->pool = &pool;
+      targ->host = host;
+      targ->port = port;
+      targ->speed = speed;
+      targ->stime = stime;
+      targ->bts = bts;
+      if(speed > 0.0){
+        double wtime = stime + (targ->reqs[0].ts - bts) / 1000000.0 / speed - tctime();
+        if(wtime > 0.0) tcsleep(wtime);
+      }
+      pthread_mutex_lock(&pool.mtx);
+      while(pool.num >= REPLTHMAX){
+        pthread_cond_wait(&pool.cnd, &pool.mtx);
+      }
+      pthread_t th;
+      if(pthread_create(&th, &attr, threadreplay, targ) == 0){
+        pool.num++;
+      } else {
+        printerr("pthread_create");
+        err = true;
+        for(int j = 0; j < targ->rnum; j++){
+          targ->reqs[j].err = true;
+        }
+      }
+      pthread_mutex_unlock(&pool.mtx);
+    }
+    pthread_mutex_lock(&pool.mtx);
+    while(pool.num > 0){
+      pthread_cond_wait(&pool.cnd, &pool.mtx);
+    }
+    pthread_mutex_unlock(&pool.mtx);
+    pthread_attr_destroy(&attr);
+    double etime = tctime();
+    pthread_cond_destroy(&pool.cnd);
+    pthread_mutex_destroy(&pool.mtx);
+    int nnum = tclistnum(names);
+    int rnum = 0;
+    for(int i = 0; i < tnum; i++){
+      rnum += targs[i].rnum;
+    }
+    double *olats = tcmalloc(sizeof(*olats) * (rnum + 1));
+    double *rlats = tcmalloc(sizeof(*rlats) * (rnum + 1));
+    int tenum = 0;
+    printf("#name\tcount\terrors\torig_mean\torig_p50\torig_p99"
+           "\treplay_mean\treplay_p50\treplay_p99\tdelta_mean\n");
+    for(int i = 0; i < nnum; i++){
+      int cnt = 0;
+      int enm = 0;
+      double osum = 0.0;
+      double rsum = 0.0;
+      for(int j = 0; j < tnum; j++){
+        TARGREPLAY *targ = targs + j;
+        for(int k = 0; k < targ->rnum; k++){
+          REPLREQ *req = targ->reqs + k;
+          if(req->nidx != i) continue;
+          if(req->err){
+            enm++;
+            continue;
+          }
+          olats[cnt] = req->olat;
+          rlats[cnt] = req->rlat;
+          osum += req->olat;
+          rsum += req->rlat;
+          cnt++;
+        }
+      }
+      tenum += enm;
+      qsort(olats, cnt, sizeof(*olats), repldblcmp);
+      qsort(rlats, cnt, sizeof(*rlats), repldblcmp);
+      if(cnt > 0){
+        double omean = osum / cnt;
+        double rmean = rsum / cnt;
+        printf("%s\t%d\t%d\t%.3f\t%.3f\t%.3f\t%.3f\t%.3f\t%.3f\t%+.3f\n",
+               tclistval2(names, i), cnt, enm, omean * 1000, olats[cnt/2] * 1000,
+               olats[(int)(cnt*0.99)] * 1000, rmean * 1000, rlats[cnt/2] * 1000,
+               rlats[(int)(cnt*0.99)] * 1000, (rmean - omean) * 1000);
+      } else {
+        printf("%s\t0\t%d\t-\t-\t-\t-\t-\t-\t-\n", tclistval2(names, i), enm);
+      }
+    }
+    tcfree(rlats);
+    tcfree(olats);
+    fprintf(stderr, "%s: %d requests on %d connections replayed in %.3f seconds (%d errors)\n",
+            g_progname, rnum, tnum, etime - stime, tenum);
+    if(tenum > 0) err = true;
+  }
+  for(int i = 0; i < tnum; i++){
+    TARGREPLAY *targ = targs + i;
+    for(int j = 0; j < targ->rnum; j++){
+      tcfree(targ->reqs[j].buf);
+    }
+    tcfree(targ->reqs);
+  }
+  tcfree(targs);
+  tcmapdel(nidxs);
+  tclistdel(names);
+  tcmapdel(conns);
+  return err ? 1 : 0;
+}
+
+
+/* open a connection to the replayed server */
+static TTSOCK *replopen(const char *host, int port){
+  int fd;
+  if(port < 1){
+    fd = ttopensockunix(host);
+  } else {
+    char addr[TTADDRBUFSIZ];
+    if(!ttgethostaddr(host, addr)) return NULL;
+    fd = ttopensock(addr, port);
+  }
+  if(fd == -1) return NULL;
+  TTSOCK *sock = ttsocknew(fd);
+  ttsocksetlife(sock, REPLTOUT);
+  return sock;
+}
+
+
+/* close a connection to the replayed server */
+static void replclose(TTSOCK *sock){
+  if(!sock) return;
+  int fd = sock->fd;
+  ttsockdel(sock);
+  ttclosesock(fd);
+}
+
+
+/* skip received data of a socket */
+static bool replskip(TTSOCK *sock, int64_t size){
+  if(size < 0) return false;
+  char buf[TTIOBUFSIZ];
+  while(size > 0){
+    int rsiz = tclmin(size, sizeof(buf));
+    if(!ttsockrecv(sock, buf, rsiz)) return false;
+    size -= rsiz;
+  }
+  return !ttsockcheckend(sock);
+}
+
+
+/* receive the response of a request of the binary protocol */
+static bool replrecvbin(TTSOCK *sock, const REPLREQ *req){
+  if(req->size < 2) return false;
+  int cmd = ((unsigned char *)req->buf)[1];
+  if(cmd == TTCMDPUTNR) return true;
+  int code = ttsockgetc(sock);
+  if(code == -1) return false;
+  switch(cmd){
+    case TTCMDGET:
+    case TTCMDITERNEXT:
+    case TTCMDEXT:
+      if(code == 0) return replskip(sock, (int32_t)ttsockgetint32(sock));
+      break;
+    case TTCMDVSIZ:
+    case TTCMDADDINT:
+      if(code == 0) return replskip(sock, sizeof(uint32_t));
+      break;
+    case TTCMDMPUT:
+    case TTCMDMOUT:
+      return replskip(sock, sizeof(uint32_t));
+    case TTCMDCURNEW:
+      return replskip(sock, sizeof(uint32_t));
+    case TTCMDBATCH:
+      if(code == 0) return replrecvbatch(sock, req);
+      break;
+    case TTCMDADDDOUBLE:
+      if(code == 0) return replskip(sock, sizeof(uint64_t) * 2);
+      break;
+    case TTCMDRNUM:
+    case TTCMDSIZE:
+      return replskip(sock, sizeof(uint64_t));
+    case TTCMDSTAT:
+      return replskip(sock, (int32_t)ttsockgetint32(sock));
+    case TTCMDMGET:
+    case TTCMDCURNEXT:
+    case TTCMDCURPREV: {
+      int rnum = ttsockgetint32(sock);
+      for(int i = 0; i < rnum; i++){
+        int ksiz = ttsockgetint32(sock);
+        int vsiz = ttsockgetint32(sock);
+        if(!replskip(sock, (int64_t)ksiz + vsiz)) return false;
+      }
+      break;
+    }
+    case TTCMDFWMKEYS:
+    case TTCMDMISC: {
+      int knum = ttsockgetint32(sock);
+      for(int i = 0; i < knum; i++){
+        if(!replskip(sock, (int32_t)ttsockgetint32(sock))) return false;
+      }
+      break;
+    }
+  }
+  return !ttsockcheckend(sock);
+}
+
+
+/* receive the sub-responses of a request of the batch command */
+static bool replrecvbatch(TTSOCK *sock, const REPLREQ *req){
+  const unsigned char *rp = (unsigned char *)req->buf + 2 + sizeof(uint32_t);
+  const unsigned char *ep = (unsigned char *)req->buf + req->size;
+  int rnum = ttsockgetint32(sock);
+  for(int i = 0; i < rnum; i++){
+    if(rp >= ep) return false;
+    int cmd = *(rp++);
+    int nnum = (cmd == TTCMDEXT) ? 4 : (cmd == TTCMDPUT || cmd == TTCMDADDINT) ? 2 : 1;
+    if(rp + sizeof(uint32_t) * nnum > ep) return false;
+    uint32_t nums[4];
+    memcpy(nums, rp, sizeof(uint32_t) * nnum);
+    rp += sizeof(uint32_t) * nnum;
+    if(cmd == TTCMDEXT){
+      rp += (int64_t)TTNTOHL(nums[0]) + TTNTOHL(nums[2]) + TTNTOHL(nums[3]);
+    } else if(cmd == TTCMDPUT){
+      rp += (int64_t)TTNTOHL(nums[0]) + TTNTOHL(nums[1]);
+    } else {
+      rp += TTNTOHL(nums[0]);
+    }
+    int code = ttsockgetc(sock);
+    if(code == -1) return false;
+    if(code != 0) continue;
+    switch(cmd){
+      case TTCMDGET:
+      case TTCMDEXT:
+        if(!replskip(sock, (int32_t)ttsockgetint32(sock))) return false;
+        break;
+      case TTCMDVSIZ:
+      case TTCMDADDINT:
+        if(!replskip(sock, sizeof(uint32_t))) return false;
+        break;
+    }
+  }
+  return !ttsockcheckend(sock);
+}
+
+
+/* receive the response of a request of the memcached compatible protocol */
+static bool replrecvmc(TTSOCK *sock, const REPLREQ *req, bool *close){
+  char line[REPLNAMESIZ*8];
+  int lsiz = tclmin(req->size, sizeof(line) - 1);
+  memcpy(line, req->buf, lsiz);
+  line[lsiz] = '\0';
+  char *pv = strchr(line, '\n');
+  if(pv) *pv = '\0';
+  pv = strchr(line, '\r');
+  if(pv) *pv = '\0';
+  TCLIST *tokens = tcstrsplit(line, " ");
+  for(int i = tclistnum(tokens) - 1; i >= 0; i--){
+    if(*tclistval2(tokens, i) == '\0') tcfree(tclistremove2(tokens, i));
+  }
+  int tnum = tclistnum(tokens);
+  const char *cmd = tnum > 0 ? tclistval2(tokens, 0) : "";
+  bool multi = !strcmp(cmd, "get") || !strcmp(cmd, "gets") || !strcmp(cmd, "stats");
+  bool noreply = tnum > 1 && !strcmp(tclistval2(tokens, tnum - 1), "noreply");
+  bool quit = !strcmp(cmd, "quit");
+  tclistdel(tokens);
+  if(quit){
+    *close = true;
+    return true;
+  }
+  if(noreply && !multi) return true;
+  while(true){
+    char *res = ttsockgets2(sock);
+    if(!res || ttsockcheckend(sock)){
+      tcfree(res);
+      return false;
+    }
+    bool fin = true;
+    if(multi){
+      if(tcstrfwm(res, "VALUE ")){
+        TCLIST *elems = tcstrsplit(res, " ");
+        int64_t vsiz = tclistnum(elems) > 3 ? tcatoi(tclistval2(elems, 3)) : -1;
+        tclistdel(elems);
+        if(!replskip(sock, vsiz + 2)){
+          tcfree(res);
+          return false;
+        }
+        fin = false;
+      } else if(tcstrfwm(res, "STAT ")){
+        fin = false;
+      }
+    }
+    tcfree(res);
+    if(fin) break;
+  }
+  return true;
+}
+
+
+/* receive the response of a request of the HTTP compatible protocol */
+static bool replrecvhttp(TTSOCK *sock, const REPLREQ *req, bool *close){
+  bool head = req->size >= 5 && !memcmp(req->buf, "HEAD ", 5);
+  char *res = ttsockgets2(sock);
+  if(!res || ttsockcheckend(sock) || !tcstrfwm(res, "HTTP/")){
+    tcfree(res);
+    return false;
+  }
+  if(tcstrfwm(res, "HTTP/1.0")) *close = true;
+  tcfree(res);
+  int64_t clen = -1;
+  while(true){
+    char *line = ttsockgets2(sock);
+    if(!line || ttsockcheckend(sock)){
+      tcfree(line);
+      return false;
+    }
+    if(*line == '\0'){
+      tcfree(line);
+      break;
+    }
+    char *pv = strchr(line, ':');
+    if(pv){
+      *(pv++) = '\0';
+      while(*pv == ' ' || *pv == '\t'){
+        pv++;
+      }
+      if(!tcstricmp(line, "content-length")){
+        clen = tcatoi(pv);
+      } else if(!tcstricmp(line, "connection")){
+        *close = !tcstricmp(pv, "close");
+      }
+    }
+    tcfree(line);
+  }
+  if(head || clen < 1) return true;
+  return replskip(sock, clen);
+}
+
+
+/* get the name of the command of a captured request */
+static void replname(const REPLREQ *req, char *name){
+  if(req->proto == PROTOBIN){
+    sprintf(name, "%s", ttcmdidtostr(((unsigned char *)req->buf)[1]));
+    return;
+  }
+  char *wp = name + sprintf(name, "%s:", req->proto == PROTOMC ? "mc" : "http");
+  for(int i = 0; i < req->size && wp < name + REPLNAMESIZ - 1; i++){
+    int c = ((unsigned char *)req->buf)[i];
+    if(c <= ' ') break;
+    *(wp++) = c;
+  }
+  *wp = '\0';
+}
+
+
+/* compare two latencies */
+static int repldblcmp(const void *a, const void *b){
+  double av = *(double *)a;
+  double bv = *(double *)b;
+  return (av > bv) - (av < bv);
+}
+
+
+/* thread to replay the requests of a connection */
+static void *threadreplay(void *targ){
+  TARGREPLAY *arg = (TARGREPLAY *)targ;
+  TTSOCK *sock = NULL;
+  for(int i = 0; i < arg->rnum; i++){
+    REPLREQ *req = arg->reqs + i;
+    if(arg->speed > 0.0){
+      double wtime = arg->stime + (req->ts - arg->bts) / 1000000.0 / arg->speed - tctime();
+      if(wtime > 0.0) tcsleep(wtime);
+    }
+    if(!sock && !(sock = replopen(arg->host, arg->port))){
+      req->err = true;
+      continue;
+    }
+    bool close = false;
+    double stime = tctime();
+    bool ok = ttsocksend(sock, req->buf, req->size);
+    if(ok){
+      switch(req->proto){
+        case PROTOBIN: ok = replrecvbin(sock, req); break;
+        case PROTOMC: ok = replrecvmc(sock, req, &close); break;
+        default: ok = replrecvhttp(sock, req, &close); break;
+      }
+    }
+    req->rlat = tctime() - stime;
+    if(!ok){
+      req->err = true;
+      close = true;
+    }
+    if(close){
+      replclose(sock);
+      sock = NULL;
+    }
+  }
+  replclose(sock);
+  REPLPOOL *pool = arg->pool;
+  pthread_mutex_lock(&pool->mtx);
+  pool->num--;
+  pthread_cond_signal(&pool->cnd);
+  pthread_mutex_unlock(&pool->mtx);
+  return NULL;
+}
+
+
 
 // END OF FILE
@@ -18,6 +18,8 @@
 #include "myconf.h"
 
 #define RECBUFSIZ      32                // buffer for records
+#define SYNCRECNUM     100               // number of records between periodic synchronizations
+#define TSRECSTEP      1000000           // interval of timestamps of records written with `-ts'
 
 typedef struct {                         // type of structure for read thread
   TCULRD *ulrd;
@@ -25,6 +27,12 @@ typedef struct {                         // type of structure for read thread
   int rnum;
 } TARGREAD;
 
+typedef struct {                         // type of structure for write thread
+  TCULOG *ulog;
+  int id;
+  int rnum;
+} TARGWRITE;
+
 
 /* global variables */
 const char *g_progname;                  // program name
@@ -35,12 +43,15 @@ int main(int argc, char **argv);
 static void usage(void);
 static void iprintf(const char *format, ...);
 static void eprint(TCULOG *ulog, const char *func);
+static int strtosync(const char *str);
 static int runwrite(int argc, char **argv);
 static int runread(int argc, char **argv);
 static int runthread(int argc, char **argv);
-static int procwrite(const char *base, int rnum, int64_t limsiz, bool as);
+static int procwrite(const char *base, int rnum, int64_t limsiz, bool as, int sync,
+                     uint64_t ts);
 static int procread(const char *base, uint64_t ts, bool pm);
-static int procthread(const char *base, int tnum, int rnum, int64_t limsiz, bool as);
+static int procthread(const char *base, int tnum, int rnum, int64_t limsiz, bool as, int sync,
+                      int wnum);
 
 
 /* main routine */
@@ -67,9 +78,10 @@ static void usage(void){
   fprintf(stderr, "%s: test cases of the remote database API of Tokyo Tyrant\n", g_progname);
   fprintf(stderr, "\n");
   fprintf(stderr, "usage:\n");
-  fprintf(stderr, "  %s write [-lim num] [-as] base rnum\n", g_progname);
+  fprintf(stderr, "  %s write [-lim num] [-as] [-sync name] [-ts num] base rnum\n", g_progname);
   fprintf(stderr, "  %s read [-ts num] [-pm] base\n", g_progname);
-  fprintf(stderr, "  %s thread [-lim num] [-as] base tnum rnum\n", g_progname);
+  fprintf(stderr, "  %s thread [-lim num] [-as] [-sync name] [-wnum num] base tnum rnum\n",
+          g_progname);
   fprintf(stderr, "\n");
   exit(1);
 }
@@ -91,12 +103,24 @@ static void eprint(TCULOG *ulog, const char *func){
 }
 
 
+/* get the synchronization policy of the update log from its name */
+static int strtosync(const char *str){
+  if(!tcstricmp(str, "none")) return TCULSNONE;
+  if(!tcstricmp(str, "interval")) return TCULSINTERVAL;
+  if(!tcstricmp(str, "group")) return TCULSGROUP;
+  if(!tcstricmp(str, "always")) return TCULSALWAYS;
+  return -1;
+}
+
+
 /* parse arguments of write command */
 static int runwrite(int argc, char **argv){
   char *base = NULL;
   char *rstr = NULL;
   int64_t limsiz = 0;
   bool as = false;
+  int sync = TCULSNONE;
+  uint64_t ts = 0;
   for(int i = 2; i < argc; i++){
     if(!base && argv[i][0] == '-'){
       if(!strcmp(argv[i], "-lim")){
@@ -104,6 +128,13 @@ static int runwrite(int argc, char **argv){
         limsiz = tcatoi(argv[i]);
       } else if(!strcmp(argv[i], "-as")){
         as = true;
+      } else if(!strcmp(argv[i], "-sync")){
+        if(++i >= argc) usage();
+        sync = strtosync(argv[i]);
+        if(sync < 0) usage();
+      } else if(!strcmp(argv[i], "-ts")){
+        if(++i >= argc) usage();
+        ts = ttstrtots(argv[i]);
       } else {
         usage();
       }
@@ -118,7 +149,7 @@ static int runwrite(int argc, char **argv){
   if(!base || !rstr) usage();
   int rnum = tcatoi(rstr);
   if(rnum < 1) usage();
-  int rv = procwrite(base, rnum, limsiz, as);
+  int rv = procwrite(base, rnum, limsiz, as, sync, ts);
   return rv;
 }
 
@@ -157,6 +188,8 @@ static int runthread(int argc, char **argv){
   char *rstr = NULL;
   int64_t limsiz = 0;
   bool as = false;
+  int sync = TCULSNONE;
+  int wnum = 1;
   for(int i = 2; i < argc; i++){
     if(!base && argv[i][0] == '-'){
       if(!strcmp(argv[i], "-lim")){
@@ -164,6 +197,13 @@ static int runthread(int argc, char **argv){
         limsiz = tcatoi(argv[i]);
       } else if(!strcmp(argv[i], "-as")){
         as = true;
+      } else if(!strcmp(argv[i], "-sync")){
+        if(++i >= argc) usage();
+        sync = strtosync(argv[i]);
+        if(sync < 0) usage();
+      } else if(!strcmp(argv[i], "-wnum")){
+        if(++i >= argc) usage();
+        wnum = tcatoi(argv[i]);
       } else {
         usage();
       }
@@ -180,16 +220,17 @@ static int runthread(int argc, char **argv){
   if(!base || !tstr || !rstr) usage();
   int tnum = tcatoi(tstr);
   int rnum = tcatoi(rstr);
-  if(tnum < 1 || rnum < 1) usage();
-  int rv = procthread(base, tnum, rnum, limsiz, as);
+  if(tnum < 1 || rnum < 1 || wnum < 1) usage();
+  int rv = procthread(base, tnum, rnum, limsiz, as, sync, wnum);
   return rv;
 }
 
 
 /* perform write command */
-static int procwrite(const char *base, int rnum, int64_t limsiz, bool as){
-  iprintf("<Writing Test>\n  base=%s  rnum=%d  limsiz=%lld  as=%d\n\n",
-          base, rnum, (long long)limsiz, as);
+static int procwrite(const char *base, int rnum, int64_t limsiz, bool as, int sync,
+                     uint64_t ts){
+  iprintf("<Writing Test>\n  base=%s  rnum=%d  limsiz=%lld  as=%d  sync=%d  ts=%llu\n\n",
+          base, rnum, (long long)limsiz, as, sync, (unsigned long long)ts);
   bool err = false;
   double stime = tctime();
   TCULOG *ulog = tculognew();
@@ -197,6 +238,10 @@ static int procwrite(const char *base, int rnum, int64_t limsiz, bool as){
     eprint(ulog, "tculogsetaio");
     err = true;
   }
+  if(!tculogsetsync(ulog, sync)){
+    eprint(ulog, "tculogsetsync");
+    err = true;
+  }
   if(!tculogopen(ulog, base, limsiz)){
     eprint(ulog, "tculogopen");
     err = true;
@@ -205,11 +250,17 @@ static int procwrite(const char *base, int rnum, int64_t limsiz, bool as){
   for(int i = 1; i <= rnum; i++){
     char buf[RECBUFSIZ];
     int len = sprintf(buf, "%08d", i);
-    if(!tculogwrite(ulog, 0, sid, sid, buf, len)){
+    uint64_t rts = (ts > 0) ? ts + (uint64_t)(i - 1) * TSRECSTEP : 0;
+    if(!tculogwrite(ulog, rts, sid, sid, buf, len)){
       eprint(ulog, "tculogwrite");
       err = true;
       break;
     }
+    if(sync == TCULSINTERVAL && i % SYNCRECNUM == 0 && !tculogsync(ulog)){
+      eprint(ulog, "tculogsync");
+      err = true;
+      break;
+    }
     if(rnum > 250 && i % (rnum / 250) == 0){
       putchar('.');
       fflush(stdout);
@@ -239,6 +290,7 @@ static int procread(const char *base, uint64_t ts, bool pm){
     err = true;
   }
   TCULRD *ulrd = tculrdnew(ulog, ts);
+  int64_t cnum = 0;
   if(ulrd){
     const char *rbuf;
     int rsiz;
@@ -246,6 +298,7 @@ static int procread(const char *base, uint64_t ts, bool pm){
     uint32_t rsid, rmid;
     int i = 1;
     while((rbuf = tculrdread(ulrd, &rsiz, &rts, &rsid, &rmid)) != NULL){
+      if(rts >= ts) cnum++;
       if(pm){
         printf("%llu\t%u:%u\t", (unsigned long long)rts, (unsigned int)rsid, (unsigned int)rmid);
         for(int i = 0; i < rsiz; i++){
@@ -264,6 +317,25 @@ static int procread(const char *base, uint64_t ts, bool pm){
     }
     if(!pm) iprintf(" (%08d)\n", i - 1);
     tculrddel(ulrd);
+  } else {
+    eprint(ulog, "tculrdnew");
+    err = true;
+  }
+  if(!pm && ts > 0 && (ulrd = tculrdnew(ulog, 0)) != NULL){
+    const char *rbuf;
+    int rsiz;
+    uint64_t rts;
+    uint32_t rsid, rmid;
+    int64_t anum = 0;
+    while((rbuf = tculrdread(ulrd, &rsiz, &rts, &rsid, &rmid)) != NULL){
+      if(rts >= ts) anum++;
+    }
+    tculrddel(ulrd);
+    iprintf("checking: %lld records since the timestamp\n", (long long)anum);
+    if(cnum != anum){
+      eprint(ulog, "tculrdread");
+      err = true;
+    }
   }
   if(!tculogclose(ulog)){
     eprint(ulog, "tculogclose");
@@ -303,10 +375,37 @@ static void *threadread(void *targ){
 }
 
 
+/* thread the write function */
+static void *threadwrite(void *targ){
+  TCULOG *ulog = ((TARGWRITE *)targ)->ulog;
+  int id = ((TARGWRITE *)targ)->id;
+  int rnum = ((TARGWRITE *)targ)->rnum;
+  bool err = false;
+  int sid = getpid() & UINT16_MAX;
+  for(int i = 1; i <= rnum; i++){
+    char buf[RECBUFSIZ];
+    int len = sprintf(buf, "%08d", i);
+    if(!tculogwrite(ulog, 0, sid, id, buf, len)){
+      eprint(ulog, "tculogwrite");
+      err = true;
+      break;
+    }
+    if(ulog->spol == TCULSINTERVAL && id == 0 && i % SYNCRECNUM == 0 && !tculogsync(ulog)){
+      eprint(ulog, "tculogsync");
+      err = true;
+      break;
+    }
+    if(id == 0 && rnum > 250 && i % (rnum / 10) == 0) tcsleep(0.1);
+  }
+  return err ? "error" : NULL;
+}
+
+
 /* perform thread command */
-static int procthread(const char *base, int tnum, int rnum, int64_t limsiz, bool as){
-  iprintf("<Threading Test>\n  base=%s  tnum=%d  rnum=%d  limsiz=%lld  as=%d\n\n",
-          base, tnum, rnum, (long long)limsiz, as);
+static int procthread(const char *base, int tnum, int rnum, int64_t limsiz, bool as, int sync,
+                      int wnum){
+  iprintf("<Threading Test>\n  base=%s  tnum=%d  rnum=%d  limsiz=%lld  as=%d  sync=%d"
+          "  wnum=%d\n\n", base, tnum, rnum, (long long)limsiz, as, sync, wnum);
   bool err = false;
   double stime = tctime();
   TCULOG *ulog = tculognew();
@@ -314,6 +413,10 @@ static int procthread(const char *base, int tnum, int rnum, int64_t limsiz, bool
     eprint(ulog, "tculogsetaio");
     err = true;
   }
+  if(!tculogsetsync(ulog, sync)){
+    eprint(ulog, "tculogsetsync");
+    err = true;
+  }
   if(!tculogopen(ulog, base, limsiz)){
     eprint(ulog, "tculogopen");
     err = true;
@@ -323,7 +426,7 @@ static int procthread(const char *base, int tnum, int rnum, int64_t limsiz, bool
   for(int i = 0; i < tnum; i++){
     targs[i].ulrd = tculrdnew(ulog, 0);
     targs[i].id = i;
-    targs[i].rnum = rnum;
+    targs[i].rnum = rnum * wnum;
     if(!targs[i].ulrd){
       eprint(ulog, "tculrdnew");
       targs[i].id = -1;
@@ -334,16 +437,27 @@ static int procthread(const char *base, int tnum, int rnum, int64_t limsiz, bool
       err = true;
     }
   }
-  int sid = getpid() & UINT16_MAX;
-  for(int i = 1; i <= rnum; i++){
-    char buf[RECBUFSIZ];
-    int len = sprintf(buf, "%08d", i);
-    if(!tculogwrite(ulog, 0, sid, sid, buf, len)){
-      eprint(ulog, "tculogwrite");
+  TARGWRITE wargs[wnum];
+  pthread_t wthreads[wnum];
+  for(int i = 0; i < wnum; i++){
+    wargs[i].ulog = ulog;
+    wargs[i].id = i;
+    wargs[i].rnum = rnum;
+    if(pthread_create(wthreads + i, NULL, threadwrite, wargs + i) != 0){
+      eprint(ulog, "pthread_create");
+      wargs[i].id = -1;
+      err = true;
+    }
+  }
+  for(int i = 0; i < wnum; i++){
+    if(wargs[i].id == -1) continue;
+    void *rv;
+    if(pthread_join(wthreads[i], &rv) != 0){
+      eprint(ulog, "pthread_join");
+      err = true;
+    } else if(rv){
       err = true;
-      break;
     }
-    if(rnum > 250 && i % (rnum / 10) == 0) tcsleep(0.1);
   }
   for(int i = 0; i < tnum; i++){
     if(targs[i].id == -1) continue;
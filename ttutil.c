@@ -34,6 +34,10 @@
 #define TRILLIONNUM    1000000000000     // trillion number
 
 
+/* private function prototypes */
+static bool ttsocksendv(TTSOCK *sock, struct iovec *iovs, int iovnum);
+
+
 /* String containing the version information. */
 const char *ttversion = _TT_VERSION;
 
@@ -300,11 +304,24 @@ TTSOCK *ttsocknew(int fd){
   assert(fd >= 0);
   TTSOCK *sock = tcmalloc(sizeof(*sock));
   sock->fd = fd;
+  sock->id = 0;
+  sock->buf = tcmalloc(TTIOBUFSIZ);
+  sock->bsiz = TTIOBUFSIZ;
+  sock->rmax = 0;
   sock->rp = sock->buf;
   sock->ep = sock->buf;
   sock->end = false;
   sock->to = 0.0;
   sock->dl = HUGE_VAL;
+  sock->pdl = HUGE_VAL;
+  sock->wbuf = NULL;
+  sock->wnum = 0;
+  sock->wtime = 0.0;
+  sock->rsum = 0;
+  sock->ssum = 0;
+  sock->rec = NULL;
+  sock->rrp = sock->buf;
+  sock->opq = NULL;
   return sock;
 }
 
@@ -312,6 +329,8 @@ TTSOCK *ttsocknew(int fd){
 /* Delete a socket object. */
 void ttsockdel(TTSOCK *sock){
   assert(sock);
+  if(sock->wbuf) tcfree(sock->wbuf);
+  if(sock->buf) tcfree(sock->buf);
   tcfree(sock);
 }
 
@@ -324,40 +343,75 @@ void ttsocksetlife(TTSOCK *sock, double lifetime){
 }
 
 
+/* Set the deferred sending mode of a socket object. */
+bool ttsocksetdefer(TTSOCK *sock, bool defer){
+  assert(sock);
+  if(defer){
+    if(!sock->wbuf){
+      sock->wbuf = tcmalloc(TTIOBUFSIZ);
+      sock->wnum = 0;
+    }
+    return true;
+  }
+  if(!sock->wbuf) return true;
+  bool err = false;
+  if(!ttsockflush(sock)) err = true;
+  tcfree(sock->wbuf);
+  sock->wbuf = NULL;
+  sock->wnum = 0;
+  return !err;
+}
+
+
+/* Set the recording buffer of a socket object. */
+void ttsocksetrec(TTSOCK *sock, TCXSTR *xstr){
+  assert(sock);
+  if(sock->rec && sock->rp > sock->rrp) tcxstrcat(sock->rec, sock->rrp, sock->rp - sock->rrp);
+  sock->rec = xstr;
+  sock->rrp = sock->rp;
+}
+
+
+/* Flush pending data of a socket object in the deferred sending mode. */
+bool ttsockflush(TTSOCK *sock){
+  assert(sock);
+  if(sock->wnum < 1) return true;
+  struct iovec iov;
+  iov.iov_base = sock->wbuf;
+  iov.iov_len = sock->wnum;
+  sock->wnum = 0;
+  double stime = tctime();
+  bool rv = ttsocksendv(sock, &iov, 1);
+  sock->wtime += tctime() - stime;
+  return rv;
+}
+
+
 /* Send data by a socket. */
 bool ttsocksend(TTSOCK *sock, const void *buf, int size){
   assert(sock && buf && size >= 0);
-  const char *rp = buf;
-  do {
-    int ocs = PTHREAD_CANCEL_DISABLE;
-    pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, &ocs);
-    if(sock->to > 0.0 && !ttwaitsock(sock->fd, 1, sock->to)){
-      pthread_setcancelstate(ocs, NULL);
-      return false;
+  struct iovec iovs[2];
+  int iovnum = 0;
+  if(sock->wbuf){
+    if(sock->wnum + size <= TTIOBUFSIZ){
+      memcpy(sock->wbuf + sock->wnum, buf, size);
+      sock->wnum += size;
+      return true;
     }
-    int wb = send(sock->fd, rp, size, 0);
-    int en = errno;
-    pthread_setcancelstate(ocs, NULL);
-    switch(wb){
-      case -1:
-        if(en != EINTR && en != EAGAIN && en != EWOULDBLOCK){
-          sock->end = true;
-          return false;
-        }
-        if(tctime() > sock->dl){
-          sock->end = true;
-          return false;
-        }
-        break;
-      case 0:
-        break;
-      default:
-        rp += wb;
-        size -= wb;
-        break;
+    if(sock->wnum > 0){
+      iovs[iovnum].iov_base = sock->wbuf;
+      iovs[iovnum].iov_len = sock->wnum;
+      iovnum++;
+      sock->wnum = 0;
     }
-  } while(size > 0);
-  return true;
+  }
+  iovs[iovnum].iov_base = (void *)buf;
+  iovs[iovnum].iov_len = size;
+  iovnum++;
+  double stime = tctime();
+  bool rv = ttsocksendv(sock, iovs, iovnum);
+  sock->wtime += tctime() - stime;
+  return rv;
 }
 
 
@@ -494,6 +548,11 @@ bool ttsockrecv(TTSOCK *sock, char *buf, int size){
 int ttsockgetc(TTSOCK *sock){
   assert(sock);
   if(sock->rp < sock->ep) return *(unsigned char *)(sock->rp++);
+  if(sock->wnum > 0 && !ttsockflush(sock)) return -1;
+  if(sock->rec && sock->ep > sock->rrp){
+    tcxstrcat(sock->rec, sock->rrp, sock->ep - sock->rrp);
+    sock->rrp = sock->ep;
+  }
   int en;
   do {
     int ocs = PTHREAD_CANCEL_DISABLE;
@@ -502,12 +561,15 @@ int ttsockgetc(TTSOCK *sock){
       pthread_setcancelstate(ocs, NULL);
       return -1;
     }
-    int rv = recv(sock->fd, sock->buf, TTIOBUFSIZ, 0);
+    int rv = recv(sock->fd, sock->buf, sock->bsiz, 0);
     en = errno;
     pthread_setcancelstate(ocs, NULL);
     if(rv > 0){
+      if(rv > sock->rmax) sock->rmax = rv;
+      sock->rsum += rv;
       sock->rp = sock->buf + 1;
       sock->ep = sock->buf + rv;
+      sock->rrp = sock->buf;
       return *(unsigned char *)sock->buf;
     } else if(rv == 0){
       sock->end = true;
@@ -525,6 +587,7 @@ void ttsockungetc(TTSOCK *sock, int c){
   if(sock->rp <= sock->buf) return;
   sock->rp--;
   *(unsigned char *)sock->rp = c;
+  if(sock->rp < sock->rrp) sock->rrp = sock->rp;
 }
 
 
@@ -837,6 +900,348 @@ double ttunpackdouble(const char *buf){
 
 
 
+/* Send data of multiple regions by a socket.
+   `sock' specifies the socket object.
+   `iovs' specifies an array of the regions.  It is modified while sending.
+   `iovnum' specifies the number of elements of the array.
+   If successful, the return value is true, else, it is false. */
+static bool ttsocksendv(TTSOCK *sock, struct iovec *iovs, int iovnum){
+  assert(sock && iovs && iovnum >= 0);
+  while(iovnum > 0 && iovs->iov_len < 1){
+    iovs++;
+    iovnum--;
+  }
+  while(iovnum > 0){
+    int ocs = PTHREAD_CANCEL_DISABLE;
+    pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, &ocs);
+    if(sock->to > 0.0 && !ttwaitsock(sock->fd, 1, sock->to)){
+      pthread_setcancelstate(ocs, NULL);
+      return false;
+    }
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = iovs;
+    msg.msg_iovlen = iovnum;
+    int wb = sendmsg(sock->fd, &msg, 0);
+    int en = errno;
+    pthread_setcancelstate(ocs, NULL);
+    switch(wb){
+      case -1:
+        if(en != EINTR && en != EAGAIN && en != EWOULDBLOCK){
+          sock->end = true;
+          return false;
+        }
+        if(tctime() > sock->dl){
+          sock->end = true;
+          return false;
+        }
+        break;
+      case 0:
+        break;
+      default:
+        sock->ssum += wb;
+        while(iovnum > 0 && wb >= iovs->iov_len){
+          wb -= iovs->iov_len;
+          iovs++;
+          iovnum--;
+        }
+        if(iovnum > 0){
+          iovs->iov_base = (char *)iovs->iov_base + wb;
+          iovs->iov_len -= wb;
+        }
+        break;
+    }
+  }
+  return true;
+}
+
+
+
+/*************************************************************************************************
+ * metrics registry
+ *************************************************************************************************/
+
+
+/* Create a metrics registry object. */
+TTMETRICS *ttmetricsnew(int thnum, int capnum){
+  assert(thnum >= 0 && capnum > 0);
+  TTMETRICS *metrics = tcmalloc(sizeof(*metrics));
+  metrics->thnum = thnum;
+  metrics->capnum = capnum;
+  metrics->num = 0;
+  metrics->names = tcmalloc(sizeof(*metrics->names) * capnum);
+  metrics->types = tcmalloc(sizeof(*metrics->types) * capnum);
+  int unit = TTCLSIZ / sizeof(*metrics->slabs);
+  metrics->stride = (capnum + unit - 1) / unit * unit;
+  size_t size = sizeof(*metrics->slabs) * metrics->stride * (thnum + 1);
+  void *slabs;
+  if(posix_memalign(&slabs, TTCLSIZ, size) != 0) tcmyfatal("posix_memalign failed");
+  memset(slabs, 0, size);
+  metrics->slabs = slabs;
+  if(pthread_mutex_init(&metrics->mtx, NULL) != 0) tcmyfatal("pthread_mutex_init failed");
+  return metrics;
+}
+
+
+/* Delete a metrics registry object. */
+void ttmetricsdel(TTMETRICS *metrics){
+  assert(metrics);
+  pthread_mutex_destroy(&metrics->mtx);
+  free(metrics->slabs);
+  for(int i = 0; i < metrics->num; i++){
+    tcfree(metrics->names[i]);
+  }
+  tcfree(metrics->types);
+  tcfree(metrics->names);
+  tcfree(metrics);
+}
+
+
+/* Register a metric in a metrics registry object. */
+int ttmetricsreg(TTMETRICS *metrics, const char *name, int type){
+  assert(metrics && name);
+  if(pthread_mutex_lock(&metrics->mtx) != 0) return -1;
+  int id = ttmetricsfind(metrics, name);
+  if(id < 0 && metrics->num < metrics->capnum){
+    id = metrics->num;
+    metrics->names[id] = tcstrdup(name);
+    metrics->types[id] = type;
+    __sync_synchronize();
+    metrics->num = id + 1;
+  }
+  pthread_mutex_unlock(&metrics->mtx);
+  return id;
+}
+
+
+/* Get the ID number of a metric of a metrics registry object. */
+int ttmetricsfind(TTMETRICS *metrics, const char *name){
+  assert(metrics && name);
+  int num = metrics->num;
+  __sync_synchronize();
+  for(int i = 0; i < num; i++){
+    if(!strcmp(metrics->names[i], name)) return i;
+  }
+  return -1;
+}
+
+
+/* Get the number of metrics of a metrics registry object. */
+int ttmetricsnum(TTMETRICS *metrics){
+  assert(metrics);
+  return metrics->num;
+}
+
+
+/* Get the name of a metric of a metrics registry object. */
+const char *ttmetricsname(TTMETRICS *metrics, int id){
+  assert(metrics && id >= 0 && id < metrics->num);
+  return metrics->names[id];
+}
+
+
+/* Get the type of a metric of a metrics registry object. */
+int ttmetricstype(TTMETRICS *metrics, int id){
+  assert(metrics && id >= 0 && id < metrics->num);
+  return metrics->types[id];
+}
+
+
+/* Add a value to a metric of a metrics registry object. */
+void ttmetricsadd(TTMETRICS *metrics, int idx, int id, int64_t num){
+  assert(metrics && id >= 0 && id < metrics->capnum);
+  if(idx >= 0 && idx < metrics->thnum){
+    metrics->slabs[metrics->stride*(idx+1)+id] += num;
+  } else {
+    __sync_add_and_fetch(metrics->slabs + id, num);
+  }
+}
+
+
+/* Get the value of a metric of a metrics registry object. */
+int64_t ttmetricssum(TTMETRICS *metrics, int id){
+  assert(metrics && id >= 0 && id < metrics->capnum);
+  int64_t sum = 0;
+  for(int i = 0; i <= metrics->thnum; i++){
+    sum += metrics->slabs[metrics->stride*i+id];
+  }
+  return sum;
+}
+
+
+
+/*************************************************************************************************
+ * request tracer
+ *************************************************************************************************/
+
+
+#define TRACEVERSION   1                 // version of the format of trace files
+
+
+/* private function prototypes */
+static void tttraceinitkey(void);
+static int64_t tttracenow(void);
+
+
+/* private global variables */
+static pthread_once_t tttraceonce = PTHREAD_ONCE_INIT;
+static pthread_key_t tttracekey;
+static volatile bool tttraceon = false;
+
+
+/* Create a request tracer object. */
+TTTRACER *tttracernew(const char *path, int snum){
+  assert(path && snum > 0);
+  if(pthread_once(&tttraceonce, tttraceinitkey) != 0) return NULL;
+  int fd = open(path, O_RDWR | O_CREAT, 00644);
+  if(fd == -1) return NULL;
+  size_t msiz = sizeof(TTTRACEHEAD) + sizeof(TTSPAN) * snum;
+  TTTRACEHEAD head;
+  bool fresh = true;
+  struct stat sbuf;
+  if(fstat(fd, &sbuf) == 0 && sbuf.st_size == msiz &&
+     pread(fd, &head, sizeof(head), 0) == sizeof(head) &&
+     !memcmp(head.magic, TTTRACEMAGIC, sizeof(TTTRACEMAGIC)) && head.version == TRACEVERSION &&
+     head.spansiz == sizeof(TTSPAN) && head.snum == snum && head.stnum == TTTSNUM) fresh = false;
+  if(fresh && (ftruncate(fd, 0) != 0 || ftruncate(fd, msiz) != 0)){
+    close(fd);
+    return NULL;
+  }
+  void *map = mmap(0, msiz, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if(map == MAP_FAILED){
+    close(fd);
+    return NULL;
+  }
+  TTTRACER *tracer = tcmalloc(sizeof(*tracer));
+  tracer->fd = fd;
+  tracer->head = map;
+  tracer->spans = (TTSPAN *)((char *)map + sizeof(TTTRACEHEAD));
+  tracer->msiz = msiz;
+  if(fresh){
+    memcpy(tracer->head->magic, TTTRACEMAGIC, sizeof(TTTRACEMAGIC));
+    tracer->head->version = TRACEVERSION;
+    tracer->head->spansiz = sizeof(TTSPAN);
+    tracer->head->snum = snum;
+    tracer->head->stnum = TTTSNUM;
+    tracer->head->head = 0;
+  }
+  tttraceon = true;
+  return tracer;
+}
+
+
+/* Delete a request tracer object. */
+bool tttracerdel(TTTRACER *tracer){
+  assert(tracer);
+  bool err = false;
+  if(msync(tracer->head, tracer->msiz, MS_ASYNC) != 0) err = true;
+  if(munmap(tracer->head, tracer->msiz) != 0) err = true;
+  if(close(tracer->fd) != 0) err = true;
+  tcfree(tracer);
+  return !err;
+}
+
+
+/* Begin a span of a request in the calling thread. */
+void tttracebegin(TTSPAN *span, int flags, double rtime, double ptime){
+  assert(span);
+  if(!tttraceon) return;
+  span->flags = flags;
+  memset(span->stamps, 0, sizeof(span->stamps));
+  span->stamps[TTTSREADY] = rtime * 1000000000.0;
+  span->stamps[TTTSPICKUP] = ptime * 1000000000.0;
+  span->stamps[TTTSPARSE] = tttracenow();
+  pthread_setspecific(tttracekey, span);
+}
+
+
+/* Record the current time as a stage of the span of the calling thread. */
+void tttracemark(int stage){
+  assert(stage >= 0 && stage < TTTSNUM);
+  if(!tttraceon) return;
+  TTSPAN *span = pthread_getspecific(tttracekey);
+  if(span) span->stamps[stage] = tttracenow();
+}
+
+
+/* End the span of the calling thread and write it into the trace file. */
+void tttraceend(TTTRACER *tracer, const char *name){
+  assert(tracer && name);
+  TTSPAN *span = pthread_getspecific(tttracekey);
+  if(!span) return;
+  pthread_setspecific(tttracekey, NULL);
+  uint64_t seq = __sync_fetch_and_add(&tracer->head->head, 1);
+  TTSPAN *slot = tracer->spans + seq % tracer->head->snum;
+  slot->seq = 0;
+  __sync_synchronize();
+  slot->flags = span->flags;
+  snprintf(slot->name, TTTRACENAMESIZ, "%s", name);
+  memcpy(slot->stamps, span->stamps, sizeof(slot->stamps));
+  __sync_synchronize();
+  slot->seq = seq + 1;
+}
+
+
+/* Load the spans in a trace file. */
+TTSPAN *tttraceload(const char *path, int *np){
+  assert(path && np);
+  int fd = open(path, O_RDONLY, 00644);
+  if(fd == -1) return NULL;
+  TTTRACEHEAD head;
+  struct stat sbuf;
+  if(fstat(fd, &sbuf) != 0 || pread(fd, &head, sizeof(head), 0) != sizeof(head) ||
+     memcmp(head.magic, TTTRACEMAGIC, sizeof(TTTRACEMAGIC)) || head.version != TRACEVERSION ||
+     head.spansiz != sizeof(TTSPAN) || head.stnum != TTTSNUM ||
+     sbuf.st_size < sizeof(head) + (uint64_t)head.spansiz * head.snum){
+    close(fd);
+    return NULL;
+  }
+  size_t msiz = sizeof(head) + (size_t)head.spansiz * head.snum;
+  void *map = mmap(0, msiz, PROT_READ, MAP_SHARED, fd, 0);
+  if(map == MAP_FAILED){
+    close(fd);
+    return NULL;
+  }
+  const TTSPAN *slots = (TTSPAN *)((char *)map + sizeof(head));
+  uint64_t end = ((TTTRACEHEAD *)map)->head;
+  uint64_t begin = end > head.snum ? end - head.snum : 0;
+  TTSPAN *spans = tcmalloc(sizeof(*spans) * (end - begin) + 1);
+  int num = 0;
+  for(uint64_t seq = begin; seq < end; seq++){
+    const TTSPAN *slot = slots + seq % head.snum;
+    if(slot->seq != seq + 1) continue;
+    __sync_synchronize();
+    TTSPAN *span = spans + num;
+    memcpy(span, slot, sizeof(*span));
+    __sync_synchronize();
+    if(slot->seq != seq + 1) continue;
+    span->seq = seq + 1;
+    span->name[TTTRACENAMESIZ-1] = '\0';
+    num++;
+  }
+  munmap(map, msiz);
+  close(fd);
+  *np = num;
+  return spans;
+}
+
+
+/* Create the key of the thread specific spans. */
+static void tttraceinitkey(void){
+  if(pthread_key_create(&tttracekey, NULL) != 0) tcmyfatal("pthread_key_create failed");
+}
+
+
+/* Get the current time in nanoseconds of the epoch.
+   The return value is the current time. */
+static int64_t tttracenow(void){
+  struct timespec ts;
+  if(clock_gettime(CLOCK_REALTIME, &ts) != 0) return 0;
+  return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+
+
 /*************************************************************************************************
  * server utilities
  *************************************************************************************************/
@@ -847,12 +1252,37 @@ double ttunpackdouble(const char *buf){
 #define TTEVENTMAX     256               // maximum number of events
 #define TTWAITREQUEST  0.2               // waiting seconds for requests
 #define TTWAITWORKER   0.1               // waiting seconds for finish of workers
+#define TTWAITPARK     1.0               // waiting seconds of idle workers
+#define TTWAITQUEUE    0.001             // waiting seconds for a room of the full queue
+#define TTCONNTABMIN   1024              // minimum size of the table of connections
+#define TTPARKMAX      (1024*1024)       // maximum size of a request kept before dispatching
+#define TTPARKTIMEO    30.0              // seconds to keep a partial request
 
 
 /* private function prototypes */
+static int ttopenservsockrp(const char *addr, int port);
+static bool ttservopenreactor(TTSERV *serv, TTREQ *req);
+static bool ttservqpush(TTSERV *serv, int fd);
+static int ttservqpop(TTSERV *serv, double *tp);
+static bool ttservqpark(TTSERV *serv, uint32_t wseq);
+static bool ttservqwake(TTSERV *serv, bool all);
+static char *ttservbufget(TTSERV *serv, int size);
+static void ttservbufput(TTSERV *serv, char *buf, int size);
+static TTSOCK *ttservconnopen(TTSERV *serv, int fd);
+static void ttservconnidle(TTSERV *serv, TTSOCK *sock);
+static void ttservconnpark(TTSERV *serv, TTSOCK *sock);
+static void ttservconnclose(TTSERV *serv, int fd);
+static void ttservconnclear(TTSERV *serv);
+static void ttservconnsweep(TTSERV *serv, double now);
+static bool ttservfillreq(TTSERV *serv, TTSOCK *sock);
+static void ttservcountconn(TTSERV *serv, int idx, bool open);
 static void *ttservtimer(void *argp);
 static void ttservtask(TTSOCK *sock, TTREQ *req);
+static bool ttservproccon(TTREQ *req, int cfd);
+static bool ttservservecon(TTREQ *req, TTSOCK *sock, bool resume);
+static void ttservcancelcon(TTREQ *req);
 static void *ttservdeqtasks(void *argp);
+static void *ttservreactor(void *argp);
 
 
 /* Create a server object. */
@@ -861,21 +1291,43 @@ TTSERV *ttservnew(void){
   serv->host[0] = '\0';
   serv->addr[0] = '\0';
   serv->port = 0;
-  serv->queue = tclistnew();
+  serv->qslots = tcmalloc(sizeof(*serv->qslots) * TTQUEUEMAX);
+  for(int i = 0; i < TTQUEUEMAX; i++){
+    serv->qslots[i].seq = i;
+    serv->qslots[i].fd = -1;
+  }
+  serv->qhead = 0;
+  serv->qtail = 0;
+  serv->qwseq = 0;
+  serv->qidle = 0;
   if(pthread_mutex_init(&serv->qmtx, NULL) != 0) tcmyfatal("pthread_mutex_init failed");
   if(pthread_cond_init(&serv->qcnd, NULL) != 0) tcmyfatal("pthread_cond_init failed");
+  serv->conns = NULL;
+  serv->connsiz = 0;
+  serv->connseq = 0;
+  if(pthread_rwlock_init(&serv->cnlck, NULL) != 0) tcmyfatal("pthread_rwlock_init failed");
+  for(int i = 0; i < TTBPCLSNUM; i++){
+    serv->bpnums[i] = 0;
+  }
+  if(pthread_mutex_init(&serv->bpmtx, NULL) != 0) tcmyfatal("pthread_mutex_init failed");
   if(pthread_mutex_init(&serv->tmtx, NULL) != 0) tcmyfatal("pthread_mutex_init failed");
   if(pthread_cond_init(&serv->tcnd, NULL) != 0) tcmyfatal("pthread_cond_init failed");
   serv->thnum = TTDEFTHNUM;
   serv->timeout = 0;
+  serv->reactor = false;
   serv->term = false;
   serv->do_log = NULL;
   serv->opq_log = NULL;
   serv->timernum = 0;
   serv->do_task = NULL;
   serv->opq_task = NULL;
+  serv->do_check = NULL;
+  serv->opq_check = NULL;
   serv->do_term = NULL;
+  serv->metrics = NULL;
   serv->opq_term = NULL;
+  serv->do_close = NULL;
+  serv->opq_close = NULL;
   return serv;
 }
 
@@ -885,9 +1337,18 @@ void ttservdel(TTSERV *serv){
   assert(serv);
   pthread_cond_destroy(&serv->tcnd);
   pthread_mutex_destroy(&serv->tmtx);
+  ttservconnclear(serv);
+  for(int i = 0; i < TTBPCLSNUM; i++){
+    for(int j = 0; j < serv->bpnums[i]; j++){
+      tcfree(serv->bpool[i][j]);
+    }
+  }
+  pthread_mutex_destroy(&serv->bpmtx);
+  pthread_rwlock_destroy(&serv->cnlck);
+  if(serv->conns) tcfree(serv->conns);
   pthread_cond_destroy(&serv->qcnd);
   pthread_mutex_destroy(&serv->qmtx);
-  tclistdel(serv->queue);
+  tcfree(serv->qslots);
   tcfree(serv);
 }
 
@@ -923,6 +1384,13 @@ void ttservtune(TTSERV *serv, int thnum, double timeout){
 }
 
 
+/* Set the reactor mode of a server object. */
+void ttservsetreactor(TTSERV *serv, bool reactor){
+  assert(serv);
+  serv->reactor = reactor;
+}
+
+
 /* Set the logging handler of a server object. */
 void ttservsetloghandler(TTSERV *serv, void (*do_log)(int, const char *, void *), void *opq){
   assert(serv && do_log);
@@ -932,14 +1400,18 @@ void ttservsetloghandler(TTSERV *serv, void (*do_log)(int, const char *, void *)
 
 
 /* Add a timed handler to a server object. */
-void ttservaddtimedhandler(TTSERV *serv, double freq, void (*do_timed)(void *), void *opq){
+bool ttservaddtimedhandler(TTSERV *serv, double freq, void (*do_timed)(void *), void *opq){
   assert(serv && freq >= 0.0 && do_timed);
-  if(serv->timernum >= TTTIMERMAX - 1) return;
+  if(serv->timernum >= TTTIMERMAX){
+    ttservlog(serv, TTLOGERROR, "too many timed handlers: %d", TTTIMERMAX);
+    return false;
+  }
   TTTIMER *timer = serv->timers + serv->timernum;
   timer->freq_timed = freq;
   timer->do_timed = do_timed;
   timer->opq_timed = opq;
   serv->timernum++;
+  return true;
 }
 
 
@@ -951,6 +1423,14 @@ void ttservsettaskhandler(TTSERV *serv, void (*do_task)(TTSOCK *, void *, TTREQ
 }
 
 
+/* Set the framing handler of a server object. */
+void ttservsetcheckhandler(TTSERV *serv, int (*do_check)(const char *, int, void *), void *opq){
+  assert(serv && do_check);
+  serv->do_check = do_check;
+  serv->opq_check = opq;
+}
+
+
 /* Set the termination handler of a server object. */
 void ttservsettermhandler(TTSERV *serv, void (*do_term)(void *), void *opq){
   assert(serv && do_term);
@@ -959,11 +1439,57 @@ void ttservsettermhandler(TTSERV *serv, void (*do_term)(void *), void *opq){
 }
 
 
+/* Set the closing handler of a server object. */
+void ttservsetclosehandler(TTSERV *serv, void (*do_close)(void *, void *), void *opq){
+  assert(serv && do_close);
+  serv->do_close = do_close;
+  serv->opq_close = opq;
+}
+
+
+/* Set the metrics registry of a server object. */
+void ttservsetmetrics(TTSERV *serv, TTMETRICS *metrics){
+  assert(serv && metrics);
+  serv->mtopen = ttmetricsreg(metrics, "conn_opened", TTMTCOUNTER);
+  serv->mtclose = ttmetricsreg(metrics, "conn_closed", TTMTCOUNTER);
+  serv->mtconn = ttmetricsreg(metrics, "connections", TTMTGAUGE);
+  if(serv->mtopen >= 0 && serv->mtclose >= 0 && serv->mtconn >= 0) serv->metrics = metrics;
+}
+
+
 /* Start the service of a server object. */
 bool ttservstart(TTSERV *serv){
   assert(serv);
-  int lfd;
-  if(serv->port < 1){
+  bool reactor = false;
+  if(serv->reactor){
+#if defined(SO_REUSEPORT)
+    if(serv->port > 0){
+      reactor = true;
+    } else {
+      ttservlog(serv, TTLOGINFO, "reactor mode is not available for UNIX domain sockets");
+    }
+#else
+    ttservlog(serv, TTLOGINFO, "reactor mode is not available on this platform");
+#endif
+  }
+  int thnum = serv->thnum;
+  TTREQ reqs[thnum];
+  for(int i = 0; i < thnum; i++){
+    reqs[i].epfd = -1;
+    reqs[i].lfd = -1;
+  }
+  int lfd = -1;
+  if(reactor){
+    for(int i = 0; i < thnum; i++){
+      if(!ttservopenreactor(serv, reqs + i)){
+        for(int j = 0; j < i; j++){
+          epoll_close(reqs[j].epfd);
+          close(reqs[j].lfd);
+        }
+        return false;
+      }
+    }
+  } else if(serv->port < 1){
     lfd = ttopenservsockunix(serv->host);
     if(lfd == -1){
       ttservlog(serv, TTLOGERROR, "ttopenservsockunix failed");
@@ -978,7 +1504,11 @@ bool ttservstart(TTSERV *serv){
   }
   int epfd = epoll_create(TTEVENTMAX);
   if(epfd == -1){
-    close(lfd);
+    if(lfd >= 0) close(lfd);
+    for(int i = 0; i < thnum; i++){
+      if(reqs[i].epfd >= 0) epoll_close(reqs[i].epfd);
+      if(reqs[i].lfd >= 0) close(reqs[i].lfd);
+    }
     ttservlog(serv, TTLOGERROR, "epoll_create failed");
     return false;
   }
@@ -996,35 +1526,65 @@ bool ttservstart(TTSERV *serv){
       err = true;
     }
   }
-  int thnum = serv->thnum;
-  TTREQ reqs[thnum];
+  void *(*worker)(void *) = reactor ? ttservreactor : ttservdeqtasks;
   for(int i = 0; i < thnum; i++){
     reqs[i].alive = true;
     reqs[i].serv = serv;
-    reqs[i].epfd = epfd;
+    if(!reactor) reqs[i].epfd = epfd;
     reqs[i].mtime = tctime();
     reqs[i].keep = false;
+    reqs[i].rtime = reqs[i].mtime;
+    reqs[i].ptime = reqs[i].mtime;
     reqs[i].idx = i;
-    if(pthread_create(&reqs[i].thid, NULL, ttservdeqtasks, reqs + i) == 0){
+    if(pthread_create(&reqs[i].thid, NULL, worker, reqs + i) == 0){
       ttservlog(serv, TTLOGINFO, "worker thread %d started", i + 1);
     } else {
       reqs[i].alive = false;
       err = true;
-      ttservlog(serv, TTLOGERROR, "pthread_create (ttservdeqtasks) failed");
+      ttservlog(serv, TTLOGERROR, "pthread_create (%s) failed",
+                reactor ? "ttservreactor" : "ttservdeqtasks");
     }
   }
-  struct epoll_event ev;
-  memset(&ev, 0, sizeof(ev));
-  ev.events = EPOLLIN;
-  ev.data.fd = lfd;
-  if(epoll_ctl(epfd, EPOLL_CTL_ADD, lfd, &ev) != 0){
-    err = true;
-    ttservlog(serv, TTLOGERROR, "epoll_ctl failed");
+  if(!reactor){
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.fd = lfd;
+    if(epoll_ctl(epfd, EPOLL_CTL_ADD, lfd, &ev) != 0){
+      err = true;
+      ttservlog(serv, TTLOGERROR, "epoll_ctl failed");
+    }
   }
-  ttservlog(serv, TTLOGSYSTEM, "listening started");
+  ttservlog(serv, TTLOGSYSTEM, "listening started%s", reactor ? " in the reactor mode" : "");
+  double swtime = tctime() + TTWAITPARK;
+  int pfds[TTEVENTMAX];
+  int pfnum = 0;
   while(!serv->term){
+    // connections which did not fit in the full queue are handed off first, in order
+    if(pfnum > 0){
+      int qnum = 0;
+      while(qnum < pfnum && ttservqpush(serv, pfds[qnum])){
+        qnum++;
+      }
+      if(qnum > 0){
+        pfnum -= qnum;
+        memmove(pfds, pfds + qnum, sizeof(*pfds) * pfnum);
+        if(serv->qidle > 0 && !ttservqwake(serv, false)){
+          err = true;
+          ttservlog(serv, TTLOGERROR, "ttservqwake failed");
+        }
+      }
+      if(pfnum > 0) ttservqwake(serv, true);
+    }
+    // in the reactor mode, nothing is registered and the waiting only paces the watchdog
     struct epoll_event events[TTEVENTMAX];
-    int fdnum = epoll_wait(epfd, events, TTEVENTMAX, TTWAITREQUEST * 1000);
+    int fdnum = 0;
+    if(pfnum < TTEVENTMAX){
+      fdnum = epoll_wait(epfd, events, TTEVENTMAX - pfnum,
+                         (pfnum > 0 ? TTWAITQUEUE : TTWAITREQUEST) * 1000);
+    } else {
+      tcsleep(TTWAITQUEUE);
+    }
     if(fdnum != -1){
       for(int i = 0; i < fdnum; i++){
         if(events[i].data.fd == lfd){
@@ -1044,11 +1604,14 @@ bool ttservstart(TTSERV *serv){
           }
           if(cfd != -1){
             ttservlog(serv, TTLOGINFO, "connected: %s:%d", addr, port);
+            ttservconnclose(serv, cfd);
             struct epoll_event ev;
             memset(&ev, 0, sizeof(ev));
             ev.events = EPOLLIN | EPOLLONESHOT;
             ev.data.fd = cfd;
-            if(epoll_ctl(epfd, EPOLL_CTL_ADD, cfd, &ev) != 0){
+            if(epoll_ctl(epfd, EPOLL_CTL_ADD, cfd, &ev) == 0){
+              ttservcountconn(serv, -1, true);
+            } else {
               close(cfd);
               err = true;
               ttservlog(serv, TTLOGERROR, "epoll_ctl failed");
@@ -1068,6 +1631,7 @@ bool ttservstart(TTSERV *serv){
               if(lfd == -1) ttservlog(serv, TTLOGERROR, "ttopenservsock failed");
             }
             if(lfd >= 0){
+              struct epoll_event ev;
               memset(&ev, 0, sizeof(ev));
               ev.events = EPOLLIN;
               ev.data.fd = lfd;
@@ -1080,19 +1644,11 @@ bool ttservstart(TTSERV *serv){
           }
         } else {
           int cfd = events[i].data.fd;
-          if(pthread_mutex_lock(&serv->qmtx) == 0){
-            tclistpush(serv->queue, &cfd, sizeof(cfd));
-            if(pthread_mutex_unlock(&serv->qmtx) != 0){
-              err = true;
-              ttservlog(serv, TTLOGERROR, "pthread_mutex_unlock failed");
-            }
-            if(pthread_cond_signal(&serv->qcnd) != 0){
-              err = true;
-              ttservlog(serv, TTLOGERROR, "pthread_cond_signal failed");
-            }
-          } else {
+          if(pfnum > 0 || !ttservqpush(serv, cfd)){
+            pfds[pfnum++] = cfd;
+          } else if(serv->qidle > 0 && !ttservqwake(serv, false)){
             err = true;
-            ttservlog(serv, TTLOGERROR, "pthread_mutex_lock failed");
+            ttservlog(serv, TTLOGERROR, "ttservqwake failed");
           }
         }
       }
@@ -1104,6 +1660,10 @@ bool ttservstart(TTSERV *serv){
         ttservlog(serv, TTLOGERROR, "epoll_wait failed");
       }
     }
+    if(serv->do_check && tctime() >= swtime){
+      ttservconnsweep(serv, tctime());
+      swtime = tctime() + TTWAITPARK;
+    }
     if(serv->timeout > 0){
       double ctime = tctime();
       for(int i = 0; i < thnum; i++){
@@ -1115,10 +1675,11 @@ bool ttservstart(TTSERV *serv){
           if(pthread_join(reqs[i].thid, &rv) == 0){
             if(rv && rv != PTHREAD_CANCELED) err = true;
             reqs[i].mtime = tctime();
-            if(pthread_create(&reqs[i].thid, NULL, ttservdeqtasks, reqs + i) != 0){
+            if(pthread_create(&reqs[i].thid, NULL, worker, reqs + i) != 0){
               reqs[i].alive = false;
               err = true;
-              ttservlog(serv, TTLOGERROR, "pthread_create (ttservdeqtasks) failed");
+              ttservlog(serv, TTLOGERROR, "pthread_create (%s) failed",
+                        reactor ? "ttservreactor" : "ttservdeqtasks");
             } else {
               ttservlog(serv, TTLOGINFO, "worker thread %d started", i + 1);
             }
@@ -1132,9 +1693,9 @@ bool ttservstart(TTSERV *serv){
     }
   }
   ttservlog(serv, TTLOGSYSTEM, "listening finished");
-  if(pthread_cond_broadcast(&serv->qcnd) != 0){
+  if(!ttservqwake(serv, true)){
     err = true;
-    ttservlog(serv, TTLOGERROR, "pthread_cond_broadcast failed");
+    ttservlog(serv, TTLOGERROR, "ttservqwake failed");
   }
   if(pthread_cond_broadcast(&serv->tcnd) != 0){
     err = true;
@@ -1155,9 +1716,13 @@ bool ttservstart(TTSERV *serv){
       ttservlog(serv, TTLOGERROR, "pthread_join failed");
     }
   }
-  if(tclistnum(serv->queue) > 0)
-    ttservlog(serv, TTLOGINFO, "%d requests discarded", tclistnum(serv->queue));
-  tclistclear(serv->queue);
+  int dnum = 0;
+  double qtime;
+  while(ttservqpop(serv, &qtime) >= 0){
+    dnum++;
+  }
+  if(dnum > 0) ttservlog(serv, TTLOGINFO, "%d requests discarded", dnum);
+  ttservconnclear(serv);
   for(int i = 0; i < serv->timernum; i++){
     TTTIMER *timer = serv->timers + i;
     if(!timer->alive) continue;
@@ -1172,6 +1737,18 @@ bool ttservstart(TTSERV *serv){
       ttservlog(serv, TTLOGERROR, "pthread_join failed");
     }
   }
+  if(reactor){
+    for(int i = 0; i < thnum; i++){
+      if(epoll_close(reqs[i].epfd) != 0){
+        err = true;
+        ttservlog(serv, TTLOGERROR, "epoll_close failed");
+      }
+      if(reqs[i].lfd >= 0 && close(reqs[i].lfd) != 0){
+        err = true;
+        ttservlog(serv, TTLOGERROR, "close failed");
+      }
+    }
+  }
   if(epoll_close(epfd) != 0){
     err = true;
     ttservlog(serv, TTLOGERROR, "epoll_close failed");
@@ -1190,6 +1767,21 @@ bool ttservstart(TTSERV *serv){
 }
 
 
+/* Get the number of requests waiting in the queue of a server object. */
+int ttservqueuenum(TTSERV *serv){
+  assert(serv);
+  int32_t num = (int32_t)(serv->qhead - serv->qtail);
+  return num > 0 ? num : 0;
+}
+
+
+/* Resume serving a connection suspended by the task handler of a server object. */
+bool ttservresume(TTREQ *req, TTSOCK *sock){
+  assert(req && sock);
+  return ttservservecon(req, sock, true);
+}
+
+
 /* Send the terminate signal to a server object. */
 bool ttservkill(TTSERV *serv){
   assert(serv);
@@ -1241,6 +1833,448 @@ char *ttbreakservexpr(const char *expr, int *pp){
 }
 
 
+/* Open a server socket of TCP/IP stream sharing the port with other sockets.
+   `addr' specifies the address of the server.  If it is `NULL', every network address is binded.
+   `port' specifies the port number of the server.
+   The return value is the file descriptor of the stream, or -1 on error. */
+static int ttopenservsockrp(const char *addr, int port){
+  assert(port >= 0);
+#if defined(SO_REUSEPORT)
+  struct sockaddr_in sain;
+  memset(&sain, 0, sizeof(sain));
+  sain.sin_family = AF_INET;
+  if(inet_aton(addr ? addr : "0.0.0.0", &sain.sin_addr) == 0) return -1;
+  uint16_t snum = port;
+  sain.sin_port = htons(snum);
+  int fd = socket(PF_INET, SOCK_STREAM, 0);
+  if(fd == -1) return -1;
+  int optint = 1;
+  if(setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, (char *)&optint, sizeof(optint)) != 0 ||
+     setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, (char *)&optint, sizeof(optint)) != 0){
+    close(fd);
+    return -1;
+  }
+  if(bind(fd, (struct sockaddr *)&sain, sizeof(sain)) != 0 ||
+     listen(fd, SOMAXCONN) != 0){
+    close(fd);
+    return -1;
+  }
+  return fd;
+#else
+  return -1;
+#endif
+}
+
+
+/* Open the listening socket and the polling descriptor of a reactor.
+   `serv' specifies the server object.
+   `req' specifies the request object of the reactor.  If its polling descriptor is already
+   opened, only the listening socket is opened and registered to it.
+   If successful, the return value is true, else, it is false. */
+static bool ttservopenreactor(TTSERV *serv, TTREQ *req){
+  bool fresh = false;
+  if(req->epfd < 0){
+    req->epfd = epoll_create(TTEVENTMAX);
+    if(req->epfd == -1){
+      ttservlog(serv, TTLOGERROR, "epoll_create failed");
+      return false;
+    }
+    fresh = true;
+  }
+  req->lfd = ttopenservsockrp(serv->addr[0] != '\0' ? serv->addr : NULL, serv->port);
+  if(req->lfd == -1){
+    ttservlog(serv, TTLOGERROR, "ttopenservsockrp failed");
+  } else {
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.fd = req->lfd;
+    if(epoll_ctl(req->epfd, EPOLL_CTL_ADD, req->lfd, &ev) == 0) return true;
+    ttservlog(serv, TTLOGERROR, "epoll_ctl failed");
+    close(req->lfd);
+    req->lfd = -1;
+  }
+  if(fresh){
+    epoll_close(req->epfd);
+    req->epfd = -1;
+  }
+  return false;
+}
+
+
+/* Enqueue a connection into the request queue of a server object.
+   `serv' specifies the server object.
+   `fd' specifies the file descriptor of the connection.
+   If successful, the return value is true, else, it is false because the queue is full.
+   The slot is published by a full barrier, so that a worker which has not seen it has already
+   been counted as idle when the caller checks idle workers. */
+static bool ttservqpush(TTSERV *serv, int fd){
+  while(true){
+    uint32_t pos = serv->qhead;
+    TTQSLOT *slot = serv->qslots + (pos & (TTQUEUEMAX - 1));
+    __sync_synchronize();
+    int32_t dif = (int32_t)(slot->seq - pos);
+    if(dif == 0){
+      if(__sync_bool_compare_and_swap(&serv->qhead, pos, pos + 1)){
+        slot->fd = fd;
+        slot->time = tctime();
+        __sync_synchronize();
+        slot->seq = pos + 1;
+        __sync_synchronize();
+        return true;
+      }
+    } else if(dif < 0){
+      return false;
+    }
+  }
+}
+
+
+/* Dequeue a connection from the request queue of a server object.
+   `serv' specifies the server object.
+   `tp' specifies the pointer to a variable into which the time of enqueueing is assigned.
+   The return value is the file descriptor of the connection, or -1 if the queue is empty. */
+static int ttservqpop(TTSERV *serv, double *tp){
+  while(true){
+    uint32_t pos = serv->qtail;
+    TTQSLOT *slot = serv->qslots + (pos & (TTQUEUEMAX - 1));
+    __sync_synchronize();
+    int32_t dif = (int32_t)(slot->seq - (pos + 1));
+    if(dif == 0){
+      if(__sync_bool_compare_and_swap(&serv->qtail, pos, pos + 1)){
+        int fd = slot->fd;
+        *tp = slot->time;
+        __sync_synchronize();
+        slot->seq = pos + TTQUEUEMAX;
+        return fd;
+      }
+    } else if(dif < 0){
+      return -1;
+    }
+  }
+}
+
+
+/* Park an idle worker of a server object until a connection is enqueued.
+   `serv' specifies the server object.
+   `wseq' specifies the wake-up sequence observed before the queue was found empty.
+   If successful, the return value is true, else, it is false. */
+static bool ttservqpark(TTSERV *serv, uint32_t wseq){
+  double integ, fract;
+  fract = modf(TTWAITPARK, &integ);
+#if defined(TTUSEFUTEX)
+  struct timespec ts;
+  ts.tv_sec = integ;
+  ts.tv_nsec = fract * 1000000000.0;
+  if(syscall(SYS_futex, &serv->qwseq, FUTEX_WAIT_PRIVATE, wseq, &ts, NULL, 0) != 0 &&
+     errno != EAGAIN && errno != EINTR && errno != ETIMEDOUT) return false;
+  return true;
+#else
+  if(pthread_mutex_lock(&serv->qmtx) != 0) return false;
+  bool err = false;
+  if(serv->qwseq == wseq){
+    struct timeval tv;
+    struct timespec ts;
+    if(gettimeofday(&tv, NULL) == 0){
+      ts.tv_sec = tv.tv_sec + (int)integ;
+      ts.tv_nsec = tv.tv_usec * 1000.0 + fract * 1000000000.0;
+      if(ts.tv_nsec >= 1000000000){
+        ts.tv_nsec -= 1000000000;
+        ts.tv_sec++;
+      }
+    } else {
+      ts.tv_sec = (1ULL << (sizeof(time_t) * 8 - 1)) - 1;
+      ts.tv_nsec = 0;
+    }
+    int code = pthread_cond_timedwait(&serv->qcnd, &serv->qmtx, &ts);
+    if(code != 0 && code != ETIMEDOUT && code != EINTR) err = true;
+  }
+  if(pthread_mutex_unlock(&serv->qmtx) != 0) err = true;
+  return !err;
+#endif
+}
+
+
+/* Wake up idle workers of a server object.
+   `serv' specifies the server object.
+   `all' specifies whether every idle worker is woken up.  If it is false, only one is.
+   If successful, the return value is true, else, it is false. */
+static bool ttservqwake(TTSERV *serv, bool all){
+  __sync_add_and_fetch(&serv->qwseq, 1);
+#if defined(TTUSEFUTEX)
+  if(syscall(SYS_futex, &serv->qwseq, FUTEX_WAKE_PRIVATE, all ? INT_MAX : 1,
+             NULL, NULL, 0) == -1) return false;
+  return true;
+#else
+  if(pthread_mutex_lock(&serv->qmtx) != 0) return false;
+  bool err = false;
+  if((all ? pthread_cond_broadcast(&serv->qcnd) : pthread_cond_signal(&serv->qcnd)) != 0)
+    err = true;
+  if(pthread_mutex_unlock(&serv->qmtx) != 0) err = true;
+  return !err;
+#endif
+}
+
+
+/* Get an I/O buffer from the buffer pool of a server object.
+   `serv' specifies the server object.
+   `size' specifies the size of the buffer.  It should be the size of one of the classes.  If it
+   is larger than the largest class, the buffer is allocated without the pool.
+   The return value is the pointer to the region of the buffer. */
+static char *ttservbufget(TTSERV *serv, int size){
+  int cls = 0;
+  while(cls < TTBPCLSNUM - 1 && (TTBPMINSIZ << (cls * 2)) < size){
+    cls++;
+  }
+  if(size > (TTBPMINSIZ << (cls * 2))) return tcmalloc(size);
+  char *buf = NULL;
+  if(pthread_mutex_lock(&serv->bpmtx) == 0){
+    if(serv->bpnums[cls] > 0) buf = serv->bpool[cls][--serv->bpnums[cls]];
+    pthread_mutex_unlock(&serv->bpmtx);
+  }
+  if(!buf) buf = tcmalloc(TTBPMINSIZ << (cls * 2));
+  return buf;
+}
+
+
+/* Put an I/O buffer back into the buffer pool of a server object.
+   `serv' specifies the server object.
+   `buf' specifies the pointer to the region of the buffer.
+   `size' specifies the size of the buffer. */
+static void ttservbufput(TTSERV *serv, char *buf, int size){
+  int cls = 0;
+  while(cls < TTBPCLSNUM - 1 && (TTBPMINSIZ << (cls * 2)) < size){
+    cls++;
+  }
+  if(size > (TTBPMINSIZ << (cls * 2))){
+    tcfree(buf);
+    return;
+  }
+  if(pthread_mutex_lock(&serv->bpmtx) == 0){
+    if(serv->bpnums[cls] < TTBPCLSMAX){
+      serv->bpool[cls][serv->bpnums[cls]++] = buf;
+      buf = NULL;
+    }
+    pthread_mutex_unlock(&serv->bpmtx);
+  }
+  if(buf) tcfree(buf);
+}
+
+
+/* Get the socket object of a connection of a server object to process its requests.
+   `serv' specifies the server object.
+   `fd' specifies the file descriptor of the connection.
+   The return value is the socket object registered in the table of connections.  If it is not
+   registered yet, a new object is created.  Pooled buffers are attached to it for reading and
+   for deferred sending.
+   Because each descriptor is processed by one worker at a time, its slot is modified under the
+   shared lock and the exclusive lock is acquired only to expand the table.  The connection is
+   taken out of the parked state under the lock. */
+static TTSOCK *ttservconnopen(TTSERV *serv, int fd){
+  TTSOCK *sock = NULL;
+  if(pthread_rwlock_rdlock(&serv->cnlck) == 0){
+    if(fd < serv->connsiz){
+      sock = serv->conns[fd];
+      if(sock) sock->pdl = HUGE_VAL;
+    }
+    pthread_rwlock_unlock(&serv->cnlck);
+  }
+  if(!sock){
+    sock = tcmalloc(sizeof(*sock));
+    sock->fd = fd;
+    sock->id = __sync_add_and_fetch(&serv->connseq, 1);
+    sock->buf = NULL;
+    sock->bsiz = TTBPMINSIZ;
+    sock->rmax = 0;
+    sock->rp = NULL;
+    sock->ep = NULL;
+    sock->end = false;
+    sock->to = 0.0;
+    sock->dl = HUGE_VAL;
+    sock->pdl = HUGE_VAL;
+    sock->wbuf = NULL;
+    sock->wnum = 0;
+    sock->wtime = 0.0;
+    sock->rsum = 0;
+    sock->ssum = 0;
+    sock->rec = NULL;
+    sock->rrp = NULL;
+    sock->opq = NULL;
+    if(pthread_rwlock_rdlock(&serv->cnlck) == 0){
+      bool done = false;
+      if(fd < serv->connsiz){
+        serv->conns[fd] = sock;
+        done = true;
+      }
+      pthread_rwlock_unlock(&serv->cnlck);
+      if(!done && pthread_rwlock_wrlock(&serv->cnlck) == 0){
+        if(fd >= serv->connsiz){
+          int nsiz = serv->connsiz > 0 ? serv->connsiz : TTCONNTABMIN;
+          while(nsiz <= fd){
+            nsiz *= 2;
+          }
+          serv->conns = tcrealloc(serv->conns, sizeof(*serv->conns) * nsiz);
+          memset(serv->conns + serv->connsiz, 0,
+                 sizeof(*serv->conns) * (nsiz - serv->connsiz));
+          serv->connsiz = nsiz;
+        }
+        serv->conns[fd] = sock;
+        pthread_rwlock_unlock(&serv->cnlck);
+      }
+    }
+  }
+  if(!sock->buf){
+    sock->buf = ttservbufget(serv, sock->bsiz);
+    sock->rp = sock->buf;
+    sock->ep = sock->buf;
+    sock->rrp = sock->buf;
+    sock->rmax = 0;
+    sock->to = 0.0;
+    sock->dl = HUGE_VAL;
+  }
+  if(!sock->wbuf){
+    sock->wbuf = ttservbufget(serv, TTIOBUFSIZ);
+    sock->wnum = 0;
+  }
+  return sock;
+}
+
+
+/* Release the buffers of the socket object of an idle connection of a server object.
+   `serv' specifies the server object.
+   `sock' specifies the socket object whose pending data has been flushed.
+   The reading buffer is kept while it contains received data not processed yet.  The size class
+   of the reading buffer is adjusted according to the maximum size of received chunks.  The
+   deadline of the socket is kept with a partial request. */
+static void ttservconnidle(TTSERV *serv, TTSOCK *sock){
+  if(sock->wbuf){
+    ttservbufput(serv, sock->wbuf, TTIOBUFSIZ);
+    sock->wbuf = NULL;
+    sock->wnum = 0;
+  }
+  if(sock->buf && sock->rp >= sock->ep){
+    ttservbufput(serv, sock->buf, sock->bsiz);
+    if(sock->bsiz > TTIOBUFSIZ){
+      sock->bsiz = TTIOBUFSIZ;
+    } else if(sock->rmax >= sock->bsiz){
+      if(sock->bsiz < TTIOBUFSIZ) sock->bsiz *= 4;
+    } else if(sock->rmax <= sock->bsiz / 4 && sock->bsiz > TTBPMINSIZ){
+      sock->bsiz /= 4;
+    }
+    sock->buf = NULL;
+    sock->rp = NULL;
+    sock->ep = NULL;
+  }
+}
+
+
+/* Mark the socket object of a connection of a server object as parked in the polling descriptor.
+   `serv' specifies the server object.
+   `sock' specifies the socket object.
+   The deadline of a partial request is published under the shared lock, so that the sweeper
+   holding the exclusive lock sees only the state of parked connections. */
+static void ttservconnpark(TTSERV *serv, TTSOCK *sock){
+  double pdl = sock->rp < sock->ep ? sock->dl : HUGE_VAL;
+  if(pthread_rwlock_rdlock(&serv->cnlck) != 0) return;
+  sock->pdl = pdl;
+  pthread_rwlock_unlock(&serv->cnlck);
+}
+
+
+/* Remove the socket object of a connection from the table of a server object.
+   `serv' specifies the server object.
+   `fd' specifies the file descriptor of the connection.
+   The state of the connection is released by the closing handler.  The buffers of the object are
+   put back into the pool and the object is deleted.  The descriptor itself is not closed. */
+static void ttservconnclose(TTSERV *serv, int fd){
+  TTSOCK *sock = NULL;
+  if(pthread_rwlock_rdlock(&serv->cnlck) == 0){
+    if(fd < serv->connsiz){
+      sock = serv->conns[fd];
+      serv->conns[fd] = NULL;
+    }
+    pthread_rwlock_unlock(&serv->cnlck);
+  }
+  if(!sock) return;
+  if(sock->opq && serv->do_close) serv->do_close(sock->opq, serv->opq_close);
+  if(sock->wbuf) ttservbufput(serv, sock->wbuf, TTIOBUFSIZ);
+  if(sock->buf) ttservbufput(serv, sock->buf, sock->bsiz);
+  tcfree(sock);
+}
+
+
+/* Remove every socket object from the table of connections of a server object.
+   `serv' specifies the server object. */
+static void ttservconnclear(TTSERV *serv){
+  for(int i = 0; i < serv->connsiz; i++){
+    if(serv->conns[i]) ttservconnclose(serv, i);
+  }
+}
+
+
+/* Shut down connections of a server object whose partial requests have expired.
+   `serv' specifies the server object.
+   `now' specifies the current time.
+   Only connections parked in the polling descriptor are examined, by the deadline published
+   when they were parked.  Only reading is shut down, so that the connection becomes ready and a
+   worker closes it as expired.  The table is locked exclusively so that no socket object is
+   freed or taken by a worker meanwhile. */
+static void ttservconnsweep(TTSERV *serv, double now){
+  if(pthread_rwlock_wrlock(&serv->cnlck) != 0) return;
+  for(int i = 0; i < serv->connsiz; i++){
+    TTSOCK *sock = serv->conns[i];
+    if(sock && sock->pdl < now) shutdown(sock->fd, SHUT_RD);
+  }
+  pthread_rwlock_unlock(&serv->cnlck);
+}
+
+
+/* Receive data of a connection of a server object without blocking until its first request is
+   complete.
+   `serv' specifies the server object.
+   `sock' specifies the socket object of the connection.
+   If the request can be dispatched, the return value is true.  It is also true if the request is
+   too large to be kept or if the connection is closed or broken, so that the response handler
+   deals with it in the usual way.  If more data should arrive, the return value is false. */
+static bool ttservfillreq(TTSERV *serv, TTSOCK *sock){
+  while(true){
+    int size = sock->ep - sock->rp;
+    int need = serv->do_check(sock->rp, size, serv->opq_check);
+    if(need <= size || need > TTPARKMAX) return true;
+    if(need > sock->bsiz){
+      int nsiz = sock->bsiz;
+      while(nsiz < need && nsiz < TTIOBUFSIZ){
+        nsiz *= 4;
+      }
+      if(nsiz < need) nsiz = need;
+      char *nbuf = ttservbufget(serv, nsiz);
+      memcpy(nbuf, sock->rp, size);
+      ttservbufput(serv, sock->buf, sock->bsiz);
+      sock->buf = nbuf;
+      sock->bsiz = nsiz;
+      sock->rp = sock->buf;
+      sock->ep = sock->buf + size;
+    } else if(sock->rp + need > sock->buf + sock->bsiz){
+      memmove(sock->buf, sock->rp, size);
+      sock->rp = sock->buf;
+      sock->ep = sock->buf + size;
+    }
+    int rv = recv(sock->fd, sock->ep, sock->buf + sock->bsiz - sock->ep, MSG_DONTWAIT);
+    if(rv > 0){
+      if(rv > sock->rmax) sock->rmax = rv;
+      sock->rsum += rv;
+      sock->ep += rv;
+    } else if(rv == -1 && errno == EINTR){
+      continue;
+    } else if(rv == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)){
+      return false;
+    } else {
+      return true;
+    }
+  }
+}
+
+
 /* Call the timed function of a server object.
    `argp' specifies the argument structure of the server object.
    The return value is `NULL' on success and other on failure. */
@@ -1292,6 +2326,18 @@ static void *ttservtimer(void *argp){
 }
 
 
+/* Count a connection opened or closed in the metrics registry of a server object.
+   `serv' specifies the server object.
+   `idx' specifies the index of the slab of the calling thread.
+   `open' specifies whether the connection is opened. */
+static void ttservcountconn(TTSERV *serv, int idx, bool open){
+  TTMETRICS *metrics = serv->metrics;
+  if(!metrics) return;
+  ttmetricsadd(metrics, idx, open ? serv->mtopen : serv->mtclose, 1);
+  ttmetricsadd(metrics, idx, serv->mtconn, open ? 1 : -1);
+}
+
+
 /* Call the task function of a server object.
    `req' specifies the request object.
    `sock' specifies the socket object. */
@@ -1302,6 +2348,129 @@ static void ttservtask(TTSOCK *sock, TTREQ *req){
 }
 
 
+/* Release the connection being served by a worker thread which is cancelled.
+   `req' specifies the request object.
+   The socket object is removed from the table and the descriptor is closed as a connection
+   closed normally, so that no state of it is handed to a later connection of the same
+   descriptor. */
+static void ttservcancelcon(TTREQ *req){
+  TTSERV *serv = req->serv;
+  int cfd = req->cfd;
+  ttservconnclose(serv, cfd);
+  ttservcountconn(serv, req->idx, false);
+  epoll_ctl(req->epfd, EPOLL_CTL_DEL, cfd, NULL);
+  ttclosesock(cfd);
+}
+
+
+/* Process requests of a connection of a server object.
+   `req' specifies the request object.
+   `cfd' specifies the file descriptor of the connection.
+   If successful, the return value is true, else, it is false. */
+static bool ttservproccon(TTREQ *req, int cfd){
+  TTSOCK *sock = ttservconnopen(req->serv, cfd);
+  return ttservservecon(req, sock, false);
+}
+
+
+/* Serve requests of a connection of a server object and give it back to the polling descriptor.
+   `req' specifies the request object.
+   `sock' specifies the socket object of the connection.
+   `resume' specifies whether the task handler has already dealt with the first request.
+   If successful, the return value is true, else, it is false. */
+static bool ttservservecon(TTREQ *req, TTSOCK *sock, bool resume){
+  TTSERV *serv = req->serv;
+  int cfd = sock->fd;
+  bool err = false;
+  req->cfd = cfd;
+  pthread_cleanup_push((void (*)(void *))ttservcancelcon, req);
+  bool held = !resume && sock->rp < sock->ep;
+  double hdl = sock->dl;
+  bool reuse;
+  do {
+    reuse = false;
+    if(!resume){
+      if(serv->timeout > 0) ttsocksetlife(sock, serv->timeout);
+      req->mtime = tctime();
+      req->keep = false;
+      req->detach = false;
+      req->suspend = false;
+      if(serv->do_check){
+        if(held && tctime() > hdl){
+          ttservlog(serv, TTLOGINFO, "partial request expired");
+          break;
+        }
+        if(!ttservfillreq(serv, sock)){
+          if(held){
+            sock->dl = hdl;
+          } else {
+            double pdl = tctime() + TTPARKTIMEO;
+            if(pdl < sock->dl) sock->dl = pdl;
+          }
+          req->keep = true;
+          break;
+        }
+        held = false;
+        if(serv->timeout <= 0) sock->dl = HUGE_VAL;
+      }
+      ttservtask(sock, req);
+      if(req->suspend) break;
+    }
+    resume = false;
+    if(req->detach){
+      req->keep = false;
+    } else if(sock->end){
+      req->keep = false;
+    } else if(sock->ep > sock->rp){
+      reuse = true;
+    }
+  } while(reuse);
+  if(!req->suspend){
+    if(!ttsockflush(sock)) req->keep = false;
+    if(req->keep){
+      ttservconnpark(serv, sock);
+      ttservconnidle(serv, sock);
+    }
+  }
+  pthread_cleanup_pop(0);
+  if(req->suspend) return true;
+  if(req->keep){
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN | EPOLLONESHOT;
+    ev.data.fd = cfd;
+    if(epoll_ctl(req->epfd, EPOLL_CTL_MOD, cfd, &ev) != 0){
+      ttservconnclose(serv, cfd);
+      close(cfd);
+      ttservcountconn(serv, req->idx, false);
+      err = true;
+      ttservlog(serv, TTLOGERROR, "epoll_ctl failed");
+    }
+  } else {
+    ttservconnclose(serv, cfd);
+    ttservcountconn(serv, req->idx, false);
+    if(epoll_ctl(req->epfd, EPOLL_CTL_DEL, cfd, NULL) != 0){
+      err = true;
+      ttservlog(serv, TTLOGERROR, "epoll_ctl failed");
+    }
+    if(req->detach){
+      if(close(cfd) != 0){
+        err = true;
+        ttservlog(serv, TTLOGERROR, "close failed");
+      }
+      ttservlog(serv, TTLOGINFO, "connection detached");
+    } else {
+      if(!ttclosesock(cfd)){
+        err = true;
+        ttservlog(serv, TTLOGERROR, "close failed");
+      }
+      ttservlog(serv, TTLOGINFO, "connection finished");
+    }
+  }
+  return !err;
+}
+
+
 /* Dequeue tasks of a server object and dispatch them.
    `argp' specifies the argument structure of the server object.
    The return value is `NULL' on success and other on failure. */
@@ -1322,83 +2491,102 @@ static void *ttservdeqtasks(void *argp){
     err = true;
     ttservlog(serv, TTLOGERROR, "pthread_sigmask failed");
   }
-  bool empty = false;
   while(!serv->term){
-    if(pthread_mutex_lock(&serv->qmtx) == 0){
-      struct timeval tv;
-      struct timespec ts;
-      if(gettimeofday(&tv, NULL) == 0){
-        ts.tv_sec = tv.tv_sec;
-        ts.tv_nsec = tv.tv_usec * 1000.0 + TTWAITREQUEST * 1000000000.0;
-        if(ts.tv_nsec >= 1000000000){
-          ts.tv_nsec -= 1000000000;
-          ts.tv_sec++;
-        }
-      } else {
-        ts.tv_sec = (1ULL << (sizeof(time_t) * 8 - 1)) - 1;
-        ts.tv_nsec = 0;
+    int cfd = ttservqpop(serv, &req->rtime);
+    if(cfd < 0){
+      uint32_t wseq = serv->qwseq;
+      __sync_add_and_fetch(&serv->qidle, 1);
+      cfd = ttservqpop(serv, &req->rtime);
+      if(cfd < 0 && !serv->term && !ttservqpark(serv, wseq)){
+        err = true;
+        ttservlog(serv, TTLOGERROR, "ttservqpark failed");
       }
-      int code = empty ? pthread_cond_timedwait(&serv->qcnd, &serv->qmtx, &ts) : 0;
-      if(code == 0 || code == ETIMEDOUT || code == EINTR){
-        void *val = tclistshift2(serv->queue);
-        if(pthread_mutex_unlock(&serv->qmtx) != 0){
-          err = true;
-          ttservlog(serv, TTLOGERROR, "pthread_mutex_unlock failed");
-        }
-        if(val){
-          empty = false;
-          int cfd = *(int *)val;
-          tcfree(val);
-          pthread_cleanup_push((void (*)(void *))close, (void *)(intptr_t)cfd);
-          TTSOCK *sock = ttsocknew(cfd);
-          pthread_cleanup_push((void (*)(void *))ttsockdel, sock);
-          bool reuse;
-          do {
-            if(serv->timeout > 0) ttsocksetlife(sock, serv->timeout);
-            req->mtime = tctime();
-            req->keep = false;
-            ttservtask(sock, req);
-            reuse = false;
-            if(sock->end){
-              req->keep = false;
-            } else if(sock->ep > sock->rp){
-              reuse = true;
-            }
-          } while(reuse);
-          pthread_cleanup_pop(1);
-          pthread_cleanup_pop(0);
-          if(req->keep){
+      __sync_sub_and_fetch(&serv->qidle, 1);
+    }
+    if(cfd >= 0){
+      req->ptime = tctime();
+      if(!ttservproccon(req, cfd)) err = true;
+    }
+    pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, NULL);
+    pthread_testcancel();
+    pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, NULL);
+    req->mtime = tctime();
+  }
+  if(pthread_sigmask(SIG_SETMASK, &oldsigset, NULL) != 0){
+    err = true;
+    ttservlog(serv, TTLOGERROR, "pthread_sigmask failed");
+  }
+  return err ? "error" : NULL;
+}
+
+
+/* Accept connections and dispatch their requests by a reactor of a worker thread.
+   `argp' specifies the argument structure of the server object.
+   The return value is `NULL' on success and other on failure. */
+static void *ttservreactor(void *argp){
+  TTREQ *req = argp;
+  TTSERV *serv = req->serv;
+  bool err = false;
+  if(pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, NULL) != 0){
+    err = true;
+    ttservlog(serv, TTLOGERROR, "pthread_setcancelstate failed");
+  }
+  sigset_t sigset;
+  sigemptyset(&sigset);
+  sigaddset(&sigset, SIGPIPE);
+  sigset_t oldsigset;
+  sigemptyset(&oldsigset);
+  if(pthread_sigmask(SIG_BLOCK, &sigset, &oldsigset) != 0){
+    err = true;
+    ttservlog(serv, TTLOGERROR, "pthread_sigmask failed");
+  }
+  while(!serv->term){
+    struct epoll_event events[TTEVENTMAX];
+    int fdnum = epoll_wait(req->epfd, events, TTEVENTMAX, TTWAITREQUEST * 1000);
+    req->rtime = tctime();
+    req->ptime = req->rtime;
+    if(fdnum != -1){
+      for(int i = 0; i < fdnum && !serv->term; i++){
+        if(req->lfd >= 0 && events[i].data.fd == req->lfd){
+          char addr[TTADDRBUFSIZ];
+          int port;
+          int cfd = ttacceptsock(req->lfd, addr, &port);
+          if(epoll_reassoc(req->epfd, req->lfd) != 0){
+            if(cfd != -1) close(cfd);
+            cfd = -1;
+          }
+          if(cfd != -1){
+            ttservlog(serv, TTLOGINFO, "connected: %s:%d", addr, port);
+            ttservconnclose(serv, cfd);
             struct epoll_event ev;
             memset(&ev, 0, sizeof(ev));
             ev.events = EPOLLIN | EPOLLONESHOT;
             ev.data.fd = cfd;
-            if(epoll_ctl(req->epfd, EPOLL_CTL_MOD, cfd, &ev) != 0){
+            if(epoll_ctl(req->epfd, EPOLL_CTL_ADD, cfd, &ev) == 0){
+              ttservcountconn(serv, req->idx, true);
+            } else {
               close(cfd);
               err = true;
               ttservlog(serv, TTLOGERROR, "epoll_ctl failed");
             }
           } else {
-            if(epoll_ctl(req->epfd, EPOLL_CTL_DEL, cfd, NULL) != 0){
-              err = true;
+            err = true;
+            ttservlog(serv, TTLOGERROR, "ttacceptsock failed");
+            if(epoll_ctl(req->epfd, EPOLL_CTL_DEL, req->lfd, NULL) != 0)
               ttservlog(serv, TTLOGERROR, "epoll_ctl failed");
-            }
-            if(!ttclosesock(cfd)){
-              err = true;
-              ttservlog(serv, TTLOGERROR, "close failed");
-            }
-            ttservlog(serv, TTLOGINFO, "connection finished");
+            if(close(req->lfd) != 0) ttservlog(serv, TTLOGERROR, "close failed");
+            req->lfd = -1;
+            tcsleep(TTWAITWORKER);
+            if(ttservopenreactor(serv, req))
+              ttservlog(serv, TTLOGSYSTEM, "listening restarted");
           }
         } else {
-          empty = true;
+          if(!ttservproccon(req, events[i].data.fd)) err = true;
         }
-      } else {
-        pthread_mutex_unlock(&serv->qmtx);
-        err = true;
-        ttservlog(serv, TTLOGERROR, "pthread_cond_timedwait failed");
       }
-    } else {
+    } else if(errno != EINTR){
       err = true;
-      ttservlog(serv, TTLOGERROR, "pthread_mutex_lock failed");
+      ttservlog(serv, TTLOGERROR, "epoll_wait failed");
     }
     pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, NULL);
     pthread_testcancel();
@@ -1479,13 +2667,20 @@ const char *ttcmdidtostr(int id){
     case TTCMDPUTKEEP: return "putkeep";
     case TTCMDPUTCAT: return "putcat";
     case TTCMDPUTSHL: return "putshl";
+    case TTCMDMPUT: return "mput";
     case TTCMDPUTNR: return "putnr";
     case TTCMDOUT: return "out";
+    case TTCMDMOUT: return "mout";
     case TTCMDGET: return "get";
     case TTCMDMGET: return "mget";
     case TTCMDVSIZ: return "vsiz";
     case TTCMDITERINIT: return "iterinit";
     case TTCMDITERNEXT: return "iternext";
+    case TTCMDCURNEW: return "curnew";
+    case TTCMDCURJUMP: return "curjump";
+    case TTCMDCURNEXT: return "curnext";
+    case TTCMDCURPREV: return "curprev";
+    case TTCMDCURDEL: return "curdel";
     case TTCMDFWMKEYS: return "fwmkeys";
     case TTCMDADDINT: return "addint";
     case TTCMDADDDOUBLE: return "adddouble";
@@ -1500,6 +2695,7 @@ const char *ttcmdidtostr(int id){
     case TTCMDSIZE: return "size";
     case TTCMDSTAT: return "stat";
     case TTCMDMISC: return "misc";
+    case TTCMDBATCH: return "batch";
     case TTCMDREPL: return "repl";
   }
   return "(unknown)";
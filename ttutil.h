@@ -47,12 +47,24 @@ __TTUTIL_CLINKAGEBEGIN
 
 typedef struct {                         /* type of structure for a socket */
   int fd;                                /* file descriptor */
-  char buf[TTIOBUFSIZ];                  /* reading buffer */
+  uint32_t id;                           /* serial number of the connection */
+  char *buf;                             /* reading buffer */
+  int bsiz;                              /* size of the reading buffer */
+  int rmax;                              /* maximum size of received chunks */
   char *rp;                              /* reading pointer */
   char *ep;                              /* end pointer */
   bool end;                              /* end flag */
   double to;                             /* timeout */
   double dl;                             /* deadline time */
+  double pdl;                            /* deadline of a partial request of a parked connection */
+  char *wbuf;                            /* writing buffer for deferred sending */
+  int wnum;                              /* size of pending data in the writing buffer */
+  double wtime;                          /* total seconds spent in sending */
+  uint64_t rsum;                         /* total bytes received */
+  uint64_t ssum;                         /* total bytes sent */
+  TCXSTR *rec;                           /* buffer to record received data */
+  char *rrp;                             /* reading pointer at the start of recording */
+  void *opq;                             /* opaque pointer of the connection */
 } TTSOCK;
 
 
@@ -149,6 +161,30 @@ void ttsockdel(TTSOCK *sock);
 void ttsocksetlife(TTSOCK *sock, double lifetime);
 
 
+/* Set the deferred sending mode of a socket object.
+   `sock' specifies the socket object.
+   `defer' specifies whether data to send is kept in the writing buffer of the socket.  Pending
+   data is sent together when the buffer is full, when the socket waits for more data to be
+   received, or when it is flushed explicitly.  If it is false, pending data is flushed.  By
+   default, it is false.
+   If successful, the return value is true, else, it is false. */
+bool ttsocksetdefer(TTSOCK *sock, bool defer);
+
+
+/* Set the recording buffer of a socket object.
+   `sock' specifies the socket object.
+   `xstr' specifies an extensible string object into which data read from the socket afterward
+   is appended.  If it is `NULL', recording is stopped.  Data read since the previous setting is
+   appended to the previous buffer when recording is stopped or the buffer is changed. */
+void ttsocksetrec(TTSOCK *sock, TCXSTR *xstr);
+
+
+/* Flush pending data of a socket object in the deferred sending mode.
+   `sock' specifies the socket object.
+   If successful, the return value is true, else, it is false. */
+bool ttsockflush(TTSOCK *sock);
+
+
 /* Send data by a socket.
    `sock' specifies the socket object.
    `buf' specifies the pointer to the region of the data to send.
@@ -261,6 +297,198 @@ double ttunpackdouble(const char *buf);
 
 
 
+/*************************************************************************************************
+ * metrics registry
+ *************************************************************************************************/
+
+
+enum {                                   /* enumeration for types of metrics */
+  TTMTCOUNTER,                           /* monotonically increasing counter */
+  TTMTGAUGE,                             /* gauge increased and decreased */
+  TTMTBYTES                              /* counter of bytes */
+};
+
+typedef struct {                         /* type of structure for a metrics registry */
+  int thnum;                             /* number of slabs owned by threads */
+  int capnum;                            /* capacity of metrics */
+  volatile int num;                      /* number of registered metrics */
+  char **names;                          /* names of metrics */
+  int *types;                            /* types of metrics */
+  int stride;                            /* number of values in each slab */
+  int64_t *slabs;                        /* slabs of values aligned to cache lines */
+  pthread_mutex_t mtx;                   /* mutex for registration */
+} TTMETRICS;
+
+
+/* Create a metrics registry object.
+   `thnum' specifies the number of threads owning slabs of their own.
+   `capnum' specifies the maximum number of metrics.
+   The return value is the new metrics registry object.
+   Each slab is aligned to cache lines so that threads updating their own slabs never share a
+   cache line.  Another slab is shared by the other threads and updated atomically. */
+TTMETRICS *ttmetricsnew(int thnum, int capnum);
+
+
+/* Delete a metrics registry object.
+   `metrics' specifies the metrics registry object. */
+void ttmetricsdel(TTMETRICS *metrics);
+
+
+/* Register a metric in a metrics registry object.
+   `metrics' specifies the metrics registry object.
+   `name' specifies the name of the metric.
+   `type' specifies the type of the metric: `TTMTCOUNTER' for a counter, `TTMTGAUGE' for a gauge,
+   `TTMTBYTES' for a counter of bytes.
+   The return value is the ID number of the metric, or -1 if the registry is full.  If a metric of
+   the same name has been registered, its ID number is returned. */
+int ttmetricsreg(TTMETRICS *metrics, const char *name, int type);
+
+
+/* Get the ID number of a metric of a metrics registry object.
+   `metrics' specifies the metrics registry object.
+   `name' specifies the name of the metric.
+   The return value is the ID number of the metric, or -1 if it is not registered.
+   This function does not lock the registry. */
+int ttmetricsfind(TTMETRICS *metrics, const char *name);
+
+
+/* Get the number of metrics of a metrics registry object.
+   `metrics' specifies the metrics registry object.
+   The return value is the number of registered metrics.  The ID numbers are from 0 to it. */
+int ttmetricsnum(TTMETRICS *metrics);
+
+
+/* Get the name of a metric of a metrics registry object.
+   `metrics' specifies the metrics registry object.
+   `id' specifies the ID number of the metric.
+   The return value is the name of the metric. */
+const char *ttmetricsname(TTMETRICS *metrics, int id);
+
+
+/* Get the type of a metric of a metrics registry object.
+   `metrics' specifies the metrics registry object.
+   `id' specifies the ID number of the metric.
+   The return value is the type of the metric. */
+int ttmetricstype(TTMETRICS *metrics, int id);
+
+
+/* Add a value to a metric of a metrics registry object.
+   `metrics' specifies the metrics registry object.
+   `idx' specifies the index of the slab of the calling thread.  If it is negative or not less
+   than the number of the slabs, the shared slab is updated atomically.
+   `id' specifies the ID number of the metric.
+   `num' specifies the additional value.  It can be negative for a gauge.
+   Only the thread owning the slab of the index should use it. */
+void ttmetricsadd(TTMETRICS *metrics, int idx, int id, int64_t num);
+
+
+/* Get the value of a metric of a metrics registry object.
+   `metrics' specifies the metrics registry object.
+   `id' specifies the ID number of the metric.
+   The return value is the summation of the values of all slabs. */
+int64_t ttmetricssum(TTMETRICS *metrics, int id);
+
+
+
+/*************************************************************************************************
+ * request tracer
+ *************************************************************************************************/
+
+
+#define TTTRACEMAGIC   "TTTRACE"         /* magic data of a trace file */
+#define TTTRACENAMESIZ 20                /* size of the command name of a span */
+
+enum {                                   /* enumeration for stages of a traced request */
+  TTTSREADY,                             /* the connection became ready */
+  TTTSPICKUP,                            /* a worker picked the connection up */
+  TTTSPARSE,                             /* the command was identified */
+  TTTSDBBEGIN,                           /* the call of the database began */
+  TTTSDBEND,                             /* the call of the database ended */
+  TTTSULWAIT,                            /* waiting for the lock of the update log began */
+  TTTSULLOCK,                            /* the lock of the update log was acquired */
+  TTTSULEND,                             /* writing the update log ended */
+  TTTSSEND,                              /* the response was sent */
+  TTTSNUM                                /* number of stages */
+};
+
+enum {                                   /* enumeration for flags of a span */
+  TTTFFORCED = 1 << 0                    /* traced by the request flag */
+};
+
+typedef struct {                         /* type of structure for the header of a trace file */
+  char magic[8];                         /* magic data */
+  uint32_t version;                      /* version of the format */
+  uint32_t spansiz;                      /* size of each span */
+  uint32_t snum;                         /* number of slots */
+  uint32_t stnum;                        /* number of stages */
+  volatile uint64_t head;                /* sequence number to be written next */
+  char pad[32];                          /* padding */
+} TTTRACEHEAD;
+
+typedef struct {                         /* type of structure for a span of a traced request */
+  volatile uint64_t seq;                 /* sequence number plus 1, or 0 while being written */
+  uint32_t flags;                        /* flags */
+  char name[TTTRACENAMESIZ];             /* name of the command */
+  int64_t stamps[TTTSNUM];               /* nanoseconds of the epoch at each stage, or 0 */
+} TTSPAN;
+
+typedef struct {                         /* type of structure for a request tracer */
+  int fd;                                /* file descriptor */
+  TTTRACEHEAD *head;                     /* mapped region of the header */
+  TTSPAN *spans;                         /* mapped region of the slots */
+  size_t msiz;                           /* size of the mapped region */
+} TTTRACER;
+
+
+/* Create a request tracer object.
+   `path' specifies the path of the trace file.  It is created if it does not exist.
+   `snum' specifies the number of slots of the ring of spans.
+   The return value is the new request tracer object or `NULL' on failure.
+   The trace file is mapped on memory and completed spans are written into the slots in the
+   order of the sequence numbers, overwriting the oldest ones, so that another process can read
+   it at any time. */
+TTTRACER *tttracernew(const char *path, int snum);
+
+
+/* Delete a request tracer object.
+   `tracer' specifies the request tracer object.
+   If successful, the return value is true, else, it is false. */
+bool tttracerdel(TTTRACER *tracer);
+
+
+/* Begin a span of a request in the calling thread.
+   `span' specifies the span object owned by the calling thread.
+   `flags' specifies the flags of the span.
+   `rtime' specifies the time when the connection became ready.
+   `ptime' specifies the time when a worker picked the connection up.
+   The current time is recorded as the stage `TTTSPARSE'.  Stages marked later in the same
+   thread are recorded in the span until `tttraceend' is called. */
+void tttracebegin(TTSPAN *span, int flags, double rtime, double ptime);
+
+
+/* Record the current time as a stage of the span of the calling thread.
+   `stage' specifies the stage.
+   If no span is begun in the calling thread, this function does nothing. */
+void tttracemark(int stage);
+
+
+/* End the span of the calling thread and write it into the trace file.
+   `tracer' specifies the request tracer object.
+   `name' specifies the name of the command. */
+void tttraceend(TTTRACER *tracer, const char *name);
+
+
+/* Load the spans in a trace file.
+   `path' specifies the path of the trace file.
+   `np' specifies the pointer to the variable into which the number of the spans is assigned.
+   The return value is the pointer to the array of the spans ordered by the sequence numbers, or
+   `NULL' on failure.  Spans being written are skipped.
+   Because the region of the return value is allocated with the `malloc' call, it should be
+   released with the `free' call when it is no longer in use. */
+TTSPAN *tttraceload(const char *path, int *np);
+
+
+
 /*************************************************************************************************
  * server utilities
  *************************************************************************************************/
@@ -268,17 +496,25 @@ double ttunpackdouble(const char *buf);
 
 #define TTDEFPORT      1978              /* default port of the server */
 #define TTMAGICNUM     0xc8              /* magic number of each command */
+#define TTMAGICTRACE   0xc9              /* magic number of each command to be traced */
 #define TTCMDPUT       0x10              /* ID of put command */
 #define TTCMDPUTKEEP   0x11              /* ID of putkeep command */
 #define TTCMDPUTCAT    0x12              /* ID of putcat command */
 #define TTCMDPUTSHL    0x13              /* ID of putshl command */
+#define TTCMDMPUT      0x14              /* ID of mput command */
 #define TTCMDPUTNR     0x18              /* ID of putnr command */
 #define TTCMDOUT       0x20              /* ID of out command */
+#define TTCMDMOUT      0x21              /* ID of mout command */
 #define TTCMDGET       0x30              /* ID of get command */
 #define TTCMDMGET      0x31              /* ID of mget command */
 #define TTCMDVSIZ      0x38              /* ID of vsiz command */
 #define TTCMDITERINIT  0x50              /* ID of iterinit command */
 #define TTCMDITERNEXT  0x51              /* ID of iternext command */
+#define TTCMDCURNEW    0x52              /* ID of curnew command */
+#define TTCMDCURJUMP   0x53              /* ID of curjump command */
+#define TTCMDCURNEXT   0x54              /* ID of curnext command */
+#define TTCMDCURPREV   0x55              /* ID of curprev command */
+#define TTCMDCURDEL    0x56              /* ID of curdel command */
 #define TTCMDFWMKEYS   0x58              /* ID of fwmkeys command */
 #define TTCMDADDINT    0x60              /* ID of addint command */
 #define TTCMDADDDOUBLE 0x61              /* ID of adddouble command */
@@ -293,9 +529,21 @@ double ttunpackdouble(const char *buf);
 #define TTCMDSIZE      0x81              /* ID of size command */
 #define TTCMDSTAT      0x88              /* ID of stat command */
 #define TTCMDMISC      0x90              /* ID of misc command */
+#define TTCMDBATCH     0x98              /* ID of batch command */
 #define TTCMDREPL      0xa0              /* ID of repl command */
 
 #define TTTIMERMAX     8                 /* maximum number of timers */
+#define TTQUEUEMAX     65536             /* capacity of the request queue */
+#define TTCLSIZ        64                /* size of a cache line */
+#define TTBPCLSNUM     3                 /* number of size classes of the buffer pool */
+#define TTBPMINSIZ     4096              /* size of buffers of the smallest class */
+#define TTBPCLSMAX     256               /* maximum number of pooled buffers of each class */
+
+typedef struct {                         /* type of structure for a slot of the request queue */
+  volatile uint32_t seq;                 /* sequence number */
+  int fd;                                /* file descriptor */
+  double time;                           /* time of enqueueing */
+} TTQSLOT;
 
 typedef struct _TTTIMER {                /* type of structure for a timer */
   pthread_t thid;                        /* thread ID */
@@ -311,8 +559,14 @@ typedef struct _TTREQ {                  /* type of structure for a server */
   bool alive;                            /* alive flag */
   struct _TTSERV *serv;                  /* server object */
   int epfd;                              /* polling file descriptor */
+  int lfd;                               /* listening file descriptor of the reactor */
+  int cfd;                               /* file descriptor of the connection being served */
   double mtime;                          /* last modified time */
+  double rtime;                          /* time when the connection became ready */
+  double ptime;                          /* time when the connection was picked up */
   bool keep;                             /* keep-alive flag */
+  bool detach;                           /* flag whether the connection is handed over */
+  bool suspend;                          /* flag whether the connection is left to the handler */
   int idx;                               /* ordinal index */
 } TTREQ;
 
@@ -320,13 +574,29 @@ typedef struct _TTSERV {                 /* type of structure for a server */
   char host[TTADDRBUFSIZ];               /* host name */
   char addr[TTADDRBUFSIZ];               /* host address */
   uint16_t port;                         /* port number */
-  TCLIST *queue;                         /* queue of requests */
-  pthread_mutex_t qmtx;                  /* mutex for the queue */
-  pthread_cond_t qcnd;                   /* condition variable for the queue */
+  TTQSLOT *qslots;                       /* slots of the queue of requests */
+  char qpad0[TTCLSIZ];                   /* padding for the enqueueing position */
+  volatile uint32_t qhead;               /* enqueueing position of the queue */
+  char qpad1[TTCLSIZ];                   /* padding for the dequeueing position */
+  volatile uint32_t qtail;               /* dequeueing position of the queue */
+  char qpad2[TTCLSIZ];                   /* padding for the parking state */
+  volatile uint32_t qwseq;               /* wake-up sequence of idle workers */
+  volatile int32_t qidle;                /* number of idle workers */
+  char qpad3[TTCLSIZ];                   /* padding for the other members */
+  pthread_mutex_t qmtx;                  /* mutex for parking without futex */
+  pthread_cond_t qcnd;                   /* condition variable for parking without futex */
+  TTSOCK **conns;                        /* table of connections indexed by descriptors */
+  int connsiz;                           /* size of the table of connections */
+  pthread_rwlock_t cnlck;                /* lock for the table of connections */
+  volatile uint32_t connseq;             /* serial number of the last connection */
+  char *bpool[TTBPCLSNUM][TTBPCLSMAX];   /* pooled I/O buffers of each size class */
+  int bpnums[TTBPCLSNUM];                /* numbers of pooled buffers of each size class */
+  pthread_mutex_t bpmtx;                 /* mutex for the buffer pool */
   pthread_mutex_t tmtx;                  /* mutex for the timer */
   pthread_cond_t tcnd;                   /* condition variable for the timer */
   int thnum;                             /* number of threads */
   double timeout;                        /* timeout milliseconds of each task */
+  bool reactor;                          /* reactor mode flag */
   bool term;                             /* terminate flag */
   void (*do_log)(int, const char *, void *);  /* call back function for logging */
   void *opq_log;                         /* opaque pointer for logging */
@@ -334,8 +604,16 @@ typedef struct _TTSERV {                 /* type of structure for a server */
   int timernum;                          /* number of timer objects */
   void (*do_task)(TTSOCK *, void *, TTREQ *);  /* call back function for task */
   void *opq_task;                        /* opaque pointer for task */
+  int (*do_check)(const char *, int, void *);  /* call back function for framing */
+  void *opq_check;                       /* opaque pointer for framing */
   void (*do_term)(void *);               /* call back gunction for termination */
   void *opq_term;                        /* opaque pointer for termination */
+  void (*do_close)(void *, void *);      /* call back function for closing connections */
+  void *opq_close;                       /* opaque pointer for closing connections */
+  TTMETRICS *metrics;                    /* metrics registry */
+  int mtopen;                            /* ID of the metric of opened connections */
+  int mtclose;                           /* ID of the metric of closed connections */
+  int mtconn;                            /* ID of the metric of current connections */
 } TTSERV;
 
 enum {                                   /* enumeration for logging levels */
@@ -374,6 +652,14 @@ bool ttservconf(TTSERV *serv, const char *host, int port);
 void ttservtune(TTSERV *serv, int thnum, double timeout);
 
 
+/* Set the reactor mode of a server object.
+   `serv' specifies the server object.
+   `reactor' specifies whether each worker thread owns a listening socket and a polling
+   descriptor of its own and serves its connections without the shared queue.  It is effective
+   only for TCP/IP sockets on systems supporting `SO_REUSEPORT'.  By default, it is false. */
+void ttservsetreactor(TTSERV *serv, bool reactor);
+
+
 /* Set the logging handler of a server object.
    `serv' specifies the server object.
    `do_log' specifies the pointer to a function to do with a log message.  Its first parameter is
@@ -388,8 +674,10 @@ void ttservsetloghandler(TTSERV *serv, void (*do_log)(int, const char *, void *)
    `freq' specifies the frequency of execution in seconds.
    `do_timed' specifies the pointer to a function to do with a event.  Its parameter is the
    opaque pointer.
-   `opq' specifies the opaque pointer to be passed to the handler.  It can be `NULL'. */
-void ttservaddtimedhandler(TTSERV *serv, double freq, void (*do_timed)(void *), void *opq);
+   `opq' specifies the opaque pointer to be passed to the handler.  It can be `NULL'.
+   If successful, the return value is true, else, it is false.
+   At most `TTTIMERMAX' handlers can be added.  The failure of adding more is logged. */
+bool ttservaddtimedhandler(TTSERV *serv, double freq, void (*do_timed)(void *), void *opq);
 
 
 /* Set the response handler of a server object.
@@ -397,10 +685,30 @@ void ttservaddtimedhandler(TTSERV *serv, double freq, void (*do_timed)(void *),
    `do_task' specifies the pointer to a function to do with a task.  Its first parameter is
    the socket object connected to the client.  Its second parameter is the opaque pointer.  Its
    third parameter is the request object.
-   `opq' specifies the opaque pointer to be passed to the handler.  It can be `NULL'. */
+   `opq' specifies the opaque pointer to be passed to the handler.  It can be `NULL'.
+   If the handler sets the `keep' member of the request object, the connection is kept alive.
+   If it sets the `detach' member, the server stops serving the connection and closes the
+   descriptor without shutting the socket down, so that a duplicated descriptor can be used
+   by another thread.  If it sets the `suspend' member, the server leaves the connection and the
+   socket object to the handler until `ttservresume' is called for them. */
 void ttservsettaskhandler(TTSERV *serv, void (*do_task)(TTSOCK *, void *, TTREQ *), void *opq);
 
 
+/* Set the framing handler of a server object.
+   `serv' specifies the server object.
+   `do_check' specifies the pointer to a function to measure the first request in received data.
+   Its first parameter is the pointer to the region of the data.  Its second parameter is the
+   size of the region.  Its third parameter is the opaque pointer.  It should return the number
+   of bytes needed to complete the first request, or the number of bytes needed to know it if
+   the data is too short.  If the return value is not more than the size of the data, the
+   request is dispatched to the response handler.
+   `opq' specifies the opaque pointer to be passed to the handler.  It can be `NULL'.
+   If this handler is set, data of each connection is received without blocking and a partial
+   request is kept in the socket object until the rest arrives, so that a slow client does not
+   occupy a worker thread. */
+void ttservsetcheckhandler(TTSERV *serv, int (*do_check)(const char *, int, void *), void *opq);
+
+
 /* Set the termination handler of a server object.
    `serv' specifies the server object.
    `do_term' specifies the pointer to a function to do with a task.  Its parameter is the opaque
@@ -409,12 +717,48 @@ void ttservsettaskhandler(TTSERV *serv, void (*do_task)(TTSOCK *, void *, TTREQ
 void ttservsettermhandler(TTSERV *serv, void (*do_term)(void *), void *opq);
 
 
+/* Set the closing handler of a server object.
+   `serv' specifies the server object.
+   `do_close' specifies the pointer to a function to release the state of a connection.  Its
+   first parameter is the opaque pointer of the socket object of the connection.  Its second
+   parameter is the opaque pointer of the handler.
+   `opq' specifies the opaque pointer to be passed to the handler.  It can be `NULL'.
+   The handler is called when a connection whose socket object has the opaque pointer is
+   closed, so that the task handler can keep state of each connection there. */
+void ttservsetclosehandler(TTSERV *serv, void (*do_close)(void *, void *), void *opq);
+
+
+/* Set the metrics registry of a server object.
+   `serv' specifies the server object.
+   `metrics' specifies the metrics registry object.  The metrics "conn_opened", "conn_closed",
+   and "connections" are registered in it and updated by the server.  Worker threads update the
+   slabs of their ordinal indexes. */
+void ttservsetmetrics(TTSERV *serv, TTMETRICS *metrics);
+
+
 /* Start the service of a server object.
    `serv' specifies the server object.
    If successful, the return value is true, else, it is false. */
 bool ttservstart(TTSERV *serv);
 
 
+/* Get the number of requests waiting in the queue of a server object.
+   `serv' specifies the server object.
+   The return value is the number of connections ready to be served but not dequeued by any
+   worker yet.  It is always 0 in the reactor mode. */
+int ttservqueuenum(TTSERV *serv);
+
+
+/* Resume serving a connection suspended by the task handler of a server object.
+   `req' specifies the request object given to the handler with the connection, or its copy.
+   `sock' specifies the socket object of the connection.
+   The rest of the received data is processed by the task handler in the calling thread, and then
+   the connection is given back to the server or closed according to the `keep' and `detach'
+   members of the request object.
+   If successful, the return value is true, else, it is false. */
+bool ttservresume(TTREQ *req, TTSOCK *sock);
+
+
 /* Send the terminate signal to a server object.
    `serv' specifies the server object.
    If successful, the return value is true, else, it is false. */